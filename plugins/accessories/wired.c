@@ -136,13 +136,16 @@ typedef struct {
 static int  jack_init (OhmPlugin *plugin, input_dev_t *dev);
 static int  jack_exit (input_dev_t *dev);
 static int  jack_event(struct input_event *event, void *user_data);
+static void jack_settle(void);
+static void jack_cancel_settle(void);
 static void jack_update_facts(int initial_query);
 
 static int   eci_init  (OhmPlugin *plugin, input_dev_t *dev);
 static int   eci_exit  (input_dev_t *dev);
 static int   eci_event (struct input_event *event, void *user_data);
-static int   eci_read  (char *buf, size_t size);
+static int   eci_read  (char *buf, size_t size, int *nread);
 static int   eci_update_mode(device_state_t *device);
+static void  eci_reset(void);
 static void  eci_schedule_update(device_state_t *device, int msecs);
 static void  eci_cancel_update(void);
 
@@ -200,16 +203,42 @@ static int inverted;                              /* inverted jack events */
 
 static gulong eci_timer;                          /* eci detection timer */
 static int    probe_delay = ECI_PROBE_DELAY;      /* eci detection delay */
+static gulong jack_timer;                         /* jack debounce timer */
+static int    debounce = JACK_DEBOUNCE_DELAY;     /* jack debounce delay */
+
+
+/*
+ * ECI accessory memory, cached per insertion
+ */
+
+static struct {
+    int         valid;                            /* memory read and cached */
+    const char *mode;                             /* mode last updated */
+    int         resolved;                         /* resolved with mode */
+    int         size;                             /* memory size */
+    char        data[ECI_MEMORY_SIZE];            /* memory contents */
+} eci;
+
+
+/*
+ * resolution statistics
+ */
+
+static unsigned int nresolve;                     /* resolutions done */
+static unsigned int ndebounce;                    /* frames debounced */
+static unsigned int nunchanged;                   /* settled, no change */
+static unsigned int necicached;                   /* ECI probes from cache */
+static int          dropped;                      /* events dropped */
 
 /*****************************************************************************
  *                             *** jack insertion ***                        *
  *****************************************************************************/
 
 /********************
- * jack_query
+ * jack_read_state
  ********************/
 static int
-jack_query(int fd)
+jack_read_state(int fd)
 {
     uint32_t bitmask[NBITS(KEY_MAX)];
     
@@ -231,6 +260,19 @@ jack_query(int fd)
     incompatible = test_bit(SW_JACK_PHYSICAL_INSERT, bitmask);
 #endif
 
+    return TRUE;
+}
+
+
+/********************
+ * jack_query
+ ********************/
+static int
+jack_query(int fd)
+{
+    if (!jack_read_state(fd))
+        return FALSE;
+
     OHM_INFO("accessories: headphone is %sconnected" , headphone  ? "" : "dis");
     OHM_INFO("accessories: microphone is %sconnected", microphone ? "" : "dis");
     OHM_INFO("accessories: lineout is %sconnected"   , lineout    ? "" : "dis");
@@ -263,9 +305,23 @@ jack_init(OhmPlugin *plugin, input_dev_t *dev)
     const char *device;
     const char *pattern;
     const char *invert;
+    const char *delay;
 
     invert = ohm_plugin_get_param(plugin, "inverted-jack-events");
     device = ohm_plugin_get_param(plugin, "jack-device");
+    delay  = ohm_plugin_get_param(plugin, "jack-debounce");
+
+    if (delay != NULL) {
+        errno = 0;
+        debounce = (int)strtoul(delay, NULL, 10);
+        if (errno != 0) {
+            OHM_ERROR("accessories: invalid jack debounce delay '%s'", delay);
+            debounce = JACK_DEBOUNCE_DELAY;
+        }
+        else
+            OHM_INFO("accessories: using jack debounce delay %d", debounce);
+        errno = 0;
+    }
 
     if (invert != NULL && !strcasecmp(invert, "true")) {
         OHM_INFO("accessories: jack events have inverted semantics");
@@ -293,6 +349,7 @@ jack_init(OhmPlugin *plugin, input_dev_t *dev)
     }
     
     if (dev->fd >= 0) {
+        dev->user_data = dev;
         jack_query(dev->fd);
         return TRUE;
     }
@@ -309,6 +366,8 @@ jack_init(OhmPlugin *plugin, input_dev_t *dev)
 static int
 jack_exit(input_dev_t *dev)
 {
+    jack_cancel_settle();
+
     if (dev->fd >= 0) {
         close(dev->fd);
         dev->fd = -1;
@@ -324,23 +383,48 @@ jack_exit(input_dev_t *dev)
 static int
 jack_event(struct input_event *event, void *user_data)
 {
-    int value;
+    input_dev_t *dev = (input_dev_t *)user_data;
+    int          value;
     
-    (void)user_data;
+    if (event->type == EV_SYN) {
+#ifdef SYN_DROPPED
+        if (event->code == SYN_DROPPED) {
+            OHM_DEBUG(DBG_WIRED, "jack events dropped, resynchronizing");
+            dropped = TRUE;
+            return TRUE;
+        }
+#endif
+        if (event->code != SYN_REPORT)
+            return TRUE;
+
+        /*
+         * Notes: After a dropped event the switch states we tracked are
+         *     unreliable, so we query them from the device once the next
+         *     complete report has arrived.
+         */
+        if (dropped) {
+            if (dev != NULL)
+                jack_read_state(dev->fd);
+            dropped = FALSE;
+        }
 
-    if (event->type != EV_SW && event->type != EV_SYN) {
+        jack_settle();
+        return TRUE;
+    }
+
+    if (event->type != EV_SW) {
         OHM_DEBUG(DBG_WIRED, "ignoring jack event type %d", event->type);
         return TRUE;
     }
 
+    if (dropped)
+        return TRUE;
+
     value = (event->value ? 1 : 0) ^ inverted;
     
     OHM_DEBUG(DBG_WIRED, "jack detection event (%d, %d (interpret as: %d))",
               event->code, event->value, value);
 
-    if (event->type == EV_SYN)
-        goto SYN_EVENT;
-
     switch (event->code) {
     case SW_HEADPHONE_INSERT:
         headphone = value;
@@ -368,10 +452,6 @@ jack_event(struct input_event *event, void *user_data)
         break;
 #endif
 
-    SYN_EVENT:
-        jack_update_facts(FALSE);
-        break;
-
     default:
         OHM_WARNING("accessories: unknown event code 0x%x", event->code);
         break;
@@ -381,6 +461,72 @@ jack_event(struct input_event *event, void *user_data)
 }
 
 
+/********************
+ * jack_settle_cb
+ ********************/
+static gboolean
+jack_settle_cb(gpointer data)
+{
+    (void)data;
+
+    jack_timer = 0;
+    jack_update_facts(FALSE);
+
+    return FALSE;
+}
+
+
+/********************
+ * jack_settle
+ ********************/
+static void
+jack_settle(void)
+{
+    /*
+     * Notes: A mechanical plug insertion or removal bounces, producing
+     *     a burst of reports within a few tens of milliseconds. Instead of
+     *     resolving every intermediate state we wait until the reports
+     *     stop for the debounce period and resolve only the settled one.
+     */
+
+    if (debounce <= 0) {
+        jack_update_facts(FALSE);
+        return;
+    }
+
+    if (jack_timer != 0) {
+        g_source_remove(jack_timer);
+        ndebounce++;
+    }
+
+    jack_timer = g_timeout_add(debounce, jack_settle_cb, NULL);
+}
+
+
+/********************
+ * jack_cancel_settle
+ ********************/
+static void
+jack_cancel_settle(void)
+{
+    if (jack_timer != 0) {
+        g_source_remove(jack_timer);
+        jack_timer = 0;
+    }
+}
+
+
+/********************
+ * accessory_request
+ ********************/
+static void
+accessory_request(const char *name, int connected)
+{
+    nresolve++;
+    dres_accessory_request(name, -1, connected);
+}
+
+
 /********************
  * jack_connect
  ********************/
@@ -412,6 +558,7 @@ static void
 jack_update_facts(int initial_query)
 {
     device_state_t *device, *current;
+    int             changed;
 
     if      (incompatible)            current = states + DEV_INCOMPATIBLE;
     else if (headphone && microphone) current = states + DEV_HEADSET;
@@ -424,14 +571,27 @@ jack_update_facts(int initial_query)
     if (current != NULL && current->name == NULL)   /* filter out line-out */
         current = NULL;
     
+    changed = (current != NULL && !current->connected);
+
     for (device = states; device->name != NULL; device++) {
         if (device != current && device->connected) {
             jack_disconnect(device);
+            changed = TRUE;
             if (!initial_query)
-                dres_accessory_request(device->name, -1, 0);
+                accessory_request(device->name, 0);
+        }
+    }
+
+    if (!changed) {
+        if (!initial_query) {
+            OHM_DEBUG(DBG_WIRED, "settled jack state unchanged, not resolving");
+            nunchanged++;
         }
+        return;
     }
 
+    eci_reset();
+
     if (current != NULL) {
         jack_connect(current);
         
@@ -451,7 +611,8 @@ jack_update_facts(int initial_query)
         if (!initial_query) {
             if (!incompatible)
                 eci_update_mode(current);
-            dres_accessory_request(current->name, -1, 1);
+            accessory_request(current->name, 1);
+            eci.resolved = TRUE;
         }
         
         if (!incompatible)
@@ -550,9 +711,12 @@ eci_event(struct input_event *event, void *user_data)
  * eci_read
  ********************/
 static int
-eci_read(char *buf, size_t size)
+eci_read(char *buf, size_t size, int *nread)
 {
     int fd, status;
+    int n;
+
+    *nread = 0;
 
     if ((fd = open(ECI_MEMORY_PATH, O_RDONLY)) < 0) {
         if (errno == ENOENT)
@@ -561,10 +725,12 @@ eci_read(char *buf, size_t size)
             status = errno;
     }
     else {
-        if (read(fd, buf, size) < 0)
+        if ((n = read(fd, buf, size)) < 0)
             status = errno;
-        else
+        else {
             status = 0;
+            *nread = n;
+        }
 
         close(fd);
     }
@@ -582,10 +748,25 @@ static gboolean
 eci_timer_cb(gpointer data)
 {
     device_state_t *device = (device_state_t *)data;
+    const char     *mode   = eci.mode;
     int             success;
     
     success = eci_update_mode(device);
-    dres_accessory_request(device->name, -1, device->connected);
+
+    /*
+     * Notes: The deferred probe is there to catch ECI accessories the
+     *     initial probe misdetected. If the mode has not changed since we
+     *     last resolved for this insertion, resolving again is pointless.
+     */
+    if (eci.resolved && eci.mode == mode) {
+        OHM_DEBUG(DBG_WIRED, "ECI mode of %s unchanged, not resolving",
+                  device->name);
+        necicached++;
+    }
+    else {
+        accessory_request(device->name, device->connected);
+        eci.resolved = TRUE;
+    }
     
     if (success)
         return CLEAR_TIMER;
@@ -619,6 +800,19 @@ eci_cancel_update(void)
 }
 
 
+/********************
+ * eci_reset
+ ********************/
+static void
+eci_reset(void)
+{
+    eci.valid    = FALSE;
+    eci.mode     = NULL;
+    eci.resolved = FALSE;
+    eci.size     = 0;
+}
+
+
 /********************
  * eci_update_mode
  ********************/
@@ -626,10 +820,24 @@ static int
 eci_update_mode(device_state_t *device)
 {
     const char *mode;
-    char        data[4096];
     int         status;
 
-    status = eci_read(data, sizeof(data));
+    /*
+     * Notes: The accessory memory does not change during an insertion,
+     *     so once it has been read successfully we keep using the cached
+     *     copy instead of going to the driver (and the accessory) again.
+     */
+
+    if (eci.valid) {
+        OHM_DEBUG(DBG_WIRED, "using cached ECI memory (%d bytes)", eci.size);
+        status = 0;
+    }
+    else {
+        status = eci_read(eci.data, sizeof(eci.data), &eci.size);
+        
+        if (status == 0)
+            eci.valid = TRUE;
+    }
 
     if (status == EAGAIN || status == 0)
         mode = DEVICE_MODE_ECI;
@@ -637,13 +845,15 @@ eci_update_mode(device_state_t *device)
         mode = DEVICE_MODE_DEFAULT;
     else {
         OHM_ERROR("accessories: ECI detection failed with errno %d (%s)",
-                  errno, strerror(errno));
+                  status, strerror(status));
         return TRUE;                             /* don't retry */
     }
     
-    OHM_INFO("accessories: accessory %s is in %s mode", device->name, mode);
-    dres_update_accessory_mode(device->name, mode);
-    
+    if (mode != eci.mode) {
+        OHM_INFO("accessories: accessory %s is in %s mode", device->name, mode);
+        dres_update_accessory_mode(device->name, mode);
+        eci.mode = mode;
+    }
 
     return TRUE;                                 /* don't retry */
 }
@@ -789,17 +999,32 @@ static gboolean
 event_handler(GIOChannel *gioc, GIOCondition mask, gpointer data)
 {
     input_dev_t        *dev = (input_dev_t *)data;
-    struct input_event  event;
+    struct input_event  events[INPUT_EVENT_BATCH];
+    ssize_t             size;
+    int                 i, n;
 
     (void)gioc;
 
+    /*
+     * Notes: evdev always returns whole events, as many as fit into
+     *     the buffer, so we can pick up a full report with one read.
+     */
+
     if (mask & G_IO_IN) {
-        if (read(dev->fd, &event, sizeof(event)) != sizeof(event)) {
+        size = read(dev->fd, events, sizeof(events));
+
+        if (size < 0 && (errno == EINTR || errno == EAGAIN))
+            return TRUE;
+        
+        if (size <= 0 || size % sizeof(events[0]) != 0) {
             OHM_ERROR("accessories: failed to read %s event", dev->name);
             return FALSE;
         }
 
-        dev->ops.event(&event, dev->user_data);
+        n = size / sizeof(events[0]);
+
+        for (i = 0; i < n; i++)
+            dev->ops.event(events + i, dev->user_data);
     }
 
     if (mask & G_IO_HUP) {
@@ -890,6 +1115,10 @@ wired_exit(void)
         dev->ops.exit(dev);
     }
 
+    OHM_INFO("accessories: %u wired accessory resolutions, suppressed "
+             "%u debounced, %u unchanged, %u cached ECI", nresolve,
+             ndebounce, nunchanged, necicached);
+
     release_facts();
 }
 
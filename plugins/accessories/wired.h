@@ -27,6 +27,9 @@ USA.
 #define DEVICE_MODE_DEFAULT      "default"
 #define ECI_MEMORY_PATH          "/sys/devices/platform/ECI_accessory.0/memory"
 #define ECI_PROBE_DELAY          2500
+#define ECI_MEMORY_SIZE          4096
+#define JACK_DEBOUNCE_DELAY      100
+#define INPUT_EVENT_BATCH        64
 
 
 void wired_init(OhmPlugin *plugin, int dbg_wired);
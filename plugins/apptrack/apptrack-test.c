@@ -21,6 +21,8 @@ USA.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <dbus/dbus.h>
@@ -32,6 +34,7 @@ USA.
 #define APPTRACK_NOTIFY      "CurrentActiveApplication"
 #define APPTRACK_SUBSCRIBE   "Subscribe"
 #define APPTRACK_UNSUBSCRIBE "Unsubscribe"
+#define APPTRACK_SUBSCRIBE_PID "SubscribePid"
 
 #define fatal(fmt, args...) do {                                \
         fprintf(stderr, "fatal error: "fmt"\n" , ## args);      \
@@ -45,6 +48,7 @@ USA.
 
 
 static DBusConnection *sys_conn;
+static uint32_t        own_pid;         /* unicast mode if non-zero */
 
 
 static void
@@ -100,10 +104,16 @@ apptrack_subscribe(void)
     msg = dbus_message_new_method_call(APPTRACK_SERVICE,
                                        APPTRACK_PATH,
                                        APPTRACK_INTERFACE,
-                                       APPTRACK_SUBSCRIBE);
+                                       own_pid ? APPTRACK_SUBSCRIBE_PID :
+                                                 APPTRACK_SUBSCRIBE);
     if (msg == NULL)
         fatal("failed to allocate D-BUS message");
 
+    if (own_pid && !dbus_message_append_args(msg,
+                                             DBUS_TYPE_UINT32, &own_pid,
+                                             DBUS_TYPE_INVALID))
+        fatal("failed to fill D-BUS message");
+
     if (!dbus_connection_send_with_reply(sys_conn, msg, &pcall, -1))
         fatal("failed to send D-BUS subscribe message");
 
@@ -210,8 +220,9 @@ int main(int argc, char *argv[])
 {
     GMainLoop *loop;
 
-    (void)argc;
-    (void)argv;
+    /* -p: only get notified about our own process */
+    if (argc > 1 && !strcmp(argv[1], "-p"))
+        own_pid = (uint32_t)getpid();
 
     loop = g_main_loop_new(NULL, FALSE);
     if (loop == NULL)
@@ -51,9 +51,28 @@ OHM_IMPORTABLE(void, app_query,       (pid_t *pid,
                                        const char **group));
 
 
+/*
+ * A client either gets every change broadcast (pid == 0), or subscribes
+ * for a single pid (unicast mode) and gets a signal addressed to it only
+ * when its process becomes or stops being the active application.
+ */
+
+typedef struct {
+    pid_t pid;                           /* pid of interest, or 0 */
+    int   active;                        /* whether pid was last active */
+} client_t;
+
 static DBusConnection *bus;
 static GHashTable     *clients;
 static int             nclient;
+static int             nunicast;         /* clients in unicast mode */
+
+static pid_t           last_pid = -1;    /* last notified application */
+static char           *last_group;
+
+static unsigned int    nbroadcast;       /* broadcast signals sent */
+static unsigned int    nunicast_sent;    /* unicast signals sent */
+static unsigned int    nsuppressed;      /* notifications not sent */
 
 
 /********************
@@ -112,17 +131,32 @@ client_lookup(const char *id)
  * client_register
  ********************/
 static void
-client_register(const char *id)
+client_register(const char *id, pid_t pid, pid_t active)
 {
-    gpointer key;
+    gpointer  key;
+    client_t *client;
 
-    if (!client_lookup(id) && (key = strdup(id)) != NULL) {
-        g_hash_table_insert(clients, key, (gpointer)1);
-        nclient++;
-        client_track_name(id, TRUE);
+    if (client_lookup(id))
+        return;
+    
+    if ((key = g_strdup(id)) == NULL || (client = g_new0(client_t, 1)) == NULL) {
+        g_free(key);
+        return;
+    }
 
+    client->pid    = pid;
+    client->active = (pid != 0 && pid == active);
+    
+    g_hash_table_insert(clients, key, client);
+    nclient++;
+    if (pid != 0)
+        nunicast++;
+    client_track_name(id, TRUE);
+
+    if (pid != 0)
+        OHM_INFO("apptrack: registered client %s for pid %u", id, pid);
+    else
         OHM_INFO("apptrack: registered client %s", id);
-    }
 }
 
 
@@ -132,9 +166,14 @@ client_register(const char *id)
 static void
 client_unregister(const char *id)
 {
-    if (client_lookup(id)) {
+    client_t *client;
+
+    if ((client = g_hash_table_lookup(clients, id)) != NULL) {
         OHM_INFO("apptrack: unregistering client %s", id);
 
+        if (client->pid != 0)
+            nunicast--;
+
         client_track_name(id, FALSE);
         g_hash_table_remove(clients, id);
         nclient--;
@@ -143,30 +182,25 @@ client_unregister(const char *id)
 
 
 /********************
- * client_subscribe
+ * subscribe_reply
  ********************/
 static DBusHandlerResult
-client_subscribe(DBusConnection *conn, DBusMessage *msg, void *user_data)
+subscribe_reply(DBusConnection *conn, DBusMessage *msg, uint32_t u32own)
 {
     DBusMessage *reply;
     const char  *sender, *binary, *argv0, *group;
     pid_t        pid;
     uint32_t     u32pid;
     
-    (void)user_data;
-    
-    if (!dbus_message_is_method_call(msg, APPTRACK_INTERFACE, "Subscribe"))
-        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-    
     sender = dbus_message_get_sender(msg);
     if (!client_lookup(sender)) {
-        client_register(sender);
-        
         binary = NULL;
         group  = NULL;
 
         app_query(&pid, &binary, &argv0, &group);
 
+        client_register(sender, (pid_t)u32own, pid);
+        
         if (binary == NULL)
             binary = "";
         if (argv0 == NULL)
@@ -197,6 +231,52 @@ client_subscribe(DBusConnection *conn, DBusMessage *msg, void *user_data)
 }
 
 
+/********************
+ * client_subscribe
+ ********************/
+static DBusHandlerResult
+client_subscribe(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+    (void)user_data;
+    
+    if (!dbus_message_is_method_call(msg, APPTRACK_INTERFACE, "Subscribe"))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    return subscribe_reply(conn, msg, 0);
+}
+
+
+/********************
+ * client_subscribe_pid
+ ********************/
+static DBusHandlerResult
+client_subscribe_pid(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+    DBusMessage *reply;
+    uint32_t     u32pid;
+    
+    (void)user_data;
+    
+    if (!dbus_message_is_method_call(msg, APPTRACK_INTERFACE,
+                                     APPTRACK_SUBSCRIBE_PID))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (!dbus_message_get_args(msg, NULL,
+                               DBUS_TYPE_UINT32, &u32pid,
+                               DBUS_TYPE_INVALID) || u32pid == 0) {
+        reply = dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS,
+                                       "expecting a non-zero pid");
+        if (reply != NULL) {
+            dbus_connection_send(conn, reply, NULL);
+            dbus_message_unref(reply);
+        }
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+    
+    return subscribe_reply(conn, msg, u32pid);
+}
+
+
 /********************
  * client_unsubscribe
  ********************/
@@ -232,7 +312,7 @@ client_unsubscribe(DBusConnection *conn, DBusMessage *msg, void *user_data)
  ********************/
 static void
 client_notify(const char *binary, const char *group, const char *argv0,
-              pid_t pid)
+              pid_t pid, const char *dest)
 {
     DBusMessage *msg;
     uint32_t     u32pid;
@@ -243,6 +323,12 @@ client_notify(const char *binary, const char *group, const char *argv0,
         return;
     }
 
+    if (dest != NULL && !dbus_message_set_destination(msg, dest)) {
+        OHM_ERROR("apptrack: failed to set D-BUS signal destination");
+        dbus_message_unref(msg);
+        return;
+    }
+
     u32pid = pid;
     if (dbus_message_append_args(msg,
                                  DBUS_TYPE_STRING, &binary,
@@ -265,7 +351,11 @@ static void
 app_change_cb(pid_t pid, const char *binary, const char *argv0,
               const char *group, void *dummy)
 {
-    (void)pid;
+    GHashTableIter  it;
+    gpointer        key, value;
+    client_t       *client;
+    int             active;
+
     (void)dummy;
 
 #if 0
@@ -283,7 +373,41 @@ app_change_cb(pid_t pid, const char *binary, const char *argv0,
     if (group == NULL)
         group = "";
 
-    client_notify(binary, group, argv0, pid);
+    /* suppress repeated notifications of the same application */
+    if (pid == last_pid && last_group != NULL && !strcmp(group, last_group)) {
+        nsuppressed += nclient;
+        return;
+    }
+
+    last_pid = pid;
+    g_free(last_group);
+    last_group = g_strdup(group);
+
+    if (nclient > nunicast) {
+        client_notify(binary, group, argv0, pid, NULL);
+        nbroadcast++;
+    }
+
+    if (nunicast <= 0)
+        return;
+
+    g_hash_table_iter_init(&it, clients);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        client = (client_t *)value;
+
+        if (client->pid == 0)
+            continue;
+
+        active = (client->pid == pid);
+
+        if (active != client->active) {
+            client_notify(binary, group, argv0, pid, (const char *)key);
+            client->active = active;
+            nunicast_sent++;
+        }
+        else
+            nsuppressed++;
+    }
 }
 
 
@@ -335,7 +459,7 @@ plugin_init(OhmPlugin *plugin)
         exit(1);
     }
     
-    clients = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    clients = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     if (clients == NULL) {
         OHM_ERROR("apptrack: failed to create client table");
         exit(1);
@@ -359,9 +483,17 @@ plugin_exit(OhmPlugin *plugin)
     if (clients != NULL) {
         g_hash_table_destroy(clients);
 
-        clients = NULL;
-        nclient = 0;
+        clients  = NULL;
+        nclient  = 0;
+        nunicast = 0;
     }
+
+    g_free(last_group);
+    last_group = NULL;
+    last_pid   = -1;
+
+    OHM_INFO("apptrack: %u broadcast, %u unicast notifications, "
+             "%u suppressed", nbroadcast, nunicast_sent, nsuppressed);
 }
 
 
@@ -385,7 +517,9 @@ OHM_PLUGIN_DBUS_METHODS(
     { APPTRACK_INTERFACE, APPTRACK_PATH, APPTRACK_SUBSCRIBE,
             client_subscribe, NULL },
     { APPTRACK_INTERFACE, APPTRACK_PATH, APPTRACK_UNSUBSCRIBE,
-            client_unsubscribe, NULL });
+            client_unsubscribe, NULL },
+    { APPTRACK_INTERFACE, APPTRACK_PATH, APPTRACK_SUBSCRIBE_PID,
+            client_subscribe_pid, NULL });
 
 
 /* 
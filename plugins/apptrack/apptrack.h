@@ -32,6 +32,7 @@ USA.
 #define APPTRACK_NOTIFY       "CurrentActiveApplication"
 #define APPTRACK_SUBSCRIBE    "Subscribe"
 #define APPTRACK_UNSUBSCRIBE  "Unsubscribe"
+#define APPTRACK_SUBSCRIBE_PID "SubscribePid"
 
 
 #endif /* __APPTRACK_PLUGIN_H__ */
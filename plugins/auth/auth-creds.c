@@ -24,6 +24,8 @@ USA.
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_CREDS
 #include <sys/creds.h>
@@ -34,6 +36,47 @@ USA.
 
 
 
+#define DEFAULT_CACHE_SIZE  64
+
+typedef struct {
+    unsigned long long  start;       /* start time of the task */
+    dev_t               dev;         /* device of the executable */
+    ino_t               ino;         /* inode of the executable */
+} task_id_t;
+
+typedef struct decision_s {
+    struct decision_s *prev;         /* LRU list, least recently used */
+    struct decision_s *next;         /*   first */
+    char              *key;          /* pid and pattern set */
+    pid_t              pid;          /* pid of the task */
+    task_id_t          task;         /* identity of the task when checked */
+    int                success;      /* outcome of the check */
+    char              *err;          /* message of the check */
+} decision_t;
+
+typedef struct {
+    GHashTable   *hash;              /* key -> decision_t */
+    decision_t    lru;               /* list head */
+    int           size;              /* number of cached decisions */
+    int           max;               /* max. number of cached decisions */
+    unsigned int  nhit;              /* decision found in cache */
+    unsigned int  nmiss;             /* decision not in cache */
+    unsigned int  nstale;            /* found but the task has changed */
+    unsigned int  nevict;            /* dropped to make room */
+} cache_t;
+
+static cache_t cache;
+
+static int   check_creds(pid_t, char **, char *, int);
+static int   task_identify(pid_t, task_id_t *);
+static char *cache_key(pid_t, char **, char *, int);
+static void  cache_insert(char *, pid_t, task_id_t *, int, char *);
+static void  cache_remove(decision_t *);
+static void  lru_unlink(decision_t *);
+static void  lru_append(decision_t *);
+
+
+
 /*! \addtogroup pubif
  *  Functions
  *  @{
@@ -41,18 +84,148 @@ USA.
 
 void auth_creds_init(OhmPlugin *plugin)
 {
-    (void)plugin;
+    const char *size;
+    char       *end;
+
+    cache.max = DEFAULT_CACHE_SIZE;
+
+    if ((size = ohm_plugin_get_param(plugin, "creds-cache-size")) != NULL) {
+        cache.max = (int)strtol(size, &end, 10);
+
+        if (*end || cache.max < 0) {
+            OHM_ERROR("auth: invalid creds-cache-size '%s'", size);
+            cache.max = DEFAULT_CACHE_SIZE;
+        }
+    }
+
+    cache.lru.prev = cache.lru.next = &cache.lru;
+
+    if (cache.max > 0) {
+        cache.hash = g_hash_table_new(g_str_hash, g_str_equal);
+
+        if (cache.hash == NULL) {
+            OHM_ERROR("auth: failed to create credential cache");
+            cache.max = 0;
+        }
+    }
+
+    OHM_INFO("auth: credential cache size %d", cache.max);
 }
 
 void auth_creds_exit(OhmPlugin *plugin)
 {
     (void)plugin;
+
+    if (cache.max > 0)
+        OHM_INFO("auth: credential cache: %u hits, %u misses, %u stale, "
+                 "%u evicted", cache.nhit, cache.nmiss, cache.nstale,
+                 cache.nevict);
+
+    while (cache.lru.next != &cache.lru)
+        cache_remove(cache.lru.next);
+
+    if (cache.hash != NULL) {
+        g_hash_table_destroy(cache.hash);
+        cache.hash = NULL;
+    }
+
+    cache.max = 0;
 }
 
 int auth_creds_check(pid_t pid, void *request, char *err, int len)
+{
+    char       **pattern = (char **)request;
+    decision_t  *dec;
+    task_id_t    task, after;
+    char         keybuf[512], *key;
+    int          identified;
+    int          success;
+
+    if (cache.max <= 0 || (key = cache_key(pid, pattern, keybuf,
+                                           sizeof(keybuf))) == NULL)
+        return check_creds(pid, pattern, err, len);
+
+    identified = task_identify(pid, &task);
+
+    if ((dec = g_hash_table_lookup(cache.hash, key)) != NULL) {
+        if (identified && !memcmp(&dec->task, &task, sizeof(task))) {
+            OHM_DEBUG(DBG_CREDS, "cached decision for pid %u: %s",
+                      pid, dec->err);
+
+            lru_unlink(dec);
+            lru_append(dec);
+            cache.nhit++;
+
+            snprintf(err, len, "%s", dec->err);
+            return dec->success;
+        }
+
+        OHM_DEBUG(DBG_CREDS, "cached decision for pid %u is stale", pid);
+
+        cache_remove(dec);
+        cache.nstale++;
+    }
+
+    cache.nmiss++;
+
+    success = check_creds(pid, pattern, err, len);
+
+    /*
+     * Notes:
+     *   The decision is cached only if the task looks the same before and
+     *   after reading its credentials. Otherwise the pid might have been
+     *   reused or the task might have exec'd (and so changed its creds)
+     *   while we were checking it.
+     */
+    if (identified && task_identify(pid, &after) &&
+        !memcmp(&task, &after, sizeof(task)))
+        cache_insert(key, pid, &task, success, err);
+
+    return success;
+}
+
+void auth_creds_forget(pid_t pid)
+{
+    decision_t *dec, *next;
+
+    for (dec = cache.lru.next;  dec != &cache.lru;  dec = next) {
+        next = dec->next;
+
+        if (dec->pid == pid) {
+            OHM_DEBUG(DBG_CREDS, "forgetting decision '%s'", dec->key);
+            cache_remove(dec);
+        }
+    }
+}
+
+char *auth_creds_request_dump(void *request, char *buf, int len)
+{
+    char **list = (char **)request;
+    char  *p    = buf;
+    int    prl;
+    char  *sep;
+    int    i;
+
+    for (i = 0, sep = "";  list[i] && len > 0;  i++, sep = ", ") {
+        prl = snprintf(p, len, "%s%s", sep, list[i]);
+
+        p   += prl;
+        len -= prl;
+    }
+
+    return buf;
+}
+
+
+
+
+/*!
+ * @}
+ */
+
+static int check_creds(pid_t pid, char **pattern, char *err, int len)
 {
 #ifdef HAVE_CREDS
-    char    **pattern = (char **)request;
     creds_t   creds;
     int       i;
     char      match[256];
@@ -93,7 +266,8 @@ int auth_creds_check(pid_t pid, void *request, char *err, int len)
     return success;
     
 #else
-    (void)request;
+    (void)pid;
+    (void)pattern;
 
     snprintf(err, len, "OK (default acceptance: creds are not available)");
 
@@ -101,30 +275,136 @@ int auth_creds_check(pid_t pid, void *request, char *err, int len)
 #endif
 }
 
-char *auth_creds_request_dump(void *request, char *buf, int len)
+
+static int task_identify(pid_t pid, task_id_t *task)
 {
-    char **list = (char **)request;
-    char  *p    = buf;
-    int    prl;
-    char  *sep;
-    int    i;
+    char         path[64], buf[512], *p;
+    struct stat  st;
+    FILE        *fp;
+    size_t       n;
+    int          field;
+
+    memset(task, 0, sizeof(*task));
+
+    snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+
+    if ((fp = fopen(path, "r")) == NULL)
+        return FALSE;
+
+    n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+
+    /*
+     * Notes:
+     *   The command name may contain spaces and parentheses, so we start
+     *   counting fields after its last ')'. That is followed by the state
+     *   (field #3); the start time is field #22.
+     */
+    if ((p = strrchr(buf, ')')) == NULL)
+        return FALSE;
+
+    for (field = 2;  field < 22;  field++) {
+        if ((p = strchr(p + 1, ' ')) == NULL)
+            return FALSE;
+    }
 
-    for (i = 0, sep = "";  list[i] && len > 0;  i++, sep = ", ") {
-        prl = snprintf(p, len, "%s%s", sep, list[i]);
+    task->start = strtoull(p + 1, NULL, 10);
 
-        p   += prl;
-        len -= prl;
+    snprintf(path, sizeof(path), "/proc/%u/exe", pid);
+
+    if (stat(path, &st) == 0) {
+        task->dev = st.st_dev;
+        task->ino = st.st_ino;
     }
 
-    return buf;
+    return TRUE;
 }
 
 
+static char *cache_key(pid_t pid, char **pattern, char *buf, int len)
+{
+    char *p = buf;
+    int   l, i;
 
+    l = snprintf(p, len, "%u", pid);
+
+    for (i = 0;  pattern[i];  i++) {
+        p   += l;
+        len -= l;
+
+        if (len <= 0)
+            return NULL;
+
+        l = snprintf(p, len, "\n%s", pattern[i]);
+    }
+
+    return l < len ? buf : NULL;
+}
+
+
+static void cache_insert(char *key, pid_t pid, task_id_t *task,
+                         int success, char *err)
+{
+    decision_t *dec;
+
+    while (cache.size >= cache.max && cache.lru.next != &cache.lru) {
+        OHM_DEBUG(DBG_CREDS, "evicting decision '%s'", cache.lru.next->key);
+        cache_remove(cache.lru.next);
+        cache.nevict++;
+    }
+
+    if ((dec = malloc(sizeof(*dec))) == NULL)
+        return;
+
+    memset(dec, 0, sizeof(*dec));
+    dec->key     = strdup(key);
+    dec->pid     = pid;
+    dec->task    = *task;
+    dec->success = success;
+    dec->err     = strdup(err);
+
+    if (dec->key == NULL || dec->err == NULL) {
+        free(dec->key);
+        free(dec->err);
+        free(dec);
+        return;
+    }
+
+    g_hash_table_insert(cache.hash, dec->key, dec);
+    lru_append(dec);
+    cache.size++;
+}
+
+
+static void cache_remove(decision_t *dec)
+{
+    g_hash_table_remove(cache.hash, dec->key);
+    lru_unlink(dec);
+    cache.size--;
+
+    free(dec->key);
+    free(dec->err);
+    free(dec);
+}
+
+
+static void lru_unlink(decision_t *dec)
+{
+    dec->prev->next = dec->next;
+    dec->next->prev = dec->prev;
+    dec->prev = dec->next = dec;
+}
+
+
+static void lru_append(decision_t *dec)
+{
+    dec->prev = cache.lru.prev;
+    dec->next = &cache.lru;
+    cache.lru.prev->next = dec;
+    cache.lru.prev = dec;
+}
 
-/*!
- * @}
- */
 
 
 
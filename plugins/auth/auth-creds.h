@@ -31,6 +31,7 @@ void  auth_creds_exit(OhmPlugin *);
 
 int   auth_creds_check(pid_t, void *, char *,int);
 char *auth_creds_request_dump(void *, char *,int);
+void  auth_creds_forget(pid_t);
 
 
 #endif /* __OHM_AUTH_CREDS_H__ */
@@ -64,7 +64,7 @@ static void   destroy_request(req_t *);
 static void   authorize_request(req_t *);
 
 static gboolean idle_callback(gpointer);
-static void dbus_callback(pid_t *, char *, void *);
+static void dbus_callback(pid_t, char *, void *);
 
 
 /*! \addtogroup pubif
@@ -259,7 +259,7 @@ static gboolean idle_callback(gpointer data)
     return FALSE;
 }
 
-static void dbus_callback(pid_t *pid, char *err, void *data)
+static void dbus_callback(pid_t pid, char *err, void *data)
 {
     req_t *request = (req_t *)data;
 
@@ -29,24 +29,56 @@ USA.
 
 #include "plugin.h"
 #include "dbusif.h"
+#include "auth-creds.h"
+
+#define DEFAULT_PID_CACHE_SIZE  64
 
 typedef struct {
-    char *bus;
-    char *addr;
+    char  *bus;
+    char  *addr;
+    pid_t  pid;                 /* pid, if answered from the cache */
     struct {
         dbusif_pid_query_cb_t  func;
         void                  *data;
     }     cb;
 } query_t;
 
+typedef struct name_s {
+    struct name_s *prev;        /* LRU list, least recently used first */
+    struct name_s *next;
+    char          *addr;        /* unique D-Bus name */
+    pid_t          pid;         /* pid of the peer */
+} name_t;
+
+typedef struct {
+    GHashTable   *hash;         /* addr -> name_t */
+    name_t        lru;          /* list head */
+    int           size;         /* number of cached names */
+    int           max;          /* max. number of cached names */
+    unsigned int  nhit;
+    unsigned int  nmiss;
+    unsigned int  ngone;        /* dropped due to NameOwnerChanged */
+    unsigned int  nevict;       /* dropped to make room */
+} name_cache_t;
+
 static DBusConnection *sys_conn;   /* D-Bus system bus */
 static DBusConnection *sess_conn;  /* D-Bus session bus */
+static name_cache_t    names;      /* pid cache for system bus peers */
 
 static void system_bus_init(void);
+static void system_bus_cleanup(void);
 static void session_bus_init(const char *);
 static void session_bus_cleanup();
 
 static void pid_queried(DBusPendingCall *, void *);
+static gboolean pid_cached(gpointer);
+
+static void name_cache_init(OhmPlugin *);
+static void name_cache_exit(void);
+static void name_cache_add(const char *, pid_t);
+static void name_cache_remove(name_t *);
+static DBusHandlerResult name_owner_changed(DBusConnection *,
+                                            DBusMessage *, void *);
 
 
 
@@ -57,14 +89,16 @@ static void pid_queried(DBusPendingCall *, void *);
 
 void dbusif_init(OhmPlugin *plugin)
 {
-    (void)plugin;
-
+    name_cache_init(plugin);
     system_bus_init();
 }
 
 void dbusif_exit(OhmPlugin *plugin)
 {
     (void)plugin;
+
+    system_bus_cleanup();
+    name_cache_exit();
 }
 
 
@@ -124,6 +158,7 @@ int dbusif_pid_query(char *bustype, char *addr,
     DBusMessage     *msg;
     DBusPendingCall *pend;
     query_t         *query;
+    name_t          *name;
     int              success;
 
     if (!bustype || !addr || !func)
@@ -142,6 +177,38 @@ int dbusif_pid_query(char *bustype, char *addr,
     if ((query = malloc(sizeof(query_t))) == NULL)
         return ENOMEM;
 
+    if (conn == sys_conn && names.hash != NULL &&
+        (name = g_hash_table_lookup(names.hash, addr)) != NULL)
+    {
+        memset(query, 0, sizeof(query_t));
+        query->bus  = strdup(bustype);
+        query->addr = strdup(addr);
+        query->pid  = name->pid;
+        query->cb.func = func;
+        query->cb.data = data;
+
+        if (g_idle_add(pid_cached, query) != 0) {
+            OHM_DEBUG(DBG_DBUS, "cached PID for address %s: %u",
+                      addr, name->pid);
+
+            name->prev->next = name->next;
+            name->next->prev = name->prev;
+            name->prev = names.lru.prev;
+            name->next = &names.lru;
+            names.lru.prev->next = name;
+            names.lru.prev = name;
+
+            names.nhit++;
+
+            return 0;
+        }
+
+        free(query->bus);
+        free(query->addr);
+    }
+    else if (conn == sys_conn && names.hash != NULL)
+        names.nmiss++;
+
     do {
         memset(query, 0, sizeof(query_t));
         query->bus  = strdup(bustype);
@@ -202,6 +269,37 @@ static void system_bus_init(void)
             OHM_ERROR("Can't get system D-Bus connection");
         exit(1);
     }
+
+    if (names.hash == NULL)
+        return;
+
+    /*
+     * Notes:
+     *   We only care about peers leaving the bus. Unique names are never
+     *   reused on the same bus, so a cached name can stay valid until
+     *   its owner goes away.
+     */
+    if (!dbus_connection_add_filter(sys_conn, name_owner_changed, NULL,NULL)) {
+        OHM_ERROR("auth: failed to add filter for NameOwnerChanged");
+        name_cache_exit();
+        return;
+    }
+
+    dbus_bus_add_match(sys_conn, NAME_OWNER_CHANGED_MATCH, NULL);
+}
+
+static void system_bus_cleanup(void)
+{
+    if (sys_conn == NULL)
+        return;
+
+    if (names.hash != NULL) {
+        dbus_bus_remove_match(sys_conn, NAME_OWNER_CHANGED_MATCH, NULL);
+        dbus_connection_remove_filter(sys_conn, name_owner_changed, NULL);
+    }
+
+    dbus_connection_unref(sys_conn);
+    sys_conn = NULL;
 }
     
 static void session_bus_init(const char *addr)
@@ -304,9 +402,13 @@ static void pid_queried(DBusPendingCall *pend, void *data)
     } while(0);
 
     if (query) {
-        if (success)
+        if (success) {
             OHM_DEBUG(DBG_DBUS, "pid query succeeded: %s -> %u",
                       query->addr, pid);
+
+            if (!strcmp(query->bus, "system"))
+                name_cache_add(query->addr, pid);
+        }
         else
             OHM_DEBUG(DBG_DBUS, "pid query for %s failed: %s",
                       query->addr, error);
@@ -325,6 +427,160 @@ static void pid_queried(DBusPendingCall *pend, void *data)
 }
 
 
+static gboolean pid_cached(gpointer data)
+{
+    query_t *query = (query_t *)data;
+
+    query->cb.func(query->pid, "OK", query->cb.data);
+
+    free(query->bus);
+    free(query->addr);
+    free(query);
+
+    return FALSE;
+}
+
+
+static void name_cache_init(OhmPlugin *plugin)
+{
+    const char *size;
+    char       *end;
+
+    names.max = DEFAULT_PID_CACHE_SIZE;
+
+    if ((size = ohm_plugin_get_param(plugin, "pid-cache-size")) != NULL) {
+        names.max = (int)strtol(size, &end, 10);
+
+        if (*end || names.max < 0) {
+            OHM_ERROR("auth: invalid pid-cache-size '%s'", size);
+            names.max = DEFAULT_PID_CACHE_SIZE;
+        }
+    }
+
+    names.lru.prev = names.lru.next = &names.lru;
+
+    if (names.max > 0) {
+        names.hash = g_hash_table_new(g_str_hash, g_str_equal);
+
+        if (names.hash == NULL) {
+            OHM_ERROR("auth: failed to create PID cache");
+            names.max = 0;
+        }
+    }
+
+    OHM_INFO("auth: PID cache size %d", names.max);
+}
+
+
+static void name_cache_exit(void)
+{
+    if (names.max > 0)
+        OHM_INFO("auth: PID cache: %u hits, %u misses, %u gone, "
+                 "%u evicted", names.nhit, names.nmiss, names.ngone,
+                 names.nevict);
+
+    while (names.lru.next != &names.lru)
+        name_cache_remove(names.lru.next);
+
+    if (names.hash != NULL) {
+        g_hash_table_destroy(names.hash);
+        names.hash = NULL;
+    }
+
+    names.max = 0;
+}
+
+
+static void name_cache_add(const char *addr, pid_t pid)
+{
+    name_t *name;
+
+    /* only unique names have a fixed owner */
+    if (names.hash == NULL || addr[0] != ':' || pid == 0)
+        return;
+
+    if ((name = g_hash_table_lookup(names.hash, addr)) != NULL) {
+        name->pid = pid;
+        return;
+    }
+
+    while (names.size >= names.max && names.lru.next != &names.lru) {
+        name_cache_remove(names.lru.next);
+        names.nevict++;
+    }
+
+    if ((name = malloc(sizeof(*name))) == NULL)
+        return;
+
+    if ((name->addr = strdup(addr)) == NULL) {
+        free(name);
+        return;
+    }
+
+    name->pid  = pid;
+    name->prev = names.lru.prev;
+    name->next = &names.lru;
+    names.lru.prev->next = name;
+    names.lru.prev = name;
+
+    g_hash_table_insert(names.hash, name->addr, name);
+    names.size++;
+}
+
+
+static void name_cache_remove(name_t *name)
+{
+    g_hash_table_remove(names.hash, name->addr);
+
+    name->prev->next = name->next;
+    name->next->prev = name->prev;
+    names.size--;
+
+    free(name->addr);
+    free(name);
+}
+
+
+static DBusHandlerResult name_owner_changed(DBusConnection *conn,
+                                            DBusMessage    *msg,
+                                            void           *ud)
+{
+    const char *name, *before, *after;
+    name_t     *entry;
+
+    (void)conn;
+    (void)ud;
+
+    if (!dbus_message_is_signal(msg, DBUS_ADMIN_INTERFACE,
+                                DBUS_NAME_OWNER_CHANGED_SIGNAL) ||
+        !dbus_message_get_args(msg, NULL,
+                               DBUS_TYPE_STRING, &name,
+                               DBUS_TYPE_STRING, &before,
+                               DBUS_TYPE_STRING, &after,
+                               DBUS_TYPE_INVALID))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (after[0] == '\0' && names.hash != NULL &&
+        (entry = g_hash_table_lookup(names.hash, name)) != NULL)
+    {
+        OHM_DEBUG(DBG_DBUS, "%s (pid %u) is gone", name, entry->pid);
+
+        /*
+         * Notes:
+         *   Peers usually leave the bus when they exit, so we take this
+         *   as a hint to drop the cached credential decisions, too. If the
+         *   process is still around its creds will simply be rechecked.
+         */
+        auth_creds_forget(entry->pid);
+
+        name_cache_remove(entry);
+        names.ngone++;
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+
 /* 
  * Local Variables:
  * c-basic-offset: 4
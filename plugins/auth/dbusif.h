@@ -39,6 +39,14 @@ typedef struct _OhmPlugin OhmPlugin;
 
 /* D-Bus signal & method names */
 #define DBUS_QUERY_PID_METHOD          "GetConnectionUnixProcessID"
+#define DBUS_NAME_OWNER_CHANGED_SIGNAL "NameOwnerChanged"
+
+/* D-Bus match rules */
+#define NAME_OWNER_CHANGED_MATCH                                \
+    "type='signal',sender='" DBUS_ADMIN_SERVICE "',"            \
+    "interface='" DBUS_ADMIN_INTERFACE "',"                     \
+    "member='" DBUS_NAME_OWNER_CHANGED_SIGNAL "',"              \
+    "path='" DBUS_ADMIN_PATH "',arg2=''"
 
 
 void  dbusif_init(OhmPlugin *);
@@ -32,6 +32,13 @@ static void  cache_destroy(void);
 static pid_t cache_lookup(const char *);
 static int   cache_insert(const char *, pid_t);
 static void  cache_delete(const char *);
+static void  decision_init(backlight_context_t *, OhmPlugin *);
+static void  decision_exit(backlight_context_t *);
+static int   decision_lookup(const char *, int *);
+static void  decision_insert(const char *, int);
+static void  decision_watch(int);
+static void  decision_invalidate(void);
+static void  request_flush_all(void);
 
 int  backlight_request(backlight_context_t *, pid_t, DBusMessage *);
 void continue_request(DBusPendingCall *, void *);
@@ -61,6 +68,7 @@ mce_init(backlight_context_t *ctx, OhmPlugin *plugin)
         ctx->fact = (OhmFact *)facts->data;
 
     cache_create();
+    decision_init(ctx, plugin);
     bus_init();
 }
 
@@ -71,6 +79,9 @@ mce_init(backlight_context_t *ctx, OhmPlugin *plugin)
 void
 mce_exit(backlight_context_t *ctx)
 {
+    request_flush_all();
+    decision_exit(ctx);
+
     ctx->fact = NULL;
     
     bus_exit();
@@ -245,18 +256,59 @@ complete_request(DBusPendingCall *pending, void *user_data)
 }
 
 
+/*
+ * Notes:
+ *   Display requests are not resolved right away. They are queued and
+ *   processed together from an idle callback, so a burst of requests
+ *   arriving within one main loop iteration ends up in a single batch
+ *   with policy enforcement disabled only once around it. Identical
+ *   requests (same request, group and binary) in a batch share a single
+ *   resolution, and requests matching a cached decision that is still
+ *   valid are not resolved at all. See the decision cache below for how
+ *   decisions get invalidated.
+ */
+
+typedef struct {
+    backlight_context_t *ctx;                 /* backlight context */
+    DBusMessage         *req;                 /* request to reply to */
+    const char          *request;             /* on, off, dim, keepon */
+    char                *group;               /* requesting group */
+    char                *binary;              /* requesting binary */
+    char                *key;                 /* decision cache key */
+} request_t;
+
+static GQueue requests = G_QUEUE_INIT;        /* queued display requests */
+static guint  request_idle;                   /* request flush callback */
+
+static gboolean request_flush(gpointer);
+
+
+/********************
+ * request_free
+ ********************/
+static void
+request_free(request_t *r)
+{
+    if (r != NULL) {
+        dbus_message_unref(r->req);
+        FREE(r->group);
+        FREE(r->binary);
+        g_free(r->key);
+        FREE(r);
+    }
+}
+
+
 /********************
  * backlight_request
  ********************/
 int
 backlight_request(backlight_context_t *ctx, pid_t pid, DBusMessage *req)
 {
-    const char          *member;
-    char                *request, *group, *binary;
-    char                *vars[3*2 + 1];
-    GValue              *field;
-    const char          *action;
-    int                  i, decision;
+    const char *member;
+    const char *request;
+    char       *group, *binary;
+    request_t  *r;
 
     member = dbus_message_get_member(req);
     if      (!strcmp(member, MCE_DISPLAY_ON_REQ))    request = "on";
@@ -268,42 +320,141 @@ backlight_request(backlight_context_t *ctx, pid_t pid, DBusMessage *req)
         return FALSE;
     }
     
+    group = binary = NULL;
     ctx->process_info(pid, &group, &binary);
 
     OHM_DEBUG(DBG_REQUEST, "%s request for {%u, %s:%s}", request,
               pid, group, binary);
-    
+
+    if (ALLOC_OBJ(r) == NULL) {
+        OHM_ERROR("backlight: failed to allocate display request.");
+        return FALSE;
+    }
+
+    r->ctx     = ctx;
+    r->req     = dbus_message_ref(req);
+    r->request = request;
+    r->group   = group  ? STRDUP(group)  : NULL;
+    r->binary  = binary ? STRDUP(binary) : NULL;
+    r->key     = g_strdup_printf("%s:%s:%s", request,
+                                 group  ? group  : "",
+                                 binary ? binary : "");
+
+    if (r->key == NULL || (group != NULL && r->group == NULL) ||
+        (binary != NULL && r->binary == NULL)) {
+        OHM_ERROR("backlight: failed to allocate display request.");
+        request_free(r);
+        return FALSE;
+    }
+
+    g_queue_push_tail(&requests, r);
+
+    if (!request_idle)
+        request_idle = g_idle_add(request_flush, NULL);
+
+    return TRUE;
+}
+
+
+/********************
+ * request_resolve
+ ********************/
+static int
+request_resolve(request_t *r)
+{
+    backlight_context_t *ctx = r->ctx;
+    char                *vars[3*2 + 1];
+    GValue              *field;
+    const char          *action;
+    char                *old;
+    int                  i, status, decision;
+
     vars[i=0] = "request";
-    vars[++i] = request;
+    vars[++i] = (char *)r->request;
     vars[++i] = "group";
-    vars[++i] = group;
+    vars[++i] = r->group;
     vars[++i] = "binary";
-    vars[++i] = binary;
+    vars[++i] = r->binary;
     vars[++i] = NULL;
 
-    ep_disable();
+    field = ohm_fact_get(ctx->fact, "state");
+    
+    if (field != NULL && G_VALUE_TYPE(field) == G_TYPE_STRING)
+        old = STRDUP(g_value_get_string(field));
+    else
+        old = NULL;
+
+    decision_watch(FALSE);
+    status = ctx->resolve("backlight_request", vars);
+    decision_watch(TRUE);
+
+    field = ohm_fact_get(ctx->fact, "state");
+
+    if (field == NULL || G_VALUE_TYPE(field) != G_TYPE_STRING)         /* ??? */
+        action = NULL;
+    else
+        action = g_value_get_string(field);
+
+    /* the backlight state is an input to the decision as well */
+    if (old == NULL || action == NULL || strcmp(old, action))
+        decision_invalidate();
     
-    if (ctx->resolve("backlight_request", vars) <= 0)              /* failure */
+    FREE(old);
+
+    if (status <= 0 || action == NULL)                    /* failure or ??? */
         decision = TRUE;
-    else {
-        field = ohm_fact_get(ctx->fact, "state");
-        
-        if (field == NULL || G_VALUE_TYPE(field) != G_TYPE_STRING)     /* ??? */
-            decision = TRUE;
-        else {
-            action   = g_value_get_string(field);
-            decision = !strcmp(action, request);
+    else
+        decision = !strcmp(action, r->request);
+
+    return decision;
+}
+
+
+/********************
+ * request_flush
+ ********************/
+static gboolean
+request_flush(gpointer data)
+{
+    request_t *r;
+    int        decision;
+
+    (void)data;
+
+    request_idle = 0;
+
+    ep_disable();
+
+    while ((r = g_queue_pop_head(&requests)) != NULL) {
+        if (!decision_lookup(r->key, &decision)) {
+            decision = request_resolve(r);
+            decision_insert(r->key, decision);
         }
-    }
-    
-    mce_send_reply(req, decision);
 
-    if (decision)
-        BACKLIGHT_SAVE_STATE(ctx, request);
+        mce_send_reply(r->req, decision);
+
+        if (decision)
+            BACKLIGHT_SAVE_STATE(r->ctx, r->request);
+
+        request_free(r);
+    }
     
     ep_enable();
 
-    return TRUE;
+    return FALSE;
+}
+
+
+/********************
+ * request_flush_all
+ ********************/
+static void
+request_flush_all(void)
+{
+    if (request_idle) {
+        g_source_remove(request_idle);
+        request_flush(NULL);
+    }
 }
 
 
@@ -572,6 +723,241 @@ cache_delete(const char *client)
 }
 
 
+/*****************************************************************************
+ *                      *** display request decision cache ***              *
+ *****************************************************************************/
+
+/*
+ * Notes:
+ *   Decisions are cached by request, group and binary and stamped with
+ *   a generation number. The generation is bumped whenever any of the
+ *   facts the backlight_request rules depend on is inserted, updated or
+ *   removed, and whenever a resolution changes the backlight state, which
+ *   invalidates all cached decisions at once. The facts to watch can be
+ *   listed in the request-facts configuration parameter. If it is not
+ *   given, any fact store change invalidates the cache. The backlight
+ *   fact is always watched. Fact store changes made by our own
+ *   resolutions are not counted, only their effect on the state is.
+ */
+
+#define DECISION_CACHE_MAX 64                 /* max. cached decisions */
+
+typedef struct {
+    char          *key;                       /* request:group:binary */
+    int            decision;                  /* cached decision */
+    unsigned long  generation;                /* fact generation */
+} decision_t;
+
+static GHashTable    *decisions;              /* decision cache */
+static GHashTable    *watched;                /* watched fact names */
+static unsigned long  generation;             /* fact generation */
+static int            resolving;              /* resolving a request */
+static gulong         fs_updated, fs_inserted, fs_removed;
+static OhmFactStore  *fs;
+
+static unsigned int   decision_nhit, decision_nmiss;
+
+
+/********************
+ * free_decision
+ ********************/
+static void
+free_decision(gpointer data)
+{
+    decision_t *d = (decision_t *)data;
+
+    if (d != NULL) {
+        FREE(d->key);
+        FREE(d);
+    }
+}
+
+
+/********************
+ * fact_changed
+ ********************/
+static void
+fact_changed(OhmFact *fact)
+{
+    const char *name;
+
+    if (resolving || fact == NULL)
+        return;
+
+    if (watched != NULL) {
+        name = ohm_structure_get_name(OHM_STRUCTURE(fact));
+
+        if (name == NULL || !g_hash_table_lookup(watched, name))
+            return;
+    }
+
+    generation++;
+}
+
+
+static void
+fact_updated(void *data, OhmFact *fact, GQuark field, gpointer value)
+{
+    (void)data;
+    (void)field;
+    (void)value;
+
+    fact_changed(fact);
+}
+
+
+static void
+fact_inserted(void *data, OhmFact *fact)
+{
+    (void)data;
+
+    fact_changed(fact);
+}
+
+
+/********************
+ * decision_init
+ ********************/
+static void
+decision_init(backlight_context_t *ctx, OhmPlugin *plugin)
+{
+    const char  *param;
+    char       **names;
+    int          i;
+
+    decisions = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      NULL, free_decision);
+    
+    if (decisions == NULL) {
+        OHM_ERROR("backlight: failed to create decision cache.");
+        exit(1);
+    }
+
+    if ((param = ohm_plugin_get_param(plugin, "request-facts")) != NULL) {
+        watched = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        names   = g_strsplit_set(param, " ,", -1);
+        
+        for (i = 0; names[i] != NULL; i++) {
+            if (names[i][0] != '\0')
+                g_hash_table_replace(watched, g_strdup(names[i]),
+                                     GINT_TO_POINTER(TRUE));
+        }
+        g_hash_table_replace(watched, g_strdup("backlight"),
+                             GINT_TO_POINTER(TRUE));
+
+        g_strfreev(names);
+
+        OHM_INFO("backlight: request decisions depend on facts %s", param);
+    }
+    
+    fs          = ctx->store;
+    fs_updated  = g_signal_connect(G_OBJECT(fs), "updated",
+                                   G_CALLBACK(fact_updated), NULL);
+    fs_inserted = g_signal_connect(G_OBJECT(fs), "inserted",
+                                   G_CALLBACK(fact_inserted), NULL);
+    fs_removed  = g_signal_connect(G_OBJECT(fs), "removed",
+                                   G_CALLBACK(fact_inserted), NULL);
+}
+
+
+/********************
+ * decision_exit
+ ********************/
+static void
+decision_exit(backlight_context_t *ctx)
+{
+    (void)ctx;
+
+    if (fs != NULL) {
+        g_signal_handler_disconnect(G_OBJECT(fs), fs_updated);
+        g_signal_handler_disconnect(G_OBJECT(fs), fs_inserted);
+        g_signal_handler_disconnect(G_OBJECT(fs), fs_removed);
+        fs = NULL;
+    }
+
+    if (decisions != NULL) {
+        OHM_INFO("backlight: %u cached, %u resolved display requests",
+                 decision_nhit, decision_nmiss);
+
+        g_hash_table_destroy(decisions);
+        decisions = NULL;
+    }
+
+    if (watched != NULL) {
+        g_hash_table_destroy(watched);
+        watched = NULL;
+    }
+}
+
+
+/********************
+ * decision_lookup
+ ********************/
+static int
+decision_lookup(const char *key, int *decision)
+{
+    decision_t *d;
+
+    d = g_hash_table_lookup(decisions, key);
+
+    if (d == NULL || d->generation != generation) {
+        decision_nmiss++;
+        return FALSE;
+    }
+
+    OHM_DEBUG(DBG_REQUEST, "using cached decision %s for %s",
+              d->decision ? "allow" : "deny", key);
+
+    *decision = d->decision;
+    decision_nhit++;
+
+    return TRUE;
+}
+
+
+/********************
+ * decision_insert
+ ********************/
+static void
+decision_insert(const char *key, int decision)
+{
+    decision_t *d;
+
+    if (g_hash_table_size(decisions) >= DECISION_CACHE_MAX)
+        g_hash_table_remove_all(decisions);
+
+    if (ALLOC_OBJ(d) == NULL || (d->key = STRDUP(key)) == NULL) {
+        free_decision(d);
+        return;
+    }
+
+    d->decision   = decision;
+    d->generation = generation;
+
+    g_hash_table_replace(decisions, d->key, d);
+}
+
+
+/********************
+ * decision_watch
+ ********************/
+static void
+decision_watch(int enabled)
+{
+    resolving = !enabled;
+}
+
+
+/********************
+ * decision_invalidate
+ ********************/
+static void
+decision_invalidate(void)
+{
+    generation++;
+}
+
+
 /*
  * Local Variables:
  * c-basic-offset: 4
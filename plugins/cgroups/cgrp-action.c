@@ -464,15 +464,27 @@ int
 action_renice_exec(cgrp_context_t *ctx,
                    cgrp_proc_attr_t *attr, cgrp_action_t *action)
 {
-    (void)ctx;
+    cgrp_process_t *process = proc_hash_lookup(ctx, attr->pid);
+    int             nice    = action->renice.priority;
 
     OHM_DEBUG(DBG_CLASSIFY, "<%u, %s> renice %d", attr->pid, attr->binary,
-              action->renice.priority);
-              
-    if (!setpriority(PRIO_PROCESS, attr->pid, action->renice.priority))
+              nice);
+
+    /*
+     * Notes: keep the nice value cached by set_nice up to date, otherwise
+     *        a later adjustment back to the cached value would be skipped.
+     */
+    
+    if (!setpriority(PRIO_PROCESS, attr->pid, nice)) {
+        if (process != NULL)
+            process->nice = nice;
         return TRUE;
-    else
+    }
+    else {
+        if (process != NULL)
+            process->nice = CGRP_UNKNOWN_VALUE;
         return (errno == ESRCH);
+    }
 }
 
 
@@ -25,12 +25,15 @@ USA.
 #include <arpa/inet.h>
 
 #include "cgrp-plugin.h"
+#include "fact-watch.h"
 
 
 static gboolean socket_cb(GIOChannel *, GIOCondition, gpointer);
 
-static void schedule_update(void *, OhmFact *, GQuark, gpointer, gpointer);
+static void schedule_update(OhmFact *, GQuark, GValue *, void *);
 static gboolean apptrack_update(gpointer);
+static void apptrack_changed(cgrp_context_t *);
+static gboolean apptrack_flush(gpointer);
 
 static const char *get_argv0(cgrp_process_t *);
 
@@ -61,10 +64,22 @@ store_init(cgrp_context_t *ctx, GSList *facts)
         return FALSE;
     }
     
+    if (!fact_watch_import()) {
+        OHM_ERROR("cgrp: fact subscription interface not available");
+        return FALSE;
+    }
+
     ctx->apptrack_changes = (OhmFact *)facts->data;
-        
-    g_signal_connect(G_OBJECT(ctx->store),
-                     "updated", G_CALLBACK(schedule_update), ctx);
+    ctx->apptrack_watch   = fact_subscribe(PLUGIN_NAME, CGRP_FACT_APPCHANGES,
+                                           NULL, NULL, NULL,
+                                           schedule_update, ctx);
+    
+    if (ctx->apptrack_watch <= 0) {
+        OHM_ERROR("cgrp: failed to subscribe to fact '%s'",
+                  CGRP_FACT_APPCHANGES);
+        ctx->apptrack_changes = NULL;
+        return FALSE;
+    }
     
     OHM_INFO("cgrp: using factstore-based application notifications");
     
@@ -121,10 +136,25 @@ socket_init(cgrp_context_t *ctx, OhmPlugin *plugin)
 int
 apptrack_init(cgrp_context_t *ctx, OhmPlugin *plugin)
 {
-    GSList *facts;
-    int     success;
+    GSList     *facts;
+    const char *window;
+    char       *end;
+    int         success;
 
     list_init(&ctx->apptrack_subscribers);
+    ctx->apptrack_notified = -1;
+
+    if ((window = ohm_plugin_get_param(plugin, "apptrack-coalesce")) != NULL) {
+        ctx->apptrack_window = (guint)strtoul(window, &end, 10);
+        
+        if (end && *end) {
+            OHM_ERROR("cgrp: invalid apptrack coalescing window '%s'", window);
+            ctx->apptrack_window = 0;
+        }
+        else if (ctx->apptrack_window > 0)
+            OHM_INFO("cgrp: coalescing application notifications (%u msecs)",
+                     ctx->apptrack_window);
+    }
     
     facts = ohm_fact_store_get_facts_by_name(ctx->store, CGRP_FACT_APPCHANGES);
 
@@ -159,10 +189,20 @@ apptrack_exit(cgrp_context_t *ctx)
 
         FREE(subscr);
     }
+
+    if (ctx->apptrack_flush != 0) {
+        g_source_remove(ctx->apptrack_flush);
+        ctx->apptrack_flush = 0;
+    }
+
+    if (ctx->apptrack_nchange > 0)
+        OHM_INFO("cgrp: %u application changes, %u notified, %u suppressed",
+                 ctx->apptrack_nchange, ctx->apptrack_nnotify,
+                 ctx->apptrack_nsuppress);
     
     if (ctx->apptrack_changes) {
-        g_signal_handlers_disconnect_by_func(G_OBJECT(ctx->store),
-                                             schedule_update, ctx);
+        fact_unsubscribe(ctx->apptrack_watch);
+        ctx->apptrack_watch = 0;
 
         if (ctx->apptrack_update != 0) {
             g_source_remove(ctx->apptrack_update);
@@ -311,6 +351,77 @@ apptrack_notify(cgrp_context_t *ctx, cgrp_process_t *process)
 
         subscr->callback(pid, binary, argv0, group, subscr->user_data);
     }
+
+    ctx->apptrack_notified = pid;
+    ctx->apptrack_nnotify++;
+}
+
+
+/********************
+ * apptrack_changed
+ ********************/
+static void
+apptrack_changed(cgrp_context_t *ctx)
+{
+    ctx->apptrack_nchange++;
+
+    if (ctx->apptrack_window == 0) {
+        apptrack_notify(ctx, ctx->active_process);
+        return;
+    }
+
+    /*
+     * Notes:
+     *   With a coalescing window, subscribers only get the active
+     *   application at the end of the window. Any intermediate states
+     *   (eg. while the user is switching between tasks) are dropped.
+     */
+
+    if (ctx->apptrack_flush != 0)
+        ctx->apptrack_nsuppress++;
+    else
+        ctx->apptrack_flush = g_timeout_add(ctx->apptrack_window,
+                                            apptrack_flush, ctx);
+}
+
+
+/********************
+ * apptrack_flush
+ ********************/
+static gboolean
+apptrack_flush(gpointer data)
+{
+    cgrp_context_t *ctx     = (cgrp_context_t *)data;
+    cgrp_process_t *process = ctx->active_process;
+    pid_t           pid     = process ? process->pid : 0;
+
+    ctx->apptrack_flush = 0;
+
+    if (pid == ctx->apptrack_notified) {
+        OHM_DEBUG(DBG_NOTIFY, "active application %u unchanged", pid);
+        ctx->apptrack_nsuppress++;
+    }
+    else
+        apptrack_notify(ctx, process);
+
+    return FALSE;
+}
+
+
+/********************
+ * apptrack_dump
+ ********************/
+void
+apptrack_dump(cgrp_context_t *ctx, FILE *fp)
+{
+    cgrp_process_t *process = ctx->active_process;
+
+    fprintf(fp, "active application: %s (pid %u)\n",
+            process ? process->binary : "<none>", process ? process->pid : 0);
+    fprintf(fp, "coalescing window: %u msecs\n", ctx->apptrack_window);
+    fprintf(fp, "%u changes, %u notified, %u suppressed\n",
+            ctx->apptrack_nchange, ctx->apptrack_nnotify,
+            ctx->apptrack_nsuppress);
 }
 
 static cgrp_process_t* update_process(cgrp_context_t *ctx, char *state)
@@ -351,7 +462,7 @@ apptrack_update(gpointer data)
     if (old_group != new_group || old_proc != new_proc)
         apptrack_cgroup_notify(ctx, new_group, new_proc);
 
-    apptrack_notify(ctx, ctx->active_process);
+    apptrack_changed(ctx);
 
     ctx->apptrack_update = 0;
 
@@ -363,23 +474,16 @@ apptrack_update(gpointer data)
  * schedule_update
  ********************/
 static void
-schedule_update(void *whatever,
-                OhmFact *fact, GQuark field_quark, gpointer value,
-                gpointer user_data)
+schedule_update(OhmFact *fact, GQuark field_quark, GValue *value,
+                void *user_data)
 {
     cgrp_context_t *ctx = (cgrp_context_t *)user_data;
-    const char     *fact_name;
-
-    if (ctx->apptrack_update != 0)
-        return;
 
-    (void)whatever;
+    (void)fact;
     (void)field_quark;
     (void)value;
 
-    fact_name = ohm_structure_get_name(OHM_STRUCTURE(fact));
-    
-    if (fact_name == NULL || strcmp(fact_name, CGRP_FACT_APPCHANGES))
+    if (ctx->apptrack_update != 0)
         return;
     
     ctx->apptrack_update = g_idle_add(apptrack_update, ctx);
@@ -435,7 +539,7 @@ socket_cb(GIOChannel *chnl, GIOCondition mask, gpointer data)
 
         process_update_state(ctx, process, state);
 
-        apptrack_notify(ctx, ctx->active_process);
+        apptrack_changed(ctx);
     }
 
     curr_active = ctx->active_group;
@@ -20,11 +20,21 @@ USA.
 
 #include <errno.h>
 #include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "cgrp-plugin.h"
 
 static int classify_by_rules(cgrp_context_t *ctx, cgrp_event_t *event,
-			     cgrp_proc_attr_t *attr);
+			     cgrp_proc_attr_t *attr, cgrp_exec_t *exec);
+
+static int  exec_cache_init (cgrp_context_t *ctx, OhmPlugin *plugin);
+static void exec_cache_exit (cgrp_context_t *ctx);
+static void exec_cache_flush(cgrp_context_t *ctx);
+static cgrp_exec_t *exec_cache_lookup(cgrp_context_t *ctx,
+                                      cgrp_proc_attr_t *attr);
+static void exec_cache_update(cgrp_context_t *ctx, cgrp_exec_t *exec,
+                              cgrp_rule_t *rules, cgrp_action_t *actions);
 
 char *classify_event_name(cgrp_event_type_t type)
 {
@@ -73,9 +83,10 @@ char *classify_event_name(cgrp_event_type_t type)
  * classify_init
  ********************/
 int
-classify_init(cgrp_context_t *ctx)
+classify_init(cgrp_context_t *ctx, OhmPlugin *plugin)
 {
-    if (!rule_hash_init(ctx) || !proc_hash_init(ctx) || !addon_hash_init(ctx)) {
+    if (!rule_hash_init(ctx) || !proc_hash_init(ctx) || !addon_hash_init(ctx) ||
+        !exec_cache_init(ctx, plugin)) {
         classify_exit(ctx);
         return FALSE;
     }
@@ -90,6 +101,7 @@ classify_init(cgrp_context_t *ctx)
 void
 classify_exit(cgrp_context_t *ctx)
 {
+    exec_cache_exit(ctx);
     rule_hash_exit(ctx);
     proc_hash_exit(ctx);
 }
@@ -124,6 +136,9 @@ classify_reconfig(cgrp_context_t *ctx)
     cgrp_procdef_t *pd;
     int             i;
 
+    /* cached decisions might point to the old add-on rules */
+    exec_cache_flush(ctx);
+
     for (i = 0, pd = ctx->addons; i < ctx->naddon; i++, pd++)
         addon_hash_insert(ctx, pd);
     
@@ -201,6 +216,7 @@ int
 classify_event(cgrp_context_t *ctx, cgrp_event_t *event)
 {
     cgrp_proc_attr_t  attr;
+    cgrp_exec_t      *exec;
     char             *argv[CGRP_MAX_ARGS];
     char              args[CGRP_MAX_CMDLINE];
     char              cmdl[CGRP_MAX_CMDLINE];
@@ -239,7 +255,12 @@ classify_event(cgrp_context_t *ctx, cgrp_event_t *event)
         attr.cmdline = cmdl;
         attr.process = proc_hash_lookup(ctx, attr.pid);
 
-        if (!process_get_binary(&attr)) {
+        if (event->any.type == CGRP_EVENT_EXEC)
+            exec = exec_cache_lookup(ctx, &attr);
+        else
+            exec = NULL;
+
+        if (!exec && !process_get_binary(&attr)) {
             /*
              * we assume that the process is gone already and no need to
              * classify it, but still we'll stay waiting for exit event
@@ -255,7 +276,7 @@ classify_event(cgrp_context_t *ctx, cgrp_event_t *event)
                 attr.process->name = attr.process->binary;
         }
 
-        return classify_by_rules(ctx, event, &attr);
+        return classify_by_rules(ctx, event, &attr, exec);
 
     case CGRP_EVENT_PTRACE:
         OHM_DEBUG(DBG_CLASSIFY, "process <%u/%u> is traced by <%u/%u>",
@@ -329,7 +350,7 @@ classify_by_binary(cgrp_context_t *ctx, pid_t pid, int reclassify)
     event.exec.pid  = attr.pid;
     event.exec.tgid = attr.tgid;
 
-    return classify_by_rules(ctx, &event, &attr);
+    return classify_by_rules(ctx, &event, &attr, NULL);
 }
 
 
@@ -366,7 +387,7 @@ classify_by_argvx(cgrp_context_t *ctx, cgrp_proc_attr_t *attr, int argn)
     event.exec.pid  = attr->pid;
     event.exec.tgid = attr->tgid;
 
-    if (!classify_by_rules(ctx, &event, attr))
+    if (!classify_by_rules(ctx, &event, attr, NULL))
         return FALSE;
 
     if (!attr->process)
@@ -386,7 +407,7 @@ classify_by_argvx(cgrp_context_t *ctx, cgrp_proc_attr_t *attr, int argn)
  * classify_by_rules
  ********************/
 static int classify_by_rules(cgrp_context_t *ctx, cgrp_event_t *event,
-			     cgrp_proc_attr_t *attr)
+			     cgrp_proc_attr_t *attr, cgrp_exec_t *exec)
 {
     cgrp_procdef_t *def;
     cgrp_rule_t    *rules = NULL;
@@ -417,7 +438,25 @@ static int classify_by_rules(cgrp_context_t *ctx, cgrp_event_t *event,
      *           evaluate fallback rules to find actions to execute.
      *
      *      3.3) If any actions were found execute them.
+     *
+     * For exec events of cached binaries whose rules only look at the
+     * binary path, we reuse the actions found by the previous evaluation.
      */
+    if (exec != NULL && exec->resolved && exec->constant) {
+        exec->nhit++;
+        ctx->exec_nhit++;
+        
+        OHM_DEBUG(DBG_CLASSIFY, "reusing cached decision for %s",
+                  exec->binary);
+
+        if (exec->actions) {
+            procattr_dump(attr);
+            return action_exec(ctx, attr, exec->actions);
+        }
+        else
+            return FALSE;
+    }
+
     def = rule_hash_lookup(ctx, attr->binary);
     if (!def)
         def = addon_hash_lookup(ctx, attr->binary);
@@ -445,6 +484,9 @@ static int classify_by_rules(cgrp_context_t *ctx, cgrp_event_t *event,
         if (!actions && rules != ctx->fallback && ctx->fallback)
             actions = rule_eval(ctx, ctx->fallback, attr);
 
+        if (exec != NULL)
+            exec_cache_update(ctx, exec, rules, actions);
+
         if (actions) {
             procattr_dump(attr);
             return action_exec(ctx, attr, actions);
@@ -497,6 +539,310 @@ classify_schedule(cgrp_context_t *ctx, pid_t pid, unsigned int delay,
         OHM_ERROR("cgrp: failed to allocate reclassification data");
 }
 
+
+/********************
+ * exec_hash
+ ********************/
+static guint
+exec_hash(gconstpointer key)
+{
+    const cgrp_exec_t *exec = (const cgrp_exec_t *)key;
+
+    return (guint)exec->ino ^ ((guint)exec->dev << 16);
+}
+
+
+/********************
+ * exec_equal
+ ********************/
+static gboolean
+exec_equal(gconstpointer key1, gconstpointer key2)
+{
+    const cgrp_exec_t *e1 = (const cgrp_exec_t *)key1;
+    const cgrp_exec_t *e2 = (const cgrp_exec_t *)key2;
+
+    return e1->dev == e2->dev && e1->ino == e2->ino;
+}
+
+
+/********************
+ * exec_cache_init
+ ********************/
+static int
+exec_cache_init(cgrp_context_t *ctx, OhmPlugin *plugin)
+{
+    const char *size;
+    char       *end;
+
+    list_init(&ctx->execlru);
+    ctx->maxexec = CGRP_EXEC_CACHE;
+
+    if ((size = ohm_plugin_get_param(plugin, "exec-cache-size")) != NULL) {
+        ctx->maxexec = (int)strtol(size, &end, 10);
+
+        if ((end && *end) || ctx->maxexec < 0) {
+            OHM_ERROR("cgrp: invalid exec cache size '%s'", size);
+            ctx->maxexec = CGRP_EXEC_CACHE;
+        }
+    }
+
+    if (ctx->maxexec == 0)
+        return TRUE;
+
+    ctx->exectbl = g_hash_table_new(exec_hash, exec_equal);
+
+    return ctx->exectbl != NULL;
+}
+
+
+/********************
+ * exec_free
+ ********************/
+static void
+exec_free(cgrp_context_t *ctx, cgrp_exec_t *exec)
+{
+    g_hash_table_remove(ctx->exectbl, exec);
+    list_delete(&exec->hook);
+    ctx->nexec--;
+
+    FREE(exec->binary);
+    FREE(exec);
+}
+
+
+/********************
+ * exec_cache_flush
+ ********************/
+static void
+exec_cache_flush(cgrp_context_t *ctx)
+{
+    cgrp_exec_t *exec;
+    list_hook_t *p, *n;
+
+    if (ctx->exectbl == NULL)
+        return;
+
+    list_foreach(&ctx->execlru, p, n) {
+        exec = list_entry(p, cgrp_exec_t, hook);
+        exec_free(ctx, exec);
+    }
+}
+
+
+/********************
+ * exec_cache_exit
+ ********************/
+static void
+exec_cache_exit(cgrp_context_t *ctx)
+{
+    if (ctx->exectbl == NULL)
+        return;
+
+    OHM_INFO("cgrp: exec cache: %u decisions reused, %u evaluated, "
+             "%u entries evicted", ctx->exec_nhit, ctx->exec_nmiss,
+             ctx->exec_nevict);
+
+    exec_cache_flush(ctx);
+    g_hash_table_destroy(ctx->exectbl);
+    ctx->exectbl = NULL;
+}
+
+
+/********************
+ * exec_cache_lookup
+ ********************/
+static cgrp_exec_t *
+exec_cache_lookup(cgrp_context_t *ctx, cgrp_proc_attr_t *attr)
+{
+    cgrp_exec_t  key, *exec;
+    struct stat  st, verify;
+    char         exe[64];
+
+    if (ctx->exectbl == NULL)
+        return NULL;
+
+    /*
+     * Notes: binaries with several hard links are not cached as rules
+     *        are matched against the path and not against the inode.
+     */
+    
+    sprintf(exe, "/proc/%u/exe", attr->pid);
+
+    if (stat(exe, &st) < 0 || !S_ISREG(st.st_mode) || st.st_nlink != 1)
+        return NULL;
+
+    key.dev = st.st_dev;
+    key.ino = st.st_ino;
+    exec    = g_hash_table_lookup(ctx->exectbl, &key);
+
+    if (exec != NULL) {
+        if (exec->ctime == st.st_ctime) {
+            strcpy(attr->binary, exec->binary);
+            list_delete(&exec->hook);
+            list_append(&ctx->execlru, &exec->hook);
+            return exec;
+        }
+        else
+            exec_free(ctx, exec);               /* replaced binary */
+    }
+
+    if (!process_get_binary(attr))
+        return NULL;
+
+    /* make sure we did not race with another exec */
+    if (stat(exe, &verify) < 0 ||
+        verify.st_dev != st.st_dev || verify.st_ino != st.st_ino ||
+        verify.st_ctime != st.st_ctime)
+        return NULL;
+
+    if (ctx->nexec >= ctx->maxexec) {
+        exec = list_entry(ctx->execlru.next, cgrp_exec_t, hook);
+        OHM_DEBUG(DBG_CLASSIFY, "evicting cached exec %s", exec->binary);
+        exec_free(ctx, exec);
+        ctx->exec_nevict++;
+    }
+
+    if (ALLOC_OBJ(exec) == NULL || (exec->binary = STRDUP(attr->binary)) == NULL) {
+        OHM_ERROR("cgrp: failed to allocate exec cache entry");
+        FREE(exec);
+        return NULL;
+    }
+
+    exec->dev   = st.st_dev;
+    exec->ino   = st.st_ino;
+    exec->ctime = st.st_ctime;
+    
+    list_init(&exec->hook);
+    list_append(&ctx->execlru, &exec->hook);
+    g_hash_table_insert(ctx->exectbl, exec, exec);
+    ctx->nexec++;
+
+    return exec;
+}
+
+
+/********************
+ * expr_constant
+ ********************/
+static int
+expr_constant(cgrp_expr_t *expr)
+{
+    /*
+     * Notes: exec events are never reclassifications, so the reclassify
+     *        property is just as constant as the binary itself.
+     */
+    
+    switch (expr->type) {
+    case CGRP_EXPR_BOOL:
+        return expr_constant(expr->bool.arg1) &&
+            (expr->bool.arg2 == NULL || expr_constant(expr->bool.arg2));
+    case CGRP_EXPR_PROP:
+        return (expr->prop.prop == CGRP_PROP_BINARY ||
+                expr->prop.prop == CGRP_PROP_RECLASSIFY);
+    default:
+        return FALSE;
+    }
+}
+
+
+/********************
+ * rule_constant
+ ********************/
+static int
+rule_constant(cgrp_rule_t *rule)
+{
+    cgrp_stmt_t *stmt;
+
+    for (stmt = rule->statements; stmt != NULL; stmt = stmt->next)
+        if (stmt->expr != NULL && !expr_constant(stmt->expr))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+/********************
+ * rule_provides
+ ********************/
+static int
+rule_provides(cgrp_rule_t *rule, cgrp_action_t *actions)
+{
+    cgrp_stmt_t *stmt;
+
+    if (actions == NULL)
+        return FALSE;
+    
+    for (stmt = rule->statements; stmt != NULL; stmt = stmt->next)
+        if (stmt->actions == actions)
+            return TRUE;
+
+    return FALSE;
+}
+
+
+/********************
+ * exec_cache_update
+ ********************/
+static void
+exec_cache_update(cgrp_context_t *ctx, cgrp_exec_t *exec,
+                  cgrp_rule_t *rules, cgrp_action_t *actions)
+{
+    exec->nmiss++;
+    ctx->exec_nmiss++;
+
+    if (exec->resolved)
+        return;
+
+    /*
+     * Notes: the fallback rules only matter if the primary ones did not
+     *        produce the actions we ended up with.
+     */
+    
+    exec->constant = rule_constant(rules);
+
+    if (exec->constant && rules != ctx->fallback && ctx->fallback != NULL &&
+        !rule_provides(rules, actions))
+        exec->constant = rule_constant(ctx->fallback);
+
+    exec->actions  = actions;
+    exec->resolved = TRUE;
+
+    OHM_DEBUG(DBG_CLASSIFY, "%s: decision %s cacheable", exec->binary,
+              exec->constant ? "is" : "is not");
+}
+
+
+/********************
+ * classify_cache_dump
+ ********************/
+void
+classify_cache_dump(cgrp_context_t *ctx, FILE *fp)
+{
+    cgrp_exec_t  *exec;
+    list_hook_t  *p, *n;
+    unsigned int  total;
+
+    if (ctx->exectbl == NULL) {
+        fprintf(fp, "exec classification cache disabled\n");
+        return;
+    }
+    
+    fprintf(fp, "exec classification cache: %d/%d entries\n",
+            ctx->nexec, ctx->maxexec);
+    fprintf(fp, "  decisions reused:    %u\n", ctx->exec_nhit);
+    fprintf(fp, "  decisions evaluated: %u\n", ctx->exec_nmiss);
+    fprintf(fp, "  entries evicted:     %u\n", ctx->exec_nevict);
+
+    list_foreach(&ctx->execlru, p, n) {
+        exec  = list_entry(p, cgrp_exec_t, hook);
+        total = exec->nhit + exec->nmiss;
+        fprintf(fp, "  %s: %u/%u hits (%u%%)%s\n", exec->binary,
+                exec->nhit, total, total ? 100 * exec->nhit / total : 0,
+                exec->resolved && !exec->constant ? ", not cacheable" : "");
+    }
+}
+
+
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -74,6 +74,9 @@ help(void)
     printf("cgroup help:          show this help\n");
     printf("cgroup show groups    show groups\n");
     printf("cgroup show config    show configuration\n");
+    printf("cgroup show apptrack  show application tracking statistics\n");
+    printf("cgroup show execcache show exec classification cache\n");
+    printf("cgroup show adjust    show priority/OOM adjustment statistics\n");
     printf("cgroup reclassify     reclassify all processes\n");
 }
 
@@ -98,6 +101,36 @@ show_config(void)
 }
 
 
+/********************
+ * show_apptrack
+ ********************/
+static void
+show_apptrack(void)
+{
+    apptrack_dump(ctx, stdout);
+}
+
+
+/********************
+ * show_execcache
+ ********************/
+static void
+show_execcache(void)
+{
+    classify_cache_dump(ctx, stdout);
+}
+
+
+/********************
+ * show_adjust
+ ********************/
+static void
+show_adjust(void)
+{
+    process_adjust_dump(ctx, stdout);
+}
+
+
 /********************
  * reclassify
  ********************/
@@ -129,6 +162,12 @@ console_command(char *command)
         show_groups();
     else if (!strcmp(command, "show config"))
         show_config();
+    else if (!strcmp(command, "show apptrack"))
+        show_apptrack();
+    else if (!strcmp(command, "show execcache"))
+        show_execcache();
+    else if (!strcmp(command, "show adjust"))
+        show_adjust();
     else if (!strncmp(command, "reclassify", sizeof("reclassify") - 1))
         reclassify(command + sizeof("reclassify") - 1);
     else
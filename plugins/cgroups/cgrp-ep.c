@@ -195,7 +195,7 @@ reparent_action(cgrp_context_t *ctx, void *data)
     if (group->partition == partition)
         return TRUE;
 
-    success = partition_add_group(partition, group, action->pid);
+    success = partition_add_group(ctx, partition, group, action->pid);
 
     OHM_DEBUG(DBG_ACTION, "reparenting group %d/'%s' to partition '%s' %s",
               action->pid, action->group, action->partition, success ? "OK" : "FAILED");
@@ -684,6 +684,9 @@ txparser(GObject *conn, GObject *transaction, gpointer data)
     success = TRUE;
 
     if (!strcmp(signal, "cgroup_actions")) {
+        /* apply only the final priority and OOM values of the decision */
+        process_adjust_begin(ctx);
+        
         for (entry = list; entry != NULL; entry = g_slist_next(entry)) {
             name = (char *)entry->data;
             for (action = actions; action->name != NULL; action++) {
@@ -691,6 +694,8 @@ txparser(GObject *conn, GObject *transaction, gpointer data)
                     success &= action_parser(action, ctx);
             }
         }
+
+        success &= process_adjust_end(ctx);
     }
 
     g_free(signal);
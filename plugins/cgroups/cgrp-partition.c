@@ -32,8 +32,11 @@ USA.
 #define PIDLEN 8                                 /* length of a pid as string */
 #define FROZEN "FROZEN\n"
 #define THAWED "THAWED\n"
+#define FROZEN_V2 "1\n"
+#define THAWED_V2 "0\n"
 
 #define CGROUP_FSTYPE  "cgroup"
+#define CGROUP2_FSTYPE "cgroup2"
 #define CGROUP_FREEZER "freezer"
 #define CGROUP_CPU     "cpu"
 #define CGROUP_MEMORY  "memory"
@@ -46,6 +49,14 @@ USA.
 #define MEMORY     "memory.limit_in_bytes"
 #define RT_PERIOD  "cpu.rt_period_us"
 #define RT_RUNTIME "cpu.rt_runtime_us"
+#define PROCS      "cgroup.procs"
+
+/* cgroup v2 (unified hierarchy) control entries */
+#define FREEZER_V2     "cgroup.freeze"
+#define CPU_V2         "cpu.weight"
+#define MEMORY_V2      "memory.max"
+#define CONTROLLERS_V2 "cgroup.controllers"
+#define SUBTREE_V2     "cgroup.subtree_control"
 
 static int discover_cgroupfs(cgrp_context_t *);
 static int mount_cgroupfs   (cgrp_context_t *);
@@ -55,6 +66,11 @@ static void close_control(int *);
 
 static int  write_control(int, char *, ...)     \
     __attribute__ ((format(printf, 2, 3)));
+static int  write_pid    (int, pid_t);
+
+static void enable_controllers(cgrp_context_t *, cgrp_partition_t *);
+static void pending_add(cgrp_partition_t *, cgrp_process_t *);
+static void pending_del(cgrp_process_t *);
 
 static void foreach_print(gpointer, gpointer, gpointer);
 static void foreach_del  (gpointer, gpointer, gpointer);
@@ -169,17 +185,38 @@ partition_add(cgrp_context_t *ctx, cgrp_partition_t *p)
         goto fail;
     }
 
+    list_init(&partition->pending);
+
     if (ctx->actual_mount != NULL &&
         mkdir(partition->path, 0755) < 0 && errno != EEXIST)
         OHM_ERROR("cgrp: failed to create partition '%s' (%s)",
                   partition->name, partition->path);
+
+    /*
+     * Notes: On a unified (v2) hierarchy there is no per-thread tasks
+     *        control, processes are always migrated as a whole, and the
+     *        controllers need to be enabled in the parent cgroup.
+     */
     
-    partition->control.tasks  = open_control(partition, TASKS);
-    partition->control.freeze = open_control(partition, FREEZER);
-    partition->control.cpu    = open_control(partition, CPU);
-    partition->control.mem    = open_control(partition, MEMORY);
+    if (CGRP_TST_FLAG(ctx->options.flags, CGRP_FLAG_UNIFIED)) {
+        partition->flags |= CGRP_PARTITION_UNIFIED;
+        enable_controllers(ctx, partition);
+        
+        partition->control.tasks  = CGRP_NO_CONTROL;
+        partition->control.procs  = open_control(partition, PROCS);
+        partition->control.freeze = open_control(partition, FREEZER_V2);
+        partition->control.cpu    = open_control(partition, CPU_V2);
+        partition->control.mem    = open_control(partition, MEMORY_V2);
+    }
+    else {
+        partition->control.tasks  = open_control(partition, TASKS);
+        partition->control.procs  = open_control(partition, PROCS);
+        partition->control.freeze = open_control(partition, FREEZER);
+        partition->control.cpu    = open_control(partition, CPU);
+        partition->control.mem    = open_control(partition, MEMORY);
+    }
 
-    if (partition->control.tasks < 0)
+    if (partition->control.tasks < 0 && partition->control.procs < 0)
         OHM_ERROR("cgrp: no task control for partition '%s'", partition->name);
 
     if (partition->control.freeze < 0 && ctx->actual_mount != NULL &&
@@ -221,12 +258,23 @@ partition_add(cgrp_context_t *ctx, cgrp_partition_t *p)
 void
 partition_del(cgrp_context_t *ctx, cgrp_partition_t *partition)
 {
+    cgrp_process_t *process;
+    list_hook_t    *p, *n;
+
     if (partition == NULL)
         return;
     
     part_hash_delete(ctx, partition->name);
+
+    if (partition->pending.next != NULL) {
+        list_foreach(&partition->pending, p, n) {
+            process = list_entry(p, cgrp_process_t, pending_hook);
+            pending_del(process);
+        }
+    }
     
     close_control(&partition->control.tasks);
+    close_control(&partition->control.procs);
     close_control(&partition->control.freeze);
     close_control(&partition->control.cpu);
     close_control(&partition->control.mem);
@@ -301,20 +349,48 @@ partition_print(cgrp_partition_t *partition, FILE *fp)
         fprintf(fp, "%s %s\n", cs->name, cs->value);
 }
 
+/********************
+ * partition_place
+ ********************/
+static void
+partition_place(cgrp_partition_t *partition, cgrp_process_t *process)
+{
+    process->partition = partition;
+    pending_del(process);
+    leader_acts(process);
+}
+
+
+/********************
+ * partition_add_process
+ ********************/
 int
 partition_add_process(cgrp_partition_t *partition, cgrp_process_t *process)
 {
-    char tasks[PIDLEN + 1];
-    int  len, chk, success = TRUE;
+    int fd, status, success;
+
+    if (partition->control.tasks >= 0)
+        fd = partition->control.tasks;
+    else if (partition->control.procs >= 0) {
+        if (process->pid != process->tgid) {
+            OHM_WARNING("cgrp: can't move thread %u/%u (%s) to partition "
+                        "'%s', threads stay with their process on cgroup v2",
+                        process->tgid, process->pid, process->name,
+                        partition->name);
+            return FALSE;
+        }
+        fd = partition->control.procs;
+    }
+    else
+        return FALSE;
 
-    len = sprintf(tasks, "%u\n", process->pid);
-    chk = write(partition->control.tasks, tasks, len);
+    status  = write_pid(fd, process->pid);
+    success = (status >= 0);
 
-    if (chk == len) {
-        process->partition = partition;
-        leader_acts(process);
-    } else if (chk >= 0 || errno != ESRCH)
-        success = FALSE;
+    if (status > 0)
+        partition_place(partition, process);
+    else if (status < 0)
+        pending_add(partition, process);
 
     OHM_DEBUG(DBG_ACTION, "adding process %u (%s) to partition '%s': %s",
               process->pid, process->name, partition->name,
@@ -324,61 +400,229 @@ partition_add_process(cgrp_partition_t *partition, cgrp_process_t *process)
 }
 
 
+/********************
+ * mark_mixed
+ ********************/
+typedef struct {
+    cgrp_group_t *group;
+    GHashTable   *mixed;
+} mixed_t;
+
+static void
+mark_mixed(cgrp_context_t *ctx, cgrp_process_t *process, void *data)
+{
+    mixed_t *m = (mixed_t *)data;
+
+    (void)ctx;
+
+    if (process->pid != process->tgid && process->group != m->group)
+        g_hash_table_insert(m->mixed, GUINT_TO_POINTER(process->tgid),
+                            GUINT_TO_POINTER(TRUE));
+}
+
+
 /********************
  * partition_add_group
  ********************/
 int
-partition_add_group(cgrp_partition_t *partition, cgrp_group_t *group, pid_t pid)
+partition_add_group(cgrp_context_t *ctx, cgrp_partition_t *partition,
+                    cgrp_group_t *group, pid_t pid)
 {
     cgrp_process_t *process;
     list_hook_t    *p, *n;
-    int             success;
+    GHashTable     *moved;
+    mixed_t         m;
+    int             status, success, nwrite;
 
     OHM_DEBUG(DBG_ACTION, "adding group '%s' to partition '%s'",
               group->name, partition->name);
 
     success = TRUE;
+    moved   = NULL;
+    nwrite  = 0;
+
+    /*
+     * Notes: When moving a whole group we first move each process with a
+     *        single write to cgroup.procs which takes all of its threads
+     *        along. With per-thread (v1) tasks control this is only done
+     *        for processes none of whose threads belong to another group.
+     *        Whatever is left is then moved one task at a time. Without
+     *        per-thread control the threads of a process that is already
+     *        in the partition are there, too.
+     */
+    
+    if (pid == 0 && partition->control.procs >= 0 &&
+        (moved = g_hash_table_new(NULL, NULL)) != NULL) {
+        m.group = group;
+        m.mixed = NULL;
+
+        if (partition->control.tasks >= 0) {
+            m.mixed = g_hash_table_new(NULL, NULL);
+            proc_hash_foreach(ctx, mark_mixed, &m);
+        }
+        
+        list_foreach(&group->processes, p, n) {
+            process = list_entry(p, cgrp_process_t, group_hook);
+
+            if (process->pid != process->tgid)
+                continue;
+
+            if (process->partition == partition) {
+                if (m.mixed == NULL)
+                    g_hash_table_insert(moved, GUINT_TO_POINTER(process->tgid),
+                                        GUINT_TO_POINTER(TRUE));
+                continue;
+            }
+
+            if (m.mixed != NULL &&
+                g_hash_table_lookup(m.mixed, GUINT_TO_POINTER(process->tgid)))
+                continue;
+
+            status = write_pid(partition->control.procs, process->tgid);
+            nwrite++;
+
+            if (status > 0) {
+                g_hash_table_insert(moved, GUINT_TO_POINTER(process->tgid),
+                                    GUINT_TO_POINTER(TRUE));
+                partition_place(partition, process);
+            }
+            else if (status < 0) {
+                pending_add(partition, process);
+                success = FALSE;
+            }
+        }
+        
+        if (m.mixed != NULL)
+            g_hash_table_destroy(m.mixed);
+    }
+    
     list_foreach(&group->processes, p, n) {
         process = list_entry(p, cgrp_process_t, group_hook);
         if (pid && process->pid != pid)
             continue;
 
-        if (process->partition != partition)
+        if (process->partition == partition)
+            continue;
+
+        if (moved != NULL &&
+            g_hash_table_lookup(moved, GUINT_TO_POINTER(process->tgid)))
+            partition_place(partition, process);
+        else {
             success &= partition_add_process(partition, process);
+            nwrite++;
+        }
     }
 
-    group->partition = partition;
+    if (moved != NULL)
+        g_hash_table_destroy(moved);
 
-    if (!success)
-        CGRP_SET_FLAG(group->flags, CGRP_GROUPFLAG_REASSIGN);
+    OHM_DEBUG(DBG_ACTION, "group '%s' moved to partition '%s' with %d writes",
+              group->name, partition->name, nwrite);
+    
+    group->partition = partition;
 
     return success;
 }
 
 
 /********************
- * unfreeze_fixup
+ * pending_add
  ********************/
-void
-unfreeze_fixup(cgrp_context_t *ctx, cgrp_partition_t *partition)
+static void
+pending_add(cgrp_partition_t *partition, cgrp_process_t *process)
 {
-    cgrp_group_t *group;
-    int           i;
+    pending_del(process);
+
+    process->pending = partition;
+    list_append(&partition->pending, &process->pending_hook);
+}
+
+
+/********************
+ * pending_del
+ ********************/
+static void
+pending_del(cgrp_process_t *process)
+{
+    if (process->pending != NULL) {
+        list_delete(&process->pending_hook);
+        process->pending = NULL;
+    }
+}
 
-    for (i = 0; i < ctx->ngroup; i++) {
-        group = &ctx->groups[i];
 
-        if (group->partition == partition &&
-            CGRP_TST_FLAG(group->flags, CGRP_GROUPFLAG_REASSIGN)) {
-            OHM_DEBUG(DBG_ACTION, "reassigning group '%s' to partition '%s'",
-                      group->name, partition->name);
-            partition_add_group(partition, group, 0);
-            CGRP_CLR_FLAG(group->flags, CGRP_GROUPFLAG_REASSIGN);
+/********************
+ * pending_retry
+ ********************/
+static void
+pending_retry(cgrp_partition_t *target, cgrp_partition_t *thawed)
+{
+    cgrp_process_t *process;
+    list_hook_t     retry, *p;
+
+    if (list_empty(&target->pending))
+        return;
+
+    /*
+     * Notes: we take over the whole pending list before retrying, as the
+     *        migrations that fail again are put back to the target. A
+     *        successful migration lets the leader move its threads and
+     *        followers, which can take any of the remaining entries off
+     *        the list, so we always pop the first one still on it.
+     */
+    
+    retry.next       = target->pending.next;
+    retry.prev       = target->pending.prev;
+    retry.next->prev = &retry;
+    retry.prev->next = &retry;
+    list_init(&target->pending);
+
+    while (!list_empty(&retry)) {
+        p = retry.next;
+        list_delete(p);
+        process = list_entry(p, cgrp_process_t, pending_hook);
+
+        if (target != thawed && process->partition != thawed) {
+            list_append(&target->pending, &process->pending_hook);
+            continue;
         }
+
+        OHM_DEBUG(DBG_ACTION, "retrying migration of %u/%u (%s) to '%s'",
+                  process->tgid, process->pid, process->name, target->name);
+
+        pending_del(process);
+        partition_add_process(target, process);
     }
 }
 
 
+/********************
+ * unfreeze_fixup
+ ********************/
+static void
+foreach_retry(gpointer key, gpointer value, gpointer user_data)
+{
+    cgrp_partition_t *target = (cgrp_partition_t *)value;
+    cgrp_partition_t *thawed = (cgrp_partition_t *)user_data;
+
+    (void)key;
+
+    pending_retry(target, thawed);
+}
+
+
+void
+unfreeze_fixup(cgrp_context_t *ctx, cgrp_partition_t *partition)
+{
+    /*
+     * Notes: Only the migrations that failed are retried: the ones to the
+     *        thawed partition and the ones out of it.
+     */
+    
+    part_hash_foreach(ctx, foreach_retry, partition);
+}
+
+
 /********************
  * partition_freeze
  ********************/
@@ -389,7 +633,11 @@ partition_freeze(cgrp_context_t *ctx, cgrp_partition_t *partition, int freeze)
     int   len, success;
 
     if (partition->control.freeze >= 0) {
-        if (freeze) {
+        if (partition->flags & CGRP_PARTITION_UNIFIED) {
+            cmd = freeze ? FROZEN_V2 : THAWED_V2;
+            len = 2;
+        }
+        else if (freeze) {
             cmd = FROZEN;
             len = sizeof(FROZEN) - 1;
         }
@@ -422,6 +670,16 @@ partition_limit_cpu(cgrp_partition_t *partition, unsigned int share)
     partition->limit.cpu = share;
     
     if (partition->control.cpu >= 0 && share > 0) {
+        /* map shares to weight like systemd does, 1024 -> 100 */
+        if (partition->flags & CGRP_PARTITION_UNIFIED) {
+            if (share > 262144)
+                share = 262144;
+            share = (share * 100) / 1024;
+            if (share < 1)
+                share = 1;
+            if (share > 10000)
+                share = 10000;
+        }
         len = snprintf(val, sizeof(val), "%u", share);
         chk = write(partition->control.cpu, val, len);
         return chk == len;
@@ -722,6 +980,66 @@ write_control(int fd, char *format, ...)
 }
 
 
+/********************
+ * write_pid
+ ********************/
+static int
+write_pid(int fd, pid_t pid)
+{
+    char buf[PIDLEN + 2];
+    int  len, chk;
+
+    /*
+     * Notes: returns 1 on success, 0 if the process is already gone and
+     *        -1 on any other failure (eg. migrating from/to frozen group).
+     */
+    
+    len = sprintf(buf, "%u\n", pid);
+    chk = write(fd, buf, len);
+
+    if (chk == len)
+        return 1;
+    else if (chk < 0 && errno == ESRCH)
+        return 0;
+    else
+        return -1;
+}
+
+
+/********************
+ * enable_controllers
+ ********************/
+static void
+enable_controllers(cgrp_context_t *ctx, cgrp_partition_t *partition)
+{
+    static const char *controllers[] = { "+cpu", "+memory", NULL };
+
+    char  path[PATH_MAX], *end;
+    int   fd, i;
+
+    if (ctx->actual_mount == NULL || !strcmp(partition->path, ctx->actual_mount))
+        return;
+
+    snprintf(path, sizeof(path), "%s", partition->path);
+    if ((end = strrchr(path, '/')) == NULL || end == path)
+        return;
+    
+    snprintf(end, sizeof(path) - (end - path), "/%s", SUBTREE_V2);
+
+    if ((fd = open(path, O_WRONLY)) < 0) {
+        OHM_WARNING("cgrp: failed to open %s", path);
+        return;
+    }
+
+    for (i = 0; controllers[i] != NULL; i++)
+        if (!write_control(fd, "%s", controllers[i]))
+            OHM_WARNING("cgrp: failed to enable controller '%s' for "
+                        "partition '%s'", controllers[i] + 1, partition->name);
+
+    close(fd);
+}
+
+
 /********************
  * foreach_print
  ********************/
@@ -753,6 +1071,48 @@ foreach_del(gpointer key, gpointer value, gpointer user_data)
 
 
 
+/********************
+ * discover_controllers
+ ********************/
+static int
+discover_controllers(const char *mount)
+{
+    mount_option_t *option;
+    FILE           *fp;
+    char            path[PATH_MAX], line[256], *name, *save;
+    int             available;
+
+    /* the freezer is built into the core of cgroup v2 */
+    available = 0;
+    CGRP_SET_FLAG(available, CGRP_FLAG_MOUNT_FREEZER);
+    
+    snprintf(path, sizeof(path), "%s/%s", mount, CONTROLLERS_V2);
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        OHM_ERROR("cgrp: failed to open %s", path);
+        return available;
+    }
+
+    if (fgets(line, sizeof(line), fp) != NULL) {
+        for (name = strtok_r(line, " \n", &save); name != NULL;
+             name = strtok_r(NULL, " \n", &save)) {
+            for (option = mntopts; option->name; option++) {
+                if (!strcmp(option->name, name)) {
+                    CGRP_SET_FLAG(available, option->flag);
+                    OHM_INFO("cgrp: cgroup v2 controller '%s' available",
+                             option->name);
+                    break;
+                }
+            }
+        }
+    }
+
+    fclose(fp);
+    
+    return available;
+}
+
+
 /********************
  * discover_cgroupfs
  ********************/
@@ -762,6 +1122,7 @@ discover_cgroupfs(cgrp_context_t *ctx)
     mount_option_t *option;
     FILE           *mounts;
     char            entry[1024], *path, *type, *opts, *rest, *next;
+    char           *unified;
     int             success, available;
     
 
@@ -772,6 +1133,7 @@ discover_cgroupfs(cgrp_context_t *ctx)
 
     success   = FALSE;
     available = 0;
+    unified   = NULL;
     while (fgets(entry, sizeof(entry), mounts) != NULL) {
         if ((path = strchr(entry, ' ')) == NULL)
             continue;
@@ -785,7 +1147,13 @@ discover_cgroupfs(cgrp_context_t *ctx)
         *path++ = '\0';
         *type++ = '\0';
         *opts++ = '\0';
-    
+
+        if (!strcmp(type, CGROUP2_FSTYPE)) {
+            if (unified == NULL)
+                unified = STRDUP(path);
+            continue;
+        }
+        
         if (strcmp(type, CGROUP_FSTYPE))
             continue;
 
@@ -815,6 +1183,19 @@ discover_cgroupfs(cgrp_context_t *ctx)
     
     fclose(mounts);
 
+    /* fall back to a unified hierarchy if there is no v1 one */
+    if (!success && unified != NULL) {
+        ctx->actual_mount = unified;
+        CGRP_SET_FLAG(ctx->options.flags, CGRP_FLAG_UNIFIED);
+        
+        OHM_INFO("cgrp: cgroup v2 fs is already mounted at %s", unified);
+        
+        available = discover_controllers(unified);
+        success   = TRUE;
+    }
+    else
+        FREE(unified);
+
     for (option = mntopts; option->name; option++)
         if (!CGRP_TST_FLAG(available, option->flag))
             CGRP_CLR_FLAG(ctx->options.flags, option->flag);
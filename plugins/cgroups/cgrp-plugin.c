@@ -99,7 +99,7 @@ plugin_init(OhmPlugin *plugin)
         plugin_exit(plugin);
 
     if (!fact_init(ctx) || !partition_init(ctx) || !group_init(ctx) ||
-        !procdef_init(ctx) || !classify_init(ctx) || !proc_init(ctx) ||
+        !procdef_init(ctx) || !classify_init(ctx, plugin) || !proc_init(ctx) ||
         !curve_init(ctx) || !leader_init(ctx)) {
         plugin_exit(plugin);
         exit(1);
@@ -119,6 +119,7 @@ typedef enum {
     CGRP_PARTITION_NONE     = 0x0,
     CGRP_PARTITION_NOFREEZE = 0x1,          /* partition not freezable */
     CGRP_PARTITION_FACT     = 0x2,          /* export partition to factstore */
+    CGRP_PARTITION_UNIFIED  = 0x4,          /* on a cgroup v2 hierarchy */
 } cgrp_part_flag_t;
 
 
@@ -131,6 +132,7 @@ typedef struct {
     int               flags;                  /* partition flags */
     struct {                                /* control file descriptors */
         int           tasks;                  /* partition tasks */
+        int           procs;                  /* partition processes */
         int           freeze;                 /* partition freezer */
         int           cpu;                    /* CPU share/weight */
         int           mem;                    /* memory limit */
@@ -148,6 +150,7 @@ typedef struct {
 #endif
 
     cgrp_ctrl_setting_t *settings;          /* extra cgroup controls */
+    list_hook_t       pending;              /* failed migrations to retry */
 } cgrp_partition_t;
 
 
@@ -158,7 +161,6 @@ typedef struct {
 typedef enum {
     CGRP_GROUPFLAG_STATIC,                  /* statically partitioned group */
     CGRP_GROUPFLAG_FACT,                    /* export to factstore */
-    CGRP_GROUPFLAG_REASSIGN,                /* partitioning has failed */
     CGRP_GROUPFLAG_PRIORITY,                /* group default priority value */
 } cgrp_group_flag_t;
 
@@ -461,6 +463,13 @@ enum {
     CGRP_OOM_EXTERN,                        /* out of policy control */
 };
 
+enum {
+    CGRP_ADJUST_NICE = 0x1,                 /* pending nice value */
+    CGRP_ADJUST_OOM  = 0x2,                 /* pending OOM adjustment */
+};
+
+#define CGRP_UNKNOWN_VALUE 0x7fff           /* not set by us (yet) */
+
 
 typedef struct {
     int   events;                           /* mask of events CGRP_EVENT*'s */
@@ -484,12 +493,20 @@ typedef struct {
     char             *name;                 /* classified by this name */
     cgrp_group_t     *group;                /* current group */
     cgrp_partition_t *partition;            /* current partition */
+    cgrp_partition_t *pending;              /* failed to migrate here */
     int               priority;             /* process priority */
     int               prio_mode;
     int               oom_adj;              /* OOM adjustment */
     int               oom_mode;
+    int               nice;                 /* nice value last set */
+    int               oom_score;            /* oom_adj value last written */
+    int               adjust;               /* pending CGRP_ADJUST_*'s */
+    int               nice_pending;         /* nice value to set */
+    int               oom_pending;          /* oom_adj value to write */
+    list_hook_t       adjust_hook;          /* hook to pending adjustments */
     list_hook_t       proc_hook;            /* hook to process table */
     list_hook_t       group_hook;           /* hook to group */
+    list_hook_t       pending_hook;         /* hook to pending migrations */
     cgrp_track_t     *track;                /* resolver notifications */
 } cgrp_process_t;
 
@@ -551,7 +568,8 @@ enum {
     CGRP_FLAG_MOUNT_CPUSET,
     CGRP_FLAG_ADDON_RULES,
     CGRP_FLAG_ADDON_MONITOR,
-    CGRP_FLAG_ALWAYS_FALLBACK
+    CGRP_FLAG_ALWAYS_FALLBACK,
+    CGRP_FLAG_UNIFIED
 };
 
 
@@ -670,6 +688,13 @@ typedef struct {
     GHashTable       *grouptbl;             /* lookup table of groups */
     GHashTable       *parttbl;              /* lookup table of partitions */
     list_hook_t      *proctbl;              /* lookup table of processes */
+    GHashTable       *exectbl;              /* exec classification cache */
+    list_hook_t       execlru;              /*   entries in LRU order */
+    int               nexec;                /*   number of entries */
+    int               maxexec;              /*   max. number of entries */
+    unsigned int      exec_nhit;            /*   reused decisions */
+    unsigned int      exec_nmiss;           /*   evaluated decisions */
+    unsigned int      exec_nevict;          /*   evicted entries */
     int               event_mask;           /* CGRP_EVENT_'s of interest */
 
     cgrp_process_t   *active_process;       /* currently active process */
@@ -686,7 +711,14 @@ typedef struct {
     guint             apptrack_src;         /*     and event source */
     list_hook_t       apptrack_subscribers; /* list of subscribers */
     OhmFact          *apptrack_changes;     /* $application_changes */
+    int               apptrack_watch;       /*   and our subscription */
     guint             apptrack_update;      /* scheduled change update */
+    guint             apptrack_window;      /* coalescing window (msecs) */
+    guint             apptrack_flush;       /* pending coalesced change */
+    pid_t             apptrack_notified;    /* last notified active pid */
+    unsigned int      apptrack_nchange;     /* active application changes */
+    unsigned int      apptrack_nnotify;     /*   notified to subscribers */
+    unsigned int      apptrack_nsuppress;   /*   coalesced or duplicate */
     
     int             (*resolve)(char *, char **);
     int             (*register_method)(char *, dres_handler_t);
@@ -702,9 +734,33 @@ typedef struct {
     int               oom_default;          /* default/starting value */
     cgrp_curve_t     *prio_curve;           /* priority adjustment mapping */
     int               prio_default;         /* default/starting value */
+
+    list_hook_t       adjustq;              /* pending priority/OOM changes */
+    int               adjust_batch;         /* batching nesting level */
+    unsigned int      nice_nset;            /* setpriority calls made */
+    unsigned int      nice_nskip;           /*   and avoided */
+    unsigned int      oom_nset;             /* oom_adj writes made */
+    unsigned int      oom_nskip;            /*   and avoided */
+    unsigned int      adjust_ncoalesce;     /* superseded batched changes */
 } cgrp_context_t;
 
 
+typedef struct {
+    list_hook_t       hook;                 /* hook to LRU list */
+    dev_t             dev;                  /* device and */
+    ino_t             ino;                  /*   inode of the executable */
+    time_t            ctime;                /*   and its status change time */
+    char             *binary;               /* path to binary */
+    int               resolved;             /* decision evaluated ? */
+    int               constant;             /* decision depends on binary only */
+    cgrp_action_t    *actions;              /* cached decision for exec */
+    unsigned int      nhit;                 /* reused decisions */
+    unsigned int      nmiss;                /* evaluated decisions */
+} cgrp_exec_t;
+
+#define CGRP_EXEC_CACHE 64                  /* default exec cache size */
+
+
 #define CGRP_RECLASSIFY_MAX 16
 
 typedef struct {
@@ -747,6 +803,9 @@ int process_set_priority(cgrp_context_t *, cgrp_process_t *, int, int);
 int process_adjust_priority(cgrp_context_t *,
                             cgrp_process_t *, cgrp_adjust_t, int, int);
 int process_adjust_oom(cgrp_context_t *, cgrp_process_t *, cgrp_adjust_t, int);
+void process_adjust_begin(cgrp_context_t *);
+int  process_adjust_end(cgrp_context_t *);
+void process_adjust_dump(cgrp_context_t *, FILE *);
 
 
 void procattr_dump(cgrp_proc_attr_t *);
@@ -772,7 +831,8 @@ cgrp_partition_t *partition_add_root(cgrp_context_t *);
 void partition_dump(cgrp_context_t *, FILE *);
 void partition_print(cgrp_partition_t *, FILE *);
 int partition_add_process(cgrp_partition_t *, cgrp_process_t *);
-int partition_add_group(cgrp_partition_t *, cgrp_group_t *, pid_t);
+int partition_add_group(cgrp_context_t *, cgrp_partition_t *, cgrp_group_t *,
+                        pid_t);
 int partition_freeze(cgrp_context_t *, cgrp_partition_t *, int);
 int partition_limit_cpu(cgrp_partition_t *, unsigned int);
 int partition_limit_mem(cgrp_partition_t *, unsigned int);
@@ -831,7 +891,7 @@ cgrp_action_t *rule_eval(cgrp_context_t *, cgrp_rule_t *, cgrp_proc_attr_t *);
 
 
 /* cgrp-classify.c */
-int  classify_init  (cgrp_context_t *);
+int  classify_init  (cgrp_context_t *, OhmPlugin *);
 void classify_exit  (cgrp_context_t *);
 int  classify_config(cgrp_context_t *);
 int  classify_reconfig(cgrp_context_t *);
@@ -840,6 +900,7 @@ int  classify_by_binary(cgrp_context_t *, pid_t, int);
 int  classify_by_argvx(cgrp_context_t *, cgrp_proc_attr_t *, int);
 void classify_schedule(cgrp_context_t *, pid_t, unsigned int, int);
 char *classify_event_name(cgrp_event_type_t);
+void classify_cache_dump(cgrp_context_t *, FILE *);
 
 
 /* cgrp-action.c */
@@ -972,6 +1033,7 @@ void apptrack_unsubscribe(void (*)(pid_t, const char *, const char *,
                                    const char *, void *),
                           void *);
 void apptrack_query(pid_t *, const char **, const char **, const char **);
+void apptrack_dump(cgrp_context_t *, FILE *);
 
 /* cgrp-console.c */
 int  console_init(cgrp_context_t *);
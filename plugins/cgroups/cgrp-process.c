@@ -79,6 +79,11 @@ static void subscr_init(cgrp_context_t *ctx);
 static void subscr_exit(cgrp_context_t *ctx);
 static void subscr_notify(cgrp_context_t *ctx, int what, pid_t pid);
 
+static int  set_nice(cgrp_context_t *ctx, cgrp_process_t *process, int nice);
+static int  set_oom (cgrp_context_t *ctx, cgrp_process_t *process, int mapped);
+static void adjust_queue(cgrp_context_t *ctx, cgrp_process_t *process,
+                         int what, int value);
+
 
 typedef struct {
     list_hook_t   hook;
@@ -97,6 +102,7 @@ proc_init(cgrp_context_t *ctx)
     
     mypid = getpid();
 
+    list_init(&ctx->adjustq);
     subscr_init(ctx);
 
     netlink_setup(ctx);
@@ -133,6 +139,11 @@ proc_exit(cgrp_context_t *ctx)
 
     proc_hash_foreach(ctx, remove_process, NULL);
 
+    OHM_INFO("cgrp: priority adjustments: %u set, %u unchanged; "
+             "OOM adjustments: %u set, %u unchanged; %u coalesced",
+             ctx->nice_nset, ctx->nice_nskip, ctx->oom_nset, ctx->oom_nskip,
+             ctx->adjust_ncoalesce);
+
     mypid = 0;
 }
 
@@ -1151,12 +1162,17 @@ process_create(cgrp_context_t *ctx, cgrp_proc_attr_t *attr)
 
     list_init(&process->proc_hook);
     list_init(&process->group_hook);
+    list_init(&process->pending_hook);
+    list_init(&process->adjust_hook);
 
     process->pid  = attr->pid;
     process->tgid = attr->tgid;
     process->tracer = attr->tracer;
     process->name = process->binary;
 
+    process->nice      = CGRP_UNKNOWN_VALUE;
+    process->oom_score = CGRP_UNKNOWN_VALUE;
+
     if (ctx->oom_curve)
         process->oom_adj = ctx->oom_default;
 
@@ -1187,6 +1203,8 @@ process_remove(cgrp_context_t *ctx, cgrp_process_t *process)
     
     group_del_process(process);
     proc_hash_unhash(ctx, process);
+    list_delete(&process->pending_hook);
+    list_delete(&process->adjust_hook);
     FREE(process->binary);
     FREE(process->argv0);
     FREE(process->argvx);
@@ -1406,7 +1424,12 @@ process_adjust_priority(cgrp_context_t *ctx, cgrp_process_t *process,
         else if (mapped < -20)
             mapped = -20;
 
-        status = setpriority(PRIO_PROCESS, process->pid, mapped);
+        if (ctx->adjust_batch > 0) {
+            adjust_queue(ctx, process, CGRP_ADJUST_NICE, mapped);
+            status = 0;
+        }
+        else
+            status = set_nice(ctx, process, mapped) ? 0 : -1;
     }
 
     return status == 0 || errno == ESRCH;
@@ -1420,8 +1443,7 @@ int
 process_adjust_oom(cgrp_context_t *ctx,
                    cgrp_process_t *process, cgrp_adjust_t adjust, int value)
 {
-    char path[PATH_MAX], val[8], *p;
-    int  oom_adj, mapped, fd, len, success;
+    int oom_adj, mapped;
 
     if (process->pid != process->tgid)
         return TRUE;
@@ -1496,6 +1518,60 @@ process_adjust_oom(cgrp_context_t *ctx,
     OHM_DEBUG(DBG_ACTION, "%u/%u (%s), adjusting OOM score %d/%d:%d",
               process->tgid, process->pid, process->name,
               oom_adj, process->oom_adj, mapped);
+
+    if (ctx->adjust_batch > 0) {
+        adjust_queue(ctx, process, CGRP_ADJUST_OOM, mapped);
+        return TRUE;
+    }
+    else
+        return set_oom(ctx, process, mapped);
+}
+
+
+/********************
+ * set_nice
+ ********************/
+static int
+set_nice(cgrp_context_t *ctx, cgrp_process_t *process, int nice)
+{
+    /*
+     * Notes: We only remember what we have set ourselves. If somebody else
+     *        changes the priority behind our back, we will not notice it
+     *        until we want a different value.
+     */
+    
+    if (process->nice == nice) {
+        ctx->nice_nskip++;
+        return TRUE;
+    }
+    
+    ctx->nice_nset++;
+
+    if (setpriority(PRIO_PROCESS, process->pid, nice) == 0) {
+        process->nice = nice;
+        return TRUE;
+    }
+    else
+        return errno == ESRCH;
+}
+
+
+/********************
+ * set_oom
+ ********************/
+static int
+set_oom(cgrp_context_t *ctx, cgrp_process_t *process, int mapped)
+{
+    char path[PATH_MAX], val[8], *p;
+    int  value, fd, len, success;
+
+    if (process->oom_score == mapped) {
+        ctx->oom_nskip++;
+        return TRUE;
+    }
+
+    ctx->oom_nset++;
+    value = mapped;
     
     /*
      *
@@ -1543,7 +1619,11 @@ process_adjust_oom(cgrp_context_t *ctx,
     len = p - val;
 
     success = write(fd, val, len);
-    if (success == len || (success < 0 && errno == ESRCH))
+    if (success == len) {
+        process->oom_score = value;
+        success = TRUE;
+    }
+    else if (success < 0 && errno == ESRCH)
         success = TRUE;
     else
         success = FALSE;
@@ -1556,6 +1636,89 @@ process_adjust_oom(cgrp_context_t *ctx,
 }
 
 
+/********************
+ * adjust_queue
+ ********************/
+static void
+adjust_queue(cgrp_context_t *ctx, cgrp_process_t *process, int what, int value)
+{
+    if (process->adjust & what)
+        ctx->adjust_ncoalesce++;
+
+    if (what == CGRP_ADJUST_NICE)
+        process->nice_pending = value;
+    else
+        process->oom_pending  = value;
+
+    process->adjust |= what;
+
+    if (list_empty(&process->adjust_hook))
+        list_append(&ctx->adjustq, &process->adjust_hook);
+}
+
+
+/********************
+ * process_adjust_begin
+ ********************/
+void
+process_adjust_begin(cgrp_context_t *ctx)
+{
+    ctx->adjust_batch++;
+}
+
+
+/********************
+ * process_adjust_end
+ ********************/
+int
+process_adjust_end(cgrp_context_t *ctx)
+{
+    cgrp_process_t *process;
+    list_hook_t    *p, *n;
+    int             success;
+
+    if (ctx->adjust_batch <= 0 || --ctx->adjust_batch > 0)
+        return TRUE;
+
+    /*
+     * Notes: by now only the last requested values are left pending, and
+     *        out of those we only apply the ones we have not set already.
+     */
+    
+    success = TRUE;
+    list_foreach(&ctx->adjustq, p, n) {
+        process = list_entry(p, cgrp_process_t, adjust_hook);
+        list_delete(&process->adjust_hook);
+
+        if (process->adjust & CGRP_ADJUST_NICE)
+            success &= set_nice(ctx, process, process->nice_pending);
+        if (process->adjust & CGRP_ADJUST_OOM)
+            success &= set_oom(ctx, process, process->oom_pending);
+
+        process->adjust = 0;
+    }
+
+    return success;
+}
+
+
+/********************
+ * process_adjust_dump
+ ********************/
+void
+process_adjust_dump(cgrp_context_t *ctx, FILE *fp)
+{
+    fprintf(fp, "priority adjustments:\n");
+    fprintf(fp, "  setpriority calls:   %u\n", ctx->nice_nset);
+    fprintf(fp, "  unchanged, skipped:  %u\n", ctx->nice_nskip);
+    fprintf(fp, "OOM adjustments:\n");
+    fprintf(fp, "  oom_adj writes:      %u\n", ctx->oom_nset);
+    fprintf(fp, "  unchanged, skipped:  %u\n", ctx->oom_nskip);
+    fprintf(fp, "batched changes superseded within a decision: %u\n",
+            ctx->adjust_ncoalesce);
+}
+
+
 /********************
  * process_track_add
  ********************/
@@ -0,0 +1,238 @@
+/*
+ *  gcc -Wall `pkg-config --cflags --libs ohm-plugin` \
+ *      partition-test.c -o partition-test
+ */
+
+/*
+ * Pending migration retry test.
+ *
+ * Puts a leader, its follower and an unrelated process on the pending
+ * list of a frozen partition, thaws the partition and checks that the
+ * retry migrates all of them exactly once even though placing the
+ * leader migrates its follower, taking it off the list being retried.
+ */
+
+#include <stdarg.h>
+#include <signal.h>
+
+int DBG_ACTION;
+
+#include "cgrp-partition.c"
+
+#define fatal(fmt, args...) do {                                \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);      \
+        exit(1);                                                \
+    } while (0)
+
+#define LEADER   0
+#define FOLLOWER 1
+#define OTHER    2
+#define NPROCESS 3
+
+static cgrp_partition_t  frozen;
+static cgrp_process_t    processes[NPROCESS];
+static int               nwrite[NPROCESS];
+
+
+void ohm_log(OhmLogLevel level, const gchar *format, ...)
+{
+    va_list ap;
+
+    if (level == OHM_LOG_ERROR) {
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        fprintf(stderr, "\n");
+    }
+}
+
+
+int __trace_printf(int id, const char *file, int line, const char *func,
+                   const char *format, ...)
+{
+    (void)id;
+    (void)file;
+    (void)line;
+    (void)func;
+    (void)format;
+
+    return FALSE;
+}
+
+
+/*
+ * stubs for the parts of the plugin the partition code calls into
+ */
+
+int part_hash_init(cgrp_context_t *ctx) { (void)ctx; return TRUE; }
+void part_hash_exit(cgrp_context_t *ctx) { (void)ctx; }
+
+int
+part_hash_insert(cgrp_context_t *ctx, cgrp_partition_t *partition)
+{
+    (void)ctx;
+    (void)partition;
+
+    return TRUE;
+}
+
+int
+part_hash_delete(cgrp_context_t *ctx, const char *name)
+{
+    (void)ctx;
+    (void)name;
+
+    return TRUE;
+}
+
+cgrp_partition_t *
+part_hash_lookup(cgrp_context_t *ctx, const char *name)
+{
+    (void)ctx;
+
+    return strcmp(name, frozen.name) ? NULL : &frozen;
+}
+
+cgrp_partition_t *
+part_hash_find_by_path(cgrp_context_t *ctx, const char *path)
+{
+    (void)ctx;
+    (void)path;
+
+    return NULL;
+}
+
+void
+part_hash_foreach(cgrp_context_t *ctx, GHFunc callback, void *data)
+{
+    (void)ctx;
+
+    callback(frozen.name, &frozen, data);
+}
+
+void
+proc_hash_foreach(cgrp_context_t *ctx,
+                  void (*callback)(cgrp_context_t *, cgrp_process_t *, void *),
+                  void *data)
+{
+    int i;
+
+    for (i = 0; i < NPROCESS; i++)
+        callback(ctx, processes + i, data);
+}
+
+void
+leader_acts(cgrp_process_t *process)
+{
+    cgrp_process_t *follower = processes + FOLLOWER;
+
+    nwrite[process - processes]++;
+
+    /* like lead_followers in cgrp-leader.c */
+    if (process == processes + LEADER &&
+        follower->partition != process->partition)
+        partition_add_process(process->partition, follower);
+}
+
+
+static void
+timeout(int signum)
+{
+    (void)signum;
+
+    printf("pending retry did not terminate\nFAILED\n");
+    exit(1);
+}
+
+
+static void
+process_init(cgrp_process_t *process, pid_t pid, char *name)
+{
+    memset(process, 0, sizeof(*process));
+
+    process->pid  = process->tgid = pid;
+    process->name = name;
+    list_init(&process->pending_hook);
+    list_init(&process->group_hook);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    cgrp_context_t ctx;
+    int            thawed, nfailed, i;
+
+    (void)argc;
+    (void)argv;
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    frozen.name          = "frozen";
+    frozen.control.procs = CGRP_NO_CONTROL;
+    list_init(&frozen.pending);
+
+    process_init(processes + LEADER  , 100, "leader");
+    process_init(processes + FOLLOWER, 200, "follower");
+    process_init(processes + OTHER   , 300, "other");
+
+    /* all migrations to a frozen partition fail */
+    if ((frozen.control.tasks = open("/dev/full", O_WRONLY)) < 0)
+        fatal("failed to open /dev/full");
+
+    for (i = 0; i < NPROCESS; i++)
+        if (partition_add_process(&frozen, processes + i))
+            fatal("migration of process #%d did not fail", i);
+
+    for (i = 0; i < NPROCESS; i++)
+        if (processes[i].pending != &frozen)
+            fatal("migration of process #%d is not pending", i);
+
+    /* thaw the partition and retry */
+    if ((thawed = open("/dev/null", O_WRONLY)) < 0 ||
+        dup2(thawed, frozen.control.tasks) < 0)
+        fatal("failed to open /dev/null");
+    close(thawed);
+
+    signal(SIGALRM, timeout);
+    alarm(5);
+
+    unfreeze_fixup(&ctx, &frozen);
+
+    alarm(0);
+
+    nfailed = 0;
+
+    for (i = 0; i < NPROCESS; i++) {
+        if (processes[i].partition != &frozen ||
+            processes[i].pending != NULL) {
+            printf("process %s not migrated\n", processes[i].name);
+            nfailed++;
+        }
+        if (nwrite[i] != 1) {
+            printf("process %s migrated %d times\n", processes[i].name,
+                   nwrite[i]);
+            nfailed++;
+        }
+    }
+
+    if (!list_empty(&frozen.pending)) {
+        printf("migrations left pending\n");
+        nfailed++;
+    }
+
+    close(frozen.control.tasks);
+
+    printf("%s\n", nfailed ? "FAILED" : "PASSED");
+
+    return nfailed ? 1 : 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -40,6 +40,12 @@ USA.
 #define INVALID_ID   -1
 #define BUFFER_CHUNK 128
 
+#define OUTPUT_CHUNK 4096                /* initial output queue size */
+#define OUTPUT_MAX   (64 * 1024)         /* max. in-memory output queue */
+#define SPOOL_MAX    (16 * 1024 * 1024)  /* max. spooled output per client */
+#define SPOOL_POLL   100                 /* grabbed output poll interval */
+#define SPOOL_PATH   "/tmp/ohm-console.XXXXXX"
+
 #define CALLBACK(c, cb, args...) do {               \
         if ((c)->cb != NULL) {                      \
             (c)->active++;                          \
@@ -112,6 +118,8 @@ enum {
     CONSOLE_SINGLE   = 0x00,
     CONSOLE_MULTIPLE = 0x01,
     CONSOLE_CLOSED   = 0x02,
+    CONSOLE_CR       = 0x04,             /* last input line ended in '\r' */
+    CONSOLE_LOST     = 0x08,             /* peer gone, owner not notified */
 };
 
 typedef struct console_s console_t;
@@ -130,7 +138,17 @@ struct console_s {
     char      *buf;                      /* input buffer */
     size_t     size;                     /* buffer size */
     size_t     used;                     /* buffer used */
-    
+    size_t     scan;                     /* input scanned for EOL so far */
+
+    char      *obuf;                     /* output queue */
+    size_t     osize;                    /* output queue size */
+    size_t     ohead;                    /* first unsent byte */
+    size_t     otail;                    /* end of queued output */
+    int        spool;                    /* overflow and grabbed output */
+    off_t      spooled;                  /* spool read offset */
+    guint      oid;                      /* G_IO_OUT watch id */
+    guint      tid;                      /* grabbed output poll timer id */
+
     void (*opened)(int, struct sockaddr *, int); /* open callback */
     void (*closed)(int);                         /* close callback */
     void (*input) (int, char *, void *);         /* input callback */
@@ -151,9 +169,19 @@ static unsigned int   nconsole;
 
 static gboolean console_accept (GIOChannel *, GIOCondition, gpointer);
 static gboolean console_handler(GIOChannel *, GIOCondition, gpointer);
+static gboolean console_writer (GIOChannel *, GIOCondition, gpointer);
+
+static int  grab_fd  (int fd, int sock);
+static int  ungrab_fd(int grab);
+
+static int  output_spool(console_t *c);
+static int  output_push (console_t *c, char *data, size_t size);
+static void output_kick (console_t *c);
+static void output_reset(console_t *c);
+
+static void close_console(console_t *c);
 
-static int grab_fd  (int fd, int sock);
-static int ungrab_fd(int grab);
+static gboolean console_poll(gpointer);
 
 
 /*****************************************************************************
@@ -221,12 +249,15 @@ del_console(console_t *c)
         }
     }
 
+    output_reset(c);
+
     FREE(c->endpoint);
     close(c->sock);
     
     c->endpoint = NULL;
     c->sock     = -1;
     c->used     = 0;
+    c->scan     = 0;
     memset(c->buf, 0, c->size);
 
     if (c->nchild > 0) {
@@ -253,7 +284,8 @@ lookup_console(int id)
     unsigned int i;
 
     for (i = 0; i < nconsole; i++)
-        if (consoles[i] != NULL && consoles[i]->gid == (guint)id)
+        if (consoles[i] != NULL && consoles[i]->gid != 0 &&
+            consoles[i]->gid == (guint)id)
             return consoles[i];
     
     return NULL;
@@ -310,6 +342,7 @@ OHM_EXPORTABLE(int, console_open, (char *address,
     c->input    = input;
     c->data     = data;
     c->flags    = multiple ? CONSOLE_MULTIPLE : CONSOLE_SINGLE;
+    c->spool    = -1;
     
     reuse = 1;
     setsockopt(c->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
@@ -350,11 +383,52 @@ OHM_EXPORTABLE(int, console_open, (char *address,
 static void
 shutdown_console(console_t *c)
 {
-    g_source_remove(c->gid);
+    if (c->gio == NULL)                  /* already shut down */
+        return;
+
+    if (c->oid != 0) {
+        g_source_remove(c->oid);
+        c->oid = 0;
+    }
+    if (c->tid != 0) {
+        g_source_remove(c->tid);
+        c->tid = 0;
+    }
+    if (c->gid != 0) {
+        g_source_remove(c->gid);
+        c->gid = 0;
+    }
     g_io_channel_unref(c->gio);
+    c->gio = NULL;
+    c->flags &= ~(CONSOLE_CLOSED | CONSOLE_LOST);
     del_console(c);
 }
 
+
+/********************
+ * close_console
+ ********************/
+static void
+close_console(console_t *c)
+{
+    /*
+     * Notes:
+     *   This is the single place where a closed console gets torn down.
+     *   The owner is notified only if the peer went away, not if it
+     *   closed the console itself, and at most once: the console is
+     *   unreachable by its id once shut down.
+     */
+    if (c->gio == NULL)
+        return;
+    
+    if (c->flags & CONSOLE_LOST) {
+        c->flags &= ~CONSOLE_LOST;
+        CALLBACK(c, closed);
+    }
+    
+    shutdown_console(c);
+}
+
 /********************
  * console_close
  ********************/
@@ -387,7 +461,7 @@ OHM_EXPORTABLE(int, console_write, (int id, char *buf, size_t size))
     if (size == 0)
         size = strlen(buf);
 
-    return write(c->sock, buf, size);
+    return output_push(c, buf, size);
 }
 
 
@@ -397,8 +471,8 @@ OHM_EXPORTABLE(int, console_write, (int id, char *buf, size_t size))
 OHM_EXPORTABLE(int, console_printf, (int id, char *fmt, ...))
 {
     console_t *c = lookup_console(id);
-    int        fd, len;
-    FILE      *fp;
+    char       buf[1024], *out;
+    int        len;
     va_list    ap;
 
     if (c == NULL) {
@@ -406,19 +480,27 @@ OHM_EXPORTABLE(int, console_printf, (int id, char *fmt, ...))
         return -1;
     }
     
-    if ((fd = dup(c->sock)) < 0)
-        return -1;
-    
-    if ((fp = fdopen(fd, "w")) == NULL) {
-        close(fd);
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (len < 0)
         return -1;
-    }
-    
+
+    if (len < (int)sizeof(buf))
+        return output_push(c, buf, len);
+
     va_start(ap, fmt);
-    len = vfprintf(fp, fmt, ap);
+    out = g_strdup_vprintf(fmt, ap);
     va_end(ap);
-    fflush(fp);
-    fclose(fp);
+
+    if (out == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    len = output_push(c, out, len);
+    g_free(out);
 
     return len;
 }
@@ -500,9 +582,21 @@ OHM_EXPORTABLE(int, console_grab, (int id, int fd))
     if (empty < 0)
         return ENOSPC;
     
-    if ((c->grabs[empty] = grab_fd(fd, c->sock)) == 0)
+    /*
+     * Grabbed output goes to the spool of the console instead of the
+     * socket itself, so a client that stops reading can never block us.
+     * The spool is then streamed to the client from the main loop.
+     */
+
+    if (output_spool(c) < 0)
         return errno;
 
+    if ((c->grabs[empty] = grab_fd(fd, c->spool)) == 0)
+        return errno;
+
+    if (c->tid == 0)
+        c->tid = g_timeout_add(SPOOL_POLL, console_poll, c);
+
     return 0;
 }
 
@@ -525,6 +619,9 @@ OHM_EXPORTABLE(int, console_ungrab, (int id, int fd))
                 c->grabs[i] = 0;
             }
         }
+        output_kick(c);
+        if (CLOSED(c))
+            close_console(c);
         return 0;
     }
     else {
@@ -538,6 +635,9 @@ OHM_EXPORTABLE(int, console_ungrab, (int id, int fd))
         if (entry >= 0) {
             ungrab_fd(c->grabs[entry]);
             c->grabs[entry] = 0;
+            output_kick(c);
+            if (CLOSED(c))
+                close_console(c);
             return 0;
         }
         else
@@ -622,11 +722,14 @@ console_accept(GIOChannel *source, GIOCondition condition, gpointer data)
     if ((sock = accept(lc->sock, (struct sockaddr *)&addr, &addrlen)) < 0)
         return TRUE;
     
-    if ((flags = fcntl(lc->sock, F_GETFD, 0)) == 0) {
+    if ((flags = fcntl(sock, F_GETFD, 0)) == 0) {
         flags |= FD_CLOEXEC;
-        fcntl(lc->sock, F_SETFD, flags);
+        fcntl(sock, F_SETFD, flags);
     }
     
+    if ((flags = fcntl(sock, F_GETFL, 0)) >= 0)
+        fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
     if (lc->nchild > 1 && !(lc->flags & CONSOLE_MULTIPLE)) {
         write(sock, BUSY_MESSAGE, sizeof(BUSY_MESSAGE) - 1);
         close(sock);
@@ -639,8 +742,10 @@ console_accept(GIOChannel *source, GIOCondition condition, gpointer data)
     c->endpoint = STRDUP(lc->endpoint);
     c->size     = BUFFER_CHUNK;
     c->used     = 0;
+    c->scan     = 0;
     c->buf      = ALLOC_ARR(char, c->size);
     c->sock     = sock;
+    c->spool    = -1;
     c->opened   = lc->opened;
     c->closed   = lc->closed;
     c->input    = lc->input;
@@ -659,7 +764,7 @@ console_accept(GIOChannel *source, GIOCondition condition, gpointer data)
     
     CALLBACK(c, opened, (struct sockaddr *)&addr, (int)addrlen);
     if (CLOSED(c))
-        shutdown_console(c);
+        close_console(c);
 
     return TRUE;
 
@@ -682,12 +787,15 @@ console_accept(GIOChannel *source, GIOCondition condition, gpointer data)
 static int
 console_read(console_t *c)
 {
-    int n, left = c->size - c->used - 1;
+    size_t size;
+    int    n, left = c->size - c->used - 1;
     
     if (left < BUFFER_CHUNK) {
-        if (REALLOC_ARR(c->buf, c->size, c->size + BUFFER_CHUNK) == NULL)
+        size = c->size * 2;
+        if (REALLOC_ARR(c->buf, c->size, size) == NULL)
             return -ENOMEM;
-        c->size += BUFFER_CHUNK;
+        c->size = size;
+        left    = c->size - c->used - 1;
     }
 
     switch ((n = read(c->sock, c->buf + c->used, left))) {
@@ -696,6 +804,7 @@ console_read(console_t *c)
         return n;
     default:
         c->used += n;
+        c->buf[c->used] = '\0';
         return c->used;
     }
 }
@@ -708,53 +817,385 @@ static gboolean
 console_handler(GIOChannel *source, GIOCondition condition, gpointer data)
 {
     console_t    *c = (console_t *)data;
-    int           left = c->size - c->used - 1;
-    unsigned int  i;
+    unsigned int  i, line;
 
     (void)source;
 
     if (condition & G_IO_IN) {
         switch (console_read(c)) {
         case -1:
+            if (errno != EAGAIN && errno != EINTR)
+                goto closed;
             break;
         case 0:
             goto closed;
         default:
-            for (i = 0; i < c->used; i++)
-                if (c->buf[i] == '\r') {
-                    c->buf[i] = '\0';
-                    if (i < c->used && c->buf[i+1] == '\n') {
-                        i++;
+            line = 0;
+
+            /* skip the '\n' of a "\r\n" split across two reads */
+            if (c->flags & CONSOLE_CR) {
+                c->flags &= ~CONSOLE_CR;
+                if (c->scan == 0 && c->buf[0] == '\n')
+                    line = c->scan = 1;
+            }
+
+            /* only scan what has not been scanned before */
+            for (i = c->scan; i < c->used; i++) {
+                if (c->buf[i] != '\r')
+                    continue;
+                
+                c->buf[i] = '\0';
+                if (i + 1 < c->used) {
+                    if (c->buf[i+1] == '\n')
                         c->buf[++i] = '\0';
-                    }
-                    CALLBACK(c, input, c->buf, c->data);
-                    if (CLOSED(c))
-                        goto closed;
-                    if ((left = c->used - i - 1) > 0) {
-                        memmove(c->buf, c->buf + i + 1, left);
-                        c->used         -= i + 1;
-                        c->buf[c->used]  = '\0';
-                        i                = 0;
-                    }
-                    else
-                        c->used = 0;
                 }
+                else
+                    c->flags |= CONSOLE_CR;
+                
+                CALLBACK(c, input, c->buf + line, c->data);
+                if (CLOSED(c))
+                    goto closed;
+                line = i + 1;
+            }
+
+            /* move any partial line to the beginning, once per read */
+            if (line > 0) {
+                c->used -= line;
+                if (c->used > 0)
+                    memmove(c->buf, c->buf + line, c->used);
+                c->buf[c->used] = '\0';
+            }
+            c->scan = c->used;
+
+            output_kick(c);
+            if (CLOSED(c))
+                goto closed;
         }
     }
     
     if (condition & G_IO_HUP) {
-        CALLBACK(c, closed);
+        c->flags |= CONSOLE_LOST;
         goto closed;
     }
 
     return TRUE;
 
  closed:
-    shutdown_console(c);
+    close_console(c);
+    return FALSE;
+}
+
+
+/*****************************************************************************
+ *                       *** output queue and spool ***                      *
+ *****************************************************************************/
+
+/********************
+ * spool_pending
+ ********************/
+static off_t
+spool_pending(console_t *c)
+{
+    off_t end;
+
+    if (c->spool < 0)
+        return 0;
+    
+    if ((end = lseek(c->spool, 0, SEEK_CUR)) < 0)
+        return 0;
+    
+    return end - c->spooled;
+}
+
+
+/********************
+ * output_spool
+ ********************/
+static int
+output_spool(console_t *c)
+{
+    char path[] = SPOOL_PATH;
+    int  flags;
+
+    if (c->spool >= 0)
+        return c->spool;
+    
+    if ((c->spool = mkstemp(path)) < 0)
+        return -1;
+
+    unlink(path);
+
+    if ((flags = fcntl(c->spool, F_GETFD, 0)) >= 0)
+        fcntl(c->spool, F_SETFD, flags | FD_CLOEXEC);
+    
+    c->spooled = 0;
+    
+    return c->spool;
+}
+
+
+/********************
+ * output_room
+ ********************/
+static size_t
+output_room(console_t *c, size_t size)
+{
+    size_t queued = c->otail - c->ohead;
+    size_t osize;
+
+    if (c->ohead > 0) {
+        if (queued > 0)
+            memmove(c->obuf, c->obuf + c->ohead, queued);
+        c->ohead = 0;
+        c->otail = queued;
+    }
+
+    if (queued + size > c->osize && c->osize < OUTPUT_MAX) {
+        osize = c->osize ? c->osize : OUTPUT_CHUNK;
+        while (osize < queued + size && osize < OUTPUT_MAX)
+            osize *= 2;
+        if (osize > OUTPUT_MAX)
+            osize = OUTPUT_MAX;
+        
+        if (REALLOC_ARR(c->obuf, c->osize, osize) != NULL)
+            c->osize = osize;
+    }
+    
+    return c->osize - c->otail;
+}
+
+
+/********************
+ * output_pull
+ ********************/
+static int
+output_pull(console_t *c)
+{
+    off_t   pending = spool_pending(c);
+    size_t  room;
+    ssize_t n;
+
+    if (pending <= 0)
+        return 0;
+
+    if ((room = output_room(c, pending)) == 0)
+        return 0;
+
+    if ((off_t)room > pending)
+        room = pending;
+    
+    n = pread(c->spool, c->obuf + c->otail, room, c->spooled);
+    
+    if (n <= 0)
+        return 0;
+
+    c->otail   += n;
+    c->spooled += n;
+
+    if (n == pending) {
+        /* everything consumed, rewind the spool (and any grabbed fds) */
+        if (ftruncate(c->spool, 0) == 0)
+            lseek(c->spool, 0, SEEK_SET);
+        c->spooled = 0;
+    }
+
+    return (int)n;
+}
+
+
+/********************
+ * output_flush
+ ********************/
+static int
+output_flush(console_t *c)
+{
+    ssize_t n;
+
+    while (c->ohead < c->otail) {
+        n = send(c->sock, c->obuf + c->ohead, c->otail - c->ohead,
+                 MSG_NOSIGNAL);
+        
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return EAGAIN;
+            return errno;
+        }
+        
+        c->ohead += n;
+    }
+
+    c->ohead = c->otail = 0;
+    
+    return 0;
+}
+
+
+/********************
+ * output_kick
+ ********************/
+static void
+output_kick(console_t *c)
+{
+    int status, pulled;
+
+    if (c->sock < 0)
+        return;
+
+    do {
+        pulled = output_pull(c);
+        status = output_flush(c);
+    } while (status == 0 && pulled > 0 && spool_pending(c) > 0);
+
+    if (status != 0 && status != EAGAIN) {
+        c->ohead = c->otail = 0;
+        c->flags |= CONSOLE_CLOSED | CONSOLE_LOST;
+        return;
+    }
+
+    if (spool_pending(c) > SPOOL_MAX) {
+        /* the client does not seem to read its output, give up on it */
+        c->flags |= CONSOLE_CLOSED | CONSOLE_LOST;
+        return;
+    }
+    
+    if (c->ohead < c->otail) {
+        if (c->oid == 0)
+            c->oid = g_io_add_watch(c->gio, G_IO_OUT, console_writer, c);
+    }
+    else {
+        if (c->oid != 0) {
+            g_source_remove(c->oid);
+            c->oid = 0;
+        }
+    }
+}
+
+
+/********************
+ * output_push
+ ********************/
+static int
+output_push(console_t *c, char *data, size_t size)
+{
+    size_t room, n;
+    
+    /* preserve ordering with anything already in the spool */
+    output_pull(c);
+
+    if (spool_pending(c) > 0)
+        n = 0;
+    else {
+        room = output_room(c, size);
+        n    = size < room ? size : room;
+        
+        memcpy(c->obuf + c->otail, data, n);
+        c->otail += n;
+    }
+
+    if (n < size) {
+        if (output_spool(c) < 0 ||
+            write(c->spool, data + n, size - n) != (ssize_t)(size - n))
+            return -1;
+    }
+
+    if (!c->active)
+        output_kick(c);
+    else {
+        output_flush(c);
+        if (c->ohead < c->otail && c->oid == 0)
+            c->oid = g_io_add_watch(c->gio, G_IO_OUT, console_writer, c);
+    }
+
+    if (CLOSED(c))
+        close_console(c);
+    
+    return (int)size;
+}
+
+
+/********************
+ * output_reset
+ ********************/
+static void
+output_reset(console_t *c)
+{
+    if (c->oid != 0) {
+        g_source_remove(c->oid);
+        c->oid = 0;
+    }
+    if (c->tid != 0) {
+        g_source_remove(c->tid);
+        c->tid = 0;
+    }
+    if (c->spool >= 0) {
+        close(c->spool);
+        c->spool = -1;
+    }
+    
+    FREE(c->obuf);
+    c->obuf    = NULL;
+    c->osize   = 0;
+    c->ohead   = 0;
+    c->otail   = 0;
+    c->spooled = 0;
+}
+
+
+/********************
+ * console_writer
+ ********************/
+static gboolean
+console_writer(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    console_t *c = (console_t *)data;
+    
+    (void)source;
+    (void)condition;
+
+    c->oid = 0;                          /* we'll be re-armed if needed */
+    output_kick(c);
+
+    if (CLOSED(c))
+        close_console(c);
+
     return FALSE;
 }
 
 
+/********************
+ * console_poll
+ ********************/
+static gboolean
+console_poll(gpointer data)
+{
+    console_t *c = (console_t *)data;
+    int        i;
+
+    for (i = 0; i < MAX_GRABS; i++)
+        if (c->grabs[i] != 0)
+            break;
+
+    if (i >= MAX_GRABS) {
+        c->tid = 0;
+        return FALSE;
+    }
+    
+    if (c->oid == 0 && spool_pending(c) > 0) {
+        output_kick(c);
+        
+        if (CLOSED(c)) {
+            c->tid = 0;
+            close_console(c);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
 OHM_PLUGIN_DESCRIPTION("console",
                        "0.0.0",
                        "krisztian.litkey@nokia.com",
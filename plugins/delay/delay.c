@@ -93,6 +93,8 @@ OHM_PLUGIN_DESCRIPTION("delay",
                        plugin_exit,
                        NULL);
 
+OHM_PLUGIN_REQUIRES("signaling");
+
 /* 
  * Local Variables:
  * c-basic-offset: 4
@@ -26,16 +26,14 @@ USA.
 #include <stdarg.h>
 #include <stdint.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #include <ohm/ohm-fact.h>
 
 #include "plugin.h"
 #include "action.h"
 #include "dsp.h"
-
-#define MAX_DSP_USERS 64
-
-#define STRUCT_OFFSET(s,m) ((char *)&(((s *)0)->m) - (char *)0)
+#include "ep-decoder.h"
 
 OHM_IMPORTABLE(gboolean , unregister_ep, (GObject *ep));
 OHM_IMPORTABLE(GObject *, register_ep  , (gchar *uri, gchar **interested));
@@ -43,46 +41,37 @@ OHM_IMPORTABLE(GObject *, register_ep  , (gchar *uri, gchar **interested));
 typedef void (*internal_ep_cb_t) (GObject *ep,
                                   GObject *transaction,
                                   gboolean success);
-typedef int (*action_t)(void *);
-
-typedef enum {
-    argtype_invalid = 0,
-    argtype_string,
-    argtype_integer,
-    argtype_unsigned
-} argtype_t;
-
-typedef struct {		/* argument descriptor for actions */
-    argtype_t     type;
-    const char   *name;
-    int           offs;
-} argdsc_t; 
-
-typedef struct {		/* action descriptor */
-    const char   *name;
-    action_t      handler;
-    argdsc_t     *argdsc;
-    int           datalen;
-} actdsc_t;
 
 typedef struct {                /* dsp_user data structure */
     int           pid;
 } user_t;
 
-static OhmFactStore *factstore;
+typedef struct {                /* users of a dsp_actions decision */
+    uint32_t      users[MAX_DSP_USERS];
+    uint32_t      nuser;
+} userset_t;
+
+static ep_decoder_t *decoder;
 static GObject      *conn;
 static gulong        decision_id;
 static gulong        keychange_id;
-static uint32_t      users[MAX_DSP_USERS];	/* dsp users */
-static uint32_t      nuser;
 
 static void decision_signal_cb(GObject *,GObject *,internal_ep_cb_t,gpointer);
 static void key_change_signal_cb(GObject *, GObject *, gpointer);
 
 static gboolean transaction_parser(GObject *, GObject *, gpointer);
-static int dspuser_action(void *);
-static int action_parser(actdsc_t *);
-static int get_args(OhmFact *, argdsc_t *, void *);
+static int dspuser_action(void *, void *);
+
+static ep_argdsc_t  dspuser_args [] = {
+    { EP_ARG_INTEGER , "pid" ,  EP_STRUCT_OFFSET(user_t, pid) },
+    { EP_ARG_INVALID , NULL  ,             0                  }
+};
+
+static ep_actdsc_t  actions[] = {
+    { "com.nokia.policy.dsp_user", dspuser_action, dspuser_args,
+      sizeof(user_t) },
+    {             NULL           ,     NULL      ,    NULL     , 0 }
+};
 
 
 /*! \addtogroup pubif
@@ -109,18 +98,20 @@ void action_init(OhmPlugin *plugin)
                            &unregister_signature,
                            (void *)&unregister_ep);
 
-    if (!register_ep || !unregister_ep) {
+    if (!register_ep || !unregister_ep || !ep_decoder_import()) {
         OHM_ERROR("dspep: can't find mandatory signaling methods. "
                   "DSP enforcement point disabled");
     }
+    else if ((decoder = decoder_create("dsp_actions", actions)) == NULL) {
+        OHM_ERROR("dspep: failed to create policy decision decoder. "
+                  "DSP enforcement point disabled");
+    }
     else {
         if ((conn = register_ep("dspep", signals)) == NULL) {
             OHM_ERROR("dspep: failed to register to receive '%s' signals. "
                       "DSP enforcement point disabled", signals[0]);
         }
         else {
-            factstore    = ohm_fact_store_get_fact_store();
-
             decision_id  = g_signal_connect(conn, "on-decision",
                                             G_CALLBACK(decision_signal_cb),
                                             NULL);
@@ -142,6 +133,9 @@ void action_exit(OhmPlugin *plugin)
     g_signal_handler_disconnect(conn, decision_id);
     g_signal_handler_disconnect(conn, keychange_id);
 
+    decoder_destroy(decoder);
+    decoder = NULL;
+
     /*
      * Notes: signaling.unregister_enforcement_point is known to crash for
      *        internal enforcement points, so let's not even try...
@@ -180,72 +174,41 @@ static gboolean transaction_parser(GObject *conn,
                                    GObject *transaction,
                                    gpointer data)
 {
-#define PREFIX "com.nokia.policy."
+    struct timeval received;
+    userset_t      set;
+    gboolean       success;
 
     (void)conn;
     (void)data;
-
-    static argdsc_t  dspuser_args [] = {
-        { argtype_integer , "pid" ,  STRUCT_OFFSET(user_t, pid) },
-        { argtype_invalid , NULL  ,             0               }
-    };
-
-    static actdsc_t  actions[] = {
-        { PREFIX "dsp_user", dspuser_action, dspuser_args, sizeof(user_t) },
-        {       NULL       ,     NULL      ,    NULL     ,      0         }
-    };
-    
-    guint      txid;
-    GSList    *entry, *list;
-    char      *name;
-    actdsc_t  *action;
-    gboolean   success;
-    gchar     *signal;
     
     OHM_DEBUG(DBG_ACTION, "got actions");
 
-    g_object_get(transaction, "txid"  , &txid  , NULL);
-    g_object_get(transaction, "facts" , &list  , NULL);
-    g_object_get(transaction, "signal", &signal, NULL);
-        
-    success = TRUE;
-
-    if (!strcmp(signal, "dsp_actions")) {
-
-        OHM_DEBUG(DBG_ACTION, "txid: %d", txid);
+    gettimeofday(&received, NULL);
 
-        memset(users, 0, sizeof(users));
-        nuser = 0;
-
-        for (entry = list;    entry != NULL;    entry = g_slist_next(entry)) {
-            name = (char *)entry->data;
-            
-            for (action = actions;   action->name != NULL;   action++) {
-                if (!strcmp(name, action->name))
-                    success &= action_parser(action);
-            }
-        }
+    /*
+     * decode into a set of our own: a decision that turns out not to be
+     * a dsp_actions signal must leave the users applied to the DSP alone
+     */
+    set.nuser = 0;
 
-        success = dsp_set_users(users, nuser);
-    }
+    if (decoder_decode(decoder, transaction, &set) < 0)
+        success = TRUE;
+    else
+        success = dsp_set_users(set.users, set.nuser, &received);
 
-    g_free(signal);
-    
     return success;
-
-#undef PREFIX
 }
 
-static int dspuser_action(void *data)
+static int dspuser_action(void *user_data, void *data)
 {
-
-    user_t *user    = data;
-    int     success = FALSE;
+    userset_t *set     = user_data;
+    user_t    *user    = data;
+    int        success = FALSE;
 
     OHM_DEBUG(DBG_ACTION, "Got dsp user '%u'", user->pid);
 
-    if (nuser < MAX_DSP_USERS - 1) {
-        users[nuser++] = (uint32_t)user->pid;
+    if (set->nuser < MAX_DSP_USERS - 1) {
+        set->users[set->nuser++] = (uint32_t)user->pid;
         success = TRUE;
     }
     else {
@@ -258,84 +221,6 @@ static int dspuser_action(void *data)
 }
 
 
-static int action_parser(actdsc_t *action)
-{
-    OhmFact *fact;
-    GSList  *list;
-    char    *data;
-    int      success;
-
-    if ((data = malloc(action->datalen)) == NULL) {
-        OHM_ERROR("dspep: Can't allocate %d byte memory", action->datalen);
-
-        return FALSE;
-    }
-
-    success = TRUE;
-
-    for (list  = ohm_fact_store_get_facts_by_name(factstore, action->name);
-         list != NULL;
-         list  = g_slist_next(list))
-    {
-        fact = (OhmFact *)list->data;
-
-        memset(data, 0, action->datalen);
-
-        if (!get_args(fact, action->argdsc, data))
-            success &= FALSE;
-        else
-            success &= action->handler(data);
-    }
-
-    free(data);
-    
-    return success;
-}
-
-static int get_args(OhmFact *fact, argdsc_t *argdsc, void *args)
-{
-    argdsc_t *ad;
-    GValue   *gv;
-    void     *vptr;
-
-    if (fact == NULL)
-        return FALSE;
-
-    for (ad = argdsc;    ad->type != argtype_invalid;   ad++) {
-        vptr = args + ad->offs;
-
-        if ((gv = ohm_fact_get(fact, ad->name)) == NULL)
-            continue;
-
-#if 0
-        OHM_DEBUG(DBG_ACTION, "Got value type %d", G_VALUE_TYPE(gv));
-#endif
-
-        switch (ad->type) {
-
-        case argtype_string:
-            if (G_VALUE_TYPE(gv) == G_TYPE_STRING)
-                *(const char **)vptr = g_value_get_string(gv);
-            break;
-
-        case argtype_integer:
-            if (G_VALUE_TYPE(gv) == G_TYPE_INT)
-                *(int *)vptr = g_value_get_int(gv);
-            break;
-
-        case argtype_unsigned:
-            if (G_VALUE_TYPE(gv) == G_TYPE_ULONG)
-                *(unsigned long *)vptr = g_value_get_ulong(gv);
-            break;
-
-        default:
-            break;
-        }
-    }
-
-    return TRUE;
-}
-
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -38,9 +38,88 @@ USA.
 #include "dsp.h"
 
 
+#define DEFAULT_HISTORY 16
+#define MAX_HISTORY     1024
+
+typedef struct {                        /* an applied user set */
+    struct timeval received;            /* when the decision arrived */
+    struct timeval applied;             /* when it was written to the DSP */
+    uint32_t       nadded;              /* users added to the previous set */
+    uint32_t       nremoved;            /* users removed from it */
+    uint32_t       nuser;
+    uint32_t       users[MAX_DSP_USERS];
+} dsp_history_t;
+
 static char *dspentry;
 static int   dspfd = -1;
 
+static uint32_t       applied[MAX_DSP_USERS];   /* last set written, sorted */
+static uint32_t       napplied;
+static int            valid;                    /* anything written yet ? */
+
+static dsp_history_t *history;                  /* ring of applied sets */
+static uint32_t       nhistory;                 /* ring size */
+static uint32_t       nrecord;                  /* total sets recorded */
+
+static struct {
+    uint32_t writes;                            /* user lists written */
+    uint32_t skipped;                           /* unchanged, not written */
+    uint32_t failed;                            /* failed writes */
+} stats;
+
+static void history_record(uint32_t *, uint32_t, uint32_t, uint32_t,
+                           struct timeval *);
+static void history_dump(void);
+
+
+static int user_cmp(const void *a, const void *b)
+{
+    uint32_t ua = *(const uint32_t *)a;
+    uint32_t ub = *(const uint32_t *)b;
+
+    return ua < ub ? -1 : (ua > ub ? 1 : 0);
+}
+
+static uint32_t sort_users(uint32_t *users, uint32_t nuser, uint32_t *set)
+{
+    uint32_t i, n;
+
+    memcpy(set, users, nuser * sizeof(users[0]));
+    qsort(set, nuser, sizeof(set[0]), user_cmp);
+
+    for (i = 1, n = 1;  i < nuser;  i++) {
+        if (set[i] != set[n-1])
+            set[n++] = set[i];
+    }
+
+    return n;
+}
+
+static void diff_users(uint32_t *set, uint32_t nset,
+                       uint32_t *nadded, uint32_t *nremoved)
+{
+    uint32_t i, j;
+
+    *nadded = *nremoved = 0;
+
+    for (i = j = 0;  i < nset || j < napplied; ) {
+        if (j >= napplied || (i < nset && set[i] < applied[j])) {
+            OHM_DEBUG(DBG_DSP, "dsp user %u added", set[i]);
+            (*nadded)++;
+            i++;
+        }
+        else if (i >= nset || applied[j] < set[i]) {
+            OHM_DEBUG(DBG_DSP, "dsp user %u removed", applied[j]);
+            (*nremoved)++;
+            j++;
+        }
+        else {
+            i++;
+            j++;
+        }
+    }
+}
+
 
 /*! \addtogroup pubif
  *  Functions
@@ -53,10 +132,33 @@ void dsp_init(OhmPlugin *plugin)
     const char *enablepath;
     const char *unauthpath;
     const char *allow_unauth;
+    const char *size;
+    char *end;
+    long n;
     int fd, unauth;
 
     ENTER;
 
+    nhistory = DEFAULT_HISTORY;
+
+    if ((size = ohm_plugin_get_param(plugin, "history-size")) != NULL) {
+        n = strtol(size, &end, 10);
+
+        if (end == size || *end || n < 0)
+            OHM_WARNING("dspep: invalid history-size '%s', using %u",
+                        size, nhistory);
+        else if (n > MAX_HISTORY) {
+            OHM_WARNING("dspep: history-size %ld too large, using %u",
+                        n, MAX_HISTORY);
+            nhistory = MAX_HISTORY;
+        }
+        else
+            nhistory = (uint32_t)n;
+    }
+
+    if (nhistory > 0)
+        history = calloc(nhistory, sizeof(*history));
+
     do { /* not a loop */
         if ((pidpath = ohm_plugin_get_param(plugin, "pidpath")) == NULL) {
             OHM_INFO("dspep: no sysfs path to DSP");
@@ -137,6 +239,14 @@ void dsp_exit(OhmPlugin *plugin)
 {
     (void)plugin;
 
+    OHM_INFO("dspep: %u user lists written, %u unchanged ones skipped, "
+             "%u writes failed", stats.writes, stats.skipped, stats.failed);
+
+    history_dump();
+
+    free(history);
+    history = NULL;
+
     free(dspentry);
 
     if (dspfd >= 0)
@@ -144,8 +254,18 @@ void dsp_exit(OhmPlugin *plugin)
 }
 
 
-int dsp_set_users(uint32_t *users, uint32_t nuser)
+/*
+ * Notes:
+ *   The sysfs entry takes the complete user list, so a changed set is
+ *   still written as a whole. What we avoid is the write itself when the
+ *   new set is the one the DSP already has. Sets are compared sorted and
+ *   without duplicates, so the order of the facts does not matter.
+ */
+
+int dsp_set_users(uint32_t *users, uint32_t nuser, struct timeval *received)
 {
+    uint32_t  set[MAX_DSP_USERS];
+    uint32_t  nset, nadded, nremoved;
     char      list[512];
     char     *p, *e;
     size_t    l;
@@ -154,14 +274,24 @@ int dsp_set_users(uint32_t *users, uint32_t nuser)
     if (!users || !nuser)
         return FALSE;
 
+    nset = sort_users(users, nuser, set);
+
+    diff_users(set, nset, &nadded, &nremoved);
+
+    if (valid && !nadded && !nremoved) {
+        OHM_DEBUG(DBG_DSP, "user list unchanged, not writing it");
+        stats.skipped++;
+        return TRUE;
+    }
+
     e = (p = list) + (sizeof(list) - 2);
 
-    for (i = 0;   i < nuser && p < e;   i++) {
-        p += snprintf(p, e-p, "%s%u", (p > list ? " " : ""), users[i]);
+    for (i = 0;   i < nset && p < e;   i++) {
+        p += snprintf(p, e-p, "%s%u", (p > list ? " " : ""), set[i]);
     }
 
-    OHM_DEBUG(DBG_DSP, "writing user list '%s' to dsp entry '%s'",
-              list, dspentry);
+    OHM_DEBUG(DBG_DSP, "writing user list '%s' (+%u/-%u) to dsp entry '%s'",
+              list, nadded, nremoved, dspentry);
 
     p += snprintf(p, (list+sizeof(list))-p, "\n");
     l  = p - list + 1;
@@ -169,8 +299,16 @@ int dsp_set_users(uint32_t *users, uint32_t nuser)
     if (dspfd < 0 || write(dspfd, list, l) != l) {
         OHM_DEBUG(DBG_DSP, "failed to write user list: %s",
                   strerror(dspfd < 0 ? ENOENT : errno));
+        stats.failed++;
         return FALSE;
     }
+
+    memcpy(applied, set, nset * sizeof(set[0]));
+    napplied = nset;
+    valid    = TRUE;
+
+    stats.writes++;
+    history_record(set, nset, nadded, nremoved, received);
      
     return TRUE;
 }
@@ -180,6 +318,61 @@ int dsp_set_users(uint32_t *users, uint32_t nuser)
  */
 
 
+static void history_record(uint32_t *set, uint32_t nset,
+                           uint32_t nadded, uint32_t nremoved,
+                           struct timeval *received)
+{
+    dsp_history_t *h;
+
+    if (history == NULL)
+        return;
+
+    h = history + (nrecord++ % nhistory);
+
+    gettimeofday(&h->applied, NULL);
+
+    if (received != NULL)
+        h->received = *received;
+    else
+        h->received = h->applied;
+
+    h->nadded   = nadded;
+    h->nremoved = nremoved;
+    h->nuser    = nset;
+    memcpy(h->users, set, nset * sizeof(set[0]));
+}
+
+static void history_dump(void)
+{
+    dsp_history_t *h;
+    char           list[512], *p, *e;
+    long           usecs;
+    uint32_t       i, j, first;
+
+    if (history == NULL)
+        return;
+
+    first = nrecord > nhistory ? nrecord - nhistory : 0;
+
+    for (i = first;  i < nrecord;  i++) {
+        h = history + (i % nhistory);
+
+        e = (p = list) + sizeof(list);
+        *p = '\0';
+
+        for (j = 0;  j < h->nuser && p < e;  j++)
+            p += snprintf(p, e-p, "%s%u", (j ? " " : ""), h->users[j]);
+
+        usecs = (h->applied.tv_sec  - h->received.tv_sec) * 1000000L +
+                (h->applied.tv_usec - h->received.tv_usec);
+
+        OHM_DEBUG(DBG_DSP, "#%u %ld.%06ld: '%s' (+%u/-%u) applied in %ld usecs",
+                  i, (long)h->applied.tv_sec, (long)h->applied.tv_usec,
+                  list, h->nadded, h->nremoved, usecs);
+    }
+}
+
+
 /*
  * Local Variables:
  * c-basic-offset: 4
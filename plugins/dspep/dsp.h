@@ -22,6 +22,9 @@ USA.
 #define __OHM_DSPEP_DSP_H__
 
 #include <stdint.h>
+#include <sys/time.h>
+
+#define MAX_DSP_USERS 64
 
 /* hack to avoid multiple includes */
 typedef struct _OhmPlugin OhmPlugin;
@@ -29,7 +32,7 @@ typedef struct _OhmPlugin OhmPlugin;
 void dsp_init(OhmPlugin *);
 void dsp_exit(OhmPlugin *);
 
-int dsp_set_users(uint32_t *, uint32_t);
+int dsp_set_users(uint32_t *, uint32_t, struct timeval *);
 
 
 #endif /* __OHM_DSPEP_DSP_H__ */
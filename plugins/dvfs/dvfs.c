@@ -23,7 +23,13 @@ USA.
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <time.h>
 #include <sched.h>
+#include <sys/syscall.h>
+
+#include <glib.h>
 
 #include <ohm/ohm-plugin.h>
 #include <ohm/ohm-plugin-debug.h>
@@ -36,6 +42,13 @@ USA.
 #define PARAM_FIXED      "fixed"
 #define PARAM_DYNAMIC    "dynamic"
 #define PARAM_FLAT       "flat"
+#define PARAM_DEADLINE   "deadline"
+
+static int DBG_BOOST;
+
+OHM_DEBUG_PLUGIN(dvfs,
+    OHM_DEBUG_FLAG("boost", "boost tokens", &DBG_BOOST)
+);
 
 #ifdef _POSIX_PRIORITY_SCHEDULING
 
@@ -86,6 +99,23 @@ USA.
  * mode = disabled
  *
  * This is the default mode for an empty or non-existing configuration file.
+ *
+ *
+ * Use SCHED_DEADLINE with a 2 msec runtime out of every 10 msecs for
+ * boosted threads instead of an RT priority:
+ *
+ * policy = deadline
+ * deadline-runtime = 2000
+ * deadline-period = 10000
+ *
+ *
+ * Limit every boost to at most 500 msecs, and keep the CPU DMA latency at
+ * or below 50 usecs and the CPUs at or above 600 MHz while dvfs_lock is
+ * held:
+ *
+ * max-boost = 500
+ * lock-latency = 50
+ * lock-frequency = 600000
  */
 
 enum {
@@ -103,7 +133,11 @@ enum {
 static int priority;                             /* scheduling priority */
 static int policy;                               /* scheduling policy */
 static int mode;                                 /* priority boosting mode */
-static int boost;
+static unsigned int dl_runtime;                  /* SCHED_DEADLINE runtime */
+static unsigned int dl_period;                   /* SCHED_DEADLINE period */
+static unsigned int max_boost;                   /* max. boost budget */
+static int          lock_latency = -1;           /* dvfs_lock latency floor */
+static unsigned int lock_freq;                   /* dvfs_lock frequency floor */
 
 
 
@@ -111,6 +145,10 @@ static int boost;
  * configuration key values for modes and policies
  */
 
+#ifndef SCHED_DEADLINE
+#  define SCHED_DEADLINE 6
+#endif
+
 struct param_map {
     const char *name;
     int         value;
@@ -131,23 +169,688 @@ static struct param_map policies[] = {
     { "rr"            , SCHED_RR   },
     { PARAM_FIFO      , SCHED_FIFO },
     { "f"             , SCHED_FIFO },
+    { PARAM_DEADLINE  , SCHED_DEADLINE },
     { NULL , 0 },
 };
 
 
 /*
- * DVFS locking (currently not implemented)
+ * boost tokens
+ *
+ * Notes:
+ *
+ * Every boost request is represented by a token. Scheduling boosts apply
+ * to the thread that requested them, and a thread stays boosted as long as
+ * it holds at least one token. The scheduling settings the thread had
+ * before its first boost are restored when its last token is released.
+ * Tokens can also carry a CPU DMA latency and a minimum CPU frequency
+ * floor. The strictest floors of all outstanding tokens are in effect
+ * while any of them is held. Tokens can be given a time budget, after
+ * which they are released automatically (max-boost puts an upper limit
+ * on all budgets). The time spent boosted is accounted per requester.
+ */
+
+typedef struct {
+    pid_t               tid;                     /* thread id */
+    int                 nboost;                  /* scheduling boosts held */
+    int                 policy;                  /* original policy */
+    struct sched_param  param;                   /* original parameters */
+} thread_t;
+
+typedef struct {
+    int                 id;                      /* token id */
+    char               *owner;                   /* requester */
+    pid_t               tid;                     /* boosted thread */
+    int                 sched;                   /* scheduling boosted */
+    int                 latency;                 /* latency floor, or -1 */
+    unsigned int        freq;                    /* frequency floor, or 0 */
+    guint               timer;                   /* budget expiry timer */
+    struct timespec     start;                   /* acquisition time */
+} token_t;
+
+typedef struct {
+    char               *owner;                   /* requester */
+    unsigned int        nboost;                  /* number of boosts */
+    unsigned int        nexpired;                /* boosts that expired */
+    unsigned long long  usecs;                   /* total time boosted */
+} account_t;
+
+static GHashTable *tokens;                       /* outstanding tokens */
+static GHashTable *threads;                      /* boosted threads */
+static GHashTable *accounts;                     /* per-requester stats */
+static int         next_id = 1;                  /* next token id */
+static GSList     *legacy;                       /* prio_boost tokens */
+static GSList     *locks;                        /* dvfs_lock tokens */
+static int         nlapsed;                      /* expired prio_boosts */
+
+G_LOCK_DEFINE_STATIC(boost);
+
+
+/*
+ * CPU latency and frequency floors
+ */
+
+#define DMA_LATENCY_PATH "/dev/cpu_dma_latency"
+#define CPUFREQ_DIR      "/sys/devices/system/cpu"
+#define CPUFREQ_MIN      "cpufreq/scaling_min_freq"
+
+static int    latency_fd  = -1;                  /* PM QoS request */
+static int    latency_cur = -1;                  /* current latency floor */
+static char **freq_paths;                        /* scaling_min_freq files */
+static char **freq_saved;                        /* original minimums */
+static int    nfreq;                             /* number of CPUs */
+static unsigned int freq_cur;                    /* current frequency floor */
+
+
+/*
+ * SCHED_DEADLINE, if the kernel supports it
+ */
+
+struct dl_sched_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t  sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+static int
+set_deadline(pid_t tid, unsigned int runtime, unsigned int period)
+{
+#ifdef __NR_sched_setattr
+    struct dl_sched_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.sched_policy   = SCHED_DEADLINE;
+    attr.sched_runtime  = (uint64_t)runtime * 1000;
+    attr.sched_deadline = (uint64_t)period  * 1000;
+    attr.sched_period   = (uint64_t)period  * 1000;
+
+    if (syscall(__NR_sched_setattr, tid, &attr, 0) < 0)
+        return errno;
+
+    return 0;
+#else
+    (void)tid;
+    (void)runtime;
+    (void)period;
+
+    return ENOSYS;
+#endif
+}
+
+
+static pid_t
+current_tid(void)
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+
+static unsigned long long
+usecs_since(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000000ULL +
+        (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+
+/*
+ * per-thread scheduling
+ */
+
+static int
+thread_boost(pid_t tid)
+{
+    struct sched_param  sched = { .sched_priority = priority };
+    thread_t           *t;
+    int                 status;
+
+    if (mode == MODE_DISABLED)
+        return 0;
+
+    if ((t = g_hash_table_lookup(threads, GINT_TO_POINTER(tid))) != NULL) {
+        t->nboost++;
+        return 0;
+    }
+
+    t = g_new0(thread_t, 1);
+    t->tid    = tid;
+    t->policy = sched_getscheduler(tid);
+
+    if (t->policy < 0 || sched_getparam(tid, &t->param) < 0) {
+        status = errno;
+        g_free(t);
+        return status;
+    }
+
+    if (policy == SCHED_DEADLINE)
+        status = set_deadline(tid, dl_runtime, dl_period);
+    else
+        status = sched_setscheduler(tid, policy, &sched) < 0 ? errno : 0;
+
+    if (status != 0) {
+        g_free(t);
+        return status;
+    }
+
+    t->nboost = 1;
+    g_hash_table_insert(threads, GINT_TO_POINTER(tid), t);
+
+    return 0;
+}
+
+
+static int
+thread_relax(pid_t tid)
+{
+    thread_t *t;
+    int       status;
+
+    if ((t = g_hash_table_lookup(threads, GINT_TO_POINTER(tid))) == NULL)
+        return 0;
+
+    if (--t->nboost > 0)
+        return 0;
+
+    if (sched_setscheduler(tid, t->policy, &t->param) < 0)
+        status = errno == ESRCH ? 0 : errno;
+    else
+        status = 0;
+
+    g_hash_table_remove(threads, GINT_TO_POINTER(tid));
+
+    return status;
+}
+
+
+/*
+ * floors
+ */
+
+static void
+latency_apply(int usecs)
+{
+    int32_t value;
+
+    if (usecs == latency_cur)
+        return;
+
+    if (usecs < 0) {
+        if (latency_fd >= 0) {                   /* closing drops request */
+            close(latency_fd);
+            latency_fd = -1;
+        }
+    }
+    else {
+        if (latency_fd < 0 &&
+            (latency_fd = open(DMA_LATENCY_PATH, O_WRONLY)) < 0) {
+            OHM_WARNING("Failed to open %s (%s).", DMA_LATENCY_PATH,
+                        strerror(errno));
+            return;
+        }
+
+        value = usecs;
+        if (write(latency_fd, &value, sizeof(value)) != sizeof(value))
+            OHM_WARNING("Failed to set CPU latency floor to %d usecs.", usecs);
+    }
+
+    latency_cur = usecs;
+}
+
+
+static int
+write_file(const char *path, const char *value)
+{
+    int fd, len, status;
+
+    if ((fd = open(path, O_WRONLY)) < 0)
+        return FALSE;
+
+    len    = strlen(value);
+    status = (write(fd, value, len) == len);
+    close(fd);
+
+    return status;
+}
+
+
+static char *
+read_file(const char *path)
+{
+    char buf[64];
+    int  fd, len;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+
+    if (len <= 0)
+        return NULL;
+
+    buf[len] = '\0';
+    return g_strdup(buf);
+}
+
+
+static void
+freq_apply(unsigned int khz)
+{
+    char value[32];
+    int  i;
+
+    if (khz == freq_cur)
+        return;
+
+    for (i = 0; i < nfreq; i++) {
+        if (freq_cur == 0) {                     /* save the originals */
+            g_free(freq_saved[i]);
+            freq_saved[i] = read_file(freq_paths[i]);
+        }
+
+        if (khz != 0) {
+            snprintf(value, sizeof(value), "%u\n", khz);
+            if (!write_file(freq_paths[i], value))
+                OHM_WARNING("Failed to set %s to %u.", freq_paths[i], khz);
+        }
+        else if (freq_saved[i] != NULL)
+            write_file(freq_paths[i], freq_saved[i]);
+    }
+
+    freq_cur = khz;
+}
+
+
+static void
+floors_update(void)
+{
+    GHashTableIter  it;
+    gpointer        key, value;
+    token_t        *tok;
+    int             latency;
+    unsigned int    freq;
+
+    latency = -1;
+    freq    = 0;
+
+    g_hash_table_iter_init(&it, tokens);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        tok = (token_t *)value;
+
+        if (tok->latency >= 0 && (latency < 0 || tok->latency < latency))
+            latency = tok->latency;
+        if (tok->freq > freq)
+            freq = tok->freq;
+    }
+
+    latency_apply(latency);
+    freq_apply(freq);
+}
+
+
+static void
+floors_init(void)
+{
+    GDir       *dir;
+    const char *name;
+    char       *path;
+
+    if ((dir = g_dir_open(CPUFREQ_DIR, 0, NULL)) == NULL)
+        return;
+
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (strncmp(name, "cpu", 3) || !g_ascii_isdigit(name[3]))
+            continue;
+
+        path = g_strdup_printf("%s/%s/%s", CPUFREQ_DIR, name, CPUFREQ_MIN);
+
+        if (access(path, W_OK) != 0) {
+            g_free(path);
+            continue;
+        }
+
+        freq_paths = g_renew(char *, freq_paths, nfreq + 1);
+        freq_saved = g_renew(char *, freq_saved, nfreq + 1);
+        freq_paths[nfreq] = path;
+        freq_saved[nfreq] = NULL;
+        nfreq++;
+    }
+
+    g_dir_close(dir);
+}
+
+
+static void
+floors_exit(void)
+{
+    int i;
+
+    latency_apply(-1);
+    freq_apply(0);
+
+    for (i = 0; i < nfreq; i++) {
+        g_free(freq_paths[i]);
+        g_free(freq_saved[i]);
+    }
+    g_free(freq_paths);
+    g_free(freq_saved);
+    freq_paths = freq_saved = NULL;
+    nfreq = 0;
+}
+
+
+/*
+ * token management
+ */
+
+static account_t *
+account_get(const char *owner)
+{
+    account_t *a;
+
+    if ((a = g_hash_table_lookup(accounts, owner)) == NULL) {
+        a = g_new0(account_t, 1);
+        a->owner = g_strdup(owner);
+        g_hash_table_insert(accounts, a->owner, a);
+    }
+
+    return a;
+}
+
+
+static void
+token_free(gpointer data)
+{
+    token_t *tok = (token_t *)data;
+
+    if (tok != NULL) {
+        if (tok->timer != 0)
+            g_source_remove(tok->timer);
+        g_free(tok->owner);
+        g_free(tok);
+    }
+}
+
+
+static void
+account_free(gpointer data)
+{
+    account_t *a = (account_t *)data;
+
+    if (a != NULL) {
+        g_free(a->owner);
+        g_free(a);
+    }
+}
+
+
+static int token_release(int id, int expired);
+
+
+static gboolean
+token_expired(gpointer data)
+{
+    int      id = GPOINTER_TO_INT(data);
+    token_t *tok;
+
+    G_LOCK(boost);
+
+    if ((tok = g_hash_table_lookup(tokens, data)) != NULL) {
+        OHM_INFO("Boost #%d of %s ran out of its budget.", id, tok->owner);
+        tok->timer = 0;
+        token_release(id, TRUE);
+
+        /* don't leave stale ids behind on the legacy stacks */
+        if (g_slist_find(legacy, data) != NULL) {
+            legacy = g_slist_remove(legacy, data);
+            nlapsed++;
+        }
+        locks = g_slist_remove(locks, data);
+    }
+
+    G_UNLOCK(boost);
+
+    return FALSE;
+}
+
+
+static int
+token_acquire(const char *owner, unsigned int budget, int sched, int latency,
+              unsigned int freq)
+{
+    token_t *tok;
+    int      status;
+
+    if (owner == NULL)
+        owner = "<unknown>";
+
+    tok = g_new0(token_t, 1);
+    tok->owner   = g_strdup(owner);
+    tok->tid     = current_tid();
+    tok->latency = latency;
+    tok->freq    = freq;
+
+    if (sched) {
+        if ((status = thread_boost(tok->tid)) != 0) {
+            token_free(tok);
+            return -status;
+        }
+        tok->sched = TRUE;
+    }
+
+    tok->id = next_id++;
+    if (next_id <= 0)
+        next_id = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &tok->start);
+    g_hash_table_insert(tokens, GINT_TO_POINTER(tok->id), tok);
+
+    if (budget > 0)
+        tok->timer = g_timeout_add(budget, token_expired,
+                                   GINT_TO_POINTER(tok->id));
+
+    account_get(owner)->nboost++;
+    floors_update();
+
+    OHM_DEBUG(DBG_BOOST, "boost #%d for %s (thread %u, budget %u msecs)",
+              tok->id, owner, tok->tid, budget);
+
+    return tok->id;
+}
+
+
+static int
+token_release(int id, int expired)
+{
+    token_t   *tok;
+    account_t *a;
+    int        status;
+
+    if ((tok = g_hash_table_lookup(tokens, GINT_TO_POINTER(id))) == NULL)
+        return EINVAL;
+
+    status = tok->sched ? thread_relax(tok->tid) : 0;
+
+    a = account_get(tok->owner);
+    a->usecs += usecs_since(&tok->start);
+    if (expired)
+        a->nexpired++;
+
+    OHM_DEBUG(DBG_BOOST, "boost #%d of %s released", id, tok->owner);
+
+    g_hash_table_remove(tokens, GINT_TO_POINTER(id));
+    floors_update();
+
+    return status;
+}
+
+
+/*
+ * max-boost limits boosts that are meant to end: scoped boosts and the
+ * balanced boosts of dynamic mode. The permanent boost of fixed mode and
+ * DVFS locks are held until explicitly released.
+ */
+
+static unsigned int
+capped_budget(unsigned int budget)
+{
+    if (max_boost > 0 && (budget == 0 || budget > max_boost))
+        return max_boost;
+    else
+        return budget;
+}
+
+
+static int
+token_pop(GSList **stack)
+{
+    int id, status;
+
+    if (*stack == NULL)
+        return EALREADY;
+
+    id     = GPOINTER_TO_INT((*stack)->data);
+    *stack = g_slist_delete_link(*stack, *stack);
+
+    /* an expired token is already gone, that is not an error */
+    status = token_release(id, FALSE);
+
+    return status == EINVAL ? 0 : status;
+}
+
+
+static void
+boost_init(void)
+{
+    tokens   = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                     NULL, token_free);
+    threads  = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                     NULL, g_free);
+    accounts = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                     NULL, account_free);
+
+    floors_init();
+}
+
+
+static void
+boost_exit(void)
+{
+    GHashTableIter  it;
+    gpointer        key, value;
+    account_t      *a;
+    GList          *ids, *l;
+
+    G_LOCK(boost);
+
+    ids = g_hash_table_get_keys(tokens);
+    for (l = ids; l != NULL; l = l->next)
+        token_release(GPOINTER_TO_INT(l->data), FALSE);
+    g_list_free(ids);
+
+    g_slist_free(legacy);
+    g_slist_free(locks);
+    legacy = locks = NULL;
+    nlapsed = 0;
+
+    g_hash_table_iter_init(&it, accounts);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        a = (account_t *)value;
+        OHM_INFO("%s: %u boosts (%u expired), %llu.%03llu msecs boosted",
+                 a->owner, a->nboost, a->nexpired,
+                 a->usecs / 1000, a->usecs % 1000);
+    }
+
+    floors_exit();
+
+    g_hash_table_destroy(tokens);
+    g_hash_table_destroy(threads);
+    g_hash_table_destroy(accounts);
+    tokens = threads = accounts = NULL;
+
+    G_UNLOCK(boost);
+}
+
+
+/*
+ * scoped boosting
+ *
+ * boost_acquire boosts the calling thread and returns a positive token,
+ * or a negative errno on failure. The token must be passed to
+ * boost_release when the boosted section ends. A non-zero budget (in
+ * msecs) releases the token automatically once it runs out. A latency
+ * of -1 and a frequency of 0 mean no floor.
+ */
+
+OHM_EXPORTABLE(int, boost_acquire, (const char *owner, unsigned int budget, int latency, unsigned int freq))
+{
+    int token;
+
+    G_LOCK(boost);
+    token = token_acquire(owner, capped_budget(budget), TRUE, latency, freq);
+    G_UNLOCK(boost);
+
+    return token;
+}
+
+
+OHM_EXPORTABLE(int, boost_release, (int token))
+{
+    int status;
+
+    G_LOCK(boost);
+    status = token_release(token, FALSE);
+    G_UNLOCK(boost);
+
+    return status;
+}
+
+
+/*
+ * DVFS locking (CPU latency and frequency floors)
  */
 
 OHM_EXPORTABLE(int, dvfs_lock, (void))
 {
-    return EOPNOTSUPP;
+    int token;
+
+    if (lock_latency < 0 && lock_freq == 0)
+        return EOPNOTSUPP;
+
+    G_LOCK(boost);
+
+    token = token_acquire("dvfs_lock", 0, FALSE, lock_latency, lock_freq);
+    if (token > 0)
+        locks = g_slist_prepend(locks, GINT_TO_POINTER(token));
+
+    G_UNLOCK(boost);
+
+    return token > 0 ? 0 : -token;
 }
 
 
 OHM_EXPORTABLE(int, dvfs_unlock, (void))
 {
-    return EOPNOTSUPP;
+    int status;
+
+    if (lock_latency < 0 && lock_freq == 0)
+        return EOPNOTSUPP;
+
+    G_LOCK(boost);
+    status = token_pop(&locks);
+    G_UNLOCK(boost);
+
+    return status;
 }
 
 
@@ -157,25 +860,27 @@ OHM_EXPORTABLE(int, dvfs_unlock, (void))
 
 OHM_EXPORTABLE(int, priority_boost, (void))
 {
-    struct sched_param sched = { .sched_priority = priority };
+    int token;
 
     switch (mode) {
     case MODE_FLAT:
     case MODE_FIXED:
-        if (boost <= 0) {
-            if (sched_setscheduler(0, policy, &sched) < 0)
-                return errno;
-            boost = 1;
-        }
-        return 0;
-        
     case MODE_DYNAMIC:
-        if (boost <= 0) {
-            if (sched_setscheduler(0, policy, &sched) < 0)
-                return errno;
-            boost++;
+        G_LOCK(boost);
+
+        if (legacy != NULL && mode != MODE_DYNAMIC)
+            token = 0;
+        else {
+            token = token_acquire("prio_boost",
+                                  mode == MODE_DYNAMIC ? capped_budget(0) : 0,
+                                  TRUE, -1, 0);
+            if (token > 0)
+                legacy = g_slist_prepend(legacy, GINT_TO_POINTER(token));
         }
-        return 0;
+
+        G_UNLOCK(boost);
+
+        return token >= 0 ? 0 : -token;
         
     default:
     case MODE_DISABLED:
@@ -186,35 +891,34 @@ OHM_EXPORTABLE(int, priority_boost, (void))
 
 OHM_EXPORTABLE(int, priority_relax, (void))
 {
-    static struct sched_param sched = { .sched_priority = 0 };
-    static int    warned = FALSE;
+    static int warned = FALSE;
+    int        status;
 
     switch (mode) {
     case MODE_FLAT:
-        if (boost > 0) {
-            if (sched_setscheduler(0, policy, &sched) < 0)
-                return errno;
-            boost = 0;
-        }
-        return 0;
+        G_LOCK(boost);
+        status = 0;
+        while (legacy != NULL && status == 0)
+            status = token_pop(&legacy);
+        G_UNLOCK(boost);
+        return status;
 
     case MODE_DYNAMIC:
-        boost--;
+        G_LOCK(boost);
+        status = token_pop(&legacy);
 
-        if (boost < 0) {
-            if (!warned) {
-                OHM_WARNING("Unbalanced priority boost/relax.");
-                warned = TRUE;
-            }
-            boost = 0;
-            return EALREADY;
+        /* the boost this relax is for has already run out */
+        if (status == EALREADY && nlapsed > 0) {
+            nlapsed--;
+            status = 0;
         }
-        
-        if (boost == 0) {
-            if (sched_setscheduler(0, SCHED_OTHER, &sched) < 0)
-                return errno;
+        G_UNLOCK(boost);
+
+        if (status == EALREADY && !warned) {
+            OHM_WARNING("Unbalanced priority boost/relax.");
+            warned = TRUE;
         }
-        return 0;
+        return status;
 
     default:
     case MODE_DISABLED:
@@ -229,13 +933,34 @@ static char *
 policy_name(int p)
 {
     switch (p) {
-    case SCHED_RR:   return PARAM_ROUNDROBIN;
-    case SCHED_FIFO: return PARAM_FIFO;
-    default:         return PARAM_DISABLED;
+    case SCHED_RR:       return PARAM_ROUNDROBIN;
+    case SCHED_FIFO:     return PARAM_FIFO;
+    case SCHED_DEADLINE: return PARAM_DEADLINE;
+    default:             return PARAM_DISABLED;
     }
 }
 
 
+static unsigned int
+param_uint(OhmPlugin *plugin, const char *name, unsigned int defval)
+{
+    const char    *value = ohm_plugin_get_param(plugin, name);
+    unsigned long  n;
+    char          *end;
+
+    if (value == NULL)
+        return defval;
+
+    n = strtoul(value, &end, 10);
+    if (end == value || *end) {
+        OHM_WARNING("Invalid %s parameter '%s'.", name, value);
+        return defval;
+    }
+
+    return (unsigned int)n;
+}
+
+
 static void
 plugin_init(OhmPlugin *plugin)
 {
@@ -248,6 +973,9 @@ plugin_init(OhmPlugin *plugin)
     struct param_map *pm;
 
 
+    if (!OHM_DEBUG_INIT(dvfs))
+        OHM_WARNING("dvfs: failed to register for debugging");
+
     /*
      * parse mode, policy and priorities
      */
@@ -278,21 +1006,47 @@ plugin_init(OhmPlugin *plugin)
         }
     }
 
+    dl_runtime = param_uint(plugin, "deadline-runtime", 0);
+    dl_period  = param_uint(plugin, "deadline-period" , 0);
+    max_boost  = param_uint(plugin, "max-boost"       , 0);
+    lock_freq  = param_uint(plugin, "lock-frequency"  , 0);
+
+    if (ohm_plugin_get_param(plugin, "lock-latency") != NULL)
+        lock_latency = (int)param_uint(plugin, "lock-latency", (unsigned)-1);
+
+    boost_init();
+
     
     /*
      * check configuration validity
      */
 
-    if (mode != MODE_DISABLED) {
-        min = sched_get_priority_min(policy);
-        max = sched_get_priority_max(policy);
-        if (priority < min)
-            priority = min;
-        if (priority > max)
-            priority = max;
+    if (mode != MODE_DISABLED && policy == SCHED_DEADLINE) {
+        if (dl_runtime == 0 || dl_period < dl_runtime) {
+            OHM_WARNING("Invalid SCHED_DEADLINE runtime/period %u/%u.",
+                        dl_runtime, dl_period);
+            mode = MODE_DISABLED;
+        }
+        else
+            priority = 0;
+    }
 
-        OHM_INFO("Priority settings: %s, %s, %d", modes[mode].name,
-                 policy_name(policy), priority);
+    if (mode != MODE_DISABLED) {
+        if (policy == SCHED_DEADLINE)
+            OHM_INFO("Priority settings: %s, %s, %u/%u usecs",
+                     modes[mode].name, policy_name(policy),
+                     dl_runtime, dl_period);
+        else {
+            min = sched_get_priority_min(policy);
+            max = sched_get_priority_max(policy);
+            if (priority < min)
+                priority = min;
+            if (priority > max)
+                priority = max;
+
+            OHM_INFO("Priority settings: %s, %s, %d", modes[mode].name,
+                     policy_name(policy), priority);
+        }
 
         if (mode == MODE_FIXED)
             priority_boost();
@@ -307,7 +1061,7 @@ plugin_exit(OhmPlugin *plugin)
 {
     (void)plugin;
 
-    return;
+    boost_exit();
 }
 
 
@@ -354,6 +1108,25 @@ OHM_EXPORTABLE(int, priority_relax, (void))
     return EOPNOTSUPP;
 }
 
+
+OHM_EXPORTABLE(int, boost_acquire, (const char *owner, unsigned int budget, int latency, unsigned int freq))
+{
+    (void)owner;
+    (void)budget;
+    (void)latency;
+    (void)freq;
+
+    return -EOPNOTSUPP;
+}
+
+
+OHM_EXPORTABLE(int, boost_release, (int token))
+{
+    (void)token;
+
+    return EOPNOTSUPP;
+}
+
 #endif /* !_POSIX_PRIORITY_SCHEDULING */
 
 
@@ -365,11 +1138,13 @@ OHM_PLUGIN_DESCRIPTION("dvfs",
 		       plugin_exit,
 		       NULL);
 
-OHM_PLUGIN_PROVIDES_METHODS(dvfs, 4,
+OHM_PLUGIN_PROVIDES_METHODS(dvfs, 6,
     OHM_EXPORT(dvfs_lock     , "lock"),
     OHM_EXPORT(dvfs_unlock   , "unlock"),
     OHM_EXPORT(priority_boost, "prio_boost"),
-    OHM_EXPORT(priority_relax, "prio_relax")
+    OHM_EXPORT(priority_relax, "prio_relax"),
+    OHM_EXPORT(boost_acquire , "boost_acquire"),
+    OHM_EXPORT(boost_release , "boost_release")
 );
 
 
@@ -31,8 +31,40 @@ typedef union
 } DBusBasicValue;
 
 
+typedef struct {
+	char		*name;		/* unique D-Bus name of the subscriber */
+	GHashTable	*facts;		/* quarks of subscribed fact names */
+} subscriber_t;
+
+typedef struct {
+	OhmFact		*fact;		/* changed fact */
+	GQuark		name;		/* name of the fact */
+	GQuark		field;		/* changed field */
+} change_t;
+
+
 static int DBG_FACTTOOL;
 static OhmFactStore *store;
+static DBusConnection *bus;
+
+static GHashTable *subscribers;		/* D-Bus name -> subscriber_t */
+static GHashTable *watched;		/* fact name quark -> # of subscribers */
+static GHashTable *changes;		/* pending (fact, field) changes */
+static guint flush_id;
+static gulong updated_id;
+static gulong removed_id;
+
+static unsigned long nupdate;		/* updates of subscribed facts */
+static unsigned long ncoalesced;	/* updates coalesced before flush */
+static unsigned long nsignal;		/* change signals sent */
+
+static void subscriber_free(gpointer);
+static guint change_hash(gconstpointer);
+static gboolean change_equal(gconstpointer, gconstpointer);
+static void updated_cb(void *, OhmFact *, GQuark, gpointer);
+static void removed_cb(void *, OhmFact *);
+static DBusHandlerResult name_owner_changed(DBusConnection *, DBusMessage *,
+	void *);
 
 
 OHM_DEBUG_PLUGIN(facttool,
@@ -46,10 +78,27 @@ static void plugin_init(OhmPlugin *plugin)
 	if (!OHM_DEBUG_INIT(facttool))
 		OHM_WARNING("facttool: Failed to initialize facttool plugin debbuging.");
 
+	/* the D-Bus handlers use these even without a fact store */
+	subscribers = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    NULL, subscriber_free);
+	watched = g_hash_table_new(g_direct_hash, g_direct_equal);
+	changes = g_hash_table_new_full(change_hash, change_equal,
+					g_free, NULL);
+
 	if ((store = ohm_get_fact_store()) == NULL) {
 		OHM_ERROR("facttool: Failed to initialize factstore.");
+		return;
 	}
 
+	if ((bus = ohm_plugin_dbus_get_connection()) == NULL ||
+	    !dbus_connection_add_filter(bus, name_owner_changed, NULL, NULL))
+		OHM_ERROR("facttool: failed to set up subscriber tracking");
+
+	updated_id = g_signal_connect(G_OBJECT(store), "updated",
+				      G_CALLBACK(updated_cb), NULL);
+	removed_id = g_signal_connect(G_OBJECT(store), "removed",
+				      G_CALLBACK(removed_cb), NULL);
+
 	OHM_INFO("facttool: init done");
 }
 
@@ -58,7 +107,37 @@ static void plugin_exit(OhmPlugin *plugin)
 {
 	(void)plugin;
 
-	OHM_INFO("facttool: exit");
+	if (store != NULL) {
+		if (g_signal_handler_is_connected(G_OBJECT(store), updated_id))
+			g_signal_handler_disconnect(G_OBJECT(store), updated_id);
+		if (g_signal_handler_is_connected(G_OBJECT(store), removed_id))
+			g_signal_handler_disconnect(G_OBJECT(store), removed_id);
+		updated_id = removed_id = 0;
+	}
+
+	if (flush_id != 0) {
+		g_source_remove(flush_id);
+		flush_id = 0;
+	}
+
+	if (bus != NULL)
+		dbus_connection_remove_filter(bus, name_owner_changed, NULL);
+
+	if (subscribers != NULL) {
+		g_hash_table_destroy(subscribers);
+		subscribers = NULL;
+	}
+	if (watched != NULL) {
+		g_hash_table_destroy(watched);
+		watched = NULL;
+	}
+	if (changes != NULL) {
+		g_hash_table_destroy(changes);
+		changes = NULL;
+	}
+
+	OHM_INFO("facttool: exit (%lu updates, %lu coalesced, %lu signals)",
+		 nupdate, ncoalesced, nsignal);
 }
 
 static int gval_match(GValue * a, GValue * b)
@@ -203,27 +282,35 @@ static int map_to_dbus_type(GValue *gval, gchar *sig, void **value)
  * ssv: fact name, field name, value to set
  * a(sv): array of struct: field name-value to check
  * 	The aray is used to select the facts where the set operation should be applied
+ *
+ * The selectors are collected first and the facts are then filtered in
+ * a single pass over the fact store list, without copying it; only the
+ * matching facts are collected for the update.
  */
 static int setfact_single(DBusMessageIter * msg_it)
 
 {
 	const gchar 	*fact_name = NULL;
 	const gchar	*field_name = NULL;
-	int		n;
+	int		n, i, nselect = 0, status = -1;
 	DBusBasicValue	dbus_value;
 	int		dbus_value_type;
 	GValue      	*gval;
+	const gchar	*select_fields_buf[FACTTOOL_SELECT_PREALLOC];
+	GValue		*select_gvals_buf[FACTTOOL_SELECT_PREALLOC];
+	const gchar	**select_fields = select_fields_buf;
+	GValue		**select_gvals = select_gvals_buf;
+	int		nalloc = FACTTOOL_SELECT_PREALLOC;
 	GSList		*fact_list;
 	GSList		*fact_list_it;
+	GSList		*matches;
 	OhmFact		*fact;
 
 	/* Read name of the fact to set */
 	if (dbus_message_iter_get_arg_type(msg_it) == DBUS_TYPE_STRING) {
 		dbus_message_iter_get_basic(msg_it, (void *)&fact_name);
 		dbus_message_iter_next(msg_it);
-		fact_list = g_slist_copy(ohm_fact_store_get_facts_by_name(store, fact_name));
-		n = fact_list ? g_slist_length(fact_list) : 0;
-		OHM_DEBUG(DBG_FACTTOOL, "%s: %d facts found!", __FUNCTION__, n);
+		fact_list = ohm_fact_store_get_facts_by_name(store, fact_name);
 	} else {
 		OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
 		goto end;
@@ -234,7 +321,7 @@ static int setfact_single(DBusMessageIter * msg_it)
 		dbus_message_iter_next(msg_it);
 	} else {
 		OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
-		goto free_list;
+		goto end;
 	}
 	/* Read the value to be set from a variant */
 	if (dbus_message_iter_get_arg_type(msg_it) == DBUS_TYPE_VARIANT) {
@@ -247,11 +334,11 @@ static int setfact_single(DBusMessageIter * msg_it)
 			dbus_message_iter_get_basic(&variant_it, (void *)&dbus_value);
 		} else {
 			OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
-			goto free_list;
+			goto end;
 		}
 	} else {
 		OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
-		goto free_list;
+		goto end;
 	}
 	dbus_message_iter_next(msg_it);
 
@@ -262,16 +349,14 @@ static int setfact_single(DBusMessageIter * msg_it)
 		DBusMessageIter variant_it;
 		const gchar     *select_field = NULL;
 		GValue          *select_gval;
-		GValue          *fact_gval;
 		DBusBasicValue  select_dbus_value;
 		int             select_dbus_value_type;
-		int             match;
 
 		dbus_message_iter_recurse(msg_it, &array_it);
 		while (dbus_message_iter_get_arg_type(&array_it) != DBUS_TYPE_INVALID) {
 			if (dbus_message_iter_get_arg_type(&array_it) != DBUS_TYPE_STRUCT) {
 				OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
-				goto free_list;
+				goto free_select;
 			}
 			dbus_message_iter_recurse(&array_it, &struct_it);
 			if (dbus_message_iter_get_arg_type(&struct_it) == DBUS_TYPE_STRING) {
@@ -279,68 +364,101 @@ static int setfact_single(DBusMessageIter * msg_it)
 				dbus_message_iter_next(&struct_it);
 			} else {
 				OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
-				goto free_list;
+				goto free_select;
 			}
+			select_gval = NULL;
 			if (dbus_message_iter_get_arg_type(&struct_it) == DBUS_TYPE_VARIANT) {
 				dbus_message_iter_recurse(&struct_it, &variant_it);
-				select_gval = NULL;
 				select_dbus_value_type = dbus_message_iter_get_arg_type(&variant_it);
 				if (is_handled_type(select_dbus_value_type) == TRUE) {
 					dbus_message_iter_get_basic(&variant_it, (void *)&select_dbus_value);
 					select_gval = dbus_value_to_gvalue(&select_dbus_value, select_dbus_value_type);
 				}
-				if (select_gval == NULL) {
-					OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
-					goto free_list;
-				}
 			}
-			/* Filter the fact list using field:value */
-			fact_list_it = fact_list;
-			while (fact_list_it != NULL) {
-				fact = (OhmFact *)fact_list_it->data;
-				fact_gval = ohm_fact_get(fact, select_field);
-				if (fact_gval == NULL)
-					match = FALSE;
-				else
-					match = gval_match(fact_gval, select_gval);
-
-				if (match == FALSE) {
-					fact_list_it = fact_list = g_slist_remove(fact_list, fact);
-					/* n is used only for debug/info log messages */
-					n--;
+			if (select_gval == NULL) {
+				OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
+				goto free_select;
+			}
+			if (nselect >= nalloc) {
+				/* more selectors than fit on the stack */
+				nalloc *= 2;
+				if (select_fields == select_fields_buf) {
+					select_fields = g_new(const gchar *, nalloc);
+					select_gvals  = g_new(GValue *, nalloc);
+					memcpy(select_fields, select_fields_buf,
+					       sizeof(select_fields_buf));
+					memcpy(select_gvals, select_gvals_buf,
+					       sizeof(select_gvals_buf));
 				} else {
-					fact_list_it = g_slist_next(fact_list_it);
+					select_fields = g_renew(const gchar *,
+								select_fields, nalloc);
+					select_gvals  = g_renew(GValue *,
+								select_gvals, nalloc);
 				}
 			}
-			g_value_unset(select_gval);
-			g_free(select_gval);
+			select_fields[nselect] = select_field;
+			select_gvals[nselect]  = select_gval;
+			nselect++;
 
 			dbus_message_iter_next(&array_it);
 		}
 		dbus_message_iter_next(msg_it);
 	}
-	/* Apply for all facts */
-	fact_list_it = fact_list;
-	while (fact_list_it != NULL) {
+
+	/* Filter the facts using all field:value selectors. Setting a field
+	 * emits "updated" synchronously and its handlers may add or remove
+	 * facts of the same name, so the matching facts are collected and
+	 * referenced before any of them is set. */
+	matches = NULL;
+	for (fact_list_it = fact_list; fact_list_it != NULL;
+	     fact_list_it = g_slist_next(fact_list_it)) {
+		GValue *fact_gval;
 
 		fact = (OhmFact *)fact_list_it->data;
+		for (i = 0; i < nselect; i++) {
+			fact_gval = ohm_fact_get(fact, select_fields[i]);
+			if (fact_gval == NULL || !gval_match(fact_gval, select_gvals[i]))
+				break;
+		}
+		if (i == nselect)
+			matches = g_slist_prepend(matches, g_object_ref(fact));
+	}
+	matches = g_slist_reverse(matches);
+
+	/* ... and apply */
+	n = 0;
+	for (fact_list_it = matches; fact_list_it != NULL;
+	     fact_list_it = g_slist_next(fact_list_it)) {
+		fact = (OhmFact *)fact_list_it->data;
+
 		gval = dbus_value_to_gvalue(&dbus_value, dbus_value_type);
 		if (gval == NULL) {
 			OHM_ERROR("%s: Unhandled value type %s", __FUNCTION__, dbus_message_type_to_string(dbus_value_type));
-			goto free_list;
+			goto free_matches;
 		}
 		OHM_DEBUG(DBG_FACTTOOL, "%s: Setting one fact.", __FUNCTION__);
 		ohm_fact_set(fact, field_name, gval);
-		fact_list_it = g_slist_next(fact_list_it);
+		n++;
 	}
 
 	OHM_INFO("%s: %d facts %s updated on field %s", __FUNCTION__, n, fact_name, field_name);
-	g_slist_free(fact_list);
-	return 0;
-free_list:
-	g_slist_free(fact_list);
+	status = 0;
+free_matches:
+	for (fact_list_it = matches; fact_list_it != NULL;
+	     fact_list_it = g_slist_next(fact_list_it))
+		g_object_unref(fact_list_it->data);
+	g_slist_free(matches);
+free_select:
+	for (i = 0; i < nselect; i++) {
+		g_value_unset(select_gvals[i]);
+		g_free(select_gvals[i]);
+	}
+	if (select_fields != select_fields_buf) {
+		g_free(select_fields);
+		g_free(select_gvals);
+	}
 end:
-	return -1;
+	return status;
 }
 
 /* Single/multiple set/create field of a fact or a collection of fact 
@@ -398,6 +516,118 @@ end:
 	return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/* Check if a GValue can be represented on D-Bus by map_to_dbus_type */
+static int is_mappable(GValue *gval)
+
+{
+	if (!G_IS_VALUE(gval))
+		return FALSE;
+
+	switch(G_VALUE_TYPE(gval)) {
+	case G_TYPE_STRING:
+	case G_TYPE_INT:
+	case G_TYPE_UINT:
+	case G_TYPE_LONG:
+	case G_TYPE_ULONG:
+	case G_TYPE_FLOAT:
+	case G_TYPE_DOUBLE:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* Append a GValue to a message as a variant
+ *
+ * Returns 1 if the value was appended, 0 if the value has a type that cannot
+ * be represented on D-Bus and -1 on error.
+ */
+static int append_variant(DBusMessageIter *it, GValue *gval)
+
+{
+	DBusMessageIter	variant_it;
+	gchar		sig_c = '?';
+	gchar		sig[2] = "?";
+	void		*value = NULL;
+	int		dbus_type = map_to_dbus_type(gval, &sig_c, &value);
+	int		success;
+
+	sig[0] = sig_c;
+	if (dbus_type == DBUS_TYPE_INVALID)
+		return 0;
+
+	if (!dbus_message_iter_open_container(it, DBUS_TYPE_VARIANT, sig, &variant_it)) {
+		OHM_ERROR("%s: error opening container", __FUNCTION__);
+		g_free(value);
+		return -1;
+	}
+	if (dbus_type == DBUS_TYPE_STRING)
+		success = dbus_message_iter_append_basic(&variant_it, dbus_type, &value);
+	else
+		success = dbus_message_iter_append_basic(&variant_it, dbus_type, value);
+	g_free(value);
+
+	if (!success) {
+		OHM_ERROR("%s: error appending OhmFact value", __FUNCTION__);
+		return -1;
+	}
+	dbus_message_iter_close_container(it, &variant_it);
+
+	return 1;
+}
+
+/* Append a list of facts to a message as aa(sv) */
+static int append_facts(DBusMessageIter *it, GSList *fact_list)
+
+{
+	DBusMessageIter	fact_it;
+	DBusMessageIter	fields_it;
+
+	/* Open array of facts */
+	if (!dbus_message_iter_open_container(it, DBUS_TYPE_ARRAY, "a(sv)", &fact_it)) {
+		OHM_ERROR("%s: error opening container", __FUNCTION__);
+		return FALSE;
+	}
+	while (fact_list != NULL) {
+		GSList	*fields = NULL;
+		OhmFact	*fact;
+
+		if (!dbus_message_iter_open_container(&fact_it, DBUS_TYPE_ARRAY, "(sv)", &fields_it)) {
+			OHM_ERROR("%s: error opening container", __FUNCTION__);
+			return FALSE;
+		}
+		fact = (OhmFact *)fact_list->data;
+		for (fields = ohm_fact_get_fields(fact); fields != NULL; fields = g_slist_next(fields)) {
+			DBusMessageIter	struct_it;
+			GQuark	qfield = (GQuark)GPOINTER_TO_INT(fields->data);
+			const	gchar *field_name = g_quark_to_string(qfield);
+			GValue	*gval = ohm_fact_get(fact, field_name);
+
+			if (!is_mappable(gval)) {
+				OHM_WARNING("%s: ignoring invalid field %s", __FUNCTION__, field_name);
+				continue;
+			}
+			if (!dbus_message_iter_open_container(&fields_it, DBUS_TYPE_STRUCT, NULL, &struct_it)) {
+				OHM_ERROR("%s: error opening container", __FUNCTION__);
+				return FALSE;
+			}
+			if (!dbus_message_iter_append_basic(&struct_it, DBUS_TYPE_STRING, &field_name)) {
+				OHM_ERROR("%s: error appending OhmFact field", __FUNCTION__);
+				return FALSE;
+			}
+			if (append_variant(&struct_it, gval) < 0)
+				return FALSE;
+			dbus_message_iter_close_container(&fields_it, &struct_it);
+		}
+
+		dbus_message_iter_close_container(&fact_it, &fields_it);
+		fact_list = g_slist_next(fact_list);
+	}
+	dbus_message_iter_close_container(it, &fact_it);
+
+	return TRUE;
+}
+
 /* Get facts
  *
  * DBUS arguments:
@@ -415,8 +645,6 @@ static DBusHandlerResult facttool_getfact(DBusConnection * c, DBusMessage * msg,
 {
 	const gchar 	*name = NULL;
 	DBusMessageIter	rep_it;
-	DBusMessageIter	fact_it;
-	DBusMessageIter	fields_it;
 	DBusMessage	*reply;
 	int		n;
 	GSList		*fact_list;
@@ -440,73 +668,74 @@ static DBusHandlerResult facttool_getfact(DBusConnection * c, DBusMessage * msg,
 	
 	dbus_message_iter_init_append(reply, &rep_it);
 
-	/* Open array of facts */
-	if (!dbus_message_iter_open_container(&rep_it, DBUS_TYPE_ARRAY, "a(sv)", &fact_it)) {
+	if (!append_facts(&rep_it, fact_list))
+		goto end;
+
+	if (!dbus_connection_send(c, reply, NULL)) {
+		OHM_ERROR("%s: failed to send the reply", __FUNCTION__);
+	}
+
+end:
+	dbus_message_unref(reply);
+cancel:
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* Get several facts in one round-trip
+ *
+ * DBUS arguments:
+ *
+ * arg 0: array of strings: names of the facts to be retrieved
+ *
+ * Returns a DBUS reply containing an array of struct of the fact name and
+ * the instances of the fact in the same format getfact uses: a(saa(sv)).
+ */
+static DBusHandlerResult facttool_getfacts(DBusConnection * c, DBusMessage * msg,
+	void *user_data)
+
+{
+	DBusMessageIter	msg_it;
+	DBusMessageIter	names_it;
+	DBusMessageIter	rep_it;
+	DBusMessageIter	array_it;
+	DBusMessageIter	struct_it;
+	DBusMessage	*reply;
+	const gchar	*name;
+
+	dbus_message_iter_init(msg, &msg_it);
+
+	if (dbus_message_iter_get_arg_type(&msg_it) != DBUS_TYPE_ARRAY ||
+	    dbus_message_iter_get_element_type(&msg_it) != DBUS_TYPE_STRING) {
+		OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
+		goto cancel;
+	}
+	if ((reply = dbus_message_new_method_return(msg)) == NULL) {
+		OHM_ERROR("%s: failed to allocate D-BUS reply", __FUNCTION__);
+		goto cancel;
+	}
+
+	dbus_message_iter_init_append(reply, &rep_it);
+
+	if (!dbus_message_iter_open_container(&rep_it, DBUS_TYPE_ARRAY, "(saa(sv))", &array_it)) {
 		OHM_ERROR("%s: error opening container", __FUNCTION__);
 		goto end;
 	}
-	while (fact_list != NULL) {
-		GSList	*fields = NULL;
-		OhmFact	*fact;
+	dbus_message_iter_recurse(&msg_it, &names_it);
+	while (dbus_message_iter_get_arg_type(&names_it) == DBUS_TYPE_STRING) {
+		dbus_message_iter_get_basic(&names_it, (void *)&name);
 
-		if (!dbus_message_iter_open_container(&fact_it, DBUS_TYPE_ARRAY, "(sv)", &fields_it)) {
-			OHM_ERROR("%s: error opening container", __FUNCTION__);
+		if (!dbus_message_iter_open_container(&array_it, DBUS_TYPE_STRUCT, NULL, &struct_it) ||
+		    !dbus_message_iter_append_basic(&struct_it, DBUS_TYPE_STRING, &name)) {
+			OHM_ERROR("%s: error appending fact %s", __FUNCTION__, name);
 			goto end;
 		}
-		fact = (OhmFact *)fact_list->data;
-		for (fields = ohm_fact_get_fields(fact); fields != NULL; fields = g_slist_next(fields)) {
-			DBusMessageIter	struct_it;
-			DBusMessageIter	variant_it;
-			GQuark	qfield = (GQuark)GPOINTER_TO_INT(fields->data);
-			const	gchar *field_name = g_quark_to_string(qfield);
-			gchar	sig_c = '?';
-			gchar	sig[2] = "?";
-			void	*value;
-			GValue	*gval = ohm_fact_get(fact, field_name);
-			int	dbus_type = map_to_dbus_type(gval, &sig_c, &value);
-
-			sig[0] = sig_c;
-			if (dbus_type == DBUS_TYPE_INVALID) {
-				OHM_WARNING("%s: ignoring invalid field %s", __FUNCTION__, field_name);
-				continue;
-			}
-			if (!dbus_message_iter_open_container(&fields_it, DBUS_TYPE_STRUCT, NULL, &struct_it)) {
-				OHM_ERROR("%s: error opening container", __FUNCTION__);
-				g_free(value);
-				goto end;
-			}
-			if (!dbus_message_iter_append_basic(&struct_it, DBUS_TYPE_STRING, &field_name)) {
-				OHM_ERROR("%s: error appending OhmFact field", __FUNCTION__);
-				g_free(value);
-				goto end;
-			}
-			if (!dbus_message_iter_open_container(&struct_it, DBUS_TYPE_VARIANT, sig, &variant_it)) {
-				OHM_ERROR("%s: error opening container", __FUNCTION__);
-				g_free(value);
-				goto end;
-			}
-			if (dbus_type == DBUS_TYPE_STRING) {
-				if (!dbus_message_iter_append_basic(&variant_it, dbus_type, &value)) {
-					OHM_ERROR("%s: error appending OhmFact value", __FUNCTION__);
-					g_free(value);
-					goto end;
-				}
-			} else {
-				if (!dbus_message_iter_append_basic(&variant_it, dbus_type, value)) {
-					OHM_ERROR("%s: error appending OhmFact value", __FUNCTION__);
-					g_free(value);
-					goto end;
-				}
-			}
-			g_free(value);
-			dbus_message_iter_close_container(&struct_it, &variant_it);
-			dbus_message_iter_close_container(&fields_it, &struct_it);
-		}
+		if (!append_facts(&struct_it, ohm_fact_store_get_facts_by_name(store, name)))
+			goto end;
+		dbus_message_iter_close_container(&array_it, &struct_it);
 
-		dbus_message_iter_close_container(&fact_it, &fields_it);
-		fact_list = g_slist_next(fact_list);
+		dbus_message_iter_next(&names_it);
 	}
-	dbus_message_iter_close_container(&rep_it, &fact_it);
+	dbus_message_iter_close_container(&rep_it, &array_it);
 
 	if (!dbus_connection_send(c, reply, NULL)) {
 		OHM_ERROR("%s: failed to send the reply", __FUNCTION__);
@@ -518,6 +747,373 @@ cancel:
 	return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/*
+ * Subscriptions
+ *
+ * A subscriber names the facts it is interested in. Field updates of those
+ * facts are collected (and coalesced per fact and field) from the fact store
+ * update callback, and sent out from an idle callback as a single unicast
+ * factchanged signal per subscriber: a(sisv), ie. fact name, index of the
+ * fact instance in the getfact(s) reply order, field name, current value.
+ */
+
+static void track_name(const char *name, int track)
+
+{
+	char		filter[1024];
+	DBusError	error;
+
+	snprintf(filter, sizeof(filter),
+		 "type='signal',"
+		 "sender='org.freedesktop.DBus',interface='org.freedesktop.DBus',"
+		 "member='NameOwnerChanged',path='/org/freedesktop/DBus',"
+		 "arg0='%s',arg1='%s',arg2=''", name, name);
+
+	if (track) {
+		dbus_error_init(&error);
+		dbus_bus_add_match(bus, filter, &error);
+		if (dbus_error_is_set(&error)) {
+			OHM_ERROR("%s: failed to add match rule \"%s\": %s",
+				  __FUNCTION__, filter, error.message);
+			dbus_error_free(&error);
+		}
+	}
+	else
+		dbus_bus_remove_match(bus, filter, NULL);
+}
+
+static void unwatch_fact(gpointer key, gpointer value, gpointer user_data)
+
+{
+	guint refcnt = GPOINTER_TO_UINT(g_hash_table_lookup(watched, key));
+
+	(void)value;
+	(void)user_data;
+
+	if (refcnt <= 1)
+		g_hash_table_remove(watched, key);
+	else
+		g_hash_table_insert(watched, key, GUINT_TO_POINTER(refcnt - 1));
+}
+
+static void subscriber_free(gpointer data)
+
+{
+	subscriber_t *s = (subscriber_t *)data;
+
+	g_hash_table_foreach(s->facts, unwatch_fact, NULL);
+	g_hash_table_destroy(s->facts);
+	g_free(s->name);
+	g_free(s);
+}
+
+static void subscriber_remove(const char *name)
+
+{
+	if (g_hash_table_lookup(subscribers, name) != NULL) {
+		OHM_DEBUG(DBG_FACTTOOL, "%s: removing subscriber %s", __FUNCTION__, name);
+		track_name(name, FALSE);
+		g_hash_table_remove(subscribers, name);
+	}
+}
+
+static guint change_hash(gconstpointer key)
+
+{
+	const change_t *ch = (const change_t *)key;
+
+	return g_direct_hash(ch->fact) ^ (ch->field * 31);
+}
+
+static gboolean change_equal(gconstpointer a, gconstpointer b)
+
+{
+	const change_t *ca = (const change_t *)a;
+	const change_t *cb = (const change_t *)b;
+
+	return ca->fact == cb->fact && ca->field == cb->field;
+}
+
+static void send_changes(gpointer key, gpointer value, gpointer user_data)
+
+{
+	subscriber_t	*s = (subscriber_t *)value;
+	DBusMessage	*msg;
+	DBusMessageIter	it;
+	DBusMessageIter	array_it;
+	DBusMessageIter	struct_it;
+	GHashTableIter	ci;
+	gpointer	ckey;
+	change_t	*ch;
+	const gchar	*name;
+	const gchar	*field;
+	dbus_int32_t	idx;
+	GValue		*gval;
+	int		n = 0;
+
+	(void)key;
+	(void)user_data;
+
+	msg = dbus_message_new_signal(DBUS_PATH_POLICY, DBUS_INTERFACE_POLICY,
+				      SIGNAL_POLICY_FACTTOOL_CHANGED);
+	if (msg == NULL || !dbus_message_set_destination(msg, s->name)) {
+		OHM_ERROR("%s: failed to allocate D-BUS signal", __FUNCTION__);
+		goto out;
+	}
+
+	dbus_message_iter_init_append(msg, &it);
+	if (!dbus_message_iter_open_container(&it, DBUS_TYPE_ARRAY, "(sisv)", &array_it))
+		goto out;
+
+	g_hash_table_iter_init(&ci, changes);
+	while (g_hash_table_iter_next(&ci, &ckey, NULL)) {
+		ch = (change_t *)ckey;
+		if (g_hash_table_lookup(s->facts, GUINT_TO_POINTER(ch->name)) == NULL)
+			continue;
+
+		name  = g_quark_to_string(ch->name);
+		field = g_quark_to_string(ch->field);
+		idx   = g_slist_index(ohm_fact_store_get_facts_by_name(store, name), ch->fact);
+		gval  = ohm_fact_get(ch->fact, field);
+
+		if (idx < 0 || gval == NULL)
+			continue;
+
+		if (!dbus_message_iter_open_container(&array_it, DBUS_TYPE_STRUCT, NULL, &struct_it) ||
+		    !dbus_message_iter_append_basic(&struct_it, DBUS_TYPE_STRING, &name) ||
+		    !dbus_message_iter_append_basic(&struct_it, DBUS_TYPE_INT32, &idx) ||
+		    !dbus_message_iter_append_basic(&struct_it, DBUS_TYPE_STRING, &field) ||
+		    append_variant(&struct_it, gval) <= 0) {
+			OHM_ERROR("%s: failed to append change of %s:%s", __FUNCTION__, name, field);
+			goto out;
+		}
+		dbus_message_iter_close_container(&array_it, &struct_it);
+		n++;
+	}
+	dbus_message_iter_close_container(&it, &array_it);
+
+	if (n > 0) {
+		if (dbus_connection_send(bus, msg, NULL))
+			nsignal++;
+		else
+			OHM_ERROR("%s: failed to send signal to %s", __FUNCTION__, s->name);
+	}
+
+out:
+	if (msg != NULL)
+		dbus_message_unref(msg);
+}
+
+static gboolean flush_changes(gpointer data)
+
+{
+	(void)data;
+
+	flush_id = 0;
+
+	if (bus != NULL)
+		g_hash_table_foreach(subscribers, send_changes, NULL);
+	g_hash_table_remove_all(changes);
+
+	OHM_DEBUG(DBG_FACTTOOL, "%s: %lu updates, %lu coalesced, %lu signals",
+		  __FUNCTION__, nupdate, ncoalesced, nsignal);
+
+	return FALSE;
+}
+
+static void updated_cb(void *data, OhmFact *fact, GQuark fldquark, gpointer value)
+
+{
+	change_t	key;
+	change_t	*ch;
+	GQuark		name;
+
+	(void)data;
+	(void)value;
+
+	if (fact == NULL || g_hash_table_size(watched) == 0)
+		return;
+
+	name = g_quark_try_string(ohm_structure_get_name(OHM_STRUCTURE(fact)));
+	if (!name || g_hash_table_lookup(watched, GUINT_TO_POINTER(name)) == NULL)
+		return;
+
+	nupdate++;
+
+	key.fact  = fact;
+	key.field = fldquark;
+	if (g_hash_table_lookup(changes, &key) != NULL) {
+		ncoalesced++;
+		return;
+	}
+
+	if ((ch = g_new0(change_t, 1)) == NULL)
+		return;
+	ch->fact  = fact;
+	ch->name  = name;
+	ch->field = fldquark;
+	g_hash_table_insert(changes, ch, ch);
+
+	if (flush_id == 0)
+		flush_id = g_idle_add(flush_changes, NULL);
+}
+
+static gboolean change_of_fact(gpointer key, gpointer value, gpointer user_data)
+
+{
+	(void)value;
+
+	return ((change_t *)key)->fact == (OhmFact *)user_data;
+}
+
+static void removed_cb(void *data, OhmFact *fact)
+
+{
+	(void)data;
+
+	if (fact != NULL && g_hash_table_size(changes) > 0)
+		g_hash_table_foreach_remove(changes, change_of_fact, fact);
+}
+
+static DBusHandlerResult name_owner_changed(DBusConnection *c, DBusMessage *msg,
+	void *user_data)
+
+{
+	const char *name, *before, *after;
+
+	(void)c;
+	(void)user_data;
+
+	if (!dbus_message_is_signal(msg, "org.freedesktop.DBus", "NameOwnerChanged") ||
+	    !dbus_message_get_args(msg, NULL,
+				   DBUS_TYPE_STRING, &name,
+				   DBUS_TYPE_STRING, &before,
+				   DBUS_TYPE_STRING, &after,
+				   DBUS_TYPE_INVALID))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	if (name != NULL && before != NULL && (!after || !after[0]))
+		subscriber_remove(name);
+
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void send_empty_reply(DBusConnection *c, DBusMessage *msg)
+
+{
+	DBusMessage	*reply;
+
+	if ((reply = dbus_message_new_method_return(msg)) == NULL) {
+		OHM_ERROR("%s: failed to allocate D-BUS reply", __FUNCTION__);
+		return;
+	}
+	if (!dbus_connection_send(c, reply, NULL)) {
+		OHM_ERROR("%s: failed to send the reply", __FUNCTION__);
+	}
+	dbus_message_unref(reply);
+}
+
+/* Subscribe to changes of facts
+ *
+ * DBUS arguments:
+ *
+ * arg 0: array of strings: names of the facts to watch
+ *
+ * The subscriber gets factchanged signals until it unsubscribes or leaves
+ * the bus.
+ */
+static DBusHandlerResult facttool_subscribe(DBusConnection * c, DBusMessage * msg,
+	void *user_data)
+
+{
+	DBusMessageIter	msg_it;
+	DBusMessageIter	names_it;
+	const char	*sender = dbus_message_get_sender(msg);
+	const gchar	*name;
+	subscriber_t	*s;
+	gpointer	q;
+
+	dbus_message_iter_init(msg, &msg_it);
+
+	if (sender == NULL ||
+	    dbus_message_iter_get_arg_type(&msg_it) != DBUS_TYPE_ARRAY ||
+	    dbus_message_iter_get_element_type(&msg_it) != DBUS_TYPE_STRING) {
+		OHM_ERROR("%s:%d Invalid dbus request", __FUNCTION__, __LINE__);
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	if ((s = g_hash_table_lookup(subscribers, sender)) == NULL) {
+		s = g_new0(subscriber_t, 1);
+		s->name  = g_strdup(sender);
+		s->facts = g_hash_table_new(g_direct_hash, g_direct_equal);
+		g_hash_table_insert(subscribers, s->name, s);
+		track_name(s->name, TRUE);
+		OHM_INFO("%s: new subscriber %s", __FUNCTION__, s->name);
+	}
+
+	dbus_message_iter_recurse(&msg_it, &names_it);
+	while (dbus_message_iter_get_arg_type(&names_it) == DBUS_TYPE_STRING) {
+		dbus_message_iter_get_basic(&names_it, (void *)&name);
+
+		q = GUINT_TO_POINTER(g_quark_from_string(name));
+		if (g_hash_table_lookup(s->facts, q) == NULL) {
+			g_hash_table_insert(s->facts, q, q);
+			g_hash_table_insert(watched, q, GUINT_TO_POINTER(
+				GPOINTER_TO_UINT(g_hash_table_lookup(watched, q)) + 1));
+		}
+		dbus_message_iter_next(&names_it);
+	}
+
+	send_empty_reply(c, msg);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* Unsubscribe from changes of facts
+ *
+ * DBUS arguments:
+ *
+ * arg 0: array of strings: names of the facts not to watch any more, an
+ *        empty array cancels all subscriptions of the caller
+ */
+static DBusHandlerResult facttool_unsubscribe(DBusConnection * c, DBusMessage * msg,
+	void *user_data)
+
+{
+	DBusMessageIter	msg_it;
+	DBusMessageIter	names_it;
+	const char	*sender = dbus_message_get_sender(msg);
+	const gchar	*name;
+	subscriber_t	*s;
+	gpointer	q;
+	int		n = 0;
+
+	dbus_message_iter_init(msg, &msg_it);
+
+	if (sender != NULL && (s = g_hash_table_lookup(subscribers, sender)) != NULL) {
+		if (dbus_message_iter_get_arg_type(&msg_it) == DBUS_TYPE_ARRAY) {
+			dbus_message_iter_recurse(&msg_it, &names_it);
+
+			while (dbus_message_iter_get_arg_type(&names_it) == DBUS_TYPE_STRING) {
+				dbus_message_iter_get_basic(&names_it, (void *)&name);
+
+				q = GUINT_TO_POINTER(g_quark_try_string(name));
+				if (q != NULL && g_hash_table_remove(s->facts, q))
+					unwatch_fact(q, NULL, NULL);
+				dbus_message_iter_next(&names_it);
+				n++;
+			}
+		}
+
+		if (n == 0 || g_hash_table_size(s->facts) == 0)
+			subscriber_remove(sender);
+	}
+
+	send_empty_reply(c, msg);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 OHM_PLUGIN_DESCRIPTION("facttool",
                        "0.0.1",
                        "mathieux.soulard@intel.com",
@@ -530,6 +1126,12 @@ OHM_PLUGIN_DBUS_METHODS(
 	{NULL, DBUS_PATH_POLICY, METHOD_POLICY_FACTTOOL_SET_FACT,
 		facttool_setfact, NULL},
 	{NULL, DBUS_PATH_POLICY, METHOD_POLICY_FACTTOOL_GET_FACT,
-		facttool_getfact, NULL}
+		facttool_getfact, NULL},
+	{NULL, DBUS_PATH_POLICY, METHOD_POLICY_FACTTOOL_GET_FACTS,
+		facttool_getfacts, NULL},
+	{NULL, DBUS_PATH_POLICY, METHOD_POLICY_FACTTOOL_SUBSCRIBE,
+		facttool_subscribe, NULL},
+	{NULL, DBUS_PATH_POLICY, METHOD_POLICY_FACTTOOL_UNSUBSCRIBE,
+		facttool_unsubscribe, NULL}
 );
 
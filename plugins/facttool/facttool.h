@@ -41,6 +41,12 @@
 
 #define METHOD_POLICY_FACTTOOL_SET_FACT			"setfact"
 #define METHOD_POLICY_FACTTOOL_GET_FACT			"getfact"
+#define METHOD_POLICY_FACTTOOL_GET_FACTS		"getfacts"
+#define METHOD_POLICY_FACTTOOL_SUBSCRIBE		"subscribe"
+#define METHOD_POLICY_FACTTOOL_UNSUBSCRIBE		"unsubscribe"
+#define SIGNAL_POLICY_FACTTOOL_CHANGED			"factchanged"
+
+#define FACTTOOL_SELECT_PREALLOC	16	/* a(sv) selectors kept on the stack */
 
 static void plugin_init(OhmPlugin *);
 static void plugin_exit(OhmPlugin *);
@@ -26,10 +26,6 @@ typedef void (*ep_cb_t) (GObject *, GObject *, gboolean);
 static void     policy_decision (GObject *, GObject *, ep_cb_t, gpointer);
 static void     policy_keychange(GObject *, GObject *, gpointer);
 
-#if 0
-static gboolean txparser        (GObject *, GObject *, gpointer);
-#endif
-
 
 /********************
  * ep_init
@@ -193,186 +189,6 @@ policy_keychange(GObject *ep, GObject *tx, gpointer data)
 
 
 
-
-
-
-
-
-#if 0
-
-/********************
- * fmradio_action
- ********************/
-static int
-fmradio_action(fmradio_context_t *ctx, void *data)
-{
-    fmradio_t *action = (fmradio_t *)data;
-    
-    FREE(ctx->action);
-    ctx->action = STRDUP(action->state);
-    
-    return TRUE;
-}
-
-
-/*****************************************************************************
- *                      *** action parsing routines from ***                 *
- *****************************************************************************/
-
-#define PREFIX    "com.nokia.policy."
-#define BACKLIGHT PREFIX"backlight"
-#define STRUCT_OFFSET(s,m) ((char *)&(((s *)0)->m) - (char *)0)
-
-typedef int (*action_t)(backlight_context_t *, void *);
-
-typedef enum {
-    argtype_invalid = 0,
-    argtype_string,
-    argtype_integer,
-    argtype_unsigned
-} argtype_t;
-
-typedef struct {		/* argument descriptor for actions */
-    argtype_t   type;
-    const char *name;
-    int         offs;
-} argdsc_t; 
-
-typedef struct {		/* action descriptor */
-    const char *name;
-    action_t    handler;
-    argdsc_t   *argdsc;
-    int         datalen;
-} actdsc_t;
-
-static argdsc_t backlight_args[] = {
-    { argtype_string , "state", STRUCT_OFFSET(backlight_t, state) },
-    { argtype_invalid,  NULL  , 0                            }
-};
-
-static actdsc_t actions[] = {
-    { BACKLIGHT, backlight_action, backlight_args, sizeof(backlight_t) },
-    { NULL     , NULL            , NULL          , 0                   }
-};
-
-static int action_parser(actdsc_t *, backlight_context_t *);
-static int get_args     (OhmFact  *, argdsc_t *, void *);
-
-
-static gboolean
-txparser(GObject *conn, GObject *transaction, gpointer data)
-{
-    backlight_context_t *ctx = (backlight_context_t *)data;
-    guint            txid;
-    GSList          *entry, *list;
-    char            *name;
-    actdsc_t        *action;
-    gboolean         success;
-    gchar           *signal;
-
-    (void)conn;
-
-    g_object_get(transaction, "txid" , &txid, NULL);
-    g_object_get(transaction, "facts", &list, NULL);
-    g_object_get(transaction, "signal", &signal, NULL);
-    
-    success = TRUE;
-
-    if (!strcmp(signal, BACKLIGHT_ACTIONS)) {
-        for (entry = list; entry != NULL; entry = g_slist_next(entry)) {
-            name = (char *)entry->data;
-            for (action = actions; action->name != NULL; action++) {
-                if (!strcmp(name, action->name))
-                    success &= action_parser(action, ctx);
-            }
-        }
-    }
-
-    g_free(signal);
-    
-    return success;
-}
-
-static int action_parser(actdsc_t *action, backlight_context_t *ctx)
-{
-    OhmFact *fact;
-    GSList  *list;
-    char    *data;
-    int      success;
-
-    if ((data = malloc(action->datalen)) == NULL) {
-        OHM_ERROR("Can't allocate %d byte memory", action->datalen);
-
-        return FALSE;
-    }
-
-    success = TRUE;
-
-    for (list  = ohm_fact_store_get_facts_by_name(ctx->store, action->name);
-         list != NULL;
-         list  = g_slist_next(list))
-    {
-        fact = (OhmFact *)list->data;
-
-        memset(data, 0, action->datalen);
-
-        if (get_args(fact, action->argdsc, data))
-            success &= action->handler(ctx, data);
-        else {
-            OHM_DEBUG(DBG_ACTION, "argument parsing error for action '%s'",
-                      action->name);
-            success &= FALSE;
-        }
-    }
-
-    free(data);
-    
-    return success;
-}
-
-static int get_args(OhmFact *fact, argdsc_t *argdsc, void *args)
-{
-    argdsc_t *ad;
-    GValue   *gv;
-    void     *vptr;
-
-    if (fact == NULL)
-        return FALSE;
-
-    for (ad = argdsc;    ad->type != argtype_invalid;   ad++) {
-        vptr = args + ad->offs;
-
-        if ((gv = ohm_fact_get(fact, ad->name)) == NULL)
-            continue;
-
-        switch (ad->type) {
-
-        case argtype_string:
-            if (G_VALUE_TYPE(gv) == G_TYPE_STRING)
-                *(const char **)vptr = g_value_get_string(gv);
-            break;
-
-        case argtype_integer:
-            if (G_VALUE_TYPE(gv) == G_TYPE_INT)
-                *(int *)vptr = g_value_get_int(gv);
-            break;
-
-        case argtype_unsigned:
-            if (G_VALUE_TYPE(gv) == G_TYPE_UINT)
-                *(unsigned int *)vptr = g_value_get_uint(gv);
-            break;
-
-        default:
-            break;
-        }
-    }
-
-    return TRUE;
-}
-
-#endif
-
-
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -38,10 +38,26 @@ typedef struct _observer {
     int refcount;
 } observer;
 
+/*
+ * The directories of the observed keys are kept in a tree. A directory
+ * is subscribed to if it has observed keys and none of its ancestors
+ * has. Adding or removing a key only touches the path to its directory
+ * and, when the subscription of that directory changes, the branches
+ * below it that have observed keys.
+ */
+
+struct _gconf_dir {
+    gchar *path;            /* full path of the directory */
+    gconf_dir *parent;
+    GHashTable *children;   /* name -> child directory */
+    int nkey;               /* observed keys in this directory */
+    int nbelow;             /* observed keys in this whole subtree */
+    gboolean watched;       /* subscribed to with gconf_client_add_dir */
+};
+
 
 static gboolean update_fact(gconf_plugin *plugin, GConfEntry *entry)
 {
-    GSList *e = NULL, *list = NULL;
     const gchar *key = NULL;
     GConfValue *val = NULL;
     OhmFact *fact = NULL;
@@ -50,18 +66,7 @@ static gboolean update_fact(gconf_plugin *plugin, GConfEntry *entry)
 
     key = gconf_entry_get_key(entry);
     val =  gconf_entry_get_value(entry);
-    list = ohm_fact_store_get_facts_by_name(plugin->fs, GCONF_FACT);
-
-    for (e = list; e != NULL; e = g_slist_next(e)) {
-        OhmFact *tmp = (OhmFact *) e->data;
-        GValue *gval = ohm_fact_get(tmp, "key");
-
-        if (gval && !strcmp(key, g_value_get_string(gval))) {
-            /* found a fact */
-            fact = tmp;
-            break;
-        }
-    }
+    fact = g_hash_table_lookup(plugin->facts, key);
 
     if (!fact) {
         /* not found, create new */
@@ -70,13 +75,14 @@ static gboolean update_fact(gconf_plugin *plugin, GConfEntry *entry)
         fact = ohm_fact_new(GCONF_FACT);
         ohm_fact_set(fact, "key", ohm_value_from_string(key));
         ohm_fact_store_insert(plugin->fs, fact);
+        g_hash_table_insert(plugin->facts, g_strdup(key), fact);
     }
         
     if (!val) {
         OHM_DEBUG(DBG_GCONF, "value was unset\n");
         /* the key was unset, delete from FS */
         ohm_fact_store_remove(plugin->fs, fact);
-        g_object_unref(fact);
+        g_hash_table_remove(plugin->facts, key);
         return TRUE;
     }
 
@@ -130,9 +136,7 @@ static gboolean update_fact(gconf_plugin *plugin, GConfEntry *entry)
 
 void notify(GConfClient *client, guint id, GConfEntry *entry, gpointer user_data)
 {
-    GSList *e = NULL;
     const gchar *key = NULL;
-    gboolean found = FALSE;
     gconf_plugin *plugin = user_data;
 
     (void) client;
@@ -140,15 +144,7 @@ void notify(GConfClient *client, guint id, GConfEntry *entry, gpointer user_data
 
     key = gconf_entry_get_key(entry);
 
-    for (e = plugin->observers; e != NULL; e = g_slist_next(e)) {
-        observer *obs = e->data;
-        if (!strcmp(key, obs->key)) {
-            found = TRUE;
-            break;
-        }
-    }
-
-    if (!found)
+    if (!g_hash_table_lookup(plugin->observers, key))
         return;
 
     update_fact(plugin, entry);
@@ -173,6 +169,11 @@ gconf_plugin * init_gconf(int flag_gconf)
         goto error;
     }
 
+    /* the observers are freed by hand, they own their keys */
+    plugin->observers = g_hash_table_new(g_str_hash, g_str_equal);
+    plugin->facts = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_object_unref);
+
     return plugin;
 
 error:
@@ -227,165 +228,229 @@ error:
 }
 
 
-static int is_child_directory(const gchar *child, const gchar *parent)
+static gconf_dir * dir_new(gconf_dir *parent, const gchar *name)
 {
-    /* return true if the directory is a child or is exactly the same
-     * directory */
-    gchar *p_iter, *c_iter;
-    int is_child = TRUE;
-
-    p_iter = (gchar *) parent;
-    c_iter = (gchar *) child;
-
-    while (is_child) {
-        if (*p_iter == '\0') {
-            /* see if the parent directory is complete */
-            if (*c_iter == '\0' || *c_iter == '/') {
-                break;
-            }
-            else {
-                /* /foo/bar vs. /foo/barbar */
-                is_child = FALSE;
-            }
-        }
-        else if (*c_iter == '\0' || *p_iter != *c_iter) {
-            is_child = FALSE;
-        }
-        p_iter++;
-        c_iter++;
-    }
+    gconf_dir *dir = g_new0(gconf_dir, 1);
+
+    if (parent == NULL)
+        dir->path = g_strdup("/");
+    else if (parent->parent == NULL)
+        dir->path = g_strconcat("/", name, NULL);
+    else
+        dir->path = g_strconcat(parent->path, "/", name, NULL);
 
-    return is_child;
+    dir->parent = parent;
+    dir->children = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+
+    if (parent)
+        g_hash_table_insert(parent->children, g_strdup(name), dir);
+
+    return dir;
 }
-static GSList * listened_directories(GSList *observers)
+
+static void dir_free(gconf_dir *dir)
 {
-    /* get a list of directories */
-    GSList *directories = NULL, *i, *j;
-    observer *obs = NULL;
+    g_hash_table_destroy(dir->children);
+    g_free(dir->path);
+    g_free(dir);
+}
 
-    for (i = observers; i != NULL; i = g_slist_next(i)) {
-        gchar *dir;
-        obs = (observer *) i->data;
-        dir = get_directory_from_key(obs->key);
-        if (dir) {
-            directories = g_slist_prepend(directories, dir);
-        }
+static gconf_dir * dir_lookup(gconf_plugin *plugin, const gchar *path,
+        gboolean create)
+{
+    gchar **names, **name;
+    gconf_dir *dir, *child;
+
+    if (plugin->dirs == NULL) {
+        if (!create)
+            return NULL;
+        plugin->dirs = dir_new(NULL, NULL);
     }
 
-    for (i = directories; i != NULL; i = g_slist_next(i)) {
-        int is_child = FALSE;
-        for (j = directories; j != NULL; j = g_slist_next(j)) {
-            if (j != i) {
-                is_child = is_child_directory(i->data, j->data);
-                if (is_child) {
-                    break;
-                }
-            }
-        }
-        if (is_child) {
+    dir = plugin->dirs;
+    names = g_strsplit(path, "/", 0);
 
-            /* filter out the directories that are the direct descendents of
-             * other directories */
-            g_free(i->data);
-            directories = g_slist_delete_link(directories, i);
+    for (name = names; *name != NULL && dir != NULL; name++) {
+        if (**name == '\0')
+            continue;
 
-            /* Start from the beginning: this appears to be a limitation
-             * of g_slist */
-            i = directories;
-        }
+        child = g_hash_table_lookup(dir->children, *name);
+
+        if (child == NULL && create)
+            child = dir_new(dir, *name);
+
+        dir = child;
     }
 
-    return directories;
+    g_strfreev(names);
+
+    return dir;
 }
 
-static void recalculate_directories(gconf_plugin *plugin)
+static void watch_dir(gconf_plugin *plugin, gconf_dir *dir)
 {
+    gconf_client_add_dir(plugin->client, dir->path, GCONF_CLIENT_PRELOAD_NONE, NULL);
+    dir->watched = TRUE;
+    OHM_DEBUG(DBG_GCONF, "Add dir '%s' to be listened", dir->path);
+}
 
-    GSList *new_dirs = NULL, *e = NULL, *f = NULL;
+static void unwatch_dir(gconf_plugin *plugin, gconf_dir *dir)
+{
+    gconf_client_remove_dir(plugin->client, dir->path, NULL);
+    dir->watched = FALSE;
+    OHM_DEBUG(DBG_GCONF, "Remove dir '%s' from being listened", dir->path);
+}
 
-    new_dirs = listened_directories(plugin->observers);
+static void watch_topmost_below(gconf_plugin *plugin, gconf_dir *dir)
+{
+    /* subscribe to the topmost directories with keys below dir */
+    GHashTableIter it;
+    gpointer name, child;
 
-    /* Calculate the difference between the original listened
-     * directories and the new ones. By first subscribing to new
-     * directories and then unsubscribing from old directories, we hope
-     * to remove the risk of a race condition when a key is changed
-     * before the new subscribtions. The API says that there can't be
-     * overlapping directories subscribed, though, but this appears to
-     * work. */
+    g_hash_table_iter_init(&it, dir->children);
 
-    /* first subscribe to new ones */
+    while (g_hash_table_iter_next(&it, &name, &child)) {
+        gconf_dir *d = child;
 
-    for (e = new_dirs; e != NULL; e = g_slist_next(e)) {
-        gboolean found = FALSE;
-        for (f = plugin->watched_dirs; f != NULL; f = g_slist_next(f)) {
-            if (strcmp((gchar *) f->data, (gchar *) e->data) == 0) {
-                found = TRUE;
-                break;
-            }
-        }
-        if (!found) {
-            gconf_client_add_dir(plugin->client, e->data, GCONF_CLIENT_PRELOAD_NONE, NULL);
-            OHM_DEBUG(DBG_GCONF, "Add dir '%s' to be listened", (gchar *) e->data);
-        }
+        if (d->nkey > 0)
+            watch_dir(plugin, d);
+        else if (d->nbelow > 0)
+            watch_topmost_below(plugin, d);
     }
+}
+
+static void unwatch_all_below(gconf_plugin *plugin, gconf_dir *dir)
+{
+    /* unsubscribe from the directories below dir */
+    GHashTableIter it;
+    gpointer name, child;
 
-    /* then unsubscribe from old ones */
+    g_hash_table_iter_init(&it, dir->children);
 
-    for (e = plugin->watched_dirs; e != NULL; e = g_slist_next(e)) {
-        gboolean found = FALSE;
-        for (f = new_dirs; f != NULL; f = g_slist_next(f)) {
-            if (strcmp((gchar *) f->data, (gchar *) e->data) == 0) {
-                found = TRUE;
-                break;
-            }
-        }
-        if (!found) {
-            gconf_client_remove_dir(plugin->client, e->data, NULL);
-            OHM_DEBUG(DBG_GCONF, "Remove dir '%s' from being listened", (gchar *) e->data);
-        }
-        g_free(e->data);
+    while (g_hash_table_iter_next(&it, &name, &child)) {
+        gconf_dir *d = child;
+
+        if (d->watched)
+            unwatch_dir(plugin, d);
+        else if (d->nbelow > 0)
+            unwatch_all_below(plugin, d);
     }
+}
 
-    g_slist_free(plugin->watched_dirs);
-    plugin->watched_dirs = new_dirs;
+static void add_key_directory(gconf_plugin *plugin, const gchar *key)
+{
+    gchar *path = get_directory_from_key(key);
+    gconf_dir *dir, *d;
+    gboolean covered = FALSE;
 
-    return;
+    if (path == NULL)
+        return;
+
+    dir = dir_lookup(plugin, path, TRUE);
+    free(path);
+
+    for (d = dir; d != NULL; d = d->parent) {
+        d->nbelow++;
+        if (d != dir && d->nkey > 0)
+            covered = TRUE;
+    }
+
+    dir->nkey++;
+
+    /* By first subscribing to the new directory and then unsubscribing
+     * from the ones it covers, we hope to remove the risk of a race
+     * condition when a key is changed before the new subscribtions. The
+     * API says that there can't be overlapping directories subscribed,
+     * though, but this appears to work. */
+
+    if (!covered && !dir->watched) {
+        watch_dir(plugin, dir);
+        unwatch_all_below(plugin, dir);
+    }
+}
+
+static void remove_key_directory(gconf_plugin *plugin, const gchar *key)
+{
+    gchar *path = get_directory_from_key(key);
+    gconf_dir *dir, *d, *parent;
+
+    if (path == NULL)
+        return;
+
+    dir = dir_lookup(plugin, path, FALSE);
+    free(path);
+
+    if (dir == NULL || dir->nkey <= 0)
+        return;
+
+    for (d = dir; d != NULL; d = d->parent)
+        d->nbelow--;
+
+    dir->nkey--;
+
+    if (dir->nkey == 0 && dir->watched) {
+        watch_topmost_below(plugin, dir);
+        unwatch_dir(plugin, dir);
+    }
+
+    /* prune the branch if it has no more keys */
+    while (dir->parent != NULL && dir->nbelow == 0) {
+        parent = dir->parent;
+        g_hash_table_remove(parent->children, strrchr(dir->path, '/') + 1);
+        dir_free(dir);
+        dir = parent;
+    }
+}
+
+static void free_directories(gconf_plugin *plugin, gconf_dir *dir)
+{
+    GHashTableIter it;
+    gpointer name, child;
+
+    g_hash_table_iter_init(&it, dir->children);
+
+    while (g_hash_table_iter_next(&it, &name, &child))
+        free_directories(plugin, child);
+
+    if (dir->watched)
+        unwatch_dir(plugin, dir);
+
+    dir_free(dir);
 }
 
 void deinit_gconf(gconf_plugin *plugin)
 {
-    GSList *e = NULL, *list;
+    GHashTableIter it;
+    gpointer key, value;
     
     /* free the observers */
 
-    for (e = plugin->observers; e != NULL; e = g_slist_next(e)) {
-        observer *obs = e->data;
+    g_hash_table_iter_init(&it, plugin->observers);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        observer *obs = value;
         free_observer(obs);
     }
 
-    /* free the facts */
+    g_hash_table_destroy(plugin->observers);
+    plugin->observers = NULL;
 
-    list = ohm_fact_store_get_facts_by_name(plugin->fs, GCONF_FACT);
+    /* free the facts */
 
-    while (list) {
-        
-        OhmFact *fact = (OhmFact *) list->data;
+    g_hash_table_iter_init(&it, plugin->facts);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        OhmFact *fact = (OhmFact *) value;
         ohm_fact_store_remove(plugin->fs, fact);
-        g_object_unref(fact);
-
-        list = ohm_fact_store_get_facts_by_name(plugin->fs, GCONF_FACT);
-
     }
 
-    g_slist_free(plugin->observers);
-    plugin->observers = NULL;
+    g_hash_table_destroy(plugin->facts);
+    plugin->facts = NULL;
 
     /* stop watching all the directories that were being watched */
-    for (e = plugin->watched_dirs; e != NULL; e = g_slist_next(e)) {
-        gconf_client_remove_dir(plugin->client, e->data, NULL);
-        g_free(e->data);
+    if (plugin->dirs) {
+        free_directories(plugin, plugin->dirs);
+        plugin->dirs = NULL;
     }
-    g_slist_free(plugin->watched_dirs);
 
     g_object_unref(plugin->client);
     g_free(plugin);
@@ -396,19 +461,15 @@ void deinit_gconf(gconf_plugin *plugin)
 
 gboolean observe(gconf_plugin *plugin, const gchar *key)
 {
-    GSList *e = NULL;
     observer *obs = NULL;
     GConfEntry *entry = NULL;
 
     
     /* see if we are already observing the key */
 
-    for (e = plugin->observers; e != NULL; e = g_slist_next(e)) {
-        obs = e->data;
-        if (!strcmp(key, obs->key)) {
-            obs->refcount++;
-            return TRUE;
-        }
+    if ((obs = g_hash_table_lookup(plugin->observers, key)) != NULL) {
+        obs->refcount++;
+        return TRUE;
     }
     
     /* create the initial fact */
@@ -434,11 +495,11 @@ gboolean observe(gconf_plugin *plugin, const gchar *key)
     obs->key = g_strdup(key);
     obs->refcount = 1;
 
-    plugin->observers = g_slist_prepend(plugin->observers, obs);
+    g_hash_table_insert(plugin->observers, obs->key, obs);
 
-    /* recalculate the watched directory set: this enables the key
+    /* update the watched directory set: this enables the key
      * notification */
-    recalculate_directories(plugin);
+    add_key_directory(plugin, key);
 
     obs->notify = gconf_client_notify_add(plugin->client, key, notify, plugin, NULL, NULL);
     OHM_DEBUG(DBG_GCONF, "Requested notify for key '%s (id %u)'\n", key, obs->notify);
@@ -449,53 +510,40 @@ gboolean observe(gconf_plugin *plugin, const gchar *key)
 
 gboolean unobserve(gconf_plugin *plugin, const gchar *key)
 {
-    GSList *e = NULL, *f = NULL, *list = NULL;
     observer *obs = NULL;
-    gboolean ret = FALSE;
+    OhmFact *fact = NULL;
 
     /* remove observers */
 
-    for (e = plugin->observers; e != NULL; e = g_slist_next(e)) {
-        obs = e->data;
-        if (!strcmp(key, obs->key)) {
-            obs->refcount--;
-            if (obs->refcount == 0) {
+    if ((obs = g_hash_table_lookup(plugin->observers, key)) == NULL)
+        return FALSE;
+
+    obs->refcount--;
+    if (obs->refcount == 0) {
                 
-                /* stop listening to the key */
+        /* stop listening to the key */
 
-                gconf_client_notify_remove(plugin->client, obs->notify);
+        gconf_client_notify_remove(plugin->client, obs->notify);
 
-                /* remove the observer */
+        /* remove the observer */
                 
-                plugin->observers = g_slist_delete_link(plugin->observers, e);
+        g_hash_table_remove(plugin->observers, obs->key);
 
-                /* remove the fact from the FS that was observed */
+        /* remove the fact from the FS that was observed */
 
-                list = ohm_fact_store_get_facts_by_name(plugin->fs, GCONF_FACT);
-                
-                for (f = list; f != NULL; f = g_slist_next(f)) {
-                    OhmFact *fact = (OhmFact *) f->data;
-                    GValue *gval = ohm_fact_get(fact, "key");
-
-                    if (gval && !strcmp(obs->key, g_value_get_string(gval))) {
-                        ohm_fact_store_remove(plugin->fs, fact);
-                        g_object_unref(fact);
-                        break;
-                    }
-                }
-
-                /* recalculate the watched directory set */
-                recalculate_directories(plugin);
-
-                free_observer(obs);
-                obs = NULL;
-            }
-            ret = TRUE;
-            break;
+        if ((fact = g_hash_table_lookup(plugin->facts, obs->key)) != NULL) {
+            ohm_fact_store_remove(plugin->fs, fact);
+            g_hash_table_remove(plugin->facts, obs->key);
         }
+
+        /* update the watched directory set */
+        remove_key_directory(plugin, obs->key);
+
+        free_observer(obs);
+        obs = NULL;
     }
     
-    return ret;
+    return TRUE;
 }
 
 /*
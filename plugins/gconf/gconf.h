@@ -57,10 +57,13 @@ USA.
 
 typedef gboolean (*hal_cb) (OhmFact *hal_fact, gchar *capability, gboolean added, gboolean removed, void *user_data);
 
+typedef struct _gconf_dir gconf_dir;
+
 typedef struct _gconf_plugin {
     guint notify;
-    GSList *observers;
-    GSList *watched_dirs;
+    GHashTable *observers;  /* key -> observer */
+    GHashTable *facts;      /* key -> fact */
+    gconf_dir *dirs;        /* directory tree of the observed keys */
     OhmFactStore *fs;
     GConfClient *client;
 } gconf_plugin;
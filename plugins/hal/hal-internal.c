@@ -39,16 +39,20 @@ static int DBG_HAL, DBG_FACTS;
 
 /* this uses libhal (for now) */
 
-typedef struct _hal_modified_property {
+/* state of a modified key, latest modification wins */
+#define KEY_MODIFIED GINT_TO_POINTER(1)
+#define KEY_REMOVED  GINT_TO_POINTER(2)
+
+typedef struct _hal_modified_device {
     char *udi;
-    char *key;
-    dbus_bool_t is_removed;
-    dbus_bool_t is_added;
-} hal_modified_property;
+    GHashTable *keys;   /* key -> KEY_MODIFIED or KEY_REMOVED */
+    guint n_changes;    /* number of change notifications coalesced */
+} hal_modified_device;
 
 typedef struct _decorator {
     gchar *capability;
     GSList *devices;
+    GHashTable *facts;  /* udi -> last fact passed to cb */
     hal_cb cb;
     void *user_data;
 } decorator;
@@ -190,6 +194,63 @@ static gboolean has_udi(decorator *dec, const gchar *udi)
     return FALSE;
 }
 
+static GValue * property_value(LibHalPropertySetIterator *iter)
+{
+    /* Convert the HAL property at the iterator to a fact field value */
+
+    LibHalPropertyType type = libhal_psi_get_type(iter);
+    GValue *val = NULL;
+
+    OHM_DEBUG(DBG_HAL, "key: '%s', ", libhal_psi_get_key(iter));
+
+    /* Not good to duplicate the switch, consider strategy pattern. Still,
+     * it is a good idea to fetch the properties only once. */
+    switch (type) {
+        case LIBHAL_PROPERTY_TYPE_INT32:
+            {
+                dbus_int32_t hal_value = libhal_psi_get_int(iter);
+                val = ohm_value_from_int(hal_value);
+                OHM_DEBUG(DBG_HAL, "int: '%i'", hal_value);
+                break;
+            }
+        case LIBHAL_PROPERTY_TYPE_STRING:
+            {
+                /* freed with propertyset */
+                char *hal_value = libhal_psi_get_string(iter);
+                val = ohm_value_from_string(hal_value);
+                OHM_DEBUG(DBG_HAL, "string: '%s'", hal_value);
+                break;
+            }
+        case LIBHAL_PROPERTY_TYPE_STRLIST:
+            {
+#define STRING_DELIMITER "\\"
+                /* freed with propertyset */
+                char **strlist = libhal_psi_get_strlist(iter);
+                gchar *escaped_string = g_strjoinv(STRING_DELIMITER, strlist);
+                val = ohm_value_from_string(escaped_string);
+                OHM_DEBUG(DBG_HAL, "escaped string: '%s'", escaped_string);
+                g_free(escaped_string);
+                break;
+#undef STRING_DELIMITER
+            }
+        case LIBHAL_PROPERTY_TYPE_BOOLEAN:
+            {
+                dbus_bool_t hal_value = libhal_psi_get_bool(iter);
+                int intval = (hal_value == TRUE) ? 1 : 0;
+                val = ohm_value_from_int(intval);
+                OHM_DEBUG(DBG_HAL, "boolean: '%s'", (hal_value == TRUE) ? "TRUE" : "FALSE");
+                break;
+            }
+        default:
+            OHM_DEBUG(DBG_HAL, "error with value (%i)", type);
+            /* error case, currently means that FactStore doesn't
+             * support the type yet */
+            break;
+    }
+
+    return val;
+}
+
 static OhmFact * create_fact(hal_plugin *plugin, const char *udi,
         const char *capability, LibHalPropertySet *properties)
 {
@@ -224,62 +285,42 @@ static OhmFact * create_fact(hal_plugin *plugin, const char *udi,
     len = libhal_property_set_get_num_elems(properties);
 
     for (i = 0; i < len; i++, libhal_psi_next(&iter)) {
-        char *key = libhal_psi_get_key(&iter);
-        LibHalPropertyType type = libhal_psi_get_type(&iter);
-        val = NULL;
-
-        OHM_DEBUG(DBG_HAL, "key: '%s', ", key);
-        /* Not good to duplicate the switch, consider strategy pattern. Still,
-         * it is a good idea to fetch the properties only once. */
-        switch (type) {
-            case LIBHAL_PROPERTY_TYPE_INT32:
-                {
-                    dbus_int32_t hal_value = libhal_psi_get_int(&iter);
-                    val = ohm_value_from_int(hal_value);
-                    OHM_DEBUG(DBG_HAL, "int: '%i'", hal_value);
-                    break;
-                }
-            case LIBHAL_PROPERTY_TYPE_STRING:
-                {
-                    /* freed with propertyset */
-                    char *hal_value = libhal_psi_get_string(&iter);
-                    val = ohm_value_from_string(hal_value);
-                    OHM_DEBUG(DBG_HAL, "string: '%s'", hal_value);
-                    break;
-                }
-            case LIBHAL_PROPERTY_TYPE_STRLIST:
-                {
-#define STRING_DELIMITER "\\"
-                    /* freed with propertyset */
-                    char **strlist = libhal_psi_get_strlist(&iter);
-                    gchar *escaped_string = g_strjoinv(STRING_DELIMITER, strlist);
-                    val = ohm_value_from_string(escaped_string);
-                    OHM_DEBUG(DBG_HAL, "escaped string: '%s'", escaped_string);
-                    g_free(escaped_string);
-                    break;
-#undef STRING_DELIMITER
-                }
-            case LIBHAL_PROPERTY_TYPE_BOOLEAN:
-                {
-                    dbus_bool_t hal_value = libhal_psi_get_bool(&iter);
-                    int intval = (hal_value == TRUE) ? 1 : 0;
-                    val = ohm_value_from_int(intval);
-                    OHM_DEBUG(DBG_HAL, "boolean: '%s'", (hal_value == TRUE) ? "TRUE" : "FALSE");
-                    break;
-                }
-            default:
-                OHM_DEBUG(DBG_HAL, "error with value (%i)", type);
-                /* error case, currently means that FactStore doesn't
-                 * support the type yet */
-                break;
+        if ((val = property_value(&iter)) != NULL) {
+            ohm_fact_set(fact, libhal_psi_get_key(&iter), val);
         }
+    }
 
-        if (val) {
-            ohm_fact_set(fact, key, val);
+    return fact;
+}
+
+static void update_fact(OhmFact *fact, GHashTable *keys,
+        LibHalPropertySet *properties)
+{
+    /* Apply only the modified keys of a HAL object to its existing fact */
+
+    LibHalPropertySetIterator iter;
+    GHashTableIter k;
+    gpointer key, state;
+    GValue *val;
+    int i, len;
+
+    libhal_psi_init(&iter, properties);
+    len = libhal_property_set_get_num_elems(properties);
+
+    for (i = 0; i < len; i++, libhal_psi_next(&iter)) {
+        if (g_hash_table_lookup(keys, libhal_psi_get_key(&iter)) == KEY_MODIFIED &&
+            (val = property_value(&iter)) != NULL) {
+            ohm_fact_set(fact, libhal_psi_get_key(&iter), val);
         }
     }
 
-    return fact;
+    g_hash_table_iter_init(&k, keys);
+    while (g_hash_table_iter_next(&k, &key, &state)) {
+        if (state == KEY_REMOVED) {
+            OHM_DEBUG(DBG_HAL, "removed key: '%s'", (char *) key);
+            ohm_fact_del(fact, key);
+        }
+    }
 }
 
 
@@ -312,8 +353,15 @@ static gboolean process_decoration(hal_plugin *plugin, decorator *dec,
 
         fact = create_fact(plugin, udi, dec->capability, properties);
         dec->cb(fact, dec->capability, added, removed, dec->user_data);
-        if (fact)
-            g_object_unref(fact);
+
+        /* remember the fact for applying later property changes to it */
+        if (fact && !removed)
+            g_hash_table_replace(dec->facts, g_strdup(udi), fact);
+        else {
+            g_hash_table_remove(dec->facts, udi);
+            if (fact)
+                g_object_unref(fact);
+        }
         libhal_free_property_set(properties);
     }
 
@@ -479,6 +527,7 @@ static void hal_device_removed_cb (LibHalContext *ctx, const char *udi)
     for (e = plugin->decorators; e != NULL; e = g_slist_next(e)) {
         decorator *dec = e->data;
         if (has_udi(dec, udi)) {
+            g_hash_table_remove(dec->facts, udi);
             orig = g_slist_find_custom(dec->devices, udi, strcmp);
             if (orig) {
                 dec->devices = g_slist_remove_link(dec->devices, orig);
@@ -497,27 +546,78 @@ static void hal_device_removed_cb (LibHalContext *ctx, const char *udi)
     return;
 }
 
+static void free_modified_device(hal_modified_device *device)
+{
+    g_hash_table_destroy(device->keys);
+    g_free(device->udi);
+    g_free(device);
+}
+
+static void process_modified_device(hal_plugin *plugin,
+        hal_modified_device *device)
+{
+    /* Fetch the properties of a modified HAL object once and update the
+     * facts of all decorators interested in it. */
+
+    LibHalPropertySet *properties = NULL;
+    gboolean fetched = FALSE;
+    DBusError error;
+    OhmFact *fact;
+    GSList *e;
+
+    OHM_DEBUG(DBG_FACTS, "udi '%s': %u changes to %u keys\n", device->udi,
+              device->n_changes, g_hash_table_size(device->keys));
+
+    for (e = plugin->decorators; e != NULL; e = g_slist_next(e)) {
+        decorator *dec = e->data;
+
+        if (!has_udi(dec, device->udi))
+            continue;
+
+        if (!fetched) {
+            dbus_error_init(&error);
+            properties = libhal_device_get_all_properties(plugin->hal_ctx,
+                    device->udi, &error);
+
+            if (dbus_error_is_set(&error)) {
+                g_print("Error getting data for HAL object %s. '%s': '%s'\n",
+                        device->udi, error.name, error.message);
+                dbus_error_free(&error);
+                return;
+            }
+            fetched = TRUE;
+        }
+
+        if ((fact = g_hash_table_lookup(dec->facts, device->udi)) != NULL) {
+            update_fact(fact, device->keys, properties);
+            dec->cb(fact, dec->capability, FALSE, FALSE, dec->user_data);
+        }
+        else {
+            fact = create_fact(plugin, device->udi, dec->capability, properties);
+            dec->cb(fact, dec->capability, FALSE, FALSE, dec->user_data);
+            if (fact)
+                g_hash_table_replace(dec->facts, g_strdup(device->udi), fact);
+        }
+    }
+
+    libhal_free_property_set(properties);
+}
+
 static gboolean process_modified_properties(gpointer data)
 {
     hal_plugin *plugin = (hal_plugin *) data;
-    GSList *e = NULL;
+    hal_modified_device *device;
 
     OHM_DEBUG(DBG_FACTS, "> process_modified_properties\n");
 
-    for (e = plugin->modified_properties; e != NULL; e = g_slist_next(e)) {
+    plugin->modified_idle = 0;
 
-        hal_modified_property *modified_property = e->data;
-        process_udi(plugin, FALSE, FALSE, modified_property->udi);
-
-        g_free(modified_property->udi);
-        g_free(modified_property->key);
-        g_free(modified_property);
-        e->data = NULL;
+    while ((device = g_queue_pop_head(plugin->modified_queue)) != NULL) {
+        g_hash_table_remove(plugin->modified_devices, device->udi);
+        process_modified_device(plugin, device);
+        free_modified_device(device);
     }
 
-    g_slist_free(plugin->modified_properties);
-    plugin->modified_properties = NULL;
-
     /* do not call again */
     return FALSE;
 }
@@ -531,9 +631,11 @@ static void hal_property_modified_cb (LibHalContext *ctx,
 
     /* This function is called several times when a signal that contains
      * information of multiple HAL property modifications arrives.
-     * Schedule a delayed processing of data in the idle loop. */
+     * Schedule a delayed processing of data in the idle loop. Changes
+     * are collected per UDI, so each modified device is refreshed only
+     * once no matter how many of its keys changed. */
 
-    hal_modified_property *modified_property = NULL;
+    hal_modified_device *device = NULL;
     hal_plugin *plugin = (hal_plugin *) libhal_ctx_get_user_data(ctx);
 
     OHM_DEBUG(DBG_FACTS,"> hal_property_modified_cb: udi '%s', key '%s', %s, %s\n",
@@ -541,20 +643,26 @@ static void hal_property_modified_cb (LibHalContext *ctx,
               is_removed ? "removed" : "not removed",
               is_added ? "added" : "not added");
 
-    if (!plugin->modified_properties) {
-        g_idle_add(process_modified_properties, plugin);
+    if (!plugin->modified_idle) {
+        plugin->modified_idle = g_idle_add(process_modified_properties, plugin);
     }
 
-    modified_property = g_new0(hal_modified_property, 1);
-    
-    modified_property->udi = g_strdup(udi);
-    modified_property->key = g_strdup(key);
-    modified_property->is_removed = is_removed;
-    modified_property->is_added = is_added;
+    device = g_hash_table_lookup(plugin->modified_devices, udi);
+
+    if (!device) {
+        device = g_new0(hal_modified_device, 1);
+        device->udi = g_strdup(udi);
+        device->keys = g_hash_table_new_full(g_str_hash, g_str_equal,
+                g_free, NULL);
+
+        g_hash_table_insert(plugin->modified_devices, device->udi, device);
+        /* devices are processed in the order of their first change */
+        g_queue_push_tail(plugin->modified_queue, device);
+    }
 
-    /* keep the order (even if O(n)) :-P */
-    plugin->modified_properties = g_slist_append(plugin->modified_properties,
-            modified_property);
+    g_hash_table_replace(device->keys, g_strdup(key),
+            is_removed ? KEY_REMOVED : KEY_MODIFIED);
+    device->n_changes++;
 
     return;
 }
@@ -608,6 +716,8 @@ gboolean decorate(hal_plugin *plugin, const gchar *capability, hal_cb cb, void *
     dec->cb = cb;
     dec->user_data = user_data;
     dec->capability = g_strdup(capability);
+    dec->facts = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_object_unref);
 
     if (!fill_decorator(plugin, dec))
         goto error;
@@ -631,6 +741,8 @@ static void free_decorator(decorator *dec) {
         g_free(f->data);
     }
     g_slist_free(dec->devices);
+    if (dec->facts)
+        g_hash_table_destroy(dec->facts);
     g_free(dec);
 
 }
@@ -769,7 +881,12 @@ hal_plugin * init_hal(DBusConnection *c, int flag_hal, int flag_facts)
         return NULL;
     }
 
+    plugin->modified_devices = g_hash_table_new(g_str_hash, g_str_equal);
+    plugin->modified_queue = g_queue_new();
+
     if (!new_hal_context(c, plugin)) {
+        g_hash_table_destroy(plugin->modified_devices);
+        g_queue_free(plugin->modified_queue);
         g_free(plugin);
         return NULL;
     }
@@ -780,6 +897,7 @@ hal_plugin * init_hal(DBusConnection *c, int flag_hal, int flag_facts)
 
 void deinit_hal(hal_plugin *plugin)
 {
+    hal_modified_device *device;
     GSList *e = NULL;
 
     for (e = plugin->decorators; e != NULL; e = g_slist_next(e)) {
@@ -790,6 +908,15 @@ void deinit_hal(hal_plugin *plugin)
     g_slist_free(plugin->decorators);
     plugin->decorators = NULL;
 
+    if (plugin->modified_idle)
+        g_source_remove(plugin->modified_idle);
+
+    while ((device = g_queue_pop_head(plugin->modified_queue)) != NULL)
+        free_modified_device(device);
+
+    g_queue_free(plugin->modified_queue);
+    g_hash_table_destroy(plugin->modified_devices);
+
     delete_hal_context(plugin);
 
     g_free(plugin);
@@ -55,7 +55,9 @@ typedef gboolean (*hal_cb) (OhmFact *hal_fact, gchar *capability, gboolean added
 typedef struct _hal_plugin {
     LibHalContext *hal_ctx;
     DBusConnection *c;
-    GSList *modified_properties;
+    GHashTable *modified_devices; /* udi -> pending property changes */
+    GQueue *modified_queue;       /* modified devices in arrival order */
+    guint modified_idle;          /* idle source processing the changes */
     GSList *decorators;
     GSList *watched;
     /* GSList *all_devices; */
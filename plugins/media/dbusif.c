@@ -46,17 +46,43 @@ typedef enum {
     session_bus
 } bus_type_t;
 
+typedef enum {
+    signal_other = 0,
+    signal_privacy,
+    signal_bluetooth,
+    signal_mute,
+    signal_max
+} signal_kind_t;
+
 typedef struct msg_queue_s {
     struct msg_queue_s *next;
     bus_type_t          bus;
+    signal_kind_t       kind;
     DBusMessage        *msg;
 } msg_queue_t;
 
+typedef struct stream_info_s {
+    struct stream_info_s *next;
+    char                 *oper;
+    char                 *group;
+    dbus_uint32_t         pid;
+    char                 *prop;
+    char                 *method;
+    char                 *arg;
+} stream_info_t;
+
 
 static DBusConnection    *sys_conn;      /* connection for D-Bus system bus */
 static DBusConnection    *sess_conn;     /* connection for D-Bus session bus */
 static int                timeout;       /* message timeout in msec */
 static msg_queue_t       *msg_que;       /* queued messages */
+static msg_queue_t       *msg_tail;      /* last queued message */
+static msg_queue_t       *msg_kind[signal_max]; /* queued signal per kind */
+static stream_info_t     *si_que;        /* pending stream info signals */
+static stream_info_t     *si_tail;       /* last pending stream info */
+static guint              si_flush;      /* idle source to send them */
+static unsigned int       nqueued;       /* number of queued signals */
+static unsigned int       ncoalesced;    /* superseded queued signals */
 
 static void system_bus_init(void);
 static void session_bus_init(const char *);
@@ -71,11 +97,16 @@ static DBusMessage *bluetooth_get_message(DBusMessage *);
 static DBusMessage *mute_req_message( DBusMessage *);
 static DBusMessage *mute_get_message(DBusMessage *);
 
-static void send_message(bus_type_t, DBusMessage *, int);
-static void queue_message(bus_type_t, DBusMessage *);
+static void send_message(bus_type_t, signal_kind_t, DBusMessage *, int);
+static void queue_message(bus_type_t, signal_kind_t, DBusMessage *);
+static void queue_unlink(msg_queue_t *);
 static void queue_flush(void);
 static void queue_purge(bus_type_t);
 
+static int  stream_info_cancel(stream_info_t *);
+static void stream_info_free(stream_info_t *);
+static gboolean stream_info_flush(gpointer);
+
 
 /*! \addtogroup pubif
  *  Functions
@@ -114,6 +145,22 @@ void dbusif_init(OhmPlugin *plugin)
 }
 
 
+void dbusif_exit(OhmPlugin *plugin)
+{
+    (void)plugin;
+
+    if (si_flush != 0) {
+        g_source_remove(si_flush);
+        stream_info_flush(NULL);
+    }
+
+    queue_purge(system_bus);
+    queue_purge(session_bus);
+
+    OHM_INFO("media: %u signals queued, %u coalesced", nqueued, ncoalesced);
+}
+
+
 DBusHandlerResult dbusif_session_notification(DBusConnection *conn,
                                               DBusMessage    *msg,
                                               void           *ud)
@@ -180,7 +227,7 @@ void dbusif_signal_privacy_override(int value, int send_now)
                                            DBUS_TYPE_INVALID);
 
         if (success)
-            send_message(session_bus, msg, send_now);
+            send_message(session_bus, signal_privacy, msg, send_now);
         else
             OHM_ERROR("media [%s]: failed to build message", __FUNCTION__);
     }
@@ -206,7 +253,7 @@ void dbusif_signal_bluetooth_override(int value, int send_now)
                                             DBUS_TYPE_INVALID);
 
         if (success)
-            send_message(session_bus, msg, send_now);
+            send_message(session_bus, signal_bluetooth, msg, send_now);
         else
             OHM_ERROR("media [%s]: failed to build message", __FUNCTION__);
     }
@@ -232,7 +279,7 @@ void dbusif_signal_mute(int value, int send_now)
                                            DBUS_TYPE_INVALID);
 
         if (success)
-            send_message(session_bus, msg, send_now);
+            send_message(session_bus, signal_mute, msg, send_now);
         else
             OHM_ERROR("media [%s]: failed to build message", __FUNCTION__);
     }
@@ -245,10 +292,7 @@ void dbusif_send_audio_stream_info(char          *oper,
                                    char          *method,
                                    char          *arg)
 {
-    static dbus_uint32_t  txid = 1;
-
-    DBusMessage          *msg;
-    int                   success;
+    stream_info_t        *si;
 
     if (!oper || !group || !pid)
         return;
@@ -262,40 +306,51 @@ void dbusif_send_audio_stream_info(char          *oper,
     if (!arg)
         arg = "";
 
-    msg = dbus_message_new_signal(DBUS_POLICY_DECISION_PATH,
-                                  DBUS_POLICY_DECISION_INTERFACE,
-                                  DBUS_STREAM_INFO_SIGNAL);
+    /*
+     * Notes: stream (un)registrations tend to come in bursts while the
+     *   policy is re-evaluated. Instead of sending each of them right
+     *   away we collect them and send the whole batch from an idle
+     *   callback. A registration that is undone within the same batch
+     *   is dropped altogether.
+     */
 
-    if (msg == NULL) {
-        OHM_ERROR("media: failed to create stream info signal");
+    if ((si = malloc(sizeof(*si))) == NULL) {
+        OHM_ERROR("media: can't get memory for stream info");
         return;
     }
 
-    success = dbus_message_append_args(msg,
-                                       DBUS_TYPE_UINT32, &txid,
-                                       DBUS_TYPE_STRING, &oper,
-                                       DBUS_TYPE_STRING, &group,
-                                       DBUS_TYPE_UINT32, &pid,
-                                       DBUS_TYPE_STRING, &arg,
-                                       DBUS_TYPE_STRING, &method,
-                                       DBUS_TYPE_STRING, &prop,
-                                       DBUS_TYPE_INVALID);
-    if (!success) {
-        OHM_ERROR("media: failed to build stream info message");
+    memset(si, 0, sizeof(*si));
+    si->oper   = strdup(oper);
+    si->group  = strdup(group);
+    si->pid    = pid;
+    si->prop   = strdup(prop);
+    si->method = strdup(method);
+    si->arg    = strdup(arg);
+
+    if (!si->oper || !si->group || !si->prop || !si->method || !si->arg) {
+        OHM_ERROR("media: can't get memory for stream info");
+        stream_info_free(si);
         return;
     }
 
-    success = dbus_connection_send(sys_conn, msg, NULL);
-
-    if (!success)
-        OHM_ERROR("media: failed to send stream info message");
-    else {
-        OHM_DEBUG(DBG_DBUS, "operation='%s' group='%s' pid=%u property='%s' "
-                  "method='%s' arg='%s'", oper, group, pid, prop, method, arg);
-        txid++;
+    if (stream_info_cancel(si)) {
+        OHM_DEBUG(DBG_DBUS, "stream info for group '%s' pid=%u cancelled",
+                  group, pid);
+        stream_info_free(si);
+        ncoalesced++;
+        return;
     }
 
-    dbus_message_unref(msg);
+    if (si_tail != NULL)
+        si_tail->next = si;
+    else
+        si_que = si;
+
+    si_tail = si;
+    nqueued++;
+
+    if (si_flush == 0)
+        si_flush = g_idle_add(stream_info_flush, NULL);
 }
 
 
@@ -430,7 +485,7 @@ static void session_bus_cleanup(void)
         dbus_connection_unregister_object_path(sess_conn,
                                                DBUS_MEDIA_MANAGER_PATH);
         
-        queue_purge(DBUS_BUS_SESSION);
+        queue_purge(session_bus);
         
         dbus_connection_unref(sess_conn);
         sess_conn = NULL;
@@ -709,13 +764,20 @@ static DBusMessage *mute_get_message(DBusMessage *msg)
     return reply;    
 }
 
-static void send_message(bus_type_t bus, DBusMessage *msg, int send_now)
+static void send_message(bus_type_t bus, signal_kind_t kind,
+                         DBusMessage *msg, int send_now)
 {
     DBusConnection *conn;
 
     if (!send_now)
-        queue_message(bus, msg);
+        queue_message(bus, kind, msg);
     else {
+        /* a queued signal of the same kind would be stale by now */
+        if (kind != signal_other && msg_kind[kind] != NULL) {
+            queue_unlink(msg_kind[kind]);
+            ncoalesced++;
+        }
+
         switch (bus) {
         case system_bus:   conn = sys_conn;    break;
         case session_bus:  conn = sess_conn;   break;
@@ -733,61 +795,209 @@ static void send_message(bus_type_t bus, DBusMessage *msg, int send_now)
     }
 }
 
-static void queue_message(bus_type_t bus, DBusMessage *msg)
+static void queue_message(bus_type_t bus, signal_kind_t kind,
+                          DBusMessage *msg)
 {
-    msg_queue_t *entry, *last;
+    msg_queue_t *entry;
+
+    /* only the latest value of an override/mute signal is of interest */
+    if (kind != signal_other && (entry = msg_kind[kind]) != NULL) {
+        OHM_DEBUG(DBG_DBUS, "coalescing queued '%s' signal",
+                  dbus_message_get_member(msg));
 
-    for (last = (msg_queue_t *)&msg_que;  last->next;   last = last->next)
-        ;
+        dbus_message_unref(entry->msg);
+        entry->bus = bus;
+        entry->msg = msg;
+
+        ncoalesced++;
+        return;
+    }
 
-    if ((entry = malloc(sizeof(msg_queue_t))) == NULL)
+    if ((entry = malloc(sizeof(msg_queue_t))) == NULL) {
         OHM_ERROR("media: can't get memory to queue D-Bus message");
+        dbus_message_unref(msg);
+    }
     else {
         memset(entry, 0, sizeof(msg_queue_t));
-        entry->bus = bus;
-        entry->msg = msg;
+        entry->bus  = bus;
+        entry->kind = kind;
+        entry->msg  = msg;
+
+        if (msg_tail != NULL)
+            msg_tail->next = entry;
+        else
+            msg_que = entry;
 
-        last->next = entry;
+        msg_tail = entry;
+
+        if (kind != signal_other)
+            msg_kind[kind] = entry;
+
+        nqueued++;
     }
 }
 
+static void queue_unlink(msg_queue_t *entry)
+{
+    msg_queue_t *prev;
+
+    if (entry == msg_que)
+        prev = NULL;
+    else {
+        for (prev = msg_que;  prev && prev->next != entry;  prev = prev->next)
+            ;
+        if (prev == NULL)
+            return;
+    }
+
+    if (prev != NULL)
+        prev->next = entry->next;
+    else
+        msg_que = entry->next;
+
+    if (entry == msg_tail)
+        msg_tail = prev;
+
+    if (msg_kind[entry->kind] == entry)
+        msg_kind[entry->kind] = NULL;
+
+    dbus_message_unref(entry->msg);
+    free(entry);
+}
+
 static void queue_flush(void)
 {
     msg_queue_t *entry, *next;
 
-    for (entry = msg_que;   entry;   entry = next) {
+    entry    = msg_que;
+    msg_que  = NULL;
+    msg_tail = NULL;
+    memset(msg_kind, 0, sizeof(msg_kind));
+
+    for ( ;   entry;   entry = next) {
         next = entry->next;
 
-        send_message(entry->bus, entry->msg, DBUSIF_SEND_NOW);
+        send_message(entry->bus, signal_other, entry->msg, DBUSIF_SEND_NOW);
 
         free(entry);
     } /* for */
-
-    msg_que = NULL;
 }
 
 static void queue_purge(bus_type_t bus)
 {
-    msg_queue_t *entry = msg_que, *prev = NULL, *next;
+    msg_queue_t *entry, *next;
 
-    while (entry) {
+    for (entry = msg_que;   entry;   entry = next) {
         next = entry->next;
 
-        if (entry->bus == bus) {
-            if (entry == msg_que)
-                msg_que = next;
+        if (entry->bus == bus)
+            queue_unlink(entry);
+    }
+}
+
+static int stream_info_cancel(stream_info_t *si)
+{
+    stream_info_t *prev, *pending;
+
+    if (strcmp(si->oper, "unregister"))
+        return FALSE;
+
+    for (prev = NULL, pending = si_que;  pending;  pending = pending->next) {
+        if (pending->pid == si->pid               &&
+            !strcmp(pending->oper  , "register")  &&
+            !strcmp(pending->group , si->group )  &&
+            !strcmp(pending->prop  , si->prop  )  &&
+            !strcmp(pending->method, si->method)  &&
+            !strcmp(pending->arg   , si->arg   )    )
+        {
+            if (prev != NULL)
+                prev->next = pending->next;
+            else
+                si_que = pending->next;
+
+            if (pending == si_tail)
+                si_tail = prev;
+
+            stream_info_free(pending);
+
+            return TRUE;
+        }
+
+        prev = pending;
+    }
 
-            if (prev)
-                prev->next = next;
+    return FALSE;
+}
 
-            dbus_message_unref(entry->msg);
-            free(entry);
-        } else {
-            prev = entry;
+static void stream_info_free(stream_info_t *si)
+{
+    if (si != NULL) {
+        free(si->oper);
+        free(si->group);
+        free(si->prop);
+        free(si->method);
+        free(si->arg);
+        free(si);
+    }
+}
+
+static gboolean stream_info_flush(gpointer data)
+{
+    static dbus_uint32_t  txid = 1;
+
+    stream_info_t        *si, *next;
+    DBusMessage          *msg;
+    int                   success;
+    int                   nsent;
+
+    (void)data;
+
+    si       = si_que;
+    si_que   = NULL;
+    si_tail  = NULL;
+    si_flush = 0;
+    nsent    = 0;
+
+    for ( ;   si;   si = next) {
+        next = si->next;
+
+        msg = dbus_message_new_signal(DBUS_POLICY_DECISION_PATH,
+                                      DBUS_POLICY_DECISION_INTERFACE,
+                                      DBUS_STREAM_INFO_SIGNAL);
+
+        if (msg == NULL)
+            OHM_ERROR("media: failed to create stream info signal");
+        else {
+            success = dbus_message_append_args(msg,
+                                               DBUS_TYPE_UINT32, &txid,
+                                               DBUS_TYPE_STRING, &si->oper,
+                                               DBUS_TYPE_STRING, &si->group,
+                                               DBUS_TYPE_UINT32, &si->pid,
+                                               DBUS_TYPE_STRING, &si->arg,
+                                               DBUS_TYPE_STRING, &si->method,
+                                               DBUS_TYPE_STRING, &si->prop,
+                                               DBUS_TYPE_INVALID);
+            if (!success)
+                OHM_ERROR("media: failed to build stream info message");
+            else if (!dbus_connection_send(sys_conn, msg, NULL))
+                OHM_ERROR("media: failed to send stream info message");
+            else {
+                OHM_DEBUG(DBG_DBUS, "operation='%s' group='%s' pid=%u "
+                          "property='%s' method='%s' arg='%s'", si->oper,
+                          si->group, si->pid, si->prop, si->method, si->arg);
+                txid++;
+                nsent++;
+            }
+
+            dbus_message_unref(msg);
         }
 
-        entry = next;
+        stream_info_free(si);
     }
+
+    OHM_DEBUG(DBG_DBUS, "%d stream info signal(s) sent", nsent);
+
+    return FALSE;
 }
 
 /* 
@@ -27,6 +27,8 @@ USA.
 
 #include <ohm/ohm-fact.h>
 
+#include "fact-watch.h"
+
 #include "plugin.h"
 #include "fsif.h"
 
@@ -46,6 +48,7 @@ typedef struct watch_fact_s {
     struct watch_fact_s   *next;
     char                  *factname;
     struct watch_entry_s  *entries;
+    int                    subscription;
 } watch_fact_t;
 
 typedef struct watch_entry_s {
@@ -53,6 +56,7 @@ typedef struct watch_entry_s {
     int                    id;
     fsif_field_t          *selist;
     char                  *fldname;
+    GQuark                 fldquark;
     union {
         fsif_field_watch_cb_t  field_watch;
         fsif_fact_watch_cb_t   fact_watch;
@@ -83,10 +87,9 @@ static char         *print_selector(fsif_field_t *, char *, int);
 static char         *print_value(fsif_fldtype_t, void *, char *, int);
 static void          inserted_cb(void *, OhmFact *);
 static void          removed_cb(void *, OhmFact *);
-static void          updated_cb(void *, OhmFact *, GQuark, gpointer);
+static void          updated_cb(OhmFact *, GQuark, GValue *, void *);
 static char         *time_str(unsigned long long, char *, int);
 
-static guint         updated_id;
 static guint         inserted_id;
 static guint         removed_id;
 
@@ -101,21 +104,25 @@ void fsif_init(OhmPlugin *plugin)
 
     fs = ohm_fact_store_get_fact_store();
 
-    updated_id  = g_signal_connect(G_OBJECT(fs), "updated" , G_CALLBACK(updated_cb) , NULL);
     inserted_id = g_signal_connect(G_OBJECT(fs), "inserted", G_CALLBACK(inserted_cb), NULL);
     removed_id  = g_signal_connect(G_OBJECT(fs), "removed" , G_CALLBACK(removed_cb) , NULL);
 }
 
 void fsif_exit(OhmPlugin *plugin)
 {
+    watch_fact_t *wfact;
+
     (void)plugin;
 
     fs = ohm_fact_store_get_fact_store();
 
-    if (g_signal_handler_is_connected(G_OBJECT(fs), updated_id)) {
-        g_signal_handler_disconnect(G_OBJECT(fs), updated_id);
-        updated_id = 0;
+    for (wfact = wfact_updates;  wfact != NULL;  wfact = wfact->next) {
+        if (wfact->subscription > 0) {
+            fact_unsubscribe(wfact->subscription);
+            wfact->subscription = 0;
+        }
     }
+
     if (g_signal_handler_is_connected(G_OBJECT(fs), inserted_id)) {
         g_signal_handler_disconnect(G_OBJECT(fs), inserted_id);
         inserted_id = 0;
@@ -323,6 +330,18 @@ int fsif_add_field_watch(char                  *factname,
         }
     }
 
+    if (wfact->subscription <= 0) {
+        if (fact_watch_import())
+            wfact->subscription = fact_subscribe("media", factname,
+                                                 NULL, NULL, NULL,
+                                                 updated_cb, wfact);
+        if (wfact->subscription <= 0) {
+            OHM_ERROR("media: can't subscribe to updates of fact '%s'",
+                      factname);
+            return -1;
+        }
+    }
+
     if ((wentry = malloc(sizeof(*wentry))) == NULL)
         return -1;
     else {
@@ -331,6 +350,7 @@ int fsif_add_field_watch(char                  *factname,
         wentry->id                   = watch_id++;
         wentry->selist               = copy_selector(selist);
         wentry->fldname              = fldname ? strdup(fldname) : NULL;
+        wentry->fldquark             = fldname ? g_quark_from_string(fldname):0;
         wentry->callback.field_watch = callback;
         wentry->usrdata              = usrdata;
         
@@ -763,13 +783,11 @@ static void removed_cb(void *data, OhmFact *fact)
     } /* if find_watch */
 }
 
-static void updated_cb(void *data,OhmFact *fact,GQuark fldquark,gpointer value)
+static void updated_cb(OhmFact *fact, GQuark fldquark, GValue *gval,
+                       void *data)
 {
-    (void)data;
-
-    GValue        *gval = (GValue *)value;
+    watch_fact_t  *wfact = (watch_fact_t *)data;
     char          *name;
-    watch_fact_t  *wfact;
     watch_entry_t *wentry;
     fsif_field_t   fld;
     char           valb[256];
@@ -780,67 +798,64 @@ static void updated_cb(void *data,OhmFact *fact,GQuark fldquark,gpointer value)
         return;
     }
         
-    name = (char *)ohm_structure_get_name(OHM_STRUCTURE(fact));
-
-    if (value != NULL && (wfact = find_watch(name, watch_update)) != NULL) {
+    name = wfact->factname;
 
-        for (wentry = wfact->entries;  wentry != NULL;  wentry = wentry->next){
+    for (wentry = wfact->entries;  wentry != NULL;  wentry = wentry->next){
 
-            fld.name = (char *)g_quark_to_string(fldquark);
+        fld.name = (char *)g_quark_to_string(fldquark);
 
-            if (matching_entry(fact, wentry->selist) &&
-                (!wentry->fldname || !strcmp(fld.name, wentry->fldname))) {
+        if (matching_entry(fact, wentry->selist) &&
+            (!wentry->fldquark || wentry->fldquark == fldquark)) {
+            
+            switch (G_VALUE_TYPE(gval)) {
                 
-                switch (G_VALUE_TYPE(gval)) {
-                    
-                case G_TYPE_STRING:
-                    fld.type = fldtype_string;
-                    fld.value.string = (char *)g_value_get_string(gval);
-                    break;
-                    
-                case G_TYPE_LONG:
-                    fld.type = fldtype_integer;
-                    fld.value.integer = g_value_get_long(gval);
-                    break;
-
-                case G_TYPE_INT:
-                    fld.type = fldtype_integer;
-                    fld.value.integer = g_value_get_int(gval);
-                    break;
-                    
-                case G_TYPE_ULONG:
-                    fld.type = fldtype_unsignd;
-                    fld.value.unsignd = g_value_get_ulong(gval);
-                    break;
-                    
-                case G_TYPE_DOUBLE:
-                    fld.type = fldtype_floating;
-                    fld.value.floating = g_value_get_double(gval);
-                    break;
-                    
-                case G_TYPE_UINT64:
-                    fld.type = fldtype_time;
-                    fld.value.time = g_value_get_uint64(gval);
-                    break;
-                    
-                default:
-                    OHM_ERROR("resource: [%s] Unsupported data type (%d) "
-                              "for field '%s'",
-                              __FUNCTION__, G_VALUE_TYPE(gval), fld.name);
-                    return;
-                }
+            case G_TYPE_STRING:
+                fld.type = fldtype_string;
+                fld.value.string = (char *)g_value_get_string(gval);
+                break;
                 
-                valstr = print_value(fld.type, (void *)&fld.value,
-                                     valb, sizeof(valb)); 
-                OHM_DEBUG(DBG_FS, "field watch point: field '%s:%s' "
-                          "changed to '%s'", name, fld.name, valstr);
+            case G_TYPE_LONG:
+                fld.type = fldtype_integer;
+                fld.value.integer = g_value_get_long(gval);
+                break;
 
-                wentry->callback.field_watch(fact, name, &fld,wentry->usrdata);
+            case G_TYPE_INT:
+                fld.type = fldtype_integer;
+                fld.value.integer = g_value_get_int(gval);
+                break;
+                
+            case G_TYPE_ULONG:
+                fld.type = fldtype_unsignd;
+                fld.value.unsignd = g_value_get_ulong(gval);
+                break;
                 
+            case G_TYPE_DOUBLE:
+                fld.type = fldtype_floating;
+                fld.value.floating = g_value_get_double(gval);
+                break;
+                
+            case G_TYPE_UINT64:
+                fld.type = fldtype_time;
+                fld.value.time = g_value_get_uint64(gval);
+                break;
+                
+            default:
+                OHM_ERROR("resource: [%s] Unsupported data type (%d) "
+                          "for field '%s'",
+                          __FUNCTION__, G_VALUE_TYPE(gval), fld.name);
                 return;
-            } /* if matching_entry */
-        } /* for */
-    } /* if find_watch */
+            }
+            
+            valstr = print_value(fld.type, (void *)&fld.value,
+                                 valb, sizeof(valb)); 
+            OHM_DEBUG(DBG_FS, "field watch point: field '%s:%s' "
+                      "changed to '%s'", name, fld.name, valstr);
+
+            wentry->callback.field_watch(fact, name, &fld,wentry->usrdata);
+            
+            return;
+        } /* if matching_entry */
+    } /* for */
 }
 
 static char *time_str(unsigned long long t, char *buf , int len)
@@ -68,6 +68,7 @@ static void plugin_init(OhmPlugin *plugin)
 static void plugin_destroy(OhmPlugin *plugin)
 {
     fsif_exit(plugin);
+    dbusif_exit(plugin);
 }
 
 
@@ -86,6 +87,8 @@ OHM_PLUGIN_PROVIDES(
     "maemo.media"
 );
 
+OHM_PLUGIN_REQUIRES("signaling");
+
 OHM_PLUGIN_DBUS_SIGNALS(
     { NULL, DBUS_POLICY_DECISION_INTERFACE, DBUS_INFO_SIGNAL,
       NULL, dbusif_info, NULL },
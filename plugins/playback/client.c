@@ -21,8 +21,12 @@ USA.
 #define SELIST_DIM 3
 
 static client_listhead_t  cl_head;
+static GHashTable        *cl_dbus_idx;  /* (dbusid, object) => client */
+static GHashTable        *cl_pid_idx;   /* pid => chain of clients */
 
-static int init_selist(client_t *, fsif_field_t *, int);
+static int   init_selist(client_t *, fsif_field_t *, int);
+static guint dbus_idx_hash(gconstpointer);
+static gboolean dbus_idx_equal(gconstpointer, gconstpointer);
 
 static void client_init(OhmPlugin *plugin)
 {
@@ -33,6 +37,9 @@ static void client_init(OhmPlugin *plugin)
     cl_head.next = (void *)&cl_head;
     cl_head.prev = (void *)&cl_head;
 
+    cl_dbus_idx = g_hash_table_new(dbus_idx_hash, dbus_idx_equal);
+    cl_pid_idx  = g_hash_table_new(g_str_hash, g_str_equal);
+
     (void)plugin;
 }
 
@@ -66,6 +73,9 @@ static client_t *client_create(char *dbusid, char *object,
                 cl->playhint = strdup("Play");
                 cl->sm       = sm;  
 
+                cl->rqlist.next = (void *)&cl->rqlist;
+                cl->rqlist.prev = (void *)&cl->rqlist;
+
                 next = (void *)&cl_head;
                 prev = cl_head.prev;
                 
@@ -74,6 +84,10 @@ static client_t *client_create(char *dbusid, char *object,
                 
                 next->prev = cl;
                 cl->prev   = prev;
+
+                if (cl->dbusid && cl->object)
+                    g_hash_table_insert(cl_dbus_idx, cl, cl);
+                client_index_stream(cl);
                 
                 dbusif_watch_client(dbusid, TRUE);
 
@@ -111,6 +125,11 @@ static void client_destroy(client_t *cl)
 
         dbusif_watch_client(cl->dbusid, FALSE);
 
+        if (cl->dbusid && cl->object &&
+            g_hash_table_lookup(cl_dbus_idx, cl) == cl)
+            g_hash_table_remove(cl_dbus_idx, cl);
+        client_unindex_stream(cl);
+
         free(cl->dbusid);
         free(cl->object);
         free(cl->pid);
@@ -141,14 +160,13 @@ static void client_destroy(client_t *cl)
 
 static client_t *client_find_by_dbus(char *dbusid, char *object)
 {
-    client_t *cl;
+    client_t key;
 
     if (dbusid && object) {
-        for (cl = cl_head.next;   cl != (void *)&cl_head;   cl = cl->next){
-            if (cl->dbusid && !strcmp(dbusid, cl->dbusid) &&
-                cl->object && !strcmp(object, cl->object)   )
-                return cl;
-        }
+        key.dbusid = dbusid;
+        key.object = object;
+
+        return g_hash_table_lookup(cl_dbus_idx, &key);
     }
     
     return NULL;
@@ -159,20 +177,72 @@ static client_t *client_find_by_stream(char *pid, char *stream)
     client_t *cl;
 
     if (pid) {
-        for (cl = cl_head.next;   cl != (void *)&cl_head;   cl = cl->next){
-            if (cl->pid && !strcmp(pid, cl->pid)) {
-                if (!stream)
-                    return cl;
+        cl = g_hash_table_lookup(cl_pid_idx, pid);
 
-                if (cl->stream && !strcmp(stream, cl->stream))
-                    return cl;
-            }
+        for (;  cl != NULL;  cl = cl->pidnext) {
+            if (!stream)
+                return cl;
+
+            if (cl->stream && !strcmp(stream, cl->stream))
+                return cl;
         }
     }
     
     return NULL;
 }
 
+/*
+ * Clients are indexed by their pid. The clients of the same process are
+ * chained in the order they got their pid. Call client_unindex_stream()
+ * before and client_index_stream() after changing the pid of a client.
+ */
+static void client_index_stream(client_t *cl)
+{
+    client_t *first, *last;
+
+    if (cl == NULL || cl->pid == NULL)
+        return;
+
+    cl->pidnext = NULL;
+
+    if ((first = g_hash_table_lookup(cl_pid_idx, cl->pid)) == NULL)
+        g_hash_table_insert(cl_pid_idx, cl->pid, cl);
+    else {
+        for (last = first;  last->pidnext != NULL;  last = last->pidnext)
+            ;
+        last->pidnext = cl;
+    }
+}
+
+static void client_unindex_stream(client_t *cl)
+{
+    client_t *first, *prev, *c;
+
+    if (cl == NULL || cl->pid == NULL)
+        return;
+
+    if ((first = g_hash_table_lookup(cl_pid_idx, cl->pid)) == NULL)
+        return;
+
+    if (first == cl) {
+        /* the key is owned by the first client, so always reinsert */
+        g_hash_table_remove(cl_pid_idx, cl->pid);
+
+        if (cl->pidnext != NULL)
+            g_hash_table_insert(cl_pid_idx, cl->pidnext->pid, cl->pidnext);
+    }
+    else {
+        for (prev = first, c = first->pidnext;  c;  prev = c, c = c->pidnext){
+            if (c == cl) {
+                prev->pidnext = cl->pidnext;
+                break;
+            }
+        }
+    }
+
+    cl->pidnext = NULL;
+}
+
 static void client_purge(char *dbusid)
 {
     client_t *cl, *nxcl;
@@ -384,6 +454,22 @@ static void client_save_playback_hint(client_t *cl, client_htype_t type,
     }
 }
 
+static guint dbus_idx_hash(gconstpointer key)
+{
+    const client_t *cl = (const client_t *)key;
+
+    return g_str_hash(cl->dbusid) * 31 + g_str_hash(cl->object);
+}
+
+static gboolean dbus_idx_equal(gconstpointer a, gconstpointer b)
+{
+    const client_t *cla = (const client_t *)a;
+    const client_t *clb = (const client_t *)b;
+
+    return !strcmp(cla->dbusid, clb->dbusid) &&
+           !strcmp(cla->object, clb->object);
+}
+
 static int init_selist(client_t *cl, fsif_field_t *selist, int dim)
 {
     if (selist != NULL && dim > 0) {
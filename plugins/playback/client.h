@@ -25,6 +25,7 @@ USA.
 
 #include "sm.h"
 #include "dbusif.h"
+#include "pbreq.h"
 
 
 #define CLIENT_LIST          \
@@ -51,6 +52,8 @@ typedef struct client_s {
     client_evfire_t   rqsetst;
     client_evfire_t   rqplayhint;
     sm_t             *sm;         /* state machine instance */
+    struct client_s  *pidnext;    /* next client in the pid index chain */
+    pbreq_listhead_t  rqlist;     /* queued requests of the client */
 } client_t;
 
 typedef enum {
@@ -80,6 +83,8 @@ static void       client_destroy(client_t *);
 static client_t  *client_find_by_dbus(char *, char *);
 static client_t  *client_find_by_stream(char *, char *);
 static void       client_purge(char *);
+static void       client_index_stream(client_t *);
+static void       client_unindex_stream(client_t *);
 
 static int        client_add_factstore_entry(char *, char *, char *, char *);
 static void       client_delete_factsore_entry(client_t *);
@@ -18,14 +18,13 @@ USA.
 *************************************************************************/
 
 
-static pbreq_listhead_t  rq_head;
+static GHashTable  *rq_trid_idx;        /* transaction id => request */
 
 static void pbreq_init(OhmPlugin *plugin)
 {
     (void)plugin;
 
-    rq_head.next = (void *)&rq_head;
-    rq_head.prev = (void *)&rq_head;
+    rq_trid_idx = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 static pbreq_t *pbreq_create(client_t *cl, DBusMessage *msg)
@@ -34,7 +33,7 @@ static pbreq_t *pbreq_create(client_t *cl, DBusMessage *msg)
 
     pbreq_t *req, *next, *prev;
 
-    if (msg == NULL)
+    if (msg == NULL || cl == NULL)
         req = NULL;
     else {
         if ((req = malloc(sizeof(*req))) != NULL) {
@@ -45,8 +44,8 @@ static pbreq_t *pbreq_create(client_t *cl, DBusMessage *msg)
             req->msg  = msg;
             req->trid = trid++;
 
-            next = (void *)&rq_head;
-            prev = rq_head.prev;
+            next = (void *)&cl->rqlist;
+            prev = cl->rqlist.prev;
             
             prev->next = req;
             req->next  = next;
@@ -54,6 +53,8 @@ static pbreq_t *pbreq_create(client_t *cl, DBusMessage *msg)
             next->prev = req;
             req->prev  = prev;
 
+            g_hash_table_insert(rq_trid_idx, GINT_TO_POINTER(req->trid), req);
+
             OHM_DEBUG(DBG_QUE, "playback request %d created", req->trid);
         }
     }
@@ -75,6 +76,8 @@ static void pbreq_destroy(pbreq_t *req)
         prev->next = req->next;
         next->prev = req->prev;
 
+        g_hash_table_remove(rq_trid_idx, GINT_TO_POINTER(req->trid));
+
         if (req->msg != NULL)
             dbus_message_unref(req->msg);
 
@@ -99,38 +102,23 @@ static void pbreq_destroy(pbreq_t *req)
 
 static pbreq_t *pbreq_get_first(client_t *cl)
 {
-    pbreq_t *req;
+    if (cl == NULL || cl->rqlist.next == (void *)&cl->rqlist)
+        return NULL;
 
-    for (req = rq_head.next;   req != (void *)&rq_head;   req = req->next) {
-        if (req->cl == cl)
-            return req;
-    }
-
-    return NULL;
+    return cl->rqlist.next;
 }
 
 static pbreq_t *pbreq_get_by_trid(int trid)
 {
-    pbreq_t *req;
-
-    for (req = rq_head.next;   req != (void *)&rq_head;   req = req->next) {
-        if (req->trid == trid)
-            return req;
-    }
-
-    return NULL;
+    return g_hash_table_lookup(rq_trid_idx, GINT_TO_POINTER(trid));
 }
 
 static void pbreq_purge(client_t *cl)
 {
-    pbreq_t *req, *nxreq;
-
-    for (req = rq_head.next;   req != (void *)&rq_head;   req = nxreq) {
-        nxreq = req->next;
+    pbreq_t *req;
 
-        if (cl == req->cl)
-            pbreq_destroy(req);
-    }
+    while ((req = pbreq_get_first(cl)) != NULL)
+        pbreq_destroy(req);
 }
 
 
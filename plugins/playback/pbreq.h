@@ -23,6 +23,8 @@ USA.
 
 #include <dbus/dbus.h>
 
+struct client_s;
+
 typedef enum {
     pbreq_invalid = 0,
     pbreq_state,
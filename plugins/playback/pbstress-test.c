@@ -0,0 +1,374 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Playback stress test.
+ *
+ * Registers a large number of fake playback objects with the playback
+ * plugin of a running ohmd, then issues RequestState calls to them one
+ * by one and reports the per-request latency. Usage:
+ *
+ *     pbstress-test [number-of-clients [number-of-rounds]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
+#define PLAYBACK_INTERFACE   "org.maemo.Playback"
+#define MANAGER_SERVICE      "org.maemo.Playback.Manager"
+#define MANAGER_INTERFACE    "org.maemo.Playback.Manager"
+#define MANAGER_PATH         "/org/maemo/Playback/Manager"
+#define PROPERTY_INTERFACE   "org.freedesktop.DBus.Properties"
+#define STRESS_PATH          "/org/maemo/Playback/Stress"
+
+#define DEFAULT_CLIENTS      2000
+#define DEFAULT_ROUNDS       3
+
+#define fatal(fmt, args...) do {                                \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);      \
+        exit(1);                                                \
+    } while (0)
+
+#define error(fmt, args...) do {                                \
+        fprintf(stderr, "error: "fmt"\n" , ## args);            \
+    } while (0)
+
+
+static DBusConnection *conn;
+static GMainLoop      *loop;
+static int             nclient = DEFAULT_CLIENTS;
+static int             nround  = DEFAULT_ROUNDS;
+static int             nready;              /* clients fully set up */
+static int             current;             /* client being requested */
+static int             nthround;            /* current round */
+static char            pidstr[32];
+
+static double          total, min, max;     /* latency statistics (usec) */
+static int             nreq, nfail;
+static struct timeval  started;
+
+
+static double
+usecs_since(struct timeval *tv)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - tv->tv_sec) * 1000000.0 + (now.tv_usec - tv->tv_usec);
+}
+
+
+static int
+object_index(const char *path)
+{
+    const char *p;
+
+    if (strncmp(path, STRESS_PATH "/", sizeof(STRESS_PATH)))
+        return -1;
+
+    p = path + sizeof(STRESS_PATH);
+
+    return (int)strtol(p, NULL, 10);
+}
+
+
+static void
+send_hello(int idx)
+{
+    DBusMessage *msg;
+    char         path[256];
+
+    snprintf(path, sizeof(path), "%s/%d", STRESS_PATH, idx);
+
+    msg = dbus_message_new_signal(path, PLAYBACK_INTERFACE, "Hello");
+    if (msg == NULL)
+        fatal("failed to allocate Hello signal");
+
+    if (!dbus_connection_send(conn, msg, NULL))
+        fatal("failed to send Hello signal");
+
+    dbus_message_unref(msg);
+}
+
+
+static void
+notify_state(const char *path, const char *state)
+{
+    DBusMessage *msg;
+    const char  *iface = PLAYBACK_INTERFACE;
+    const char  *prop  = "State";
+
+    msg = dbus_message_new_signal(path, PROPERTY_INTERFACE, "Notify");
+    if (msg == NULL)
+        fatal("failed to allocate Notify signal");
+
+    if (!dbus_message_append_args(msg,
+                                  DBUS_TYPE_STRING, &iface,
+                                  DBUS_TYPE_STRING, &prop,
+                                  DBUS_TYPE_STRING, &state,
+                                  DBUS_TYPE_INVALID))
+        fatal("failed to fill Notify signal");
+
+    dbus_connection_send(conn, msg, NULL);
+    dbus_message_unref(msg);
+}
+
+
+static void request_next(void);
+
+
+static void
+request_reply(DBusPendingCall *pcall, void *user_data)
+{
+    struct timeval *sent = (struct timeval *)user_data;
+    DBusMessage    *reply;
+    double          usecs = usecs_since(sent);
+
+    if ((reply = dbus_pending_call_steal_reply(pcall)) == NULL ||
+        dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+        nfail++;
+
+    if (reply != NULL)
+        dbus_message_unref(reply);
+    dbus_pending_call_unref(pcall);
+
+    if (nreq == 0 || usecs < min)
+        min = usecs;
+    if (usecs > max)
+        max = usecs;
+    total += usecs;
+    nreq++;
+
+    request_next();
+}
+
+
+static void
+request_next(void)
+{
+    static struct timeval  sent;
+    static const char     *states[] = { "Play", "Stop" };
+
+    DBusMessage     *msg;
+    DBusPendingCall *pcall;
+    char             path[256], *pathp = path;
+    const char      *state, *stream = "", *pid = pidstr;
+
+    if (current >= nclient) {
+        printf("round %d: %d requests, %d failed, latency "
+               "min %.1f / avg %.1f / max %.1f usecs\n", nthround + 1,
+               nreq, nfail, min, nreq ? total / nreq : 0.0, max);
+
+        total = min = max = 0.0;
+        nreq  = nfail = 0;
+        current = 0;
+
+        if (++nthround >= nround) {
+            g_main_loop_quit(loop);
+            return;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/%d", STRESS_PATH, current);
+    state = states[nthround & 1];
+    current++;
+
+    msg = dbus_message_new_method_call(MANAGER_SERVICE, MANAGER_PATH,
+                                       MANAGER_INTERFACE, "RequestState");
+    if (msg == NULL ||
+        !dbus_message_append_args(msg,
+                                  DBUS_TYPE_OBJECT_PATH, &pathp,
+                                  DBUS_TYPE_STRING, &state,
+                                  DBUS_TYPE_STRING, &pid,
+                                  DBUS_TYPE_STRING, &stream,
+                                  DBUS_TYPE_INVALID))
+        fatal("failed to create RequestState message");
+
+    gettimeofday(&sent, NULL);
+
+    if (!dbus_connection_send_with_reply(conn, msg, &pcall, -1) ||
+        !dbus_pending_call_set_notify(pcall, request_reply, &sent, NULL))
+        fatal("failed to send RequestState message");
+
+    dbus_message_unref(msg);
+}
+
+
+static DBusHandlerResult
+object_method(DBusConnection *c, DBusMessage *msg, void *user_data)
+{
+    DBusMessage *reply;
+    const char  *path = dbus_message_get_path(msg);
+    const char  *iface, *prop, *value;
+    char        *pidp = pidstr;
+    int          idx;
+
+    (void)c;
+    (void)user_data;
+
+    if ((idx = object_index(path)) < 0)
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (dbus_message_is_method_call(msg, PROPERTY_INTERFACE, "Get")) {
+        if (!dbus_message_get_args(msg, NULL,
+                                   DBUS_TYPE_STRING, &iface,
+                                   DBUS_TYPE_STRING, &prop,
+                                   DBUS_TYPE_INVALID))
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+        if      (!strcmp(prop, "Pid"))   value = pidp;
+        else if (!strcmp(prop, "Class")) value = "Player";
+        else if (!strcmp(prop, "State")) value = "Stop";
+        else if (!strcmp(prop, "Flags")) value = "1";
+        else                             value = "";
+
+        reply = dbus_message_new_method_return(msg);
+        dbus_message_append_args(reply,
+                                 DBUS_TYPE_STRING, &value,
+                                 DBUS_TYPE_INVALID);
+        dbus_connection_send(conn, reply, NULL);
+        dbus_message_unref(reply);
+
+        if (!strcmp(prop, "Flags") && ++nready == nclient) {
+            printf("%d clients set up in %.3f secs\n", nclient,
+                   usecs_since(&started) / 1000000.0);
+            request_next();
+        }
+
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (dbus_message_is_method_call(msg, PROPERTY_INTERFACE, "Set")) {
+        reply = dbus_message_new_method_return(msg);
+        dbus_connection_send(conn, reply, NULL);
+        dbus_message_unref(reply);
+
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+
+static DBusHandlerResult
+state_changed(DBusConnection *c, DBusMessage *msg, void *user_data)
+{
+    const char *path = dbus_message_get_path(msg);
+    const char *iface, *prop, *value;
+    DBusMessageIter it, var;
+
+    (void)c;
+    (void)user_data;
+
+    /* echo back any state the policy sets on our objects */
+    if (path == NULL || object_index(path) < 0 ||
+        !dbus_message_is_method_call(msg, PROPERTY_INTERFACE, "Set"))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (!dbus_message_iter_init(msg, &it) ||
+        dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_STRING)
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    dbus_message_iter_get_basic(&it, &iface);
+    dbus_message_iter_next(&it);
+    dbus_message_iter_get_basic(&it, &prop);
+    dbus_message_iter_next(&it);
+
+    if (dbus_message_iter_get_arg_type(&it) == DBUS_TYPE_VARIANT) {
+        dbus_message_iter_recurse(&it, &var);
+        if (dbus_message_iter_get_arg_type(&var) != DBUS_TYPE_STRING)
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        dbus_message_iter_get_basic(&var, &value);
+    }
+    else if (dbus_message_iter_get_arg_type(&it) == DBUS_TYPE_STRING)
+        dbus_message_iter_get_basic(&it, &value);
+    else
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (!strcmp(prop, "State"))
+        notify_state(path, value);
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+
+static void
+bus_init(void)
+{
+    static struct DBusObjectPathVTable vtable = {
+        .message_function = object_method
+    };
+
+    if ((conn = dbus_bus_get(DBUS_BUS_SESSION, NULL)) == NULL)
+        fatal("failed to get session D-BUS connection");
+
+    dbus_connection_setup_with_g_main(conn, NULL);
+
+    if (!dbus_connection_add_filter(conn, state_changed, NULL, NULL))
+        fatal("failed to install D-BUS filter");
+
+    if (!dbus_connection_register_fallback(conn, STRESS_PATH, &vtable, NULL))
+        fatal("failed to register object path %s", STRESS_PATH);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    if (argc > 1 && (nclient = (int)strtol(argv[1], NULL, 10)) <= 0)
+        fatal("invalid number of clients '%s'", argv[1]);
+    if (argc > 2 && (nround = (int)strtol(argv[2], NULL, 10)) <= 0)
+        fatal("invalid number of rounds '%s'", argv[2]);
+
+    snprintf(pidstr, sizeof(pidstr), "%u", (unsigned int)getpid());
+
+    loop = g_main_loop_new(NULL, FALSE);
+    if (loop == NULL)
+        fatal("failed to initialize main loop");
+
+    bus_init();
+
+    gettimeofday(&started, NULL);
+
+    for (i = 0; i < nclient; i++)
+        send_hello(i);
+
+    g_main_loop_run(loop);
+
+    return 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -49,12 +49,6 @@ typedef struct {
     sm_stdef_t    stdef[stid_max]; /* state definitions */
 } sm_def_t;
 
-typedef struct {
-    sm_t         *sm;
-    sm_evdata_t  *evdata;
-    sm_evfree_t   evfree;
-} sm_schedule_t;
-
 
 sm_evdef_t  evdef[evid_max] = {
     { evid_invalid           ,  "invalid event"          },
@@ -262,6 +256,9 @@ sm_def_t  sm_def = {
 
 
 static void  verify_state_machine(void);
+static int   enqueue_event(sm_t *, sm_evdata_t *, sm_evfree_t);
+static void  purge_queue(sm_t *);
+static sm_evdata_t *copy_evdata(sm_evdata_t *);
 static int   fire_scheduled_event(void *);
 static int   fire_setstate_changed_event(void *);
 static int   fire_playhint_changed_event(void *);
@@ -344,7 +341,17 @@ static int sm_destroy(sm_t *sm)
         return FALSE;
     }
 
-    OHM_DEBUG(DBG_SM, "[%s] state machine is going to be destroyed", sm->name);
+    OHM_DEBUG(DBG_SM, "[%s] state machine is going to be destroyed "
+              "(events: %u queued, %u coalesced, %u dropped)", sm->name,
+              sm->nqueued, sm->ncoalesced, sm->ndropped);
+
+    purge_queue(sm);
+
+    if (sm->dispatch) {
+        /* we're called from fire_scheduled_event(); it will free us */
+        sm->dead = TRUE;
+        return TRUE;
+    }
 
     if (sm->sched != 0)
         g_source_remove(sm->sched);
@@ -373,13 +380,10 @@ static int sm_process_event(sm_t *sm, sm_evdata_t *evdata)
     sm_stdef_t   *state, *next_state;
     sm_transit_t *transit;
 
-    if (!sm || !evdata)
-        return FALSE;
+    sm_evdata_t  *copy;
 
-    if (sm->busy) {
-        OHM_ERROR("[%s] attempt for nested event processing", sm->name);
+    if (!sm || !evdata)
         return FALSE;
-    }
 
     evid = evdata->evid;
     stid = sm->stid;
@@ -390,6 +394,27 @@ static int sm_process_event(sm_t *sm, sm_evdata_t *evdata)
         return FALSE;
     }
 
+    if (sm->busy) {
+        /*
+         * A transition function triggered another event for us. The
+         * event data usually lives on the caller's stack, so queue a
+         * private copy and let it be processed once we are done.
+         * 'client gone' is the exception: the machine is destroyed
+         * right after it so there would be nobody to process it.
+         */
+        if (evid == evid_client_gone || (copy = copy_evdata(evdata)) == NULL){
+            OHM_ERROR("[%s] attempt for nested event processing", sm->name);
+            return FALSE;
+        }
+
+        OHM_DEBUG(DBG_SM, "[%s] deferring nested '%s' event",
+                  sm->name, evdef[evid].name);
+
+        sm_schedule_event(sm, copy, sm_free_evdata);
+
+        return TRUE;
+    }
+
     if (/* stid < stid_invalid || */ stid >= stid_max) {
         OHM_ERROR("[%s] current state %d is out of range (0 - %d)",
                   sm->name, stid, stid_max-1);
@@ -452,8 +477,6 @@ static int sm_process_event(sm_t *sm, sm_evdata_t *evdata)
 
 static void sm_schedule_event(sm_t *sm, sm_evdata_t *evdata,sm_evfree_t evfree)
 {
-    sm_schedule_t *schedule;
-
     if (!sm || !evdata) {
         OHM_ERROR("[%s] failed to schedule event: <null> argument",
                   sm ? sm->name : "SM-NULL");
@@ -466,34 +489,18 @@ static void sm_schedule_event(sm_t *sm, sm_evdata_t *evdata,sm_evfree_t evfree)
         return;
     }
 
-    if (sm->sched != 0) {
-        OHM_ERROR("[%s] failed to schedule event: multiple requests",sm->name);
-        return;
-    }
-
-    if ((schedule = malloc(sizeof(*schedule))) == NULL) {
-        OHM_ERROR("[%s] failed to schedule event: malloc failed", sm->name);
+    if (!enqueue_event(sm, evdata, evfree))
         return;
-    }
 
-    schedule->sm     = sm;
-    schedule->evdata = evdata;
-    schedule->evfree = evfree;
-
-    sm->sched = g_idle_add(fire_scheduled_event, schedule);
+    OHM_DEBUG(DBG_SM, "[%s] schedule event '%s' (%d pending)",
+              sm->name, evdef[evdata->evid].name, sm->qlen);
 
     if (sm->sched == 0) {
-        OHM_ERROR("[%s] failed to schedule event: g_idle_add() failed",
-                  sm->name);
-
-        free(schedule);
-
-        if (evfree != NULL)
-            evfree(evdata);
-    }
-    else {
-        OHM_DEBUG(DBG_SM, "[%s] schedule event '%s'",
-                  sm->name, evdef[evdata->evid].name);
+        if ((sm->sched = g_idle_add(fire_scheduled_event, sm)) == 0) {
+            OHM_ERROR("[%s] failed to schedule event: g_idle_add() failed",
+                      sm->name);
+            purge_queue(sm);
+        }
     }
 }
 
@@ -586,24 +593,162 @@ static void verify_state_machine()
         exit(EINVAL);
 }
 
+static int enqueue_event(sm_t *sm, sm_evdata_t *evdata, sm_evfree_t evfree)
+{
+    sm_evid_t    evid = evdata->evid;
+    sm_queued_t *q;
+    int          i;
+
+    for (i = 0;  i < sm->qlen;  i++) {
+        q = sm->queue + (sm->qhead + i) % SM_QUEUE_MAX;
+
+        /*
+         * the very same static event data needs to be processed only
+         * once; setstate/playhint requests do not get here, they are
+         * collapsed by the client (see schedule_deferred_request())
+         */
+        if (evfree == NULL && q->evfree == NULL && q->evdata == evdata) {
+            OHM_DEBUG(DBG_SM, "[%s] '%s' event coalesced",
+                      sm->name, evdef[evid].name);
+
+            sm->ncoalesced++;
+
+            return TRUE;
+        }
+    }
+
+    if (sm->qlen >= SM_QUEUE_MAX) {
+        OHM_ERROR("[%s] failed to schedule '%s' event: queue is full",
+                  sm->name, evdef[evid].name);
+
+        sm->ndropped++;
+
+        if (evfree != NULL)
+            evfree(evdata);
+
+        return FALSE;
+    }
+
+    q = sm->queue + (sm->qhead + sm->qlen) % SM_QUEUE_MAX;
+    q->evdata = evdata;
+    q->evfree = evfree;
+    q->trid   = 0;
+
+    /*
+     * a playback reply is only a pointer to the request, which can be
+     * gone by the time the event is processed; we remember the request
+     * by its transaction id and look it up again on dispatch
+     */
+    if ((evid == evid_playback_complete || evid == evid_playback_failed) &&
+        evdata->pbreply.req != NULL)
+        q->trid = evdata->pbreply.req->trid;
+
+    sm->qlen++;
+    sm->nqueued++;
+
+    return TRUE;
+}
+
+static void purge_queue(sm_t *sm)
+{
+    sm_queued_t *q;
+
+    while (sm->qlen > 0) {
+        q = sm->queue + sm->qhead;
+
+        sm->qhead = (sm->qhead + 1) % SM_QUEUE_MAX;
+        sm->qlen--;
+
+        if (q->evfree != NULL)
+            q->evfree(q->evdata);
+    }
+}
+
+static sm_evdata_t *copy_evdata(sm_evdata_t *evdata)
+{
+    sm_evdata_t *copy;
+
+    if ((copy = malloc(sizeof(*copy))) == NULL)
+        return NULL;
+
+    memcpy(copy, evdata, sizeof(*copy));
+
+    switch (evdata->evid) {
+
+    case evid_state_signal:
+    case evid_property_received:
+    case evid_setprop_succeeded:
+        copy->property.name  = evdata->property.name ?
+                               strdup(evdata->property.name) : NULL;
+        copy->property.value = evdata->property.value ?
+                               strdup(evdata->property.value) : NULL;
+        break;
+
+    case evid_setstate_changed:
+    case evid_playhint_changed:
+        copy->watch.value = evdata->watch.value ?
+                            strdup(evdata->watch.value) : NULL;
+        break;
+
+    case evid_playback_complete:
+    case evid_playback_failed:
+        /* not owned; the request is looked up again on dispatch */
+        break;
+
+    default:
+        break;
+    }
+
+    return copy;
+}
+
 static int fire_scheduled_event(void *data)
 {
-    sm_schedule_t *schedule = (sm_schedule_t *)data;
-    sm_t          *sm       = schedule->sm;
-    sm_evdata_t   *evdata   = schedule->evdata;
+    sm_t        *sm = (sm_t *)data;
+    sm_queued_t  q;
+    int          n;
 
-    sm->sched = 0;
+    OHM_DEBUG(DBG_SM, "[%s] fire %d event(s)", sm->name, sm->qlen);
 
-    OHM_DEBUG(DBG_SM, "[%s] fire event", sm->name);
+    sm->dispatch = TRUE;
 
-    sm_process_event(sm, evdata);
+    /*
+     * drain everything that is pending, including the events queued
+     * while processing; the bound keeps a misbehaving client from
+     * monopolizing the main loop
+     */
+    for (n = 0;  n < 2 * SM_QUEUE_MAX && sm->qlen > 0 && !sm->dead;  n++) {
+        q = sm->queue[sm->qhead];
 
-    if (schedule->evfree != NULL)
-        schedule->evfree(evdata);
+        sm->qhead = (sm->qhead + 1) % SM_QUEUE_MAX;
+        sm->qlen--;
 
-    free(schedule);
+        if (q.trid != 0 &&
+            (q.evdata->pbreply.req = pbreq_get_by_trid(q.trid)) == NULL) {
+            OHM_DEBUG(DBG_SM, "[%s] dropping '%s' event: request %d is gone",
+                      sm->name, evdef[q.evdata->evid].name, q.trid);
+        }
+        else
+            sm_process_event(sm, q.evdata);
 
-    return FALSE;               /* run only once */
+        if (q.evfree != NULL)
+            q.evfree(q.evdata);
+    }
+
+    sm->dispatch = FALSE;
+
+    if (sm->dead) {
+        free(sm->name);
+        free(sm);
+        return FALSE;
+    }
+
+    if (sm->qlen > 0)
+        return TRUE;            /* keep going at the next idle round */
+
+    sm->sched = 0;
+
+    return FALSE;
 }
 
 static int fire_setstate_changed_event(void *data)
@@ -741,7 +886,10 @@ static int save_property(sm_evdata_t *evdata, void *usrdata)
     char        *end;
 
     if (!strcmp(property->name, "Pid")) {
+        client_unindex_stream(cl);
+        free(cl->pid);
         cl->pid = strdup(property->value);
+        client_index_stream(cl);
         client_update_factstore_entry(cl, "pid", cl->pid);
         
         OHM_DEBUG(DBG_TRANS, "[%s] playback pid is set to %s",
@@ -988,12 +1136,16 @@ static int process_pbreq(sm_evdata_t *evdata, void *usrdata)
                                                    old_pid, old_str);
                 }
 
+                client_unindex_stream(cl);
+
                 if (cl->pid)    free(cl->pid);
                 if (cl->stream) free(cl->stream);
 
                 cl->pid    = pid    ? strdup(pid)    : NULL;
                 cl->stream = stream ? strdup(stream) : NULL;
 
+                client_index_stream(cl);
+
                 client_update_factstore_entry(cl, "pid", pid);
                 if (stream) {
                     client_update_factstore_entry(cl, "stream", stream);
@@ -53,14 +53,6 @@ typedef enum {
     stid_max
 } sm_stid_t;
 
-typedef struct {
-    char         *name;       /* name of the state machine instance */
-    sm_stid_t     stid;       /* ID of the current state */
-    int           busy;       /* to prevent nested event processing */
-    unsigned int  sched;      /* event source for scheduled event if any */
-    void         *data;       /* passed to trfunc() as second arg */
-} sm_t;
-
 /*
  * event data
  */
@@ -88,8 +80,32 @@ typedef union sm_evdata_u {
     sm_evdata_pbreply_t   pbreply;
 } sm_evdata_t;
 
+#define SM_QUEUE_MAX  16       /* max. number of pending events per machine */
+
 typedef void (*sm_evfree_t)(sm_evdata_t *);
 
+typedef struct {
+    sm_evdata_t  *evdata;
+    sm_evfree_t   evfree;
+    int           trid;       /* request of a playback reply, 0 if none */
+} sm_queued_t;
+
+typedef struct {
+    char         *name;       /* name of the state machine instance */
+    sm_stid_t     stid;       /* ID of the current state */
+    int           busy;       /* to prevent nested event processing */
+    int           dispatch;   /* the event queue is being drained */
+    int           dead;       /* destroyed while draining the queue */
+    unsigned int  sched;      /* event source for the queued events if any */
+    void         *data;       /* passed to trfunc() as second arg */
+    sm_queued_t   queue[SM_QUEUE_MAX]; /* pending events (ring buffer) */
+    int           qhead;      /* index of the first pending event */
+    int           qlen;       /* number of pending events */
+    unsigned int  nqueued;    /* number of events queued so far */
+    unsigned int  ncoalesced; /* repeated static events collapsed */
+    unsigned int  ndropped;   /* events lost due to a full queue */
+} sm_t;
+
 /*
  * state machine public interfaces
  */
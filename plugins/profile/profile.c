@@ -29,7 +29,9 @@ USA.
 #include "profile.h"
 
 static int  profile_load_state(void);
-static int  profile_save_state(OhmFact *fact);
+static int  profile_save_state(void);
+static void state_config(OhmPlugin *plugin);
+static void state_exit(void);
 static void reconnect_profile(void);
 
 static int DBG_PROFILE, DBG_FACTS;
@@ -43,8 +45,6 @@ static DBusConnection *bus_conn;
 
 static void plugin_init(OhmPlugin * plugin)
 {
-    (void) plugin;
-
     if (!OHM_DEBUG_INIT(profile))
         g_warning("Failed to initialize profile plugin debugging.");
     
@@ -53,6 +53,7 @@ static void plugin_init(OhmPlugin * plugin)
     /* We could remove this if installing ohm created /var/lib/ohm. */
     mkdir(PROFILE_SAVE_DIR, 0755);
 
+    state_config(plugin);
     profile_load_state();
     profile_connection_disable_autoconnect();
     
@@ -73,6 +74,8 @@ static void plugin_exit(OhmPlugin * plugin)
     }
     
     profile_plugin_p = NULL;
+
+    state_exit();
     return;
 }
 
@@ -240,119 +243,487 @@ static gboolean profile_create_fact(const char *profile, profileval_t *values)
 
     OHM_DEBUG(DBG_PROFILE, "created fact: fs: %p, fact: %p", fs, fact);
 
-    profile_save_state(fact);
+    profile_save_state();
     
     return TRUE;
 }
 
 
-static int save_field(FILE *fp, const gchar *key, GValue *value)
+/********************
+ * state persistence
+ ********************/
+
+/*
+ * Notes:
+ *
+ *   Saving is coalesced: changes only arm a timer and the state of the
+ *   profile fact is written once the timer fires (or when the plugin
+ *   exits). The state is written to a temporary file which is synced and
+ *   then atomically renamed over the old one, so a crash leaves either the
+ *   old or the new state behind but never a partial one. Writes that would
+ *   not change the saved state are skipped.
+ *
+ *   The state can be saved either in the original line-based text format
+ *   or in a compact binary one (save-format = binary). Loading accepts
+ *   both and parses the whole file in one go from an mmap-ed buffer.
+ *
+ *   Binary format (native byte order):
+ *     header: magic[8] = "OHMPROF\0", u32 version, u32 field count
+ *     field:  u16 key length, key, u8 type ('s', 'i' or 'f'),
+ *             u32 value length, value (string without terminating NUL,
+ *             int32 or double)
+ */
+
+#define STATE_MAGIC      "OHMPROF"
+#define STATE_VERSION    1
+#define STATE_SAVE_DELAY 500                    /* msecs */
+#define STATE_MAX_SIZE   (1024 * 1024)
+#define STATE_PATH       (state.path ? state.path : PROFILE_SAVE_PATH)
+
+static struct {
+    char    *path;                              /* state file, if not default */
+    int      binary;                            /* use binary format */
+    guint    delay;                             /* save coalescing delay */
+    guint    timer;                             /* pending save */
+    GString *saved;                             /* last saved content */
+    int      nsave;                             /* saves requested */
+    int      nwrite;                            /* saves written */
+} state = {
+    .path   = NULL,
+    .binary = FALSE,
+    .delay  = STATE_SAVE_DELAY,
+};
+
+
+static void state_config(OhmPlugin *plugin)
+{
+    const char *path   = ohm_plugin_get_param(plugin, "save-path");
+    const char *format = ohm_plugin_get_param(plugin, "save-format");
+    const char *delay  = ohm_plugin_get_param(plugin, "save-delay");
+    char       *e;
+    long        msecs;
+
+    if (path != NULL && *path)
+        state.path = g_strdup(path);
+
+    if (format != NULL) {
+        if (!strcmp(format, "binary"))
+            state.binary = TRUE;
+        else if (!strcmp(format, "text"))
+            state.binary = FALSE;
+        else
+            OHM_WARNING("profile: invalid save-format '%s'", format);
+    }
+
+    if (delay != NULL) {
+        msecs = strtol(delay, &e, 10);
+        if (*e || msecs < 0)
+            OHM_WARNING("profile: invalid save-delay '%s'", delay);
+        else
+            state.delay = (guint)msecs;
+    }
+}
+
+
+static int encode_text(GString *buf, const gchar *key, GValue *value)
 {
-    if (value == NULL)
-        return EINVAL;
-    
     /*
      * Notes: Although, currently we only have string fields maybe one
      *   day we'd like to support some other types as well.
      */
 
-    fprintf(fp, "%s\n", key);
-
     switch (G_VALUE_TYPE(value)) {
     case G_TYPE_STRING:
-        fprintf(fp, "s:%s\n", g_value_get_string(value));
+        g_string_append_printf(buf, "%s\ns:%s\n", key,
+                               g_value_get_string(value));
         break;
     case G_TYPE_INT:
-        fprintf(fp, "i:%d\n", g_value_get_int(value));
+        g_string_append_printf(buf, "%s\ni:%d\n", key, g_value_get_int(value));
         break;
     case G_TYPE_DOUBLE:
-        fprintf(fp, "f:%f\n", g_value_get_double(value));
+        g_string_append_printf(buf, "%s\nf:%f\n", key,
+                               g_value_get_double(value));
         break;
     default:
         return EINVAL;
     }
-    
+
     return 0;
 }
 
 
-static int load_field(FILE *fp, char *key, size_t size, GValue **value)
+static int encode_binary(GString *buf, const gchar *key, GValue *value)
 {
-    char val[256], *e;
-    size_t len;
-    int i;
-    double d;
-
-    if (fgets(key, size, fp) == NULL)
-        return ENOENT;
-
-    if ((len = strlen(key)) == 0 || key[len - 1] != '\n')
-        return EINVAL;
-
-    key[len - 1] = '\0';
-    
-    if (fgets(val, sizeof(val), fp) == NULL)
-        return EINVAL;
-
-    if ((len = strlen(val)) < 2 || val[1] != ':' || val[len - 1] != '\n')
-        return EINVAL;
-
-    val[len - 1] = '\0';
+    const gchar *str;
+    uint16_t     klen;
+    uint32_t     vlen;
+    int32_t      i;
+    double       d;
+    char         type;
 
-    switch (val[0]) {
-    case 's':
-        *value = ohm_value_from_string(val + 2);
+    switch (G_VALUE_TYPE(value)) {
+    case G_TYPE_STRING:
+        type = 's';
+        str  = g_value_get_string(value);
+        vlen = str ? strlen(str) : 0;
         break;
-    case 'i':
-        i = (int)strtol(val + 2, &e, 10);
-        if (e != NULL && *e)
-            return EINVAL;
-        *value = ohm_value_from_int(i);
+    case G_TYPE_INT:
+        type = 'i';
+        i    = g_value_get_int(value);
+        str  = (const gchar *)&i;
+        vlen = sizeof(i);
         break;
-    case 'f':
-        d = strtod(val + 2, &e);
-        if (e != NULL && *e)
-            return EINVAL;
-        *value = ohm_value_from_double(d);
+    case G_TYPE_DOUBLE:
+        type = 'f';
+        d    = g_value_get_double(value);
+        str  = (const gchar *)&d;
+        vlen = sizeof(d);
         break;
     default:
         return EINVAL;
     }
 
+    klen = strlen(key);
+
+    g_string_append_len(buf, (const gchar *)&klen, sizeof(klen));
+    g_string_append_len(buf, key, klen);
+    g_string_append_c(buf, type);
+    g_string_append_len(buf, (const gchar *)&vlen, sizeof(vlen));
+    g_string_append_len(buf, str, vlen);
+
     return 0;
 }
 
 
-static int profile_save_state(OhmFact *fact)
+static GString *state_encode(OhmFact *fact, int binary)
 {
-    FILE *fp;
-    GSList *l;
-    GQuark  q;
+    GString     *buf;
+    GSList      *l;
+    GQuark       q;
     const gchar *key;
-    GValue *value;
-    int err;
-    
-    if ((fp = fopen(PROFILE_SAVE_PATH, "w")) == NULL)
-        return errno;
+    GValue      *value;
+    uint32_t     version, count, *countp;
+    int          err;
+
+    buf     = g_string_sized_new(256);
+    version = STATE_VERSION;
+    count   = 0;
+
+    if (binary) {
+        g_string_append_len(buf, STATE_MAGIC, sizeof(STATE_MAGIC));
+        g_string_append_len(buf, (const gchar *)&version, sizeof(version));
+        g_string_append_len(buf, (const gchar *)&count, sizeof(count));
+    }
 
     for (l = ohm_fact_get_fields(fact); l != NULL; l = l->next) {
-        q = (GQuark)GPOINTER_TO_INT(l->data);
-        key = g_quark_to_string(q);
+        q     = (GQuark)GPOINTER_TO_INT(l->data);
+        key   = g_quark_to_string(q);
         value = ohm_fact_get(fact, key);
 
-        if ((err = save_field(fp, key, value)) != 0) {
-            fclose(fp);
-            unlink(PROFILE_SAVE_PATH);
-            return err;
+        if (value == NULL)
+            err = EINVAL;
+        else if (binary)
+            err = encode_binary(buf, key, value);
+        else
+            err = encode_text(buf, key, value);
+
+        if (err != 0) {
+            OHM_ERROR("profile: can't save field %s of type %s", key,
+                      value ? G_VALUE_TYPE_NAME(value) : "<none>");
+            g_string_free(buf, TRUE);
+            return NULL;
         }
+
+        count++;
     }
-    
-    fflush(fp);
-    /* fdatasync(fileno(fp)); */
-    fclose(fp);
+
+    if (binary) {
+        countp  = (uint32_t *)(buf->str + sizeof(STATE_MAGIC) + sizeof(version));
+        *countp = count;
+    }
+
+    return buf;
+}
+
+
+static int write_all(int fd, const char *data, size_t size)
+{
+    ssize_t n;
+
+    while (size > 0) {
+        if ((n = write(fd, data, size)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        data += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+
+static int state_write(OhmFact *fact)
+{
+    GString *buf;
+    gchar   *tmp, *dir;
+    int      fd, err;
+
+    if ((buf = state_encode(fact, state.binary)) == NULL)
+        return EINVAL;
+
+    if (state.saved != NULL && state.saved->len == buf->len &&
+        !memcmp(state.saved->str, buf->str, buf->len)) {
+        OHM_DEBUG(DBG_PROFILE, "profile state unchanged, not saving");
+        g_string_free(buf, TRUE);
+        return 0;
+    }
+
+    tmp = g_strdup_printf("%s.tmp", STATE_PATH);
+
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        err = errno;
+        goto fail;
+    }
+
+    if ((err = write_all(fd, buf->str, buf->len)) == 0 && fdatasync(fd) < 0)
+        err = errno;
+
+    if (err != 0) {
+        close(fd);
+        unlink(tmp);
+        goto fail;
+    }
+
+    close(fd);
+
+    if (rename(tmp, STATE_PATH) < 0) {
+        err = errno;
+        unlink(tmp);
+        goto fail;
+    }
+
+    /* make the rename itself durable */
+    dir = g_path_get_dirname(STATE_PATH);
+    if ((fd = open(dir, O_RDONLY)) >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    g_free(dir);
+
+    g_free(tmp);
+
+    if (state.saved != NULL)
+        g_string_free(state.saved, TRUE);
+    state.saved = buf;
+    state.nwrite++;
 
     OHM_INFO("Profile state saved.");
     return 0;
+
+ fail:
+    OHM_ERROR("profile: failed to save state to %s (%d: %s)", STATE_PATH,
+              err, strerror(err));
+    g_free(tmp);
+    g_string_free(buf, TRUE);
+    return err;
+}
+
+
+static int profile_flush_state(void)
+{
+    OhmFactStore *fs = ohm_fact_store_get_fact_store();
+    GSList       *list;
+
+    if (state.timer != 0) {
+        g_source_remove(state.timer);
+        state.timer = 0;
+    }
+
+    list = ohm_fact_store_get_facts_by_name(fs, FACTSTORE_PROFILE);
+
+    if (g_slist_length(list) != 1)
+        return ENOENT;
+
+    return state_write((OhmFact *)list->data);
+}
+
+
+static gboolean state_timer_cb(gpointer data)
+{
+    (void)data;
+
+    state.timer = 0;
+    profile_flush_state();
+
+    return FALSE;
+}
+
+
+static int profile_save_state(void)
+{
+    state.nsave++;
+
+    if (state.delay == 0)
+        return profile_flush_state();
+
+    if (state.timer == 0)
+        state.timer = g_timeout_add(state.delay, state_timer_cb, NULL);
+
+    return 0;
+}
+
+
+static void state_exit(void)
+{
+    if (state.timer != 0)
+        profile_flush_state();
+
+    OHM_INFO("profile: %d state saves requested, %d written",
+             state.nsave, state.nwrite);
+
+    if (state.saved != NULL) {
+        g_string_free(state.saved, TRUE);
+        state.saved = NULL;
+    }
+
+    g_free(state.path);
+    state.path = NULL;
+}
+
+
+static GValue *decode_number(char type, const char *val, size_t len)
+{
+    char   *e, *str;
+    long    i = 0;
+    double  d = 0.0;
+    int     ok;
+
+    if (type != 'i' && type != 'f')
+        return NULL;
+
+    str = g_strndup(val, len);
+
+    if (type == 'i')
+        i = strtol(str, &e, 10);
+    else
+        d = strtod(str, &e);
+
+    ok = (e != str && !*e);
+    g_free(str);
+
+    if (!ok)
+        return NULL;
+
+    return type == 'i' ? ohm_value_from_int((int)i) : ohm_value_from_double(d);
+}
+
+
+static int parse_text(OhmFact *fact, const char *p, const char *end)
+{
+    const char *key, *kend, *val, *vend;
+    gchar      *k;
+    GValue     *value;
+
+    while (p < end) {
+        key = p;
+        if ((kend = memchr(key, '\n', end - key)) == NULL || kend == key)
+            return EINVAL;
+
+        val = kend + 1;
+        if (val >= end || (vend = memchr(val, '\n', end - val)) == NULL ||
+            vend - val < 2 || val[1] != ':')
+            return EINVAL;
+
+        if (val[0] == 's') {
+            k     = g_strndup(val + 2, vend - val - 2);
+            value = ohm_value_from_string(k);
+            g_free(k);
+        }
+        else if ((value = decode_number(val[0], val + 2, vend - val - 2)) == NULL)
+            return EINVAL;
+
+        k = g_strndup(key, kend - key);
+        ohm_fact_set(fact, k, value);
+        g_free(k);
+
+        p = vend + 1;
+    }
+
+    return 0;
+}
+
+
+static int parse_binary(OhmFact *fact, const char *p, const char *end)
+{
+    uint32_t  version, count, vlen, i;
+    uint16_t  klen;
+    int32_t   n;
+    double    d;
+    char      type;
+    gchar    *k, *v;
+    GValue   *value;
+
+    p += sizeof(STATE_MAGIC);
+
+    if (end - p < (ptrdiff_t)(sizeof(version) + sizeof(count)))
+        return EINVAL;
+
+    memcpy(&version, p, sizeof(version)); p += sizeof(version);
+    memcpy(&count  , p, sizeof(count));   p += sizeof(count);
+
+    if (version != STATE_VERSION)
+        return EINVAL;
+
+    for (i = 0; i < count; i++) {
+        if (end - p < (ptrdiff_t)sizeof(klen))
+            return EINVAL;
+        memcpy(&klen, p, sizeof(klen)); p += sizeof(klen);
+
+        if (klen == 0 || end - p < (ptrdiff_t)(klen + 1 + sizeof(vlen)))
+            return EINVAL;
+        k = g_strndup(p, klen); p += klen;
+        type = *p++;
+        memcpy(&vlen, p, sizeof(vlen)); p += sizeof(vlen);
+
+        if (end - p < (ptrdiff_t)vlen) {
+            g_free(k);
+            return EINVAL;
+        }
+
+        value = NULL;
+        switch (type) {
+        case 's':
+            v     = g_strndup(p, vlen);
+            value = ohm_value_from_string(v);
+            g_free(v);
+            break;
+        case 'i':
+            if (vlen == sizeof(n)) {
+                memcpy(&n, p, sizeof(n));
+                value = ohm_value_from_int(n);
+            }
+            break;
+        case 'f':
+            if (vlen == sizeof(d)) {
+                memcpy(&d, p, sizeof(d));
+                value = ohm_value_from_double(d);
+            }
+            break;
+        }
+        p += vlen;
+
+        if (value == NULL) {
+            g_free(k);
+            return EINVAL;
+        }
+
+        ohm_fact_set(fact, k, value);
+        g_free(k);
+    }
+
+    return p == end ? 0 : EINVAL;
 }
 
 
@@ -361,17 +732,46 @@ static int profile_load_state(void)
     OhmFactStore *fs = ohm_fact_store_get_fact_store();
     OhmFact *fact;
     GSList *l, *n;
-    gchar key[128];
-    GValue *value;
-    FILE *fp;
-    int err;
+    struct stat st;
+    const char *data;
+    void *map;
+    int fd, err;
     
-    if ((fp = fopen(PROFILE_SAVE_PATH, "r")) == NULL) {
-        if (errno != ENOENT)
+    if ((fd = open(STATE_PATH, O_RDONLY)) < 0) {
+        err = errno;
+        if (err != ENOENT)
             OHM_ERROR("profile: could not load saved state from %s (%d: %s)",
-                      PROFILE_SAVE_PATH, errno, strerror(errno));
-        return errno;
+                      STATE_PATH, err, strerror(err));
+        return err;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        err = errno;
+        close(fd);
+        OHM_ERROR("profile: could not load saved state from %s (%d: %s)",
+                  STATE_PATH, err, strerror(err));
+        return err;
+    }
+
+    if (st.st_size > STATE_MAX_SIZE) {
+        err = EFBIG;
+        close(fd);
+        OHM_ERROR("profile: could not load saved state from %s (%d: %s)",
+                  STATE_PATH, err, strerror(err));
+        return err;
+    }
+
+    if (st.st_size == 0)
+        map = NULL;
+    else if ((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                         fd, 0)) == MAP_FAILED) {
+        err = errno;
+        close(fd);
+        OHM_ERROR("profile: could not map saved state %s (%d: %s)",
+                  STATE_PATH, err, strerror(err));
+        return err;
     }
+    close(fd);
 
     /* remove any old profile facts */
     l = ohm_fact_store_get_facts_by_name(fs, FACTSTORE_PROFILE);
@@ -384,16 +784,23 @@ static int profile_load_state(void)
     /* create new fact and populate it with saved fields */
     if ((fact = ohm_fact_new(FACTSTORE_PROFILE)) == NULL) {
         OHM_ERROR("profile: failed to create fact %s", FACTSTORE_PROFILE);
-        fclose(fp);
+        if (map != NULL)
+            munmap(map, st.st_size);
         return ENOMEM;
     }
+
+    data = (const char *)map;
+
+    if (st.st_size >= (off_t)sizeof(STATE_MAGIC) &&
+        !memcmp(data, STATE_MAGIC, sizeof(STATE_MAGIC)))
+        err = parse_binary(fact, data, data + st.st_size);
+    else
+        err = parse_text(fact, data, data + st.st_size);
+
+    if (map != NULL)
+        munmap(map, st.st_size);
     
-    while ((err = load_field(fp, key, sizeof(key), &value)) == 0)
-        ohm_fact_set(fact, key, value);
-    
-    fclose(fp);
-    
-    if (err != ENOENT) {
+    if (err != 0) {
         g_object_unref(fact);
         OHM_ERROR("profile: failed to load saved state");
         return err;
@@ -448,6 +855,8 @@ static void profile_value_change(const char *profile, const char *key,
 
         OHM_DEBUG(DBG_PROFILE, "changing key %s with new value '%s'", key, val);
         ohm_fact_set(fact, key, gval);
+
+        profile_save_state();
     }
     else {
         OHM_DEBUG(DBG_PROFILE, "Error, no facts or empty key");
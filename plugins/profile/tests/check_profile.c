@@ -393,6 +393,78 @@ START_TEST (test_profile_value_change)
 
 END_TEST
 
+START_TEST (test_state_persistence)
+
+    OhmFactStore *fs = ohm_fact_store_get_fact_store();
+    OhmFact *fact;
+    GSList *list;
+    GValue *gv;
+    char path[] = "/tmp/check_profile.XXXXXX";
+    int fd, binary, nwrite;
+
+    fd = mkstemp(path);
+    fail_if(fd < 0, "failed to create temporary state file");
+    close(fd);
+
+    state.path  = g_strdup(path);
+    state.delay = 1000;
+
+    for (binary = FALSE; binary <= TRUE; binary++) {
+        state.binary = binary;
+
+        /* start from a single profile fact with one field of each type */
+        list = ohm_fact_store_get_facts_by_name(fs, FACTSTORE_PROFILE);
+        while (list != NULL) {
+            ohm_fact_store_remove(fs, list->data);
+            list = ohm_fact_store_get_facts_by_name(fs, FACTSTORE_PROFILE);
+        }
+
+        fact = ohm_fact_new(FACTSTORE_PROFILE);
+        ohm_fact_set(fact, PROFILE_NAME_KEY, ohm_value_from_string("silent"));
+        ohm_fact_set(fact, "ringing.alert.volume", ohm_value_from_int(42));
+        ohm_fact_set(fact, "ringing.alert.gain", ohm_value_from_double(0.5));
+        ohm_fact_store_insert(fs, fact);
+
+        /* a burst of save requests must not write anything yet */
+        nwrite = state.nwrite;
+        profile_save_state();
+        profile_save_state();
+        profile_save_state();
+        fail_unless(state.nwrite == nwrite, "save was not coalesced");
+        fail_unless(state.timer != 0, "no pending save");
+
+        fail_unless(profile_flush_state() == 0, "failed to save state");
+        fail_unless(state.nwrite == nwrite + 1, "state saved %d times",
+                    state.nwrite - nwrite);
+
+        /* an identical state is not rewritten */
+        fail_unless(profile_flush_state() == 0, "failed to save state");
+        fail_unless(state.nwrite == nwrite + 1, "unchanged state rewritten");
+
+        fail_unless(profile_load_state() == 0, "failed to load state");
+
+        list = ohm_fact_store_get_facts_by_name(fs, FACTSTORE_PROFILE);
+        fail_if(g_slist_length(list) != 1, "wrong number of facts: %d",
+                g_slist_length(list));
+        fact = list->data;
+
+        gv = ohm_fact_get(fact, PROFILE_NAME_KEY);
+        fail_unless(gv != NULL && G_VALUE_TYPE(gv) == G_TYPE_STRING &&
+                    !strcmp(g_value_get_string(gv), "silent"),
+                    "string field not restored");
+        gv = ohm_fact_get(fact, "ringing.alert.volume");
+        fail_unless(gv != NULL && G_VALUE_TYPE(gv) == G_TYPE_INT &&
+                    g_value_get_int(gv) == 42, "integer field not restored");
+        gv = ohm_fact_get(fact, "ringing.alert.gain");
+        fail_unless(gv != NULL && G_VALUE_TYPE(gv) == G_TYPE_DOUBLE &&
+                    g_value_get_double(gv) == 0.5, "double field not restored");
+    }
+
+    unlink(path);
+    state_exit();
+
+END_TEST
+
 Suite *ohm_profile_suite(void)
 {
     Suite *suite = suite_create("ohm_profile");
@@ -402,6 +474,7 @@ Suite *ohm_profile_suite(void)
 
     tcase_add_test(tc_all, test_profile_init_deinit);
     tcase_add_test(tc_all, find_segfault);
+    tcase_add_test(tc_all, test_state_persistence);
     //tcase_add_test(tc_all, find_segfault_2);
     //tcase_add_test(tc_all, test_profile_name_change);
     //tcase_add_test(tc_all, test_profile_value_change);
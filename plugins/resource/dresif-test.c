@@ -0,0 +1,223 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Resolver batch test.
+ *
+ * Queues more resolver requests than fit in a batch from within the
+ * transaction of a single request, the way manager_acquire does, and
+ * checks that the queue is never flushed underneath that transaction,
+ * that the transaction completes normally, and that the whole batch is
+ * then resolved from the main loop in order, without waiting for the
+ * batching window. Usage:
+ *
+ *     dresif-test [requests]
+ */
+
+#include "transaction.c"
+#include "dresif.c"
+#include "test-stubs.h"
+
+#define DEFAULT_REQUESTS   (3 * BATCH_MAX + 5)
+#define WINDOW_MSECS       60000
+
+static uint32_t  trans_id = NO_TRANSACTION;    /* like manager.c */
+static uint32_t  caller_id;
+static int       ncaller;                      /* caller completions */
+static uint32_t  nexpected;                    /* next request in order */
+static int       nresolved;
+static int       nbatch;
+static int       nresolve;
+static int       nfailed;
+
+
+static int fake_resolve(char *goal, char **locals)
+{
+    (void)goal;
+    (void)locals;
+
+    nresolve++;
+
+    return 1;
+}
+
+
+static void caller_done(uint32_t *ids, int nid, uint32_t txid, void *data)
+{
+    (void)data;
+
+    if (txid != caller_id) {
+        fprintf(stderr, "transaction %u completed instead of caller %u\n",
+                txid, caller_id);
+        nfailed++;
+    }
+
+    if (nid != 1 || ids[0] != 1) {
+        fprintf(stderr, "caller transaction lost its resource set\n");
+        nfailed++;
+    }
+
+    ncaller++;
+}
+
+
+static void batch_done(uint32_t *ids, int nid, uint32_t txid, void *data)
+{
+    (void)ids;
+    (void)nid;
+    (void)txid;
+    (void)data;
+}
+
+
+static void batch_handler(int stage, dresif_request_t *reqs, int nreq)
+{
+    static uint32_t saved_id = NO_TRANSACTION;
+    int i;
+
+    switch (stage) {
+
+    case DRESIF_BATCH_START:
+        if (trans_id != NO_TRANSACTION) {
+            fprintf(stderr, "batch flushed inside transaction %u\n",
+                    trans_id);
+            nfailed++;
+        }
+
+        saved_id = trans_id;
+        trans_id = transaction_create(batch_done, NULL);
+
+        for (i = 0;  i < nreq;  i++) {
+            if (reqs[i].manager_id != nexpected) {
+                fprintf(stderr, "request %u resolved instead of %u\n",
+                        reqs[i].manager_id, nexpected);
+                nfailed++;
+            }
+            nexpected = reqs[i].manager_id + 1;
+        }
+
+        nresolved += nreq;
+        nbatch++;
+        break;
+
+    case DRESIF_BATCH_END:
+        transaction_unref(trans_id);
+        trans_id = saved_id;
+        break;
+    }
+}
+
+
+static void run(int window, int nreq)
+{
+    uint32_t i;
+    int      n;
+
+    batch.window = window;
+    nexpected = nresolved = nbatch = nresolve = ncaller = 0;
+
+    /* a client request: start its transaction and queue in it */
+    caller_id = trans_id = transaction_create(caller_done, NULL);
+
+    if (caller_id == NO_TRANSACTION)
+        fatal("failed to create caller transaction");
+
+    transaction_add_resource_set(caller_id, 1);
+
+    for (i = 0;  i < (uint32_t)nreq;  i++) {
+        if (!dresif_queue_request(i, "acquire", (i & 1), i))
+            fatal("failed to queue request #%u", i);
+
+        if (trans_id != caller_id) {
+            fprintf(stderr, "caller transaction replaced by %u after "
+                    "request #%u\n", trans_id, i);
+            nfailed++;
+            trans_id = caller_id;
+        }
+    }
+
+    if (nbatch != 0) {
+        fprintf(stderr, "%d batches flushed while queueing\n", nbatch);
+        nfailed++;
+    }
+
+    transaction_unref(trans_id);
+    trans_id = NO_TRANSACTION;
+
+    if (ncaller != 1) {
+        fprintf(stderr, "caller transaction completed %d times\n", ncaller);
+        nfailed++;
+    }
+
+    /* a full batch must not wait for the window to pass */
+    for (n = 0;  n < 10 && nresolved < nreq;  n++)
+        g_main_context_iteration(NULL, FALSE);
+
+    if (nresolved != nreq) {
+        fprintf(stderr, "window %d: %d of %d requests resolved\n",
+                window, nresolved, nreq);
+        nfailed++;
+    }
+
+    if (nresolve != nbatch) {
+        fprintf(stderr, "window %d: %d resolutions for %d batches\n",
+                window, nresolve, nbatch);
+        nfailed++;
+    }
+
+    printf("window %d: %d requests in %d batch(es), %d resolution(s)\n",
+           window, nresolved, nbatch, nresolve);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int nreq = DEFAULT_REQUESTS;
+
+    if (argc > 1 && (nreq = (int)strtol(argv[1], NULL, 10)) <= BATCH_MAX)
+        fatal("number of requests must be above %d", BATCH_MAX);
+
+    resolve = fake_resolve;
+    dresif_set_batch_handler(batch_handler);
+
+    run(BATCH_IDLE, nreq);
+    run(WINDOW_MSECS, nreq);
+
+    dresif_exit(NULL);
+
+    if (transaction_pending() != 0) {
+        fprintf(stderr, "%d transactions left pending\n",
+                transaction_pending());
+        nfailed++;
+    }
+
+    printf("%s\n", nfailed ? "FAILED" : "PASSED");
+
+    return nfailed ? 1 : 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
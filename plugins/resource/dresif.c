@@ -24,6 +24,7 @@ USA.
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #include "plugin.h"
 #include "dresif.h"
@@ -33,9 +34,35 @@ USA.
 #define DRESIF_VARTYPE(t)  (char *)(t)
 #define DRESIF_VARVALUE(v) (char *)(v)
 
+#define BATCH_OFF      -1       /* resolve every request right away */
+#define BATCH_IDLE      0       /* collect requests of a main loop round */
+#define BATCH_MAX      64       /* flush without waiting from this size on */
+
+typedef struct {
+    int                  window;    /* BATCH_OFF, BATCH_IDLE or msecs */
+    dresif_batch_cb_t    handler;   /* called around the resolution */
+    dresif_request_t    *reqs;      /* queued requests */
+    int                  nreq;
+    int                  size;      /* allocated size of reqs */
+    guint                srcid;     /* idle/timer source for the flush */
+    int                  urgent;    /* srcid is an immediate idle flush */
+} batch_t;
+
+typedef struct {
+    unsigned int         nresolve;  /* number of resolver invocations */
+    unsigned int         nrequest;  /* number of requests resolved */
+    double               usecs;     /* total time spent in the resolver */
+} stats_t;
+
 
 OHM_IMPORTABLE(int, resolve, (char *goal, char **locals));
 
+static batch_t  batch = { .window = BATCH_OFF };
+static stats_t  stats;
+
+static int      timed_resolve(char **, int);
+static gboolean batch_flush(gpointer);
+
 
 /*! \addtogroup pubif
  *  Functions
@@ -46,8 +73,8 @@ void dresif_init(OhmPlugin *plugin)
 {
     char *name      = "dres.resolve";
     char *signature = (char *)resolve_SIGNATURE;
-
-    (void)plugin;
+    const char *window;
+    char       *e;
 
     ENTER;
 
@@ -58,9 +85,130 @@ void dresif_init(OhmPlugin *plugin)
         exit(1);
     }
 
+    /*
+     * Notes: batching needs a rule base that handles the 'batch' local
+     *   variable of resource_request, hence it is off unless configured.
+     */
+    if ((window = ohm_plugin_get_param(plugin, "resolver-batch")) != NULL) {
+        if (!strcmp(window, "off"))
+            batch.window = BATCH_OFF;
+        else if (!strcmp(window, "idle"))
+            batch.window = BATCH_IDLE;
+        else {
+            batch.window = strtol(window, &e, 10);
+
+            if (*e != '\0' || batch.window < 0) {
+                OHM_ERROR("resource: invalid value '%s' for "
+                          "'resolver-batch'", window);
+                batch.window = BATCH_OFF;
+            }
+        }
+    }
+
+    switch (batch.window) {
+    case BATCH_OFF:
+        OHM_INFO("resource: resolver batching is disabled");
+        break;
+    case BATCH_IDLE:
+        OHM_INFO("resource: resolver batching per main loop iteration");
+        break;
+    default:
+        OHM_INFO("resource: resolver batching window is %dmsec",batch.window);
+        break;
+    }
+
     LEAVE;
 }
 
+void dresif_exit(OhmPlugin *plugin)
+{
+    (void)plugin;
+
+    if (batch.srcid != 0) {
+        g_source_remove(batch.srcid);
+        batch_flush(NULL);
+    }
+
+    g_free(batch.reqs);
+    batch.reqs = NULL;
+    batch.size = 0;
+
+    if (stats.nresolve > 0) {
+        OHM_INFO("resource: %u requests in %u resolutions "
+                 "(%.2f requests/resolution, %.1f usecs/request)",
+                 stats.nrequest, stats.nresolve,
+                 (double)stats.nrequest / (double)stats.nresolve,
+                 stats.nrequest ? stats.usecs / stats.nrequest : 0.0);
+    }
+}
+
+void dresif_set_batch_handler(dresif_batch_cb_t handler)
+{
+    batch.handler = handler;
+}
+
+/*
+ * Notes:
+ *   This is called from within the transaction of the manager request
+ *   that queues it. Resolving the batch runs a transaction of its own,
+ *   so the queue must never be flushed from here: a full batch just
+ *   grows and gets an immediate idle flush instead of waiting for the
+ *   batching window.
+ */
+
+int dresif_queue_request(uint32_t  manager_id,
+                         char     *request,
+                         int       reply,
+                         uint32_t  reqno)
+{
+    dresif_request_t *req;
+    guint             srcid;
+    int               urgent;
+
+    if (batch.window == BATCH_OFF)
+        return FALSE;
+
+    if (batch.nreq >= batch.size) {
+        batch.size = batch.size ? 2 * batch.size : BATCH_MAX;
+        batch.reqs = g_renew(dresif_request_t, batch.reqs, batch.size);
+    }
+
+    urgent = (batch.window == BATCH_IDLE || batch.nreq + 1 >= BATCH_MAX);
+
+    if (batch.srcid == 0 || (urgent && !batch.urgent)) {
+        if (urgent)
+            srcid = g_idle_add(batch_flush, NULL);
+        else
+            srcid = g_timeout_add(batch.window, batch_flush, NULL);
+
+        if (srcid == 0 && batch.srcid == 0) {
+            /* let the caller resolve it outside of the batch */
+            OHM_ERROR("resource: failed to schedule resolver batch");
+            return FALSE;
+        }
+
+        if (srcid != 0) {
+            if (batch.srcid != 0)
+                g_source_remove(batch.srcid);
+
+            batch.srcid  = srcid;
+            batch.urgent = urgent;
+        }
+    }
+
+    req = batch.reqs + batch.nreq++;
+
+    req->manager_id = manager_id;
+    req->request    = request;
+    req->reply      = reply;
+    req->reqno      = reqno;
+
+    OHM_DEBUG(DBG_DRES, "queued '%s' request for manager id %u (%d in batch)",
+              request, manager_id, batch.nreq);
+
+    return TRUE;
+}
+
 
 int dresif_resource_request(uint32_t  manager_id,
                             char     *client_name,
@@ -93,9 +241,7 @@ int dresif_resource_request(uint32_t  manager_id,
 #endif
     vars[++i] = NULL;
 
-    timestamp_add("resource request -- resolving start");
-    status = resolve("resource_request", vars);
-    timestamp_add("resource request -- resolving end");
+    status = timed_resolve(vars, 1);
     
     if (status < 0) {
         OHM_DEBUG(DBG_DRES, "resolving resource_request for %s/%d "
@@ -124,6 +270,111 @@ int dresif_resource_request(uint32_t  manager_id,
  * @}
  */
 
+static int timed_resolve(char **vars, int nreq)
+{
+    struct timeval start, end;
+    int            status;
+
+    gettimeofday(&start, NULL);
+
+    timestamp_add("resource request -- resolving start");
+    status = resolve("resource_request", vars);
+    timestamp_add("resource request -- resolving end");
+
+    gettimeofday(&end, NULL);
+
+    stats.nresolve++;
+    stats.nrequest += nreq;
+    stats.usecs    += (end.tv_sec  - start.tv_sec) * 1000000.0 +
+                      (end.tv_usec - start.tv_usec);
+
+    return status;
+}
+
+static gboolean batch_flush(gpointer data)
+{
+    dresif_request_t *reqs;
+    dresif_request_t *req, *last;
+    char             *vars[16];
+    char             *list;
+    char             *p, *e;
+    int               nreq;
+    int               status;
+    int               i;
+
+    (void)data;
+
+    batch.srcid  = 0;
+    batch.urgent = FALSE;
+
+    if ((nreq = batch.nreq) == 0)
+        return FALSE;
+
+    /* anything queued while we are busy here goes to the next batch */
+    reqs = batch.reqs;
+    batch.reqs = NULL;
+    batch.nreq = 0;
+    batch.size = 0;
+
+    list = g_malloc(nreq * 24 + 1);
+
+    /*
+     * the rule base sees the last request in the usual way and the
+     * whole batch as a 'manager_id:request ...' list in 'batch'
+     */
+    p = list;
+    e = list + nreq * 24 + 1;
+    *p = '\0';
+
+    for (i = 0;  i < nreq && p < e;  i++) {
+        req = reqs + i;
+        p  += snprintf(p, e - p, "%s%u:%s", i ? " " : "",
+                       req->manager_id, req->request);
+    }
+
+    last = reqs + nreq - 1;
+
+    vars[i=0] = "manager_id";
+    vars[++i] = DRESIF_VARTYPE('i');
+    vars[++i] = DRESIF_VARVALUE(last->manager_id);
+
+    vars[++i] = "request";
+    vars[++i] = DRESIF_VARTYPE('s');
+    vars[++i] = DRESIF_VARVALUE(last->request);
+
+    vars[++i] = "batch";
+    vars[++i] = DRESIF_VARTYPE('s');
+    vars[++i] = DRESIF_VARVALUE(list);
+
+    vars[++i] = NULL;
+
+    if (batch.handler != NULL)
+        batch.handler(DRESIF_BATCH_START, reqs, nreq);
+
+    status = timed_resolve(vars, nreq);
+
+    if (status <= 0) {
+        OHM_DEBUG(DBG_DRES, "resolving batch of %d resource_request(s) "
+                  "failed (%d)", nreq, status);
+    }
+    else {
+        OHM_DEBUG(DBG_DRES, "successfully resolved batch of %d "
+                  "resource_request(s): %s", nreq, list);
+    }
+
+    if (batch.handler != NULL)
+        batch.handler(DRESIF_BATCH_END, reqs, nreq);
+
+    OHM_DEBUG(DBG_DRES, "resolver statistics: %.2f requests/resolution, "
+              "%.1f usecs/request", (double)stats.nrequest/stats.nresolve,
+              stats.usecs / stats.nrequest);
+
+    g_free(list);
+    g_free(reqs);
+
+    return FALSE;
+}
+
 
 /* 
  * Local Variables:
@@ -26,7 +26,22 @@ USA.
 /* hack to avoid multiple includes */
 typedef struct _OhmPlugin OhmPlugin;
 
+#define DRESIF_BATCH_START  0   /* batch is about to be resolved */
+#define DRESIF_BATCH_END    1   /* batch has been resolved */
+
+typedef struct {
+    uint32_t  manager_id;       /* resource set the request is for */
+    char     *request;          /* 'acquire', 'release', etc. */
+    int       reply;            /* client expects a grant in any case */
+    uint32_t  reqno;            /* request number of the reply */
+} dresif_request_t;
+
+typedef void (*dresif_batch_cb_t)(int, dresif_request_t *, int);
+
 void dresif_init(OhmPlugin *);
+void dresif_exit(OhmPlugin *);
+void dresif_set_batch_handler(dresif_batch_cb_t);
+int  dresif_queue_request(uint32_t, char *, int, uint32_t);
 int  dresif_resource_request(uint32_t, char *, uint32_t, char *);
 
 
@@ -62,6 +62,8 @@ static uint32_t     trans_id;
 static reg_data_t  *reg_reqs;
 
 static void forced_auto_release(resource_set_t *);
+static int  request_resolution(resource_set_t *, char *, int);
+static void batch_handler(int, dresif_request_t *, int);
 
 static void keyword_list(char *, char **, int);
 
@@ -112,6 +114,8 @@ void manager_init(OhmPlugin *plugin)
     ADD_FIELD_WATCH("request", request_cb);
     ADD_FIELD_WATCH("block"  , block_cb  );
 
+    dresif_set_batch_handler(batch_handler);
+
     LEAVE;
 
 #undef ADD_FIELD_WATCH
@@ -163,7 +167,9 @@ void manager_unregister(resmsg_t *msg, resset_t *resset, void *proto_data)
     if (rs)
         resource_set_destroy(resset);
 
-    if (manager_id) {
+    if (manager_id &&
+        !dresif_queue_request(manager_id, "unregister", FALSE, 0))
+    {
         dresif_resource_request(manager_id, client_name, client_id,
                                 "unregister");
     }
@@ -203,6 +209,7 @@ void manager_update(resmsg_t *msg, resset_t *resset, void *proto_data)
  /* uint32_t         reqno  = record->reqno; */
     int32_t          errcod = 0;
     const char      *errmsg = "OK";
+    int              deferred = FALSE;
 
     resource_set_dump_message(msg, resset, "from");
 
@@ -244,13 +251,14 @@ void manager_update(resmsg_t *msg, resset_t *resset, void *proto_data)
         rs->granted.client != 0)
         resource_set_update_factstore(resset, update_request);
 
-    dresif_resource_request(rs->manager_id, resset->peer, resset->id, "update");
+    deferred = request_resolution(rs, "update", TRUE);
 
  reply_message:
     OHM_DEBUG(DBG_MGR, "message replied with %d '%s'", errcod, errmsg);
     resproto_reply_message(resset, msg, proto_data, errcod, errmsg);
 
-    if (trans_id != NO_TRANSACTION && (resset->mode & RESMSG_MODE_ALWAYS_REPLY))
+    if (!deferred && trans_id != NO_TRANSACTION &&
+        (resset->mode & RESMSG_MODE_ALWAYS_REPLY))
         resource_set_queue_change(rs, trans_id, rs->reqno, resource_set_granted);
 
     transaction_end(rs);
@@ -263,6 +271,7 @@ void manager_acquire(resmsg_t *msg, resset_t *resset, void *proto_data)
     int32_t         errcod = 0;
     const char     *errmsg = "OK";
     int             acquire;
+    int             deferred = FALSE;
 
     resource_set_dump_message(msg, resset, "from");
 
@@ -292,8 +301,7 @@ void manager_acquire(resmsg_t *msg, resset_t *resset, void *proto_data)
 
         if (acquire) {
             resource_set_update_factstore(resset, update_request);
-            dresif_resource_request(rs->manager_id, resset->peer,
-                                    resset->id, "acquire");
+            deferred = request_resolution(rs, "acquire", TRUE);
         }
     }
 
@@ -301,7 +309,9 @@ void manager_acquire(resmsg_t *msg, resset_t *resset, void *proto_data)
 
     resproto_reply_message(resset, msg, proto_data, errcod, errmsg);
 
-    if (rs && trans_id && (resset->mode & RESMSG_MODE_ALWAYS_REPLY)) {
+    if (rs && !deferred && trans_id &&
+        (resset->mode & RESMSG_MODE_ALWAYS_REPLY))
+    {
         resource_set_queue_change(rs,trans_id,rs->reqno,resource_set_granted);
     }
 
@@ -315,6 +325,7 @@ void manager_release(resmsg_t *msg, resset_t *resset, void *proto_data)
     int32_t         errcod = 0;
     const char     *errmsg = "OK";
     int             release;
+    int             deferred = FALSE;
 
     resource_set_dump_message(msg, resset, "from");
 
@@ -348,8 +359,7 @@ void manager_release(resmsg_t *msg, resset_t *resset, void *proto_data)
 
         if (release) {
             resource_set_update_factstore(resset, update_request);
-            dresif_resource_request(rs->manager_id, resset->peer,
-                                    resset->id, "release");
+            deferred = request_resolution(rs, "release", TRUE);
         }
     }
 
@@ -357,7 +367,9 @@ void manager_release(resmsg_t *msg, resset_t *resset, void *proto_data)
 
     resproto_reply_message(resset, msg, proto_data, errcod, errmsg);
 
-    if (rs && trans_id && (resset->mode & RESMSG_MODE_ALWAYS_REPLY)) {
+    if (rs && !deferred && trans_id &&
+        (resset->mode & RESMSG_MODE_ALWAYS_REPLY))
+    {
         resource_set_queue_change(rs,trans_id,rs->reqno,resource_set_granted);
     }
 
@@ -393,10 +405,8 @@ void manager_audio(resmsg_t *msg, resset_t *resset, void *proto_data)
         success = resource_set_add_spec(resset, resource_audio, group, pid,
                                         propnam, method,pattern);
 
-        if (success) {
-            dresif_resource_request(rs->manager_id, resset->peer,
-                                    resset->id, "audio");
-        }
+        if (success)
+            request_resolution(rs, "audio", FALSE);
     }
 
     OHM_DEBUG(DBG_MGR, "message replied with %d '%s'", errcod, errmsg);
@@ -428,10 +438,8 @@ void manager_video(resmsg_t *msg, resset_t *resset, void *proto_data)
     else {
         success = resource_set_add_spec(resset, resource_video, pid);
 
-        if (success) {
-            dresif_resource_request(rs->manager_id, resset->peer,
-                                    resset->id, "video");
-        }
+        if (success)
+            request_resolution(rs, "video", FALSE);
     }
 
     OHM_DEBUG(DBG_MGR, "message replied with %d '%s'", errcod, errmsg);
@@ -466,14 +474,81 @@ static void forced_auto_release(resource_set_t *rs)
             resource_set_update_factstore(resset, update_block);
             resource_set_update_factstore(resset, update_request);
 
-            dresif_resource_request(rs->manager_id, resset->peer,
-                                    resset->id, "release");
+            request_resolution(rs, "release", FALSE);
 
             transaction_end(rs);
         }
     }
 }
 
+static int request_resolution(resource_set_t *rs, char *request, int reply)
+{
+    resset_t *resset = rs->resset;
+
+    reply = reply && (trans_id != NO_TRANSACTION) &&
+            (resset->mode & RESMSG_MODE_ALWAYS_REPLY);
+
+    if (dresif_queue_request(rs->manager_id, request, reply, rs->reqno))
+        return TRUE;
+
+    dresif_resource_request(rs->manager_id, resset->peer, resset->id, request);
+
+    return FALSE;
+}
+
+static void batch_handler(int stage, dresif_request_t *reqs, int nreq)
+{
+    static uint32_t saved_id = NO_TRANSACTION;
+
+    resource_set_t *rs;
+    int             i;
+
+    /*
+     * Run the resolution of the batch in a transaction of its own, so
+     * that the grants and advices it produces are sent out together.
+     * Sets that want a reply in any case get one per request, each
+     * with its original request number, the same way as in the
+     * non-batched case; rs->reqno only keeps grant_cb from queueing
+     * a reply-less grant meanwhile. Any transaction in progress is put
+     * aside and restored afterwards.
+     */
+    switch (stage) {
+
+    case DRESIF_BATCH_START:
+        saved_id = trans_id;
+        transaction_start(NULL, NULL);
+
+        for (i = 0;  i < nreq;  i++) {
+            if (reqs[i].reply &&
+                (rs = resource_set_find_by_id(reqs[i].manager_id)) != NULL)
+                rs->reqno = reqs[i].reqno;
+        }
+        break;
+
+    case DRESIF_BATCH_END:
+        for (i = 0;  i < nreq;  i++) {
+            if (reqs[i].reply &&
+                (rs = resource_set_find_by_id(reqs[i].manager_id)) != NULL)
+            {
+                if (trans_id != NO_TRANSACTION) {
+                    resource_set_queue_change(rs, trans_id, reqs[i].reqno,
+                                              resource_set_granted);
+                }
+                rs->reqno = 0;
+            }
+        }
+
+        transaction_end(NULL);
+
+        trans_id = saved_id;
+        saved_id = NO_TRANSACTION;
+        break;
+
+    default:
+        break;
+    }
+}
+
 static void keyword_list(char *str, char **list, int length)
 {
     char *p;
@@ -567,7 +642,7 @@ static void register_cb(int32_t errcod, reg_data_t *regreq)
     }
 
     transaction_start(rs, msg);
-    dresif_resource_request(rs->manager_id, resset->peer, resset->id, "register");
+    request_resolution(rs, "register", FALSE);
 
  reply_message:
     OHM_DEBUG(DBG_MGR, "message replied with %d '%s'", errcod, errmsg);
@@ -874,12 +949,9 @@ static void transaction_end(resource_set_t *rs)
 
 static void transaction_complete(uint32_t *ids,int nid,uint32_t txid,void *ud)
 {
-    int i;
-
     (void)ud;
 
-    for (i = 0;   i < nid;   i++)
-        resource_set_send_queued_changes(ids[i], txid);
+    resource_set_send_queued_batch(ids, nid, txid);
 }
 
 
@@ -111,6 +111,7 @@ static void plugin_init(OhmPlugin *plugin)
 
 static void plugin_destroy(OhmPlugin *plugin)
 {
+    dresif_exit(plugin);
     auth_exit(plugin);
     fsif_exit(plugin);
 }
@@ -131,7 +132,7 @@ OHM_PLUGIN_PROVIDES(
     "maemo.resource"
 );
 
-OHM_PLUGIN_REQUIRES("dres");
+OHM_PLUGIN_REQUIRES("dres", "signaling");
 
 
 OHM_PLUGIN_DBUS_SIGNALS(
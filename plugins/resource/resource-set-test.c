@@ -0,0 +1,280 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Grant queue test.
+ *
+ * Queues more grants with distinct request numbers than fit in the
+ * in-place ring of a resource set, then checks that every one of them
+ * is sent, in order and with its own value, once the transaction
+ * completes. Also checks that a grant of a later transaction is not
+ * folded into a full ring of an earlier one. Usage:
+ *
+ *     resource-set-test [grants]
+ */
+
+#include <unistd.h>
+
+#include "transaction.c"
+#include "resource-set.c"
+#include "test-stubs.h"
+
+#define DEFAULT_GRANTS   (4 * RESOURCE_SET_QUEUE_DIM + 3)
+#define VALUE(reqno)     ((reqno) * 16 + 1)
+
+static resset_t  resset;
+static uint32_t  sent_reqno[1024];
+static uint32_t  sent_value[1024];
+static int       nmsg;
+static int       nfailed;
+
+
+/*
+ * stubs for the factstore and the rest of libresource
+ */
+
+int fsif_add_factstore_entry(char *name, fsif_field_t *fields)
+{
+    (void)name;
+    (void)fields;
+
+    return TRUE;
+}
+
+
+int fsif_delete_factstore_entry(char *name, fsif_field_t *fields)
+{
+    (void)name;
+    (void)fields;
+
+    return TRUE;
+}
+
+
+int fsif_update_factstore_entry(char *name, fsif_field_t *selist,
+                                fsif_field_t *fldlist)
+{
+    (void)name;
+    (void)selist;
+    (void)fldlist;
+
+    return TRUE;
+}
+
+
+void fsif_get_field_by_entry(fsif_entry_t *entry, fsif_fldtype_t type,
+                             char *name, void *vptr)
+{
+    (void)entry;
+    (void)type;
+    (void)name;
+    (void)vptr;
+}
+
+
+resource_spec_t *resource_spec_create(resource_set_t *rs,
+                                      resource_spec_type_t type,
+                                      va_list args)
+{
+    (void)rs;
+    (void)type;
+    (void)args;
+
+    return NULL;
+}
+
+
+void resource_spec_destroy(resource_spec_t *spec)
+{
+    (void)spec;
+}
+
+
+int resource_spec_update(resource_spec_t *spec, resource_set_t *rs,
+                         resource_spec_type_t type, va_list args)
+{
+    (void)spec;
+    (void)rs;
+    (void)type;
+    (void)args;
+
+    return TRUE;
+}
+
+
+char *resmsg_dump_message(resmsg_t *msg, int indent, char *buf, int len)
+{
+    (void)msg;
+    (void)indent;
+    (void)len;
+
+    *buf = '\0';
+
+    return buf;
+}
+
+
+int resproto_send_message(resset_t *rset, resmsg_t *msg,
+                          resproto_status_t status)
+{
+    (void)rset;
+    (void)status;
+
+    if (msg->type != RESMSG_GRANT)
+        return TRUE;
+
+    if (nmsg < (int)(sizeof(sent_reqno) / sizeof(sent_reqno[0]))) {
+        sent_reqno[nmsg] = msg->notify.reqno;
+        sent_value[nmsg] = msg->notify.resrc;
+    }
+
+    nmsg++;
+
+    return TRUE;
+}
+
+
+static void completed(uint32_t *ids, int nid, uint32_t txid, void *data)
+{
+    (void)data;
+
+    resource_set_send_queued_batch(ids, nid, txid);
+}
+
+
+static void queue_grant(resource_set_t *rs, uint32_t txid, uint32_t reqno,
+                        uint32_t value)
+{
+    rs->granted.factstore = value;
+    resource_set_queue_change(rs, txid, reqno, resource_set_granted);
+}
+
+
+static void overflow(resource_set_t *rs, int ngrant)
+{
+    uint32_t txid, reqno;
+    int      i;
+
+    nmsg = 0;
+
+    if ((txid = transaction_create(completed, NULL)) == NO_TRANSACTION)
+        fatal("failed to create transaction");
+
+    for (reqno = 1;  reqno <= (uint32_t)ngrant;  reqno++)
+        queue_grant(rs, txid, reqno, VALUE(reqno));
+
+    transaction_unref(txid);
+
+    if (nmsg != ngrant) {
+        fprintf(stderr, "%d grants sent for %d requests\n", nmsg, ngrant);
+        nfailed++;
+    }
+
+    for (i = 0;  i < nmsg && i < ngrant;  i++) {
+        if (sent_reqno[i] != (uint32_t)i + 1 ||
+            sent_value[i] != VALUE(sent_reqno[i])) {
+            fprintf(stderr, "grant #%d: reqno %u value %u\n", i,
+                    sent_reqno[i], sent_value[i]);
+            nfailed++;
+        }
+    }
+
+    printf("%d grants queued, %d sent\n", ngrant, nmsg);
+}
+
+
+static void later_transaction(resource_set_t *rs)
+{
+    uint32_t first, second, reqno;
+    uint32_t later = VALUE(1000);
+
+    nmsg = 0;
+
+    first  = transaction_create(completed, NULL);
+    second = transaction_create(completed, NULL);
+
+    if (first == NO_TRANSACTION || second == NO_TRANSACTION)
+        fatal("failed to create transactions");
+
+    for (reqno = 1;  reqno <= RESOURCE_SET_QUEUE_DIM;  reqno++)
+        queue_grant(rs, first, reqno, VALUE(reqno));
+
+    queue_grant(rs, second, 0, later);
+
+    transaction_unref(second);
+    transaction_unref(first);
+
+    if (nmsg != RESOURCE_SET_QUEUE_DIM + 1 ||
+        sent_reqno[RESOURCE_SET_QUEUE_DIM - 1] != RESOURCE_SET_QUEUE_DIM ||
+        sent_value[RESOURCE_SET_QUEUE_DIM - 1] !=
+        VALUE(RESOURCE_SET_QUEUE_DIM) ||
+        sent_reqno[RESOURCE_SET_QUEUE_DIM] != 0 ||
+        sent_value[RESOURCE_SET_QUEUE_DIM] != later) {
+        fprintf(stderr, "grant of a later transaction merged into an "
+                "earlier one\n");
+        nfailed++;
+    }
+
+    printf("%d grants sent over two transactions\n", nmsg);
+}
+
+
+int main(int argc, char *argv[])
+{
+    resource_set_t *rs;
+    int             ngrant = DEFAULT_GRANTS;
+
+    if (argc > 1 && ((ngrant = (int)strtol(argv[1], NULL, 10)) <= 0 ||
+                     ngrant > (int)(sizeof(sent_reqno) /
+                                    sizeof(sent_reqno[0]))))
+        fatal("invalid number of grants '%s'", argv[1]);
+
+    resset.peer  = "test";
+    resset.id    = 1;
+    resset.klass = "player";
+    resset.mode  = RESMSG_MODE_ALWAYS_REPLY;
+
+    if ((rs = resource_set_create(getpid(), &resset)) == NULL)
+        fatal("failed to create resource set");
+
+    overflow(rs, ngrant);
+    later_transaction(rs);
+
+    resource_set_destroy(&resset);
+
+    if (transaction_pending() != 0) {
+        fprintf(stderr, "%d transactions left pending\n",
+                transaction_pending());
+        nfailed++;
+    }
+
+    printf("%s\n", nfailed ? "FAILED" : "PASSED");
+
+    return nfailed ? 1 : 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -43,7 +43,19 @@ USA.
 
 #define SELIST_DIM  2
 
+#define QUEUE_SIZE(q)     ((q)->overflow ? (q)->size : RESOURCE_SET_QUEUE_DIM)
+#define QUEUE_INDEX(q,i)  (((q)->first + (i)) % QUEUE_SIZE(q))
+#define QUEUE_ENTRY(q,i)  \
+    (((q)->overflow ? (q)->overflow : (q)->entries) + QUEUE_INDEX(q,i))
+
+typedef struct {
+    resource_set_t *rs;
+    int             idx;
+} batch_entry_t;
+
 static resource_set_t  *hash_table[HASH_DIM];
+static unsigned int     nsent;        /* grant/advice messages sent */
+static unsigned int     nsuppressed;  /* collapsed or redundant messages */
 
 static gboolean idle_task(gpointer);
 
@@ -51,6 +63,8 @@ static void enqueue_send_request(resource_set_t *, resource_set_field_id_t,
                                  uint32_t, uint32_t);
 static void dequeue_and_send(resource_set_t*,resource_set_field_id_t,uint32_t);
 static void destroy_queue(resource_set_t *, resource_set_field_id_t);
+static int  grow_queue(resource_set_qhead_t *);
+static int  batch_compare(const void *, const void *);
 
 static int add_factstore_entry(resource_set_t *);
 static int delete_factstore_entry(resource_set_t *);
@@ -97,13 +111,7 @@ resource_set_t *resource_set_create(pid_t client_pid, resset_t *resset)
             rs->manager_id = manager_id++;
             rs->resset     = resset;
             rs->request    = strdup("release");
-            
-            rs->granted.queue.first = (void *)&rs->granted.queue;
-            rs->granted.queue.last  = (void *)&rs->granted.queue;
-            
-            rs->advice.queue.first = (void *)&rs->advice.queue;
-            rs->advice.queue.last  = (void *)&rs->advice.queue;
-            
+
             resset->userdata = rs;
             add_to_hash_table(rs);
             add_factstore_entry(rs);
@@ -278,6 +286,61 @@ void resource_set_send_queued_changes(uint32_t manager_id, uint32_t txid)
     }
 }
 
+void resource_set_send_queued_batch(uint32_t *ids, int nid, uint32_t txid)
+{
+    batch_entry_t  buf[32];
+    batch_entry_t *batch;
+    resource_set_t *rs;
+    unsigned int   sent, suppressed;
+    int            n, i;
+
+    if (nid <= 0)
+        return;
+
+    if (nid <= (int)(sizeof(buf) / sizeof(buf[0])))
+        batch = buf;
+    else if ((batch = malloc(nid * sizeof(batch_entry_t))) == NULL) {
+        for (i = 0;  i < nid;  i++)
+            resource_set_send_queued_changes(ids[i], txid);
+        return;
+    }
+
+    for (i = n = 0;  i < nid;  i++) {
+        if ((rs = find_in_hash_table(ids[i])) != NULL && rs->resset != NULL) {
+            batch[n].rs  = rs;
+            batch[n].idx = i;
+            n++;
+        }
+    }
+
+    /*
+     * send the notifications to a peer back-to-back, preserving the
+     * order of the resource sets within the transaction otherwise
+     */
+    if (n > 1)
+        qsort(batch, n, sizeof(batch_entry_t), batch_compare);
+
+    sent       = nsent;
+    suppressed = nsuppressed;
+
+    for (i = 0;  i < n;  i++) {
+        rs = batch[i].rs;
+
+        /* sending might have destroyed some of the resource sets */
+        if (find_in_hash_table(ids[batch[i].idx]) == rs)
+            dequeue_and_send(rs, resource_set_granted, txid);
+        if (find_in_hash_table(ids[batch[i].idx]) == rs)
+            dequeue_and_send(rs, resource_set_advice , txid);
+    }
+
+    OHM_DEBUG(DBG_SET, "transaction %u: %d resource sets, %u messages sent, "
+              "%u suppressed (total %u sent, %u suppressed)", txid, n,
+              nsent - sent, nsuppressed - suppressed, nsent, nsuppressed);
+
+    if (batch != buf)
+        free(batch);
+}
+
 void resource_set_send_release_request(resource_set_t *rs)
 {
     resset_t *resset;
@@ -318,6 +381,11 @@ int resource_set_add_idle_task(resource_set_t *rs, resource_set_task_t task)
     return success;
 }
 
+resource_set_t *resource_set_find_by_id(uint32_t manager_id)
+{
+    return find_in_hash_table(manager_id);
+}
+
 resource_set_t *resource_set_find(fsif_entry_t *entry)
 {
     uint32_t manager_id = INVALID_MANAGER_ID;
@@ -403,25 +471,52 @@ static void enqueue_send_request(resource_set_t          *rs,
     default:                                                           return;
     }
 
-    if ((qentry = malloc(sizeof(resource_set_queue_t))) == NULL)
-        OHM_ERROR("resource: [%s] memory allocation failure", __FUNCTION__);
-    else {
-        qhead = &value->queue;
+    qhead = &value->queue;
+
+    /*
+     * A later value of the same transaction supersedes the queued one,
+     * as long as that does not cost a pending reply. Values of other
+     * transactions are never merged. Should the ring fill up it is
+     * moved to a larger one on the heap instead of dropping a value.
+     */
+    if (qhead->length > 0) {
+        qentry = QUEUE_ENTRY(qhead, qhead->length - 1);
+
+        if (qentry->txid == txid &&
+            (!qentry->reqno || !reqno || qentry->reqno == reqno))
+        {
+            qentry->value = value->factstore;
 
-        memset(qentry, 0, sizeof(resource_set_queue_t));
-        qentry->next  = (void *)qhead;
-        qentry->prev  = qhead->last;
-        qentry->txid  = txid;
-        qentry->reqno = reqno;
-        qentry->value = value->factstore;
+            if (reqno)
+                qentry->reqno = reqno;
 
-        qhead->last->next = qentry;
-        qhead->last = qentry;
+            nsuppressed++;
+
+            OHM_DEBUG(DBG_SET, "%s/%u (manager_id %u) superseded queued %s "
+                      "value with %s", resset->peer, resset->id,
+                      rs->manager_id, type,
+                      resmsg_res_str(qentry->value, buf, sizeof(buf)));
+            return;
+        }
+    }
 
-        OHM_DEBUG(DBG_SET, "%s/%u (manager_id %u) enqued %s value %s",
-                  resset->peer, resset->id, rs->manager_id, type,
-                  resmsg_res_str(qentry->value, buf, sizeof(buf)));
+    if (qhead->length >= QUEUE_SIZE(qhead) && !grow_queue(qhead)) {
+        OHM_ERROR("resource: %s/%u (manager_id %u) failed to queue %s value: "
+                  "out of memory", resset->peer, resset->id, rs->manager_id,
+                  type);
+        return;
     }
+
+    qentry = QUEUE_ENTRY(qhead, qhead->length);
+    qentry->txid  = txid;
+    qentry->reqno = reqno;
+    qentry->value = value->factstore;
+
+    qhead->length++;
+
+    OHM_DEBUG(DBG_SET, "%s/%u (manager_id %u) enqued %s value %s",
+              resset->peer, resset->id, rs->manager_id, type,
+              resmsg_res_str(qentry->value, buf, sizeof(buf)));
 }
 
 static void dequeue_and_send(resource_set_t          *rs,
@@ -432,7 +527,7 @@ static void dequeue_and_send(resource_set_t          *rs,
     resmsg_type_t          type;
     resource_set_output_t *value;
     resource_set_qhead_t  *qhead;
-    resource_set_queue_t  *qentry;
+    resource_set_queue_t   qentry;
     resource_set_queue_t  *qnext;
     int32_t                block;
     resmsg_t               msg;
@@ -452,68 +547,78 @@ static void dequeue_and_send(resource_set_t          *rs,
     qhead = &value->queue;
     block = rs->block;
 
-    qnext = (void *) qhead->first;
-
     /*
      * we assume that the queue contains strictly monoton increasing txid's
      * and this function is called with strictly monoton txid's
      */
-    while ((void *)(qentry = qnext) != (void *)qhead) {
-        if (qentry->txid > txid)
+    while (qhead->length > 0) {
+        qentry = *QUEUE_ENTRY(qhead, 0);
+
+        if (qentry.txid > txid)
             return;             /* nothing to send */
 
-        if (qentry->txid == txid) {
-            if (qentry->reqno || value->client != qentry->value) {
-                if (block && type == RESMSG_GRANT) {
-                    OHM_DEBUG(DBG_SET, "%s/%u (manager_id %u) dequed but not "
-                              "sent %s value %s", resset->peer, resset->id,
-                              rs->manager_id, resmsg_type_str(type),
-                              resmsg_res_str(value->client,buf,sizeof(buf)));
-                }
-                else {
-                    memset(&msg, 0, sizeof(msg));
-                    msg.notify.type  = type;
-                    msg.notify.id    = resset->id;
-                    msg.notify.reqno = qentry->reqno;
-                    msg.notify.resrc = qentry->value;
-                
-                    if (resproto_send_message(resset, &msg, NULL)) {
-                        value->client = qentry->value;
-
-                        OHM_DEBUG(DBG_SET, "%s/%u (manager_id %u) dequed and "
-                                  "sent %s value %s", resset->peer, resset->id,
-                                  rs->manager_id, resmsg_type_str(type),
-                                  resmsg_res_str(value->client,buf,sizeof(buf))
-                                 );
-                    }
-                    else {
-                        OHM_ERROR("resource: failed to send %s message to "
-                                  "%s/%u (manager id %u)",
-                                  resmsg_type_str(type), resset->peer,
-                                  resset->id, rs->manager_id);
-                    }
-                } /* if !block */
-            }
-        }
-        else {
+        /* take the entry off before sending; sending might recurse */
+        qhead->first = QUEUE_INDEX(qhead, 1);
+        qhead->length--;
+
+        if (qhead->length == 0)
+            destroy_queue(rs, what);
+
+        qnext = qhead->length ? QUEUE_ENTRY(qhead, 0) : NULL;
+
+        if (qentry.txid != txid) {
             OHM_ERROR("resource: deleting out-of-order '%s' transaction "
                       "%u for %s/%u (manager id %u: expected transaction %u)",
-                      resmsg_type_str(type), qentry->txid,
+                      resmsg_type_str(type), qentry.txid,
                       resset->peer, resset->id, rs->manager_id, txid);
+            continue;
+        }
+
+        if (!qentry.reqno && qnext != NULL && qnext->txid == txid) {
+            nsuppressed++;
+            continue;           /* superseded by the next one */
+        }
+
+        if (!qentry.reqno && value->client == qentry.value) {
+            nsuppressed++;
+            continue;           /* the client knows this already */
+        }
+
+        if (block && type == RESMSG_GRANT) {
+            OHM_DEBUG(DBG_SET, "%s/%u (manager_id %u) dequed but not "
+                      "sent %s value %s", resset->peer, resset->id,
+                      rs->manager_id, resmsg_type_str(type),
+                      resmsg_res_str(value->client,buf,sizeof(buf)));
+            continue;
         }
 
-        qentry->prev->next = qentry->next;
-        qentry->next->prev = qentry->prev;
-        qnext = (void *) qhead->first;
-        free(qentry);
+        memset(&msg, 0, sizeof(msg));
+        msg.notify.type  = type;
+        msg.notify.id    = resset->id;
+        msg.notify.reqno = qentry.reqno;
+        msg.notify.resrc = qentry.value;
+
+        if (resproto_send_message(resset, &msg, NULL)) {
+            value->client = qentry.value;
+            nsent++;
+
+            OHM_DEBUG(DBG_SET, "%s/%u (manager_id %u) dequed and "
+                      "sent %s value %s", resset->peer, resset->id,
+                      rs->manager_id, resmsg_type_str(type),
+                      resmsg_res_str(value->client,buf,sizeof(buf)));
+        }
+        else {
+            OHM_ERROR("resource: failed to send %s message to "
+                      "%s/%u (manager id %u)",
+                      resmsg_type_str(type), resset->peer,
+                      resset->id, rs->manager_id);
+        }
     } /* while */
 }
 
 static void destroy_queue(resource_set_t *rs, resource_set_field_id_t what)
 {
     resource_set_qhead_t *qhead;
-    resource_set_queue_t *qentry;
-    resource_set_queue_t *qnext;
 
     switch (what) {
     case resource_set_granted:    qhead = &rs->granted.queue;    break;
@@ -521,17 +626,51 @@ static void destroy_queue(resource_set_t *rs, resource_set_field_id_t what)
     default:                                                     return;
     }
 
-    qnext = (void *) qhead->first;
+    free(qhead->overflow);
 
-    while ((void *)(qentry = qnext) != (void *)qhead) {
+    qhead->overflow = NULL;
+    qhead->size     = 0;
+    qhead->first    = 0;
+    qhead->length   = 0;
+}
 
-        qentry->prev->next = qentry->next;
-        qentry->next->prev = qentry->prev;
+static int grow_queue(resource_set_qhead_t *qhead)
+{
+    resource_set_queue_t *entries;
+    int                   size, i;
 
-        qnext = (void *) qhead->first;
+    size = 2 * QUEUE_SIZE(qhead);
 
-        free(qentry);
-    }
+    if ((entries = malloc(size * sizeof(entries[0]))) == NULL)
+        return FALSE;
+
+    for (i = 0;  i < qhead->length;  i++)
+        entries[i] = *QUEUE_ENTRY(qhead, i);
+
+    free(qhead->overflow);
+
+    qhead->overflow = entries;
+    qhead->size     = size;
+    qhead->first    = 0;
+
+    return TRUE;
+}
+
+static int batch_compare(const void *a, const void *b)
+{
+    const batch_entry_t *ba = (const batch_entry_t *)a;
+    const batch_entry_t *bb = (const batch_entry_t *)b;
+    resset_t            *ra = ba->rs->resset;
+    resset_t            *rb = bb->rs->resset;
+    int                  cmp;
+
+    if (ra->resconn != rb->resconn)
+        return (ra->resconn < rb->resconn) ? -1 : 1;
+
+    if ((cmp = strcmp(ra->peer ? ra->peer : "", rb->peer ? rb->peer : "")))
+        return cmp;
+
+    return ba->idx - bb->idx;
 }
 
 
@@ -27,6 +27,7 @@ USA.
 #include <res-conn.h>
 
 #define INVALID_MANAGER_ID (~(uint32_t)0)
+#define RESOURCE_SET_QUEUE_DIM  8  /* pending values kept in place */
 
 /* hack to avoid multiple includes */
 typedef struct _OhmPlugin OhmPlugin;
@@ -48,17 +49,18 @@ typedef enum {
     resource_video
 } resource_spec_type_t;
 
-typedef struct resource_set_queue_s {
-    struct resource_set_queue_s *next;
-    struct resource_set_queue_s *prev;
-    uint32_t                     txid;   /* transaction ID */
-    uint32_t                     reqno;  /* request number, if any */
-    uint32_t                     value;  /* value */
+typedef struct {
+    uint32_t                 txid;   /* transaction ID */
+    uint32_t                 reqno;  /* request number, if any */
+    uint32_t                 value;  /* value */
 } resource_set_queue_t;
 
 typedef struct {
-    resource_set_queue_t    *first;
-    resource_set_queue_t    *last;
+    int                      first;  /* index of the oldest entry */
+    int                      length; /* number of entries */
+    int                      size;   /* size of overflow, if any */
+    resource_set_queue_t    *overflow; /* entries, once outgrown the below */
+    resource_set_queue_t     entries[RESOURCE_SET_QUEUE_DIM];
 } resource_set_qhead_t;
 
 typedef struct {
@@ -78,7 +80,6 @@ typedef struct resource_set_s {
     int32_t                  block;      /* manager forced release */
     resource_set_output_t    granted;    /* granted resources of this set */
     resource_set_output_t    advice;     /* advice on this resource set */
-    resource_set_qhead_t     qhead;      /* queue for delayed responses */
     uint32_t                 reqno;
     struct {
         uint32_t            srcid;
@@ -104,9 +105,11 @@ int  resource_set_update_factstore(resset_t *, resource_set_update_t);
 void resource_set_queue_change(resource_set_t *, uint32_t,
                                uint32_t, resource_set_field_id_t);
 void resource_set_send_queued_changes(uint32_t, uint32_t);
+void resource_set_send_queued_batch(uint32_t *, int, uint32_t);
 void resource_set_send_release_request(resource_set_t *);
 int  resource_set_add_idle_task(resource_set_t *, resource_set_task_t);
 resource_set_t *resource_set_find(struct _OhmFact *);
+resource_set_t *resource_set_find_by_id(uint32_t);
 
 void resource_set_dump_message(resmsg_t *, resset_t *, const char *);
 
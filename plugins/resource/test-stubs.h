@@ -0,0 +1,92 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Common fixture of the resource plugin test programs. The tests
+ * include the sources they exercise directly; this provides what those
+ * sources expect from the rest of the plugin and from ohmd. Include it
+ * once per test program, after the sources under test.
+ */
+
+#ifndef __OHM_RESOURCE_TEST_STUBS_H__
+#define __OHM_RESOURCE_TEST_STUBS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#define fatal(fmt, args...) do {                                \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);      \
+        exit(1);                                                \
+    } while (0)
+
+
+int DBG_INIT, DBG_MGR, DBG_SET, DBG_DBUS, DBG_INTERNAL;
+int DBG_DRES, DBG_FS, DBG_QUE, DBG_TRANSACT, DBG_MEDIA, DBG_AUTH;
+
+
+void plugin_print_timestamp(const char *func, const char *step)
+{
+    (void)func;
+    (void)step;
+}
+
+
+void timestamp_add(const char *fmt, ...)
+{
+    (void)fmt;
+}
+
+
+void ohm_log(OhmLogLevel level, const gchar *format, ...)
+{
+    va_list ap;
+
+    if (level == OHM_LOG_ERROR) {
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        fprintf(stderr, "\n");
+    }
+}
+
+
+int __trace_printf(int id, const char *file, int line, const char *func,
+                   const char *format, ...)
+{
+    (void)id;
+    (void)file;
+    (void)line;
+    (void)func;
+    (void)format;
+
+    return FALSE;
+}
+
+#endif /* __OHM_RESOURCE_TEST_STUBS_H__ */
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,201 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Transaction stress test.
+ *
+ * Keeps a large number of overlapping transactions outstanding, finishes
+ * them in random order and checks that they still get completed in the
+ * order of their creation, with the resource sets that were added to
+ * them. Some of the completion callbacks create new transactions to
+ * exercise ring growth from within a completion. Usage:
+ *
+ *     transaction-test [transactions [outstanding [seed]]]
+ */
+
+#include <sys/time.h>
+
+#include "transaction.c"
+#include "test-stubs.h"
+
+#define DEFAULT_TOTAL      50000
+#define DEFAULT_WINDOW     5000
+
+static uint32_t  last_completed;
+static int       ncompleted;
+static int       nnested;
+static int       nfailed;
+
+
+static int nset_of(uint32_t txid)
+{
+    return txid % 7;            /* 0 - 6: mostly inline, some on the heap */
+}
+
+
+static void completed(uint32_t *ids, int nid, uint32_t txid, void *data)
+{
+    uint32_t nested;
+    int      i;
+
+    (void)data;
+
+    if (last_completed != NO_TRANSACTION && txid != last_completed + 1) {
+        fprintf(stderr, "transaction %u completed after %u\n",
+                txid, last_completed);
+        nfailed++;
+    }
+
+    if (nid != nset_of(txid)) {
+        fprintf(stderr, "transaction %u has %d resource sets instead of %d\n",
+                txid, nid, nset_of(txid));
+        nfailed++;
+    }
+
+    for (i = 0;  i < nid;  i++) {
+        if (ids[i] != txid * 10 + i) {
+            fprintf(stderr, "transaction %u: resource set #%d is %u\n",
+                    txid, i, ids[i]);
+            nfailed++;
+        }
+    }
+
+    last_completed = txid;
+    ncompleted++;
+
+    /* a completion that starts and finishes another transaction */
+    if (txid % 97 == 0) {
+        if ((nested = transaction_create(completed, NULL)) == NO_TRANSACTION)
+            fatal("failed to create nested transaction");
+
+        for (i = 0;  i < nset_of(nested);  i++)
+            transaction_add_resource_set(nested, nested * 10 + i);
+
+        transaction_unref(nested);
+        nnested++;
+    }
+}
+
+
+static uint32_t start_transaction(void)
+{
+    uint32_t txid;
+    int      i;
+
+    if ((txid = transaction_create(completed, NULL)) == NO_TRANSACTION)
+        fatal("failed to create transaction");
+
+    for (i = 0;  i < nset_of(txid);  i++) {
+        if (!transaction_add_resource_set(txid, txid * 10 + i) ||
+            !transaction_add_resource_set(txid, txid * 10 + i))
+            fatal("failed to add resource set to transaction %u", txid);
+    }
+
+    return txid;
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct timeval  start, end;
+    uint32_t       *pending;
+    int             total  = DEFAULT_TOTAL;
+    int             window = DEFAULT_WINDOW;
+    unsigned int    seed   = 1;
+    int             npending, ncreated, maxpending;
+    int             idx;
+    double          secs;
+
+    if (argc > 1 && (total = (int)strtol(argv[1], NULL, 10)) <= 0)
+        fatal("invalid number of transactions '%s'", argv[1]);
+    if (argc > 2 && (window = (int)strtol(argv[2], NULL, 10)) <= 0)
+        fatal("invalid number of outstanding transactions '%s'", argv[2]);
+    if (argc > 3)
+        seed = (unsigned int)strtoul(argv[3], NULL, 10);
+
+    if ((pending = malloc(window * sizeof(*pending))) == NULL)
+        fatal("can't allocate memory");
+
+    srand(seed);
+
+    npending = ncreated = maxpending = 0;
+
+    gettimeofday(&start, NULL);
+
+    while (ncreated < total || npending > 0) {
+        if (ncreated < total && npending < window &&
+            (npending == 0 || rand() % 3 != 0))
+        {
+            pending[npending++] = start_transaction();
+            ncreated++;
+        }
+        else {
+            /* finish a random outstanding transaction */
+            idx = rand() % npending;
+
+            if (rand() % 2)
+                transaction_ref(pending[idx]), transaction_unref(pending[idx]);
+
+            if (!transaction_unref(pending[idx]))
+                fatal("failed to unref transaction %u", pending[idx]);
+
+            pending[idx] = pending[--npending];
+        }
+
+        if (transaction_pending() > maxpending)
+            maxpending = transaction_pending();
+    }
+
+    gettimeofday(&end, NULL);
+
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+
+    printf("%d transactions (%d nested) completed in %.3f secs, "
+           "%.0f transactions/sec\n", ncompleted, nnested, secs,
+           secs > 0 ? ncompleted / secs : 0.0);
+    printf("max. %d outstanding, ring size %u\n", maxpending, ring.size);
+
+    if (ncompleted != total + nnested) {
+        fprintf(stderr, "%d transactions created but %d completed\n",
+                total + nnested, ncompleted);
+        nfailed++;
+    }
+
+    if (transaction_pending() != 0) {
+        fprintf(stderr, "%d transactions left pending\n",
+                transaction_pending());
+        nfailed++;
+    }
+
+    free(pending);
+
+    printf("%s\n", nfailed ? "FAILED" : "PASSED");
+
+    return nfailed ? 1 : 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -28,19 +28,17 @@ USA.
 #include "plugin.h"
 #include "transaction.h"
 
-#define HASH_BITS      10
-#define HASH_DIM       (1 << HASH_BITS)
-#define HASH_MASK      (HASH_DIM - 1)
-#define HASH_INDEX(i)  ((i) & HASH_MASK)
+#define RING_MIN       1024    /* initial (and minimal) size of the ring */
+#define INLINE_SETS    4       /* resource sets stored without malloc */
 
-#define ALLOC_DIM      1024
-#define ALLOC_JUNK     (ALLOC_DIM * sizeof(uint32_t))
+#define RING_INDEX(id) ((id) & (ring.size - 1))
 
 
 typedef struct {
-    int       junks;
     int       length;
-    uint32_t *table;    
+    int       size;
+    uint32_t *table;                    /* points to inl or to heap */
+    uint32_t  inl[INLINE_SETS];
 } resset_table_t;
 
 typedef struct {
@@ -55,12 +53,18 @@ typedef struct {
     completion_t       completion;
 } transaction_t;
 
+typedef struct {
+    transaction_t     *slots;
+    uint32_t           size;            /* always power of 2 */
+} transaction_ring_t;
+
 
-static transaction_t   transactions[HASH_DIM];
-static uint32_t        txwrite;
-static uint32_t        txread = 1;
+static transaction_ring_t  ring;
+static uint32_t            txwrite;
+static uint32_t            txread = 1;
 
 static transaction_t *find_transaction(uint32_t);
+static int grow_ring(void);
 static int add_resource_set(transaction_t *, uint32_t);
 static void complete_transaction(uint32_t);
 
@@ -83,26 +87,48 @@ uint32_t transaction_create(transaction_callback_t callback, void *user_data)
 {
     static uint32_t  count = NO_TRANSACTION;
 
-    uint32_t       txid = ++count;
-    int            idx  = HASH_INDEX(txid);
-    transaction_t *tx   = transactions + idx;
+    uint32_t       txid = count + 1;
+    transaction_t *tx;
+
+    if (txid == NO_TRANSACTION)
+        txid++;                 /* wrapped around */
+
+    /*
+     * Notes: transactions are completed in the order of their creation,
+     *   so the outstanding ones are always txread ... txwrite. The ring is
+     *   grown whenever this window would not fit into it any more.
+     */
+    if (ring.slots == NULL || txid - txread >= ring.size) {
+        if (!grow_ring()) {
+            OHM_ERROR("resource: can't allocate memory for transaction %u",
+                      txid);
+            return NO_TRANSACTION;
+        }
+    }
+
+    tx = ring.slots + RING_INDEX(txid);
 
     if (tx->id != NO_TRANSACTION) {
-        OHM_ERROR("resource: transaction table overflow: transaction %u",txid);
-        txid = NO_TRANSACTION;
+        OHM_ERROR("resource: transaction %u collides with pending "
+                  "transaction %u", txid, tx->id);
+        return NO_TRANSACTION;
     }
-    else {
-        memset(tx, 0, sizeof(transaction_t));
-        tx->id     = txid;
-        tx->refcnt = 1;
 
-        tx->completion.function  = callback;
-        tx->completion.user_data = user_data;
+    count = txid;
 
-        txwrite = txid;
+    memset(tx, 0, sizeof(transaction_t));
+    tx->id     = txid;
+    tx->refcnt = 1;
 
-        OHM_DEBUG(DBG_TRANSACT, "transaction %u created", txid);
-    }
+    tx->resset.size  = INLINE_SETS;
+    tx->resset.table = tx->resset.inl;
+
+    tx->completion.function  = callback;
+    tx->completion.user_data = user_data;
+
+    txwrite = txid;
+
+    OHM_DEBUG(DBG_TRANSACT, "transaction %u created", txid);
 
     return txid;
 }
@@ -164,6 +190,11 @@ int transaction_unref(uint32_t txid)
     return success;
 }
 
+int transaction_pending(void)
+{
+    return ring.slots ? (int)(txwrite - txread + 1) : 0;
+}
+
 
 /*!
  * @}
@@ -171,72 +202,136 @@ int transaction_unref(uint32_t txid)
 
 static transaction_t *find_transaction(uint32_t txid)
 {
-    int            idx = HASH_INDEX(txid);
-    transaction_t *tx  = transactions + idx;
+    transaction_t *tx;
+
+    if (txid == NO_TRANSACTION || ring.slots == NULL)
+        return NULL;
+
+    tx = ring.slots + RING_INDEX(txid);
+
+    return (txid == tx->id) ? tx : NULL;
+}
+
+
+static int grow_ring(void)
+{
+    transaction_t *slots, *old, *tx;
+    uint32_t       size;
+    uint32_t       id;
+
+    size = ring.size ? ring.size * 2 : RING_MIN;
+
+    if ((slots = calloc(size, sizeof(transaction_t))) == NULL)
+        return FALSE;
+
+    if ((old = ring.slots) != NULL) {
+        for (id = txread;  id - txread < ring.size;  id++) {
+            tx = old + RING_INDEX(id);
 
-    return (txid != NO_TRANSACTION && txid == tx->id) ? tx : NULL;
+            if (tx->id == id) {
+                memcpy(slots + (id & (size - 1)), tx, sizeof(*tx));
+
+                /* the inline table moved along with the transaction */
+                tx = slots + (id & (size - 1));
+                if (tx->resset.size == INLINE_SETS)
+                    tx->resset.table = tx->resset.inl;
+            }
+        }
+
+        free(old);
+    }
+
+    OHM_DEBUG(DBG_TRANSACT, "transaction ring grown to %u slots", size);
+
+    ring.slots = slots;
+    ring.size  = size;
+
+    return TRUE;
 }
 
 
 static int add_resource_set(transaction_t *tx, uint32_t rsid)
 {
-    int   idx   = tx->resset.length;
-    int   junks;
-    int   size;
-    void *mem;
-    int   i;
-
-    for (i = 0;    i < tx->resset.length;   i++) {
-        if (tx->resset.table[i] == rsid)
+    resset_table_t *rt = &tx->resset;
+    uint32_t       *table;
+    int             size;
+    int             i;
+
+    for (i = 0;    i < rt->length;   i++) {
+        if (rt->table[i] == rsid)
             return TRUE;        /* it is already there */
     }
-    
-    if ((junks = (idx + ALLOC_JUNK) / ALLOC_JUNK) > tx->resset.junks) {
-        size = junks * ALLOC_JUNK * sizeof(uint32_t *);
-        mem  = realloc(tx->resset.table, size);
-        
-        if (mem == NULL)
+
+    if (rt->length >= rt->size) {
+        size = rt->size * 2;
+
+        if (rt->table == rt->inl) {
+            if ((table = malloc(size * sizeof(uint32_t))) != NULL)
+                memcpy(table, rt->inl, sizeof(rt->inl));
+        }
+        else
+            table = realloc(rt->table, size * sizeof(uint32_t));
+
+        if (table == NULL)
             return FALSE;
 
-        tx->resset.junks = junks;
-        tx->resset.table = mem;
+        rt->size  = size;
+        rt->table = table;
     }
 
-    tx->resset.length = idx + 1;
-    tx->resset.table[idx] = rsid;
+    rt->table[rt->length++] = rsid;
 
     return TRUE;
 }
 
 static void complete_transaction(uint32_t txid)
 {
+    static int     completing;
+
     transaction_t *tx;
     uint32_t       id;
+    int            last;
 
-    if (txid == txread) {
-        for (id = txread;  id <= txwrite;   id++)  {
-            if ((tx = find_transaction(id)) == NULL) {
-                OHM_ERROR("resource: wants to complete transaction %u "
-                          "but can't find it", id);
-                continue;
-            }
+    /*
+     * only the oldest transaction can be completed; it drags along every
+     * subsequent one that has already been finished. Completions that
+     * happen from within a completion callback are picked up by the loop
+     * below.
+     */
+    if (txid != txread || completing)
+        return;
 
-            if (tx->refcnt > 0)
-                break;
+    completing = TRUE;
 
-            OHM_DEBUG(DBG_TRANSACT, "completing transaction %u", tx->id);
+    while ((tx = find_transaction(txread)) != NULL && tx->refcnt <= 0) {
+        id = tx->id;
 
-            if (tx->completion.function != NULL) {
-                tx->completion.function(tx->resset.table, tx->resset.length,
-                                        tx->id, tx->completion.user_data);
-            }
-        
-            free(tx->resset.table);
-            memset(tx, 0, sizeof(*tx));
-            
-            txread = id + 1;
+        OHM_DEBUG(DBG_TRANSACT, "completing transaction %u", id);
+
+        if (tx->completion.function != NULL) {
+            tx->completion.function(tx->resset.table, tx->resset.length,
+                                    id, tx->completion.user_data);
+
+            /* the callback might have created transactions (and grown
+               the ring) in the meantime */
+            tx = find_transaction(id);
         }
+
+        if (tx->resset.table != tx->resset.inl)
+            free(tx->resset.table);
+
+        memset(tx, 0, sizeof(*tx));
+
+        last = (txread == txwrite);
+
+        if (++txread == NO_TRANSACTION)
+            txread++;
+
+        if (last)
+            break;
     }
+
+    completing = FALSE;
 }
 
 
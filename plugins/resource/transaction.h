@@ -37,6 +37,8 @@ int transaction_add_resource_set(uint32_t, uint32_t);
 int transaction_ref(uint32_t);
 int transaction_unref(uint32_t);
 
+int transaction_pending(void);
+
 
 
 #endif	/* __OHM_RESOURCE_TRANSACTION_H__ */
@@ -23,6 +23,7 @@ USA.
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #include <glib.h>
 #include <gmodule.h>
@@ -35,6 +36,10 @@ USA.
 #define HAL_PLATFORM_ID   "platform.id"
 #define HAL_BUTTON_STATE  "button.state.value"
 
+#define FACT_PREFIX       "com.nokia.policy."
+#define SYNTHETIC_EVENT   "com.nokia.policy.sensor_event"
+#define DEFAULT_SENSORS   "proximity:proximity"
+
 /* debug flags */
 static int DBG_HAL, DBG_SENSOR;
 
@@ -49,65 +54,90 @@ OHM_IMPORTABLE(gboolean, hal_register  , (gchar *capability,
                                           hal_cb cb, void *user_data));
 OHM_IMPORTABLE(gboolean, hal_unregister, (void *user_data));
 
+/* policy resolver interface, looked up at runtime */
+OHM_IMPORTABLE(int, resolve, (char *goal, char **locals));
+
 /* sensor handlers */
 typedef struct sensor_s sensor_t;
 typedef int (*handler_t)(sensor_t *sensor, OhmFact *event);
 
-typedef struct {
-    int          nstate;
-    const char **states;
-} state_map_t;
+typedef struct {                                 /* a class of sensors */
+    const char   *name;                          /* class name */
+    const char   *state_key;                     /* HAL state key name */
+    handler_t     handler;                       /* event handler */
+    const char  **states;                        /* state names */
+    int           nstate;                        /* number of states */
+} sensor_class_t;
+
+struct sensor_s {
+    char           *id;                          /* HAL event platform.id */
+    char           *fact_name;
+    sensor_class_t *class;
+    int             state;                       /* current state */
+    int             pending;                     /* state of next flush */
+    int             queued;                      /* on the pending list */
+    OhmFact        *fact;
+    sensor_t       *next;                        /* more with the same id */
+};
 
 
 static const char *proximity_states[] = { [0] = "far", [1] = "close", NULL };
+static const char *switch_states[]    = { [0] = "off", [1] = "on"   , NULL };
 
-#define HAL_BUTTON(sensor_id, h, state_map) {                           \
-    id:        sensor_id,                                               \
-    fact_name: "com.nokia.policy."sensor_id,                            \
+#define HAL_BUTTON(class_name, h, state_map) {                          \
+    name:      class_name,                                              \
     state_key: HAL_BUTTON_STATE,                                        \
-            states:    state_map,                                       \
     handler:   h,                                                       \
-    state:     0,                                                       \
-    fact:      NULL                                                     \
+    states:    state_map,                                               \
+    nstate:    0                                                        \
 }
 
-struct sensor_s {
-    const char   *id;                            /* HAL event platform.id */
-    const char   *fact_name;
-    const char   *state_key;                     /* HAL state key name */
-    handler_t     handler;                       /* event_handler */
-    const char  **states;
-    int           nstate;
-    int           state;                         /* current state */
-    OhmFact      *fact;
-};
-
-
 
-/* sensors of interest */
+/* sensor classes we know about */
 static int button_handler(sensor_t *sensor, OhmFact *event);
 
-static sensor_t sensor_table[] = {
+static sensor_class_t class_table[] = {
     HAL_BUTTON("proximity", button_handler, proximity_states),
-    { NULL, NULL, NULL, NULL, NULL, 0, 0, NULL }
+    HAL_BUTTON("switch"   , button_handler, switch_states),
+    { NULL, NULL, NULL, NULL, 0 }
 };
 
 
 static OhmFactStore *store;
+static GHashTable   *sensors;                    /* platform.id -> sensor_t */
+static GSList       *pending;                    /* sensors with new states */
+static guint         flush_id;                   /* pending flush */
+static char         *goal;                       /* goal to resolve or NULL */
+
+static struct {
+    unsigned int events;                         /* HAL events received */
+    unsigned int unknown;                        /* ... for no sensor */
+    unsigned int coalesced;                      /* states overridden */
+    unsigned int flushes;                        /* batches flushed */
+    unsigned int changes;                        /* fact updates */
+    unsigned int resolves;                       /* resolver calls */
+} stats;
+
+
+static sensor_class_t *
+class_lookup(const char *name)
+{
+    sensor_class_t *class;
+
+    for (class = class_table; class->name != NULL; class++)
+        if (!strcmp(class->name, name))
+            return class;
+
+    return NULL;
+}
 
 
 static int
 sensor_init(sensor_t *sensor)
 {
-    int         i, n;
     const char *state;
     GSList     *factlist;
 
-    /* count state map entries */
-    for (i = 0, n = 0; sensor->states[i] != NULL; i++, n++)
-        ;
-    sensor->nstate = n;
-
     /* create and initialize fact */
     factlist = ohm_fact_store_get_facts_by_name(store, sensor->fact_name);
     if (factlist != NULL) {
@@ -115,7 +145,7 @@ sensor_init(sensor_t *sensor)
             OHM_ERROR("sensor: multiple facts for sensor %s", sensor->id);
             exit(1);
         }
-        sensor->fact = (OhmFact *)factlist->data;
+        sensor->fact = g_object_ref((OhmFact *)factlist->data);
     }
     else {
         sensor->fact = ohm_fact_new(sensor->fact_name);
@@ -125,10 +155,11 @@ sensor_init(sensor_t *sensor)
     if (sensor->fact == NULL)
         return FALSE;
         
-    if (sensor->state >= sensor->nstate)
+    if (sensor->state >= sensor->class->nstate)
         sensor->state = 0;
+    sensor->pending = sensor->state;
     
-    state = sensor->states[sensor->state];
+    state = sensor->class->states[sensor->state];
     ohm_fact_set(sensor->fact, "state", ohm_value_from_string(state));
     
     return TRUE;
@@ -145,19 +176,236 @@ sensor_exit(sensor_t *sensor)
     }
 }
 
+
+static void
+sensor_free(gpointer data)
+{
+    sensor_t *sensor = (sensor_t *)data;
+    sensor_t *next;
+
+    for ( ; sensor != NULL; sensor = next) {
+        next = sensor->next;
+
+        sensor_exit(sensor);
+        g_free(sensor->id);
+        g_free(sensor->fact_name);
+        g_free(sensor);
+    }
+}
+
+
+static sensor_t *
+sensor_find_fact(const char *fact_name)
+{
+    GHashTableIter  it;
+    gpointer        key, value;
+    sensor_t       *sensor;
+
+    g_hash_table_iter_init(&it, sensors);
+
+    while (g_hash_table_iter_next(&it, &key, &value))
+        for (sensor = (sensor_t *)value; sensor; sensor = sensor->next)
+            if (!strcmp(sensor->fact_name, fact_name))
+                return sensor;
+
+    return NULL;
+}
+
+
+/*
+ * Notes:
+ *   Sensors are configured as a comma-separated list of
+ *   platform-id:class[:fact-name] entries. The fact name defaults to
+ *   the platform id with the usual policy prefix. Any number of sensors
+ *   may share a class and a platform id may feed several sensors, but
+ *   each sensor needs a fact of its own, so all but one of the sensors
+ *   sharing a platform id need an explicit fact name.
+ */
+
 static int
-button_handler(sensor_t *sensor, OhmFact *event)
+sensor_add(const char *id, const char *class_name, const char *fact_name)
+{
+    sensor_class_t *class;
+    sensor_t       *sensor, *first, *other;
+
+    if ((class = class_lookup(class_name)) == NULL) {
+        OHM_ERROR("sensors: unknown class '%s' for sensor %s", class_name, id);
+        return FALSE;
+    }
+
+    sensor = g_new0(sensor_t, 1);
+    sensor->id    = g_strdup(id);
+    sensor->class = class;
+
+    if (fact_name != NULL && *fact_name)
+        sensor->fact_name = g_strdup(fact_name);
+    else
+        sensor->fact_name = g_strdup_printf(FACT_PREFIX"%s", id);
+
+    if ((other = sensor_find_fact(sensor->fact_name)) != NULL) {
+        OHM_ERROR("sensors: sensor %s can't use fact %s of sensor %s, "
+                  "give it a fact name of its own", id, sensor->fact_name,
+                  other->id);
+        sensor_free(sensor);
+        return FALSE;
+    }
+
+    if (!sensor_init(sensor)) {
+        OHM_ERROR("sensors: failed to intialize sensor %s", id);
+        sensor_free(sensor);
+        return FALSE;
+    }
+
+    if ((first = g_hash_table_lookup(sensors, id)) != NULL) {
+        sensor->next = first->next;
+        first->next  = sensor;
+    }
+    else
+        g_hash_table_insert(sensors, sensor->id, sensor);
+
+    OHM_INFO("sensors: %s sensor %s initialized (fact %s).", class->name,
+             sensor->id, sensor->fact_name);
+
+    return TRUE;
+}
+
+
+static int
+sensor_config(const char *config)
 {
-    GValue     *gstate;
+    char **entries, **fields;
+    int    i, n;
+
+    entries = g_strsplit(config, ",", 0);
+
+    for (i = 0, n = 0; entries[i] != NULL; i++) {
+        g_strstrip(entries[i]);
+
+        if (!*entries[i])
+            continue;
+
+        fields = g_strsplit(entries[i], ":", 3);
+
+        if (fields[0] == NULL || fields[1] == NULL)
+            OHM_ERROR("sensors: invalid sensor entry '%s'", entries[i]);
+        else if (sensor_add(g_strstrip(fields[0]), g_strstrip(fields[1]),
+                            fields[2] ? g_strstrip(fields[2]) : NULL))
+            n++;
+
+        g_strfreev(fields);
+    }
+
+    g_strfreev(entries);
+
+    return n;
+}
+
+
+/*
+ * Notes:
+ *   Sensor state changes are not pushed to the fact store one by one.
+ *   They are collected for the current main loop iteration, with the
+ *   last state of each sensor winning, and flushed from an idle
+ *   callback: the changed facts are updated together and the resolver
+ *   is run once for the whole batch.
+ */
+
+static int
+resolve_goal(void)
+{
+    char *vars[1] = { NULL };
+    int   status;
+
+    if (goal == NULL || resolve == NULL)
+        return TRUE;
+
+    stats.resolves++;
+
+    status = resolve(goal, vars);
+
+    if (status < 0)
+        OHM_ERROR("sensors: resolving '%s' failed: (%d) %s", goal,
+                  status, strerror(-status));
+    else if (!status)
+        OHM_ERROR("sensors: resolving '%s' failed", goal);
+
+    return status > 0;
+}
+
+
+static gboolean
+sensor_flush(gpointer data)
+{
+    sensor_t   *sensor;
+    GSList     *l;
     const char *state;
-    int         stid;
+    int         nchange;
+
+    (void)data;
+
+    flush_id = 0;
+    nchange  = 0;
+
+    for (l = pending; l != NULL; l = g_slist_next(l)) {
+        sensor = (sensor_t *)l->data;
+        sensor->queued = FALSE;
+
+        if (sensor->pending == sensor->state || sensor->fact == NULL)
+            continue;
+
+        sensor->state = sensor->pending;
+        state         = sensor->class->states[sensor->state];
+
+        OHM_DEBUG(DBG_SENSOR, "new state for sensor %s: %s", sensor->id,
+                  state);
+
+        ohm_fact_set(sensor->fact, "state", ohm_value_from_string(state));
+        nchange++;
+    }
+
+    g_slist_free(pending);
+    pending = NULL;
+
+    stats.flushes++;
+    stats.changes += nchange;
+
+    if (nchange > 0)
+        resolve_goal();
+
+    return FALSE;
+}
+
+
+static void
+sensor_queue(sensor_t *sensor, int state)
+{
+    if (sensor->queued)
+        stats.coalesced++;
+    else {
+        pending = g_slist_prepend(pending, sensor);
+        sensor->queued = TRUE;
+    }
+
+    sensor->pending = state;
+
+    if (!flush_id)
+        flush_id = g_idle_add(sensor_flush, NULL);
+}
+
+
+static int
+button_handler(sensor_t *sensor, OhmFact *event)
+{
+    sensor_class_t *class = sensor->class;
+    GValue         *gstate;
+    int             stid;
 
     OHM_DEBUG(DBG_SENSOR, "got event for sensor %s", sensor->id);
 
     if (sensor->fact == NULL)
         return FALSE;
 
-    if ((gstate = ohm_fact_get(event, sensor->state_key)) == NULL)
+    if ((gstate = ohm_fact_get(event, class->state_key)) == NULL)
         return FALSE;
 
     if (G_VALUE_TYPE(gstate) != G_TYPE_INT)
@@ -165,16 +413,13 @@ button_handler(sensor_t *sensor, OhmFact *event)
 
     stid = g_value_get_int(gstate);
 
-    if (stid < 0 || stid >= sensor->nstate) {
+    if (stid < 0 || stid >= class->nstate) {
         OHM_ERROR("sensor: invalid state %d for sensor %s", stid, sensor->id);
         return FALSE;
     }
 
-    state = sensor->states[stid];
+    sensor_queue(sensor, stid);
 
-    OHM_DEBUG(DBG_SENSOR, "new state for sensor %s: %s", sensor->id, state);
-    
-    ohm_fact_set(sensor->fact, "state", ohm_value_from_string(state));
     return TRUE;
 }
 
@@ -200,6 +445,8 @@ hal_event(OhmFact *fact, gchar *capability, gboolean added, gboolean removed,
     }
 #endif
     
+    stats.events++;
+
     if ((gid = ohm_fact_get(fact, HAL_PLATFORM_ID)) == NULL)
         return TRUE;
     
@@ -208,63 +455,170 @@ hal_event(OhmFact *fact, gchar *capability, gboolean added, gboolean removed,
     
     id = g_value_get_string(gid);
 
-    for (sensor = sensor_table; sensor->id != NULL; sensor++) {
-        if (!strcmp(sensor->id, id))
-            sensor->handler(sensor, fact);
-        
+    if (id == NULL || (sensor = g_hash_table_lookup(sensors, id)) == NULL) {
+        stats.unknown++;
         return TRUE;
     }
+
+    for ( ; sensor != NULL; sensor = sensor->next)
+        sensor->class->handler(sensor, fact);
     
     return TRUE;
 }
 
 
+/*
+ * Notes:
+ *   inject feeds count synthetic HAL events for the given platform id
+ *   through the normal dispatch path, cycling through the states of the
+ *   sensor starting at state, and logs the achieved event rate. It is
+ *   meant for measuring dispatch throughput; the resulting state changes
+ *   are batched and flushed like real ones. Returns the number of
+ *   events injected or -1 on error.
+ */
+
+OHM_EXPORTABLE(int, sensor_inject, (const char *id, int state, int count))
+{
+    sensor_t       *sensor;
+    OhmFact        *event;
+    struct timeval  start, end;
+    double          usecs;
+    int             nstate, i;
+
+    if (sensors == NULL || id == NULL || count <= 0)
+        return -1;
+
+    if ((sensor = g_hash_table_lookup(sensors, id)) == NULL) {
+        OHM_ERROR("sensors: can't inject events for unknown sensor %s", id);
+        return -1;
+    }
+
+    nstate = sensor->class->nstate;
+
+    if (state < 0 || state >= nstate) {
+        OHM_ERROR("sensors: invalid state %d for sensor %s", state, id);
+        return -1;
+    }
+
+    if ((event = ohm_fact_new(SYNTHETIC_EVENT)) == NULL)
+        return -1;
+
+    ohm_fact_set(event, HAL_PLATFORM_ID, ohm_value_from_string(id));
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < count; i++) {
+        ohm_fact_set(event, sensor->class->state_key,
+                     ohm_value_from_int((state + i) % nstate));
+        hal_event(event, "button", FALSE, FALSE, NULL);
+    }
+
+    gettimeofday(&end, NULL);
+
+    g_object_unref(event);
+
+    usecs = (end.tv_sec - start.tv_sec) * 1000000.0 +
+        (end.tv_usec - start.tv_usec);
+
+    OHM_INFO("sensors: injected %d events for %s in %.3f msecs, "
+             "%.0f events/sec", count, id, usecs / 1000.0,
+             usecs > 0 ? count * 1000000.0 / usecs : 0.0);
+
+    return count;
+}
+
+
 static void
 plugin_init(OhmPlugin *plugin)
 {
-    sensor_t *sensor;
+    sensor_class_t *class;
+    const char     *config, *param;
+    char           *name      = "dres.resolve";
+    char           *signature = (char *)resolve_SIGNATURE;
+    int             n;
     
     if ((store = ohm_get_fact_store()) == NULL) {
         OHM_ERROR("sensors: Failed to initialize factstore.");
         exit(1);
     }
 
+    /* count state map entries */
+    for (class = class_table; class->name != NULL; class++)
+        for (class->nstate = 0; class->states[class->nstate]; class->nstate++)
+            ;
+
+    sensors = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                    NULL, sensor_free);
+
+    if ((config = ohm_plugin_get_param(plugin, "sensors")) == NULL)
+        config = DEFAULT_SENSORS;
+
+    if ((n = sensor_config(config)) == 0)
+        OHM_WARNING("sensors: no sensors configured.");
+    else
+        OHM_INFO("sensors: %d sensor%s configured.", n, n == 1 ? "" : "s");
+
+    if ((param = ohm_plugin_get_param(plugin, "resolve-goal")) != NULL &&
+        *param) {
+        goal = g_strdup(param);
+
+        ohm_module_find_method(name, &signature, (void *)&resolve);
+
+        if (resolve == NULL)
+            OHM_WARNING("sensors: can't find method '%s', "
+                        "not resolving '%s'", name, goal);
+        else
+            OHM_INFO("sensors: resolving '%s' on sensor changes.", goal);
+    }
+
     if (!hal_register("button", hal_event, plugin)) {
         OHM_ERROR("sensors: Failed to subscribe to HAL button events.");
         exit(1);
     }
 
     OHM_INFO("sensors: subscribed for HAL button events.");
-    
-    for (sensor = sensor_table; sensor->id !=  NULL; sensor++) {
-        if (sensor_init(sensor))
-            OHM_INFO("sensors: sensor %s initialized.", sensor->id);
-        else
-            OHM_ERROR("sensors: failed to intialize sensor %s", sensor->id);
-    }
 }
 
 
 static void
 plugin_exit(OhmPlugin *plugin)
 {
-    sensor_t *sensor;
-    
     hal_unregister(plugin);
 
-    for (sensor = sensor_table; sensor->id != NULL; sensor++)
-        sensor_exit(sensor);
+    if (flush_id) {
+        g_source_remove(flush_id);
+        flush_id = 0;
+    }
+
+    g_slist_free(pending);
+    pending = NULL;
+
+    OHM_INFO("sensors: %u events (%u unknown), %u coalesced, "
+             "%u changes in %u batches, %u resolves", stats.events,
+             stats.unknown, stats.coalesced, stats.changes, stats.flushes,
+             stats.resolves);
+
+    if (sensors != NULL) {
+        g_hash_table_destroy(sensors);
+        sensors = NULL;
+    }
+
+    g_free(goal);
+    goal = NULL;
 
     store = NULL;
 }
 
 
 OHM_PLUGIN_DESCRIPTION("sensors",
-        "0.0.1",
+        "0.0.2",
         "krisztian.litkey@nokia.com",
         OHM_LICENSE_LGPL, plugin_init, plugin_exit,
         NULL);
 
+OHM_PLUGIN_PROVIDES_METHODS(sensors, 1,
+        OHM_EXPORT(sensor_inject, "inject"));
+
 OHM_PLUGIN_REQUIRES_METHODS(sensors, 2,
         OHM_IMPORT("hal.set_observer"  , hal_register),
         OHM_IMPORT("hal.unset_observer", hal_unregister));
@@ -0,0 +1,117 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/**
+ * @file ep-decoder.h
+ * @brief Shared policy decision decoder for internal enforcement points.
+ *
+ * An enforcement point describes the actions it understands with a table
+ * of action descriptors, each listing the fact fields to extract and where
+ * to store them in a handler-specific structure. The table is compiled
+ * once by decoder_create. decoder_decode then walks the facts of a policy
+ * decision transaction and calls the matching handlers with the extracted
+ * arguments.
+ */
+
+#ifndef __OHM_EP_DECODER_H__
+#define __OHM_EP_DECODER_H__
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <ohm/ohm-plugin.h>
+
+#define EP_STRUCT_OFFSET(s,m) ((char *)&(((s *)0)->m) - (char *)0)
+
+typedef enum {
+    EP_ARG_INVALID = 0,
+    EP_ARG_STRING,                      /* G_TYPE_STRING -> const char *   */
+    EP_ARG_INTEGER,                     /* G_TYPE_INT    -> int            */
+    EP_ARG_UNSIGNED,                    /* G_TYPE_UINT   -> unsigned int   */
+    EP_ARG_LONG,                        /* G_TYPE_LONG   -> long           */
+    EP_ARG_ULONG,                       /* G_TYPE_ULONG  -> unsigned long  */
+} ep_argtype_t;
+
+typedef struct {                        /* argument descriptor for actions */
+    ep_argtype_t  type;
+    const char   *name;
+    int           offs;
+} ep_argdsc_t;
+
+typedef int (*ep_action_cb_t)(void *user_data, void *args);
+
+typedef struct {                        /* action descriptor */
+    const char     *name;
+    ep_action_cb_t  handler;
+    ep_argdsc_t    *argdsc;
+    int             datalen;
+} ep_actdsc_t;
+
+typedef struct ep_decoder_s ep_decoder_t;
+
+
+#ifndef SIGNALING_H
+
+/*
+ * Enforcement points include this header to import the decoder methods
+ * of the signaling plugin. ep_decoder_import resolves them and returns
+ * FALSE if any of them is missing.
+ */
+
+OHM_IMPORTABLE(ep_decoder_t *, decoder_create , (const char  *signal,
+                                                 ep_actdsc_t *actions));
+OHM_IMPORTABLE(void          , decoder_destroy, (ep_decoder_t *decoder));
+OHM_IMPORTABLE(int           , decoder_decode , (ep_decoder_t *decoder,
+                                                 GObject      *transaction,
+                                                 void         *user_data));
+
+static int
+ep_decoder_import(void)
+{
+    char *create_signature  = (char *)decoder_create_SIGNATURE;
+    char *destroy_signature = (char *)decoder_destroy_SIGNATURE;
+    char *decode_signature  = (char *)decoder_decode_SIGNATURE;
+
+    if (decoder_create == NULL)
+        ohm_module_find_method("signaling.decoder_create",
+                               &create_signature, (void *)&decoder_create);
+    if (decoder_destroy == NULL)
+        ohm_module_find_method("signaling.decoder_destroy",
+                               &destroy_signature, (void *)&decoder_destroy);
+    if (decoder_decode == NULL)
+        ohm_module_find_method("signaling.decoder_decode",
+                               &decode_signature, (void *)&decoder_decode);
+
+    return (decoder_create != NULL && decoder_destroy != NULL &&
+            decoder_decode != NULL);
+}
+
+#endif /* !SIGNALING_H */
+
+
+#endif /* __OHM_EP_DECODER_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,92 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/**
+ * @file fact-watch.h
+ * @brief Filtered fact store update subscriptions.
+ *
+ * Instead of every plugin connecting to the global "updated" signal of
+ * the fact store and filtering each field update of each fact by name, a
+ * plugin subscribes once to the updates of a fact, optionally limited to
+ * a single field and to fact instances whose selector field has a given
+ * string value. The signaling plugin dispatches updates through a table
+ * keyed by the fact name quark, so only matching subscribers get called.
+ */
+
+#ifndef __OHM_FACT_WATCH_H__
+#define __OHM_FACT_WATCH_H__
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <ohm/ohm-plugin.h>
+#include <ohm/ohm-fact.h>
+
+typedef void (*fw_update_cb_t)(OhmFact *fact, GQuark field, GValue *value,
+                               void *user_data);
+
+
+#ifndef SIGNALING_H
+
+/*
+ * Plugins include this header to import the subscription methods of the
+ * signaling plugin. fact_watch_import resolves them and returns FALSE if
+ * any of them is missing. Subscription ids are positive, so callers keep
+ * 0 for no subscription and treat any id <= 0 as a failure.
+ */
+
+OHM_IMPORTABLE(int , fact_subscribe  , (const char     *owner,
+                                        const char     *fact,
+                                        const char     *field,
+                                        const char     *selfield,
+                                        const char     *selvalue,
+                                        fw_update_cb_t  callback,
+                                        void           *user_data));
+OHM_IMPORTABLE(void, fact_unsubscribe, (int id));
+
+static int
+fact_watch_import(void)
+{
+    char *subscribe_signature   = (char *)fact_subscribe_SIGNATURE;
+    char *unsubscribe_signature = (char *)fact_unsubscribe_SIGNATURE;
+
+    if (fact_subscribe == NULL)
+        ohm_module_find_method("signaling.fact_subscribe",
+                               &subscribe_signature, (void *)&fact_subscribe);
+    if (fact_unsubscribe == NULL)
+        ohm_module_find_method("signaling.fact_unsubscribe",
+                               &unsubscribe_signature,
+                               (void *)&fact_unsubscribe);
+
+    return (fact_subscribe != NULL && fact_unsubscribe != NULL);
+}
+
+#endif /* !SIGNALING_H */
+
+
+#endif /* __OHM_FACT_WATCH_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
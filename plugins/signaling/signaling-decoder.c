@@ -0,0 +1,238 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/**
+ * @file signaling-decoder.c
+ * @brief Precompiled policy decision decoder for internal enforcement points.
+ *
+ * Every internal enforcement point used to carry its own copy of the
+ * txparser/action_parser/get_args trio, which looked up the signal and
+ * each fact field by name for every transaction. The decoder does the
+ * name resolution once, when the enforcement point registers its action
+ * table: fact names become hash table keys and field names quarks, so
+ * decoding a transaction is a hash lookup per fact name and a quark
+ * lookup per field.
+ */
+
+#include "signaling.h"
+
+typedef struct {                        /* a precompiled argument */
+    GQuark        field;                /* fact field name */
+    GType         gtype;                /* expected value type */
+    ep_argtype_t  type;                 /* argument type */
+    int           offs;                 /* offset in the argument buffer */
+} argplan_t;
+
+typedef struct {                        /* a precompiled action */
+    GQuark          name;               /* fact name */
+    ep_action_cb_t  handler;            /* action handler */
+    argplan_t      *args;               /* arguments to extract */
+    int             nargs;              /* number of arguments */
+    int             datalen;            /* argument buffer size */
+} actplan_t;
+
+struct ep_decoder_s {
+    gchar        *signal;               /* signal we decode */
+    OhmFactStore *store;                /* fact store */
+    GHashTable   *actions;              /* fact name -> actplan_t */
+    actplan_t    *plans;                /* precompiled actions */
+    int           nplan;                /* number of actions */
+    int           maxlen;               /* largest argument buffer */
+};
+
+
+static GType
+arg_gtype(ep_argtype_t type)
+{
+    switch (type) {
+    case EP_ARG_STRING:   return G_TYPE_STRING;
+    case EP_ARG_INTEGER:  return G_TYPE_INT;
+    case EP_ARG_UNSIGNED: return G_TYPE_UINT;
+    case EP_ARG_LONG:     return G_TYPE_LONG;
+    case EP_ARG_ULONG:    return G_TYPE_ULONG;
+    default:              return G_TYPE_INVALID;
+    }
+}
+
+
+ep_decoder_t *
+ep_decoder_create(const char *signal, ep_actdsc_t *actions)
+{
+    ep_decoder_t *decoder;
+    ep_actdsc_t  *action;
+    ep_argdsc_t  *ad;
+    actplan_t    *plan;
+    argplan_t    *arg;
+    int           nplan, nargs;
+
+    if (signal == NULL || actions == NULL)
+        return NULL;
+
+    for (nplan = 0; actions[nplan].name != NULL; nplan++)
+        ;
+
+    decoder          = g_new0(ep_decoder_t, 1);
+    decoder->signal  = g_strdup(signal);
+    decoder->store   = ohm_fact_store_get_fact_store();
+    decoder->actions = g_hash_table_new(g_str_hash, g_str_equal);
+    decoder->plans   = g_new0(actplan_t, nplan);
+    decoder->nplan   = nplan;
+
+    for (action = actions, plan = decoder->plans;
+         action->name != NULL;
+         action++, plan++) {
+        for (nargs = 0; action->argdsc[nargs].type != EP_ARG_INVALID; nargs++)
+            ;
+
+        plan->name    = g_quark_from_string(action->name);
+        plan->handler = action->handler;
+        plan->args    = g_new0(argplan_t, nargs);
+        plan->nargs   = nargs;
+        plan->datalen = action->datalen;
+
+        for (ad = action->argdsc, arg = plan->args;
+             ad->type != EP_ARG_INVALID;
+             ad++, arg++) {
+            arg->field = g_quark_from_string(ad->name);
+            arg->gtype = arg_gtype(ad->type);
+            arg->type  = ad->type;
+            arg->offs  = ad->offs;
+        }
+
+        if (plan->datalen > decoder->maxlen)
+            decoder->maxlen = plan->datalen;
+
+        /* the quark string is static, so it can key the table */
+        g_hash_table_insert(decoder->actions,
+                            (gpointer)g_quark_to_string(plan->name), plan);
+    }
+
+    return decoder;
+}
+
+
+void
+ep_decoder_destroy(ep_decoder_t *decoder)
+{
+    int i;
+
+    if (decoder == NULL)
+        return;
+
+    for (i = 0; i < decoder->nplan; i++)
+        g_free(decoder->plans[i].args);
+
+    g_hash_table_destroy(decoder->actions);
+    g_free(decoder->plans);
+    g_free(decoder->signal);
+    g_free(decoder);
+}
+
+
+static void
+decode_args(actplan_t *plan, OhmFact *fact, char *data)
+{
+    argplan_t *arg;
+    GValue    *gv;
+    void      *vptr;
+    int        i;
+
+    for (i = 0, arg = plan->args; i < plan->nargs; i++, arg++) {
+        gv = ohm_structure_qget(OHM_STRUCTURE(fact), arg->field);
+
+        if (gv == NULL || G_VALUE_TYPE(gv) != arg->gtype)
+            continue;
+
+        vptr = data + arg->offs;
+
+        switch (arg->type) {
+        case EP_ARG_STRING:
+            *(const char **)vptr = g_value_get_string(gv);
+            break;
+        case EP_ARG_INTEGER:
+            *(int *)vptr = g_value_get_int(gv);
+            break;
+        case EP_ARG_UNSIGNED:
+            *(unsigned int *)vptr = g_value_get_uint(gv);
+            break;
+        case EP_ARG_LONG:
+            *(long *)vptr = g_value_get_long(gv);
+            break;
+        case EP_ARG_ULONG:
+            *(unsigned long *)vptr = g_value_get_ulong(gv);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+
+/*
+ * Returns -1 if the transaction is not for the signal of the decoder,
+ * otherwise TRUE if all handlers succeeded and FALSE if any of them
+ * failed.
+ */
+
+int
+ep_decoder_decode(ep_decoder_t *decoder, GObject *transaction,
+                  void *user_data)
+{
+    Transaction *t = TRANSACTION(transaction);
+    actplan_t   *plan;
+    GSList      *entry, *list;
+    char        *data;
+    int          success;
+
+    if (decoder == NULL || t->signal == NULL ||
+        strcmp(t->signal, decoder->signal))
+        return -1;
+
+    data    = g_alloca(decoder->maxlen > 0 ? decoder->maxlen : 1);
+    success = TRUE;
+
+    for (entry = t->facts; entry != NULL; entry = g_slist_next(entry)) {
+        plan = g_hash_table_lookup(decoder->actions, entry->data);
+
+        if (plan == NULL)
+            continue;
+
+        for (list  = ohm_fact_store_get_facts_by_quark(decoder->store,
+                                                       plan->name);
+             list != NULL;
+             list  = g_slist_next(list)) {
+            memset(data, 0, plan->datalen);
+            decode_args(plan, (OhmFact *)list->data, data);
+
+            success &= plan->handler(user_data, data);
+        }
+    }
+
+    return success;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,349 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/**
+ * @file signaling-factwatch.c
+ * @brief Filtered fact store update subscriptions.
+ *
+ * A single "updated" handler is connected to the fact store while there
+ * are subscriptions. It looks up the subscriptions of the updated fact by
+ * the fact name quark and checks the field and selector of each of them
+ * by quark, so updates of facts nobody is interested in cost one hash
+ * lookup and never reach any plugin.
+ *
+ * For every subscriber we count the updates delivered to it and the ones
+ * of its fact that were filtered out by field or selector, ie. the ones
+ * it would have had to receive and discard itself.
+ */
+
+#include "signaling.h"
+
+typedef struct fw_watch_s fw_watch_t;
+
+typedef struct {                        /* a subscribing plugin */
+    char          *name;                /* plugin name */
+    unsigned long  delivered;           /* updates delivered */
+    unsigned long  discarded;           /* updates filtered out */
+} fw_owner_t;
+
+struct fw_watch_s {                     /* a subscription */
+    fw_watch_t     *next;               /* next watch of the same fact */
+    int             id;                 /* subscription id */
+    fw_owner_t     *owner;              /* subscriber */
+    GQuark          field;              /* field name, or 0 for all */
+    GQuark          selfield;           /* selector field, or 0 for none */
+    char           *selvalue;           /* selector value */
+    fw_update_cb_t  callback;           /* notification callback */
+    void           *user_data;          /* opaque callback data */
+    int             dead;               /* unsubscribed during dispatch */
+};
+
+typedef struct {                        /* subscriptions of a fact */
+    GQuark      name;                   /* fact name */
+    fw_watch_t *watches;                /* in subscription order */
+} fw_fact_t;
+
+static OhmFactStore  *store;
+static gulong         updated_id;
+static GHashTable    *facts;            /* fact quark -> fw_fact_t */
+static GHashTable    *ids;              /* watch id -> fw_fact_t */
+static GHashTable    *owners;           /* plugin name -> fw_owner_t */
+static int            next_id = 1;
+static int            dispatching;      /* dispatch nesting level */
+static GSList        *dead;             /* facts with dead watches */
+static unsigned long  nunwatched;       /* updates nobody subscribed to */
+static int            DBG_WATCH;
+
+static void updated_cb(void *, OhmFact *, GQuark, gpointer);
+
+
+static void
+owner_free(gpointer data)
+{
+    fw_owner_t *o = (fw_owner_t *)data;
+
+    g_free(o->name);
+    g_free(o);
+}
+
+
+static void
+fact_free(gpointer data)
+{
+    fw_fact_t  *f = (fw_fact_t *)data;
+    fw_watch_t *w, *next;
+
+    for (w = f->watches; w != NULL; w = next) {
+        next = w->next;
+        g_free(w->selvalue);
+        g_free(w);
+    }
+
+    g_free(f);
+}
+
+
+static void
+watch_connect(void)
+{
+    if (updated_id == 0)
+        updated_id = g_signal_connect(G_OBJECT(store), "updated",
+                                      G_CALLBACK(updated_cb), NULL);
+}
+
+
+static void
+watch_disconnect(void)
+{
+    if (updated_id != 0) {
+        g_signal_handler_disconnect(G_OBJECT(store), updated_id);
+        updated_id = 0;
+    }
+}
+
+
+/*
+ * remove the dead watches of a fact, and the fact itself if it has
+ * no watches left
+ */
+
+static void
+fact_purge(fw_fact_t *f)
+{
+    fw_watch_t **wp, *w;
+
+    for (wp = &f->watches; (w = *wp) != NULL; ) {
+        if (w->dead) {
+            *wp = w->next;
+            g_free(w->selvalue);
+            g_free(w);
+        }
+        else
+            wp = &w->next;
+    }
+
+    if (f->watches == NULL)
+        g_hash_table_remove(facts, GUINT_TO_POINTER(f->name));
+
+    if (g_hash_table_size(facts) == 0)
+        watch_disconnect();
+}
+
+
+static int
+selector_match(fw_watch_t *w, OhmFact *fact)
+{
+    GValue *gv;
+
+    if (!w->selfield)
+        return TRUE;
+
+    gv = ohm_structure_qget(OHM_STRUCTURE(fact), w->selfield);
+
+    return (gv != NULL && G_VALUE_TYPE(gv) == G_TYPE_STRING &&
+            !strcmp(g_value_get_string(gv), w->selvalue));
+}
+
+
+static void
+updated_cb(void *data, OhmFact *fact, GQuark field, gpointer value)
+{
+    fw_fact_t  *f;
+    fw_watch_t *w;
+    GQuark      name;
+    GSList     *l;
+
+    (void)data;
+
+    if (fact == NULL || value == NULL)
+        return;
+
+    name = ohm_structure_get_qname(OHM_STRUCTURE(fact));
+
+    if ((f = g_hash_table_lookup(facts, GUINT_TO_POINTER(name))) == NULL) {
+        nunwatched++;
+        return;
+    }
+
+    dispatching++;
+
+    for (w = f->watches; w != NULL; w = w->next) {
+        if (w->dead)
+            continue;
+
+        if ((w->field && w->field != field) || !selector_match(w, fact)) {
+            w->owner->discarded++;
+            continue;
+        }
+
+        w->owner->delivered++;
+        w->callback(fact, field, (GValue *)value, w->user_data);
+    }
+
+    if (--dispatching == 0 && dead != NULL) {
+        for (l = dead; l != NULL; l = l->next)
+            fact_purge((fw_fact_t *)l->data);
+        g_slist_free(dead);
+        dead = NULL;
+    }
+}
+
+
+int
+fw_subscribe(const char *owner, const char *fact, const char *field,
+             const char *selfield, const char *selvalue,
+             fw_update_cb_t callback, void *user_data)
+{
+    fw_fact_t   *f;
+    fw_watch_t  *w, **wp;
+    fw_owner_t  *o;
+    GQuark       name;
+
+    if (facts == NULL || fact == NULL || callback == NULL ||
+        (selfield != NULL && selvalue == NULL))
+        return -1;
+
+    if (owner == NULL)
+        owner = "<unknown>";
+
+    if ((o = g_hash_table_lookup(owners, owner)) == NULL) {
+        o = g_new0(fw_owner_t, 1);
+        o->name = g_strdup(owner);
+        g_hash_table_insert(owners, o->name, o);
+    }
+
+    name = g_quark_from_string(fact);
+
+    if ((f = g_hash_table_lookup(facts, GUINT_TO_POINTER(name))) == NULL) {
+        f = g_new0(fw_fact_t, 1);
+        f->name = name;
+        g_hash_table_insert(facts, GUINT_TO_POINTER(name), f);
+    }
+
+    w = g_new0(fw_watch_t, 1);
+    w->id        = next_id++;
+    w->owner     = o;
+    w->field     = field    ? g_quark_from_string(field)    : 0;
+    w->selfield  = selfield ? g_quark_from_string(selfield) : 0;
+    w->selvalue  = g_strdup(selvalue);
+    w->callback  = callback;
+    w->user_data = user_data;
+
+    for (wp = &f->watches; *wp != NULL; wp = &(*wp)->next)
+        ;
+    *wp = w;
+
+    g_hash_table_insert(ids, GINT_TO_POINTER(w->id), f);
+
+    watch_connect();
+
+    OHM_DEBUG(DBG_WATCH, "watch %d: %s subscribed to %s%s%s%s%s%s%s",
+              w->id, owner, fact, field ? ":" : "", field ? field : "",
+              selfield ? " [" : "", selfield ? selfield : "",
+              selfield ? "=" : "", selfield ? selvalue : "");
+
+    return w->id;
+}
+
+
+void
+fw_unsubscribe(int id)
+{
+    fw_fact_t  *f;
+    fw_watch_t *w;
+
+    if (ids == NULL ||
+        (f = g_hash_table_lookup(ids, GINT_TO_POINTER(id))) == NULL)
+        return;
+
+    g_hash_table_remove(ids, GINT_TO_POINTER(id));
+
+    for (w = f->watches; w != NULL && w->id != id; w = w->next)
+        ;
+
+    if (w == NULL)
+        return;
+
+    OHM_DEBUG(DBG_WATCH, "watch %d of %s removed", id, w->owner->name);
+
+    w->dead = TRUE;
+
+    /* can't unlink while the watch list is being walked */
+    if (dispatching) {
+        if (!g_slist_find(dead, f))
+            dead = g_slist_prepend(dead, f);
+    }
+    else
+        fact_purge(f);
+}
+
+
+void
+fw_init(int flag_watch)
+{
+    DBG_WATCH = flag_watch;
+
+    store  = ohm_fact_store_get_fact_store();
+    facts  = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                   NULL, fact_free);
+    ids    = g_hash_table_new(g_direct_hash, g_direct_equal);
+    owners = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                   NULL, owner_free);
+}
+
+
+void
+fw_exit(void)
+{
+    GHashTableIter  it;
+    gpointer        key, value;
+    fw_owner_t     *o;
+
+    if (facts == NULL)
+        return;
+
+    watch_disconnect();
+
+    g_hash_table_iter_init(&it, owners);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        o = (fw_owner_t *)value;
+        OHM_INFO("signaling: fact watch %s: %lu updates delivered, "
+                 "%lu filtered out", o->name, o->delivered, o->discarded);
+    }
+    OHM_INFO("signaling: fact watch: %lu updates of unwatched facts dropped",
+             nunwatched);
+
+    g_slist_free(dead);
+    dead = NULL;
+
+    g_hash_table_destroy(facts);
+    g_hash_table_destroy(ids);
+    g_hash_table_destroy(owners);
+    facts = ids = owners = NULL;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
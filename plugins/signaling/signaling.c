@@ -28,11 +28,12 @@ USA.
 
 #include "signaling.h"
 
-static int DBG_SIGNALING, DBG_FACTS;
+static int DBG_SIGNALING, DBG_FACTS, DBG_WATCH;
 
 OHM_DEBUG_PLUGIN(signaling,
     OHM_DEBUG_FLAG("signaling", "Signaling events" , &DBG_SIGNALING),
-    OHM_DEBUG_FLAG("facts"    , "fact manipulation", &DBG_FACTS));
+    OHM_DEBUG_FLAG("facts"    , "fact manipulation", &DBG_FACTS),
+    OHM_DEBUG_FLAG("watch"    , "fact subscriptions", &DBG_WATCH));
 
 /* completion cb type */
 typedef void (*completion_cb_t)(char *id, char *argt, void **argv);
@@ -81,6 +82,34 @@ OHM_EXPORTABLE(void, queue_key_change, (gchar *signal, GSList *facts))
     return;
 }
 
+/* precompiled policy decision decoder for internal enforcement points */
+OHM_EXPORTABLE(ep_decoder_t *, decoder_create, (const char *signal, ep_actdsc_t *actions))
+{
+    return ep_decoder_create(signal, actions);
+}
+
+OHM_EXPORTABLE(void, decoder_destroy, (ep_decoder_t *decoder))
+{
+    ep_decoder_destroy(decoder);
+}
+
+OHM_EXPORTABLE(int, decoder_decode, (ep_decoder_t *decoder, GObject *transaction, void *user_data))
+{
+    return ep_decoder_decode(decoder, transaction, user_data);
+}
+
+/* filtered fact store update subscriptions */
+OHM_EXPORTABLE(int, fact_subscribe, (const char *owner, const char *fact, const char *field, const char *selfield, const char *selvalue, fw_update_cb_t callback, void *user_data))
+{
+    return fw_subscribe(owner, fact, field, selfield, selvalue,
+                        callback, user_data);
+}
+
+OHM_EXPORTABLE(void, fact_unsubscribe, (int id))
+{
+    fw_unsubscribe(id);
+}
+
 /* simple wrapper: just return true or false to the caller */
 static void complete(Transaction *t, gpointer data)
 {
@@ -211,6 +240,7 @@ plugin_init(OhmPlugin * plugin)
         g_warning("Failed to initialize signaling plugin debugging.");
 
     init_signaling(c, DBG_SIGNALING, DBG_FACTS);
+    fw_init(DBG_WATCH);
     return;
 }
 
@@ -219,6 +249,7 @@ plugin_exit(OhmPlugin * plugin)
 {
     (void) plugin;
 
+    fw_exit();
     deinit_signaling();
     return;
 }
@@ -229,12 +260,17 @@ OHM_PLUGIN_DESCRIPTION("signaling",
         OHM_LICENSE_LGPL, plugin_init, plugin_exit,
         NULL);
 
-OHM_PLUGIN_PROVIDES_METHODS(signaling, 5,
+OHM_PLUGIN_PROVIDES_METHODS(signaling, 10,
         OHM_EXPORT(register_internal_enforcement_point, "register_enforcement_point"),
         OHM_EXPORT(unregister_internal_enforcement_point, "unregister_enforcement_point"),
         OHM_EXPORT(signal_changed, "signal_changed"),
         OHM_EXPORT(queue_policy_decision, "queue_policy_decision"),
-        OHM_EXPORT(queue_key_change, "queue_key_change"));
+        OHM_EXPORT(queue_key_change, "queue_key_change"),
+        OHM_EXPORT(decoder_create, "decoder_create"),
+        OHM_EXPORT(decoder_destroy, "decoder_destroy"),
+        OHM_EXPORT(decoder_decode, "decoder_decode"),
+        OHM_EXPORT(fact_subscribe, "fact_subscribe"),
+        OHM_EXPORT(fact_unsubscribe, "fact_unsubscribe"));
 
 OHM_PLUGIN_DBUS_SIGNALS(
         {NULL, DBUS_INTERFACE_POLICY, SIGNAL_POLICY_ACK,
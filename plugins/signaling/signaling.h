@@ -43,6 +43,8 @@ USA.
 #include <dbus/dbus.h>
 
 #include "signaling_marshal.h"
+#include "ep-decoder.h"
+#include "fact-watch.h"
 
 #include <ohm/ohm-plugin.h>
 #include <ohm/ohm-fact.h>
@@ -220,6 +222,26 @@ DBusHandlerResult unregister_external_enforcement_point(DBusConnection * c, DBus
 
 DBusHandlerResult update_external_enforcement_points(DBusConnection * c, DBusMessage * msg, void *user_data);
 
+/* policy decision decoder for internal enforcement points */
+
+ep_decoder_t * ep_decoder_create(const char *signal, ep_actdsc_t *actions);
+
+void ep_decoder_destroy(ep_decoder_t *decoder);
+
+int ep_decoder_decode(ep_decoder_t *decoder, GObject *transaction, void *user_data);
+
+/* filtered fact store update subscriptions */
+
+int fw_subscribe(const char *owner, const char *fact, const char *field,
+                 const char *selfield, const char *selvalue,
+                 fw_update_cb_t callback, void *user_data);
+
+void fw_unsubscribe(int id);
+
+void fw_init(int flag_watch);
+
+void fw_exit(void);
+
 #endif
 
 /*
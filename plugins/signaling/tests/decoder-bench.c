@@ -0,0 +1,327 @@
+/*************************************************************************
+Copyright (C) 2010 Nokia Corporation.
+
+These OHM Modules are free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Policy decision decoder benchmark.
+ *
+ * Fills the fact store with a number of action facts, then decodes the
+ * same transaction repeatedly, first with the per-transaction parser the
+ * enforcement points used to carry and then with the precompiled decoder.
+ * Prints the decode time per transaction for both and checks that they
+ * extracted the same arguments. Usage:
+ *
+ *     decoder-bench [transactions [actions [facts-per-action]]]
+ */
+
+#include <stdarg.h>
+#include <sys/time.h>
+
+#include "../signaling.h"
+
+#define PREFIX             "com.nokia.policy."
+#define SIGNAL             "bench_actions"
+#define MAX_ACTIONS        64
+
+#define DEFAULT_TOTAL      100000
+#define DEFAULT_ACTIONS    8
+#define DEFAULT_FACTS      2
+
+#define fatal(fmt, args...) do {                                \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);      \
+        exit(1);                                                \
+    } while (0)
+
+
+typedef struct {                        /* bench action arguments */
+    const char *state;
+    int         level;
+    long        pid;
+} bench_t;
+
+static unsigned long  checksum;
+
+
+void ohm_log(OhmLogLevel level, const gchar *format, ...)
+{
+    va_list ap;
+
+    if (level == OHM_LOG_ERROR) {
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        fprintf(stderr, "\n");
+    }
+}
+
+
+static int bench_action(void *user_data, void *data)
+{
+    bench_t *bench = (bench_t *)data;
+
+    (void)user_data;
+
+    checksum += bench->level + bench->pid + (bench->state ? *bench->state : 0);
+
+    return TRUE;
+}
+
+
+static ep_argdsc_t bench_args[] = {
+    { EP_ARG_STRING , "state", EP_STRUCT_OFFSET(bench_t, state) },
+    { EP_ARG_INTEGER, "level", EP_STRUCT_OFFSET(bench_t, level) },
+    { EP_ARG_LONG   , "pid"  , EP_STRUCT_OFFSET(bench_t, pid  ) },
+    { EP_ARG_INVALID, NULL   , 0                                }
+};
+
+static ep_actdsc_t actions[MAX_ACTIONS + 1];
+
+
+/*
+ * the parser as it used to be duplicated in the enforcement points
+ */
+
+static int legacy_get_args(OhmFact *fact, ep_argdsc_t *argdsc, void *args)
+{
+    ep_argdsc_t *ad;
+    GValue      *gv;
+    void        *vptr;
+
+    if (fact == NULL)
+        return FALSE;
+
+    for (ad = argdsc;    ad->type != EP_ARG_INVALID;   ad++) {
+        vptr = args + ad->offs;
+
+        if ((gv = ohm_fact_get(fact, ad->name)) == NULL)
+            continue;
+
+        switch (ad->type) {
+
+        case EP_ARG_STRING:
+            if (G_VALUE_TYPE(gv) == G_TYPE_STRING)
+                *(const char **)vptr = g_value_get_string(gv);
+            break;
+
+        case EP_ARG_INTEGER:
+            if (G_VALUE_TYPE(gv) == G_TYPE_INT)
+                *(int *)vptr = g_value_get_int(gv);
+            break;
+
+        case EP_ARG_LONG:
+            if (G_VALUE_TYPE(gv) == G_TYPE_LONG)
+                *(long *)vptr = g_value_get_long(gv);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+static int legacy_action_parser(OhmFactStore *store, ep_actdsc_t *action)
+{
+    OhmFact *fact;
+    GSList  *list;
+    char    *data;
+    int      success;
+
+    if ((data = malloc(action->datalen)) == NULL)
+        return FALSE;
+
+    success = TRUE;
+
+    for (list  = ohm_fact_store_get_facts_by_name(store, action->name);
+         list != NULL;
+         list  = g_slist_next(list))
+    {
+        fact = (OhmFact *)list->data;
+
+        memset(data, 0, action->datalen);
+
+        if (legacy_get_args(fact, action->argdsc, data))
+            success &= action->handler(NULL, data);
+        else
+            success &= FALSE;
+    }
+
+    free(data);
+
+    return success;
+}
+
+static gboolean legacy_txparser(OhmFactStore *store, GObject *transaction)
+{
+    guint        txid;
+    GSList      *entry, *list;
+    char        *name;
+    ep_actdsc_t *action;
+    gboolean     success;
+    gchar       *signal;
+
+    g_object_get(transaction, "txid" , &txid, NULL);
+    g_object_get(transaction, "facts", &list, NULL);
+    g_object_get(transaction, "signal", &signal, NULL);
+
+    success = TRUE;
+
+    if (!strcmp(signal, SIGNAL)) {
+        for (entry = list; entry != NULL; entry = g_slist_next(entry)) {
+            name = (char *)entry->data;
+            for (action = actions; action->name != NULL; action++) {
+                if (!strcmp(name, action->name))
+                    success &= legacy_action_parser(store, action);
+            }
+        }
+    }
+
+    g_free(signal);
+
+    return success;
+}
+
+
+static GObject *setup(OhmFactStore *store, int nact, int nfact)
+{
+    GObject *transaction;
+    GSList  *facts;
+    OhmFact *fact;
+    char     name[64];
+    int      i, j;
+
+    facts = NULL;
+
+    for (i = 0; i < nact; i++) {
+        snprintf(name, sizeof(name), PREFIX "bench_%d", i);
+
+        actions[i].name    = g_strdup(name);
+        actions[i].handler = bench_action;
+        actions[i].argdsc  = bench_args;
+        actions[i].datalen = sizeof(bench_t);
+
+        for (j = 0; j < nfact; j++) {
+            if ((fact = ohm_fact_new(name)) == NULL)
+                fatal("failed to create fact %s", name);
+
+            ohm_fact_set(fact, "state", ohm_value_from_string("on"));
+            ohm_fact_set(fact, "level", ohm_value_from_int(i * nfact + j));
+            ohm_fact_set(fact, "pid"  , ohm_value_from_long(1000 + j));
+
+            if (!ohm_fact_store_insert(store, fact))
+                fatal("failed to insert fact %s", name);
+        }
+
+        facts = g_slist_append(facts, g_strdup(name));
+    }
+
+    transaction = g_object_new(TRANSACTION_TYPE, NULL);
+    g_object_set(transaction, "signal", SIGNAL, "facts", facts, NULL);
+
+    return transaction;
+}
+
+
+static double usecs(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000.0 +
+        (end->tv_usec - start->tv_usec);
+}
+
+
+int main(int argc, char *argv[])
+{
+    OhmFactStore   *store;
+    ep_decoder_t   *decoder;
+    GObject        *transaction;
+    struct timeval  start, end;
+    unsigned long   legacy_sum, decoder_sum;
+    int             total = DEFAULT_TOTAL;
+    int             nact  = DEFAULT_ACTIONS;
+    int             nfact = DEFAULT_FACTS;
+    int             i, nfailed;
+    double          legacy_us, decoder_us;
+
+    if (argc > 1 && (total = (int)strtol(argv[1], NULL, 10)) <= 0)
+        fatal("invalid number of transactions '%s'", argv[1]);
+    if (argc > 2 && ((nact = (int)strtol(argv[2], NULL, 10)) <= 0 ||
+                     nact > MAX_ACTIONS))
+        fatal("invalid number of actions '%s'", argv[2]);
+    if (argc > 3 && (nfact = (int)strtol(argv[3], NULL, 10)) <= 0)
+        fatal("invalid number of facts per action '%s'", argv[3]);
+
+    g_type_init();
+
+    if ((store = ohm_fact_store_get_fact_store()) == NULL)
+        fatal("failed to get fact store");
+
+    transaction = setup(store, nact, nfact);
+
+    if ((decoder = ep_decoder_create(SIGNAL, actions)) == NULL)
+        fatal("failed to create decoder");
+
+    nfailed = 0;
+
+    checksum = 0;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < total; i++)
+        if (!legacy_txparser(store, transaction))
+            nfailed++;
+    gettimeofday(&end, NULL);
+    legacy_us  = usecs(&start, &end);
+    legacy_sum = checksum;
+
+    checksum = 0;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < total; i++)
+        if (ep_decoder_decode(decoder, transaction, NULL) != TRUE)
+            nfailed++;
+    gettimeofday(&end, NULL);
+    decoder_us  = usecs(&start, &end);
+    decoder_sum = checksum;
+
+    printf("%d transactions, %d actions x %d facts\n", total, nact, nfact);
+    printf("legacy parser: %.3f usecs/transaction\n", legacy_us / total);
+    printf("decoder      : %.3f usecs/transaction\n", decoder_us / total);
+    if (decoder_us > 0)
+        printf("speedup      : %.2fx\n", legacy_us / decoder_us);
+
+    if (legacy_sum != decoder_sum) {
+        fprintf(stderr, "checksum mismatch: legacy %lu, decoder %lu\n",
+                legacy_sum, decoder_sum);
+        nfailed++;
+    }
+
+    ep_decoder_destroy(decoder);
+    g_object_unref(transaction);
+
+    printf("%s\n", nfailed ? "FAILED" : "PASSED");
+
+    return nfailed ? 1 : 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
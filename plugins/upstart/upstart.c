@@ -37,6 +37,8 @@ USA.
 #include <ohm/ohm-plugin-debug.h>
 #include <ohm/ohm-fact.h>
 
+#include "fact-watch.h"
+
 /* This plugin has two features:
  *
  * First, it emits an upstart signal when ohmd enters the idle loop the
@@ -56,11 +58,12 @@ extern char **environ;
 OHM_IMPORTABLE(int, resolve, (char *goal, char **locals));
 OHM_PLUGIN_REQUIRES_METHODS(upstart, 1,
     OHM_IMPORT("dres.resolve", resolve));
+OHM_PLUGIN_REQUIRES("signaling");
 
 static int DBG_UPSTART;
 
 static unsigned int init_id;
-static gulong updated_id;
+static int updated_id;
 static gulong enable_notifications_id;
 
 OHM_DEBUG_PLUGIN(upstart,
@@ -91,7 +94,6 @@ static int enable_notifications_cb(void *data)
 static int init_cb(void *data)
 {
     (void) data;
-    OhmFactStore *fs = ohm_fact_store_get_fact_store();
 
     gboolean retval;
     GPid pid;
@@ -103,8 +105,8 @@ static int init_cb(void *data)
     retval = g_spawn_async(NULL, argv, NULL, 0, NULL, NULL, &pid, NULL);
 
     /* no need to keep on listening to the signal */
-    if (g_signal_handler_is_connected(G_OBJECT(fs), updated_id)) {
-        g_signal_handler_disconnect(G_OBJECT(fs), updated_id);
+    if (updated_id > 0) {
+        fact_unsubscribe(updated_id);
         updated_id = 0;
     }
 
@@ -114,44 +116,18 @@ static int init_cb(void *data)
     return FALSE;
 }
 
-static void updated_cb(void *data, OhmFact *fact, GQuark fldquark, gpointer value) {
-
+static void updated_cb(OhmFact *fact, GQuark field, GValue *value, void *data)
+{
+    (void) fact;
+    (void) field;
     (void) data;
 
-    GValue *gval = (GValue *)value;
-    const char *name;
-
-    if (fact == NULL) {
-        OHM_DEBUG(DBG_UPSTART, "%s() called with null fact pointer", __FUNCTION__);
-        return;
-    }
-
-    if (value == NULL) {
-        OHM_DEBUG(DBG_UPSTART, "%s() called with null value pointer", __FUNCTION__);
-        return;
-    }
+    /* the state of the signaling plugin fact changed */
 
-    name = (char *) ohm_structure_get_name(OHM_STRUCTURE(fact));
-    if (!strcmp(name, "com.nokia.policy.plugin")) {
-        GValue *name;
-        if ((name = ohm_fact_get(fact, "name")) != NULL) {
-            if (G_VALUE_TYPE(name) == G_TYPE_STRING) {
-                if (!strcmp(g_value_get_string(name), "signaling")) {
-
-                    /* there was a change in signaling plugin fact */
-
-                    char *fieldname = (char *) g_quark_to_string(fldquark);
-
-                    if (!strcmp(fieldname, "state") && G_VALUE_TYPE(gval) == G_TYPE_STRING) {
-                        /* it was the state that changed */
-                        if (!strcmp(g_value_get_string(gval), "signaled")) {
-                            /* emit the signal in the next idle loop */
-                            init_id = g_idle_add(init_cb, NULL);
-                        }
-                    }
-                }
-            }
-        }
+    if (G_VALUE_TYPE(value) == G_TYPE_STRING &&
+            !strcmp(g_value_get_string(value), "signaled") && init_id == 0) {
+        /* emit the signal in the next idle loop */
+        init_id = g_idle_add(init_cb, NULL);
     }
 }
 
@@ -178,7 +154,12 @@ static void plugin_init(OhmPlugin *plugin)
      * been initialized. Thus we don't check the signaling fact state
      * here but instead assume that it has been initialized as something
      * else than 'signaled'. */
-    updated_id = g_signal_connect(G_OBJECT(fs), "updated" , G_CALLBACK(updated_cb) , NULL);
+    if (fact_watch_import())
+        updated_id = fact_subscribe("upstart", "com.nokia.policy.plugin",
+                                    "state", "name", "signaling",
+                                    updated_cb, NULL);
+    if (updated_id <= 0)
+        OHM_ERROR("upstart: failed to subscribe to signaling plugin state");
 
     respawn = getenv("UPSTART_JOB_RESPAWNED");
 
@@ -240,8 +221,8 @@ static void plugin_exit(OhmPlugin *plugin)
         return;
     }
 
-    if (g_signal_handler_is_connected(G_OBJECT(fs), updated_id)) {
-        g_signal_handler_disconnect(G_OBJECT(fs), updated_id);
+    if (updated_id > 0) {
+        fact_unsubscribe(updated_id);
         updated_id = 0;
     }
 
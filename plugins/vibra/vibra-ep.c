@@ -19,6 +19,7 @@ USA.
 
 
 #include "vibra-plugin.h"
+#include "ep-decoder.h"
 
 
 /*
@@ -35,6 +36,9 @@ typedef void (*ep_cb_t) (GObject *, GObject *, gboolean);
 static void     policy_decision (GObject *, GObject *, ep_cb_t, gpointer);
 static void     policy_keychange(GObject *, GObject *, gpointer);
 static gboolean txparser        (GObject *, GObject *, gpointer);
+static int      txparser_init   (void);
+
+static ep_decoder_t *decoder;
 
 
 /********************
@@ -58,6 +62,11 @@ ep_init(vibra_context_t *ctx, GObject *(*signaling_register)(gchar *, gchar **))
         exit(1);
     }
 
+    if (!txparser_init()) {
+        OHM_ERROR("vibra: failed to create policy decision decoder");
+        exit(1);
+    }
+
     ctx->sigdcn = g_signal_connect(ctx->sigconn, "on-decision",
                                    G_CALLBACK(policy_decision),  (gpointer)ctx);
     ctx->sigkey = g_signal_connect(ctx->sigconn, "on-key-change",
@@ -84,6 +93,9 @@ ep_exit(vibra_context_t *ctx, gboolean (*signaling_unregister)(GObject *ep))
     }
     
     ctx->sigconn = NULL;
+
+    decoder_destroy(decoder);
+    decoder = NULL;
 }
 
 
@@ -122,11 +134,12 @@ policy_keychange(GObject *ep, GObject *tx, gpointer data)
  * mute_action
  ********************/
 static int
-mute_action(vibra_context_t *ctx, void *data)
+mute_action(void *user_data, void *data)
 {
-    mute_t        *action = (mute_t *)data;
-    vibra_group_t *group;
-    int            state;
+    vibra_context_t *ctx    = (vibra_context_t *)user_data;
+    mute_t          *action = (mute_t *)data;
+    vibra_group_t   *group;
+    int              state;
     
     state = !strcmp(action->state, "unmuted");
 
@@ -150,154 +163,37 @@ mute_action(vibra_context_t *ctx, void *data)
 
 #define PREFIX   "com.nokia.policy."
 #define MUTE     PREFIX"vibra_mute"
-#define STRUCT_OFFSET(s,m) ((char *)&(((s *)0)->m) - (char *)0)
-
-typedef int (*action_t)(vibra_context_t *, void *);
-
-typedef enum {
-    argtype_invalid = 0,
-    argtype_string,
-    argtype_integer,
-    argtype_unsigned
-} argtype_t;
-
-typedef struct {		/* argument descriptor for actions */
-    argtype_t   type;
-    const char *name;
-    int         offs;
-} argdsc_t; 
-
-typedef struct {		/* action descriptor */
-    const char *name;
-    action_t    handler;
-    argdsc_t   *argdsc;
-    int         datalen;
-} actdsc_t;
-
-static argdsc_t mute_args[] = {
-    { argtype_string , "group", STRUCT_OFFSET(mute_t, group) },
-    { argtype_string , "mute" , STRUCT_OFFSET(mute_t, state) },
-    { argtype_invalid,  NULL  , 0                            }
+
+static ep_argdsc_t mute_args[] = {
+    { EP_ARG_STRING , "group", EP_STRUCT_OFFSET(mute_t, group) },
+    { EP_ARG_STRING , "mute" , EP_STRUCT_OFFSET(mute_t, state) },
+    { EP_ARG_INVALID,  NULL  , 0                               }
 };
 
-static actdsc_t actions[] = {
+static ep_actdsc_t actions[] = {
     { MUTE, mute_action, mute_args, sizeof(mute_t) },
     { NULL, NULL       , NULL     , 0              }
 };
 
-static int action_parser(actdsc_t *, vibra_context_t *);
-static int get_args     (OhmFact  *, argdsc_t *, void *);
-
-
-static gboolean
-txparser(GObject *conn, GObject *transaction, gpointer data)
-{
-    vibra_context_t *ctx = (vibra_context_t *)data;
-    guint            txid;
-    GSList          *entry, *list;
-    char            *name;
-    actdsc_t        *action;
-    gboolean         success;
-    gchar           *signal;
-
-    (void)conn;
-
-    g_object_get(transaction, "txid" , &txid, NULL);
-    g_object_get(transaction, "facts", &list, NULL);
-    g_object_get(transaction, "signal", &signal, NULL);
-    
-    success = TRUE;
-
-    if (!strcmp(signal, VIBRA_ACTIONS)) {
-        for (entry = list; entry != NULL; entry = g_slist_next(entry)) {
-            name = (char *)entry->data;
-            for (action = actions; action->name != NULL; action++) {
-                if (!strcmp(name, action->name))
-                    success &= action_parser(action, ctx);
-            }
-        }
-    }
-
-    g_free(signal);
-    
-    return success;
-}
 
-static int action_parser(actdsc_t *action, vibra_context_t *ctx)
+static int
+txparser_init(void)
 {
-    OhmFact *fact;
-    GSList  *list;
-    char    *data;
-    int      success;
-
-    if ((data = malloc(action->datalen)) == NULL) {
-        OHM_ERROR("Can't allocate %d byte memory", action->datalen);
-
+    if (!ep_decoder_import())
         return FALSE;
-    }
-
-    success = TRUE;
 
-    for (list  = ohm_fact_store_get_facts_by_name(ctx->store, action->name);
-         list != NULL;
-         list  = g_slist_next(list))
-    {
-        fact = (OhmFact *)list->data;
-
-        memset(data, 0, action->datalen);
-
-        if (get_args(fact, action->argdsc, data))
-            success &= action->handler(ctx, data);
-        else {
-            OHM_DEBUG(DBG_ACTION, "argument parsing error for action '%s'",
-                      action->name);
-            success &= FALSE;
-        }
-    }
+    decoder = decoder_create(VIBRA_ACTIONS, actions);
 
-    free(data);
-    
-    return success;
+    return decoder != NULL;
 }
 
-static int get_args(OhmFact *fact, argdsc_t *argdsc, void *args)
-{
-    argdsc_t *ad;
-    GValue   *gv;
-    void     *vptr;
-
-    if (fact == NULL)
-        return FALSE;
-
-    for (ad = argdsc;    ad->type != argtype_invalid;   ad++) {
-        vptr = args + ad->offs;
 
-        if ((gv = ohm_fact_get(fact, ad->name)) == NULL)
-            continue;
-
-        switch (ad->type) {
-
-        case argtype_string:
-            if (G_VALUE_TYPE(gv) == G_TYPE_STRING)
-                *(const char **)vptr = g_value_get_string(gv);
-            break;
-
-        case argtype_integer:
-            if (G_VALUE_TYPE(gv) == G_TYPE_INT)
-                *(int *)vptr = g_value_get_int(gv);
-            break;
-
-        case argtype_unsigned:
-            if (G_VALUE_TYPE(gv) == G_TYPE_UINT)
-                *(unsigned int *)vptr = g_value_get_uint(gv);
-            break;
-
-        default:
-            break;
-        }
-    }
+static gboolean
+txparser(GObject *conn, GObject *transaction, gpointer data)
+{
+    (void)conn;
 
-    return TRUE;
+    return decoder_decode(decoder, transaction, data) != FALSE;
 }
 
 /*
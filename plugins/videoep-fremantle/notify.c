@@ -19,6 +19,14 @@ USA.
 
 
 #define STARTUP_BLOCK_TIME  (2 * 60) /* 2 minutes */
+#define MAX_DGRAMS_PER_WAKEUP  32      /* don't starve the main loop */
+
+enum {                                 /* notification kinds */
+    NOTIFY_SYSTEMUI = 0,
+    NOTIFY_CALLUI,
+    NOTIFY_ROTATION,
+    NOTIFY_KINDS
+};
 
 static int       setup_notify_connection(notify_t *, unsigned short);
 static void      teardown_notify_connection(notify_t *);
@@ -28,6 +36,8 @@ static int       dres_rotation_notify(notify_t *, int);
 static int       parse_systemui_notification(char *, int *);
 static int       parse_callui_notification(char *, int *);
 static int       parse_rotation_notification(char *, int *);
+static void      parse_notifications(notify_t *, char *, int, int *);
+static void      apply_notifications(notify_t *, int *);
 static gboolean  notify_cb(GIOChannel *, GIOCondition, gpointer);
 
 
@@ -58,6 +68,11 @@ static notify_t *notify_init(unsigned short port)
 static void notify_exit(notify_t *notif)
 {
     if (notif != NULL) {
+        OHM_DEBUG(DBG_INFO, "%u datagrams in %u wakeups, %u notifications, "
+                  "%u collapsed, %u resolver calls", notif->ndgram,
+                  notif->nwakeup, notif->nnotif, notif->ncollapsed,
+                  notif->nresolve);
+
         teardown_notify_connection(notif);
         free(notif);
     }
@@ -284,6 +299,95 @@ static int parse_rotation_notification(char *msg, int *length)
 }
 
 
+/*
+ * Notes:
+ *   A datagram can carry several newline separated notifications and
+ *   popups or rotations tend to arrive in bursts. Every notification is
+ *   parsed in place in the receive buffer and only the last state of each
+ *   kind is kept in pending[]; earlier ones of the same kind are
+ *   superseded. The resolver is called once per kind afterwards.
+ */
+
+static void parse_notifications(notify_t *notif, char *buf, int len,
+                                int *pending)
+{
+    char *p, *e;
+    int   l;
+    int   kind;
+    int   value;
+
+    while (len > 0 && buf[len-1] == '\0')
+        len--;
+
+    for (p = buf, e = buf + len;   p < e && *p;   p += l) {
+        l     = 0;
+        kind  = -1;
+        value = -1;
+
+        switch (*p) {
+        case 's':
+            if ((value = parse_systemui_notification(p, &l)) >= 0)
+                kind = NOTIFY_SYSTEMUI;
+            break;
+        case 'c':
+            if ((value = parse_callui_notification(p, &l)) >= 0)
+                kind = NOTIFY_CALLUI;
+            break;
+        case 'r':
+            if ((value = parse_rotation_notification(p, &l)) >= 0)
+                kind = NOTIFY_ROTATION;
+            break;
+        default:
+            break;
+        }
+
+        if (kind < 0) {
+            /* skip the unknown line */
+            for (l = 0;  p + l < e && p[l] != '\0';  l++) {
+                if (p[l] == '\n') {
+                    l++;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        OHM_DEBUG(DBG_INFO, "%s: %d", kind == NOTIFY_SYSTEMUI ? "systemui" :
+                  kind == NOTIFY_CALLUI ? "callui" : "rotation-transition",
+                  value);
+
+        if (pending[kind] >= 0)
+            notif->ncollapsed++;
+
+        pending[kind] = value;
+        notif->nnotif++;
+    }
+}
+
+static void apply_notifications(notify_t *notif, int *pending)
+{
+    if (pending[NOTIFY_SYSTEMUI] >= 0 &&
+        pending[NOTIFY_SYSTEMUI] != notif->sysui) {
+        notif->sysui = pending[NOTIFY_SYSTEMUI];
+        dres_systemui_notify(notif, notif->sysui);
+        notif->nresolve++;
+    }
+
+    if (pending[NOTIFY_CALLUI] >= 0 &&
+        pending[NOTIFY_CALLUI] != notif->callui) {
+        notif->callui = pending[NOTIFY_CALLUI];
+        dres_callui_notify(notif, notif->callui);
+        notif->nresolve++;
+    }
+
+    if (pending[NOTIFY_ROTATION] >= 0 &&
+        pending[NOTIFY_ROTATION] != notif->transit) {
+        notif->transit = pending[NOTIFY_ROTATION];
+        dres_rotation_notify(notif, notif->transit);
+        notif->nresolve++;
+    }
+}
+
 static gboolean notify_cb(GIOChannel *ch, GIOCondition cond, gpointer data)
 {
     notify_t        *notif = (notify_t *)data;
@@ -291,12 +395,10 @@ static gboolean notify_cb(GIOChannel *ch, GIOCondition cond, gpointer data)
     gboolean         retval;
     char             buf[156];
     int              len;
-    char            *p, *e;
-    int              l;
+    int              n;
     time_t           now;
-    int              sysui;
-    int              callui;
-    int              transit;
+    int              blocked;
+    int              pending[NOTIFY_KINDS];
 
     if (ch != notif->chan) {
         OHM_ERROR("videoep: %s(): confused with data structures",
@@ -313,21 +415,39 @@ static gboolean notify_cb(GIOChannel *ch, GIOCondition cond, gpointer data)
         else {
             retval = TRUE;
 
-            for (;;) {
-                if ((len = recv(notif->sockfd, buf,sizeof(buf)-1, 0)) < 0) {
-                    if (errno == EINTR)
-                        continue;
-                }
-                break;
-            }
-
             if (clock_gettime(CLOCK_MONOTONIC, &tp) < 0)
                 now = time(NULL);
             else
                 now = tp.tv_sec;
 
+            blocked = (now - notif->start) <= STARTUP_BLOCK_TIME;
+
+            pending[NOTIFY_SYSTEMUI] = -1;
+            pending[NOTIFY_CALLUI]   = -1;
+            pending[NOTIFY_ROTATION] = -1;
+
+            notif->nwakeup++;
+
+            /* drain whatever has been queued up since the last wakeup */
+            for (n = 0;  n < MAX_DGRAMS_PER_WAKEUP;  n++) {
+                len = recv(notif->sockfd, buf, sizeof(buf)-1, MSG_DONTWAIT);
+
+                if (len < 0) {
+                    if (errno == EINTR) {
+                        n--;
+                        continue;
+                    }
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        OHM_ERROR("videoep: failed to receive notification: "
+                                  "%s", strerror(errno));
+                    break;
+                }
+
+                notif->ndgram++;
+
+                if (blocked)
+                    continue;
 
-            if ((now - notif->start) > STARTUP_BLOCK_TIME) {
                 buf[len] = '\0';
 
 #           if 0
@@ -346,49 +466,11 @@ static gboolean notify_cb(GIOChannel *ch, GIOCondition cond, gpointer data)
                 }
 #           endif
 
-                while (len > 0 && buf[len-1] == '\0')
-                    len--;
-
-                for (p = buf;   *p  && p < (buf + len);   p += l) {
-
-                    if ((sysui = parse_systemui_notification(p, &l)) >= 0) {
-
-                        OHM_DEBUG(DBG_INFO, "systemui: %d", sysui);
-                        
-                        if (sysui != notif->sysui) {
-                            dres_systemui_notify(notif, sysui);
-                            notif->sysui = sysui;
-                        }
-                    }
-                    else if ((callui = parse_callui_notification(p, &l)) >= 0){
-
-                        OHM_DEBUG(DBG_INFO, "callui: %d", callui);
-                        
-                        if (callui != notif->callui) {
-                            dres_callui_notify(notif, callui);
-                            notif->callui = callui;
-                        }
-                    }
-                    else if ((transit = parse_rotation_notification(p,&l))>=0){
-                        
-                        OHM_DEBUG(DBG_INFO, "rotation-transition: %d",transit);
-                        
-                        if (transit !=  notif->transit) {
-                            dres_rotation_notify(notif, transit);
-                            notif->transit = transit;
-                        }
-                    }
-                    else {
-                        for (l = 0;  p[l] != '\0';  l++) {
-                            if (p[l] == '\n') {
-                                l++;
-                                break;
-                            }
-                        }
-                    }
-
-                } /* for */
+                parse_notifications(notif, buf, len, pending);
             }
+
+            if (!blocked)
+                apply_notifications(notif, pending);
         }
     }
 
@@ -30,6 +30,11 @@ typedef struct notify_s {
     int             transit;
     int             sysui;
     int             callui;
+    unsigned int    nwakeup;            /* statistics */
+    unsigned int    ndgram;
+    unsigned int    nnotif;
+    unsigned int    ncollapsed;
+    unsigned int    nresolve;
 } notify_t;
 
 static notify_t *notify_init(unsigned short);
@@ -22,7 +22,10 @@ USA.
 #define __OHM_TXPARSER_H__
 
 #include "videoep.h"
+#include "ep-decoder.h"
 
+static int      txparser_init(void);
+static void     txparser_exit(void);
 static gboolean txparser(GObject *, GObject *, gpointer);
 
 
@@ -127,6 +127,11 @@ static void plugin_init(OhmPlugin *plugin)
             break;
         }
 
+        if (!txparser_init()) {
+            OHM_ERROR("videoep: failed to create policy decision decoder");
+            break;
+        }
+
         if ((conn = register_ep("videoep", signals)) == NULL) {
             OHM_ERROR("videoep: Failed to initialize VieoEP");
             break;
@@ -163,6 +168,8 @@ static void plugin_init(OhmPlugin *plugin)
     if (conn != NULL)
         unregister_ep(videoep->conn);
 
+    txparser_exit();
+
     free(videoep);
 }
 
@@ -179,6 +186,7 @@ static void plugin_exit(OhmPlugin *plugin)
 
         xrt_exit(videoep->xr);
         notify_exit(videoep->notif);
+        txparser_exit();
 
         free(videoep);
     }
@@ -61,6 +61,11 @@ static int  query_attribute(xrt_t *, xrt_attribute_t *);
 static void finish_attribute_query(xrt_t *, void *, void *);
 static void check_if_attribute_queries_are_complete(xrt_t *,xrt_attribute_t *);
 static int  set_attribute(xrt_t *, xrt_attribute_t *, int32_t);
+static int  stage_attribute(xrt_t *, xrt_attribute_t *, int32_t);
+static int  flush_attributes(xrt_t *);
+static void invalidate_attributes(xrt_t *);
+static void select_events(xrt_t *);
+static void handle_event(xrt_t *, xcb_generic_event_t *);
 static int  rque_is_full(xrt_rque_t *);
 static int  rque_append_request(xrt_rque_t *, unsigned int,
                                 xrt_reply_handler_t, void *);
@@ -89,6 +94,10 @@ static void xrt_exit(xrt_t *xr)
 {
     if (xr != NULL) {
 
+        OHM_DEBUG(DBG_XV, "%u attribute writes in %u flushes, "
+                  "%u unchanged ones skipped", xr->nwrite, xr->nflush,
+                  xr->nskip);
+
         disconnect_from_xserver(xr);
 
         free(xr->display);
@@ -121,6 +130,8 @@ static void xrt_connect_to_xserver(xrt_t *xr)
         }
     }
 
+    select_events(xr);
+
     query_attrdef(xr, &clone_to_tvout);
     query_attrdef(xr, &tvout_standard);
 
@@ -140,29 +151,32 @@ static int xrt_not_connected_to_xserver(xrt_t *xr)
     return FALSE;
 }
 
+/*
+ * Notes:
+ *   Attribute values are cached per adaptor. Changes are staged first and
+ *   then written in one go with a single flush; writes of values the
+ *   server already has are skipped. The cache is trusted until an Xvideo
+ *   or RandR event or an X error marks it stale, in which case the next
+ *   write goes out unconditionally and revalidates it.
+ */
+
 static int xrt_clone_to_tvout(xrt_t *xr, xrt_clone_type_t clone)
 {
     int32_t        enable   = (clone == xrt_do_not_clone) ? 0 : 1;
     int32_t        standard = clone - xrt_clone_pal; /* dirty but fast */
-    int            retval   = 0;
     xrt_adaptor_t *adaptor;
 
     for (adaptor = xr->adaptors;   adaptor != NULL;  adaptor = adaptor->next) {
         if (adaptor->clone.valid) {
-            if (enable   != adaptor->clone.value ||
-                standard != adaptor->tvstd.value   )
-            {
-                set_attribute(xr, &adaptor->tvstd, standard);
-
-                if (set_attribute(xr, &adaptor->clone, enable) < 0)
-                    retval = -1;
-                else
-                    xcb_flush(xr->xconn);
-            }
+            /* the standard is irrelevant when not cloning */
+            if (enable)
+                stage_attribute(xr, &adaptor->tvstd, standard);
+
+            stage_attribute(xr, &adaptor->clone, enable);
         }
     }
 
-    return retval;
+    return flush_attributes(xr);
 }
 
 static int connect_to_xserver(xrt_t *xr)
@@ -492,6 +506,8 @@ static void finish_adaptor_query(xrt_t *xr, void *reply_data, void *user_data)
                      adaptor->name, adinf->num_ports,
                      adaptor->portbeg, adaptor->portend);
 
+            xcb_xv_select_port_notify(xr->xconn, adaptor->portbeg, TRUE);
+
             query_attribute(xr, &adaptor->clone);
             query_attribute(xr, &adaptor->tvstd);
 
@@ -611,10 +627,10 @@ static void finish_attribute_query(xrt_t *xr, void *reply_data,void *user_data)
     xrt_attribute_t *attr = user_data;
     xrt_attrdef_t   *def = attr->def;
 
-    if (!attr->valid)
-        *(attr->flags) |= def->bit;
+    *(attr->flags) |= def->bit;
 
-    if (reply) {
+    /* if we have written the attribute meanwhile, the reply is outdated */
+    if (reply && !attr->valid) {
         attr->valid = TRUE;
         attr->value = reply->value;
 
@@ -653,24 +669,166 @@ static int set_attribute(xrt_t *xr, xrt_attribute_t *attr, int32_t value)
     if (xr->xconn == NULL || xcb_connection_has_error(xr->xconn))
         return -1;
 
-    if (rque_is_full(&xr->rque)) {
-        OHM_ERROR("videoep: request queue is full");
-        return -1;
-    }
-
     ckie = xcb_xv_set_port_attribute(xr->xconn, adaptor->portbeg,
                                      def->atom, value);
         
     if (xcb_connection_has_error(xr->xconn)) {
-        OHM_ERROR("videoep: failed to query attribute '%s' ", def->name);
+        OHM_ERROR("videoep: failed to set attribute '%s' ", def->name);
+        return -1;
+    }
+
+    (void)ckie;
+
+    OHM_DEBUG(DBG_XV, "attribute '%s' of '%s' set to %d", def->name,
+              adaptor->name, value);
+
+    /* assume the write succeeds; errors invalidate the cache */
+    attr->valid = TRUE;
+    attr->value = value;
+    attr->stale = FALSE;
+
+    xr->nwrite++;
+
+    return 0;
+}
+
+static int stage_attribute(xrt_t *xr, xrt_attribute_t *attr, int32_t value)
+{
+    if (!attr->def->valid)
         return -1;
+
+    if (attr->valid && !attr->stale && attr->value == value) {
+        attr->dirty = FALSE;
+        xr->nskip++;
+        return 0;
     }
 
-    query_attribute(xr, attr);
+    attr->pending = value;
+    attr->dirty   = TRUE;
 
     return 0;
 }
 
+static int flush_attributes(xrt_t *xr)
+{
+    xrt_adaptor_t   *adaptor;
+    xrt_attribute_t *attrs[2];
+    int              i, n, retval;
+
+    retval = 0;
+    n      = 0;
+
+    for (adaptor = xr->adaptors;   adaptor != NULL;  adaptor = adaptor->next) {
+        /* the standard must be in place before cloning is enabled */
+        attrs[0] = &adaptor->tvstd;
+        attrs[1] = &adaptor->clone;
+
+        for (i = 0;  i < 2;  i++) {
+            if (!attrs[i]->dirty)
+                continue;
+
+            attrs[i]->dirty = FALSE;
+
+            if (set_attribute(xr, attrs[i], attrs[i]->pending) < 0)
+                retval = -1;
+            else
+                n++;
+        }
+    }
+
+    if (n > 0) {
+        xcb_flush(xr->xconn);
+        xr->nflush++;
+    }
+
+    return retval;
+}
+
+static void invalidate_attributes(xrt_t *xr)
+{
+    xrt_adaptor_t *adaptor;
+
+    for (adaptor = xr->adaptors;   adaptor != NULL;  adaptor = adaptor->next) {
+        adaptor->clone.stale = TRUE;
+        adaptor->tvstd.stale = TRUE;
+    }
+}
+
+static void select_events(xrt_t *xr)
+{
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_iterator_t              si;
+
+    xr->xvevent = 0;
+    xr->rrevent = 0;
+
+    if ((ext = xcb_get_extension_data(xr->xconn, &xcb_xv_id)) != NULL &&
+        ext->present)
+        xr->xvevent = ext->first_event;
+
+    if ((ext = xcb_get_extension_data(xr->xconn, &xcb_randr_id)) != NULL &&
+        ext->present)
+    {
+        xr->rrevent = ext->first_event;
+
+        for (si = xcb_setup_roots_iterator(xcb_get_setup(xr->xconn));
+             si.rem;
+             xcb_screen_next(&si))
+        {
+            xcb_randr_select_input(xr->xconn, si.data->root,
+                                   XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
+                                   XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE);
+        }
+    }
+}
+
+static void handle_event(xrt_t *xr, xcb_generic_event_t *ev)
+{
+    xcb_xv_port_notify_event_t *pn;
+    xrt_adaptor_t              *adaptor;
+    xrt_attribute_t            *attr;
+    uint8_t                     type = ev->response_type & ~0x80;
+
+    OHM_DEBUG(DBG_XV, "got event %d", ev->response_type);
+
+    if (type == 0) {
+        /* one of our writes may have failed */
+        invalidate_attributes(xr);
+        return;
+    }
+
+    if (xr->xvevent && type == xr->xvevent + XCB_XV_PORT_NOTIFY) {
+        pn = (xcb_xv_port_notify_event_t *)ev;
+
+        for (adaptor = xr->adaptors;  adaptor != NULL;  adaptor = adaptor->next){
+            if (pn->port != adaptor->portbeg)
+                continue;
+
+            if (adaptor->clone.def->valid &&
+                pn->attribute == adaptor->clone.def->atom)
+                attr = &adaptor->clone;
+            else if (adaptor->tvstd.def->valid &&
+                     pn->attribute == adaptor->tvstd.def->atom)
+                attr = &adaptor->tvstd;
+            else
+                continue;
+
+            attr->valid = TRUE;
+            attr->value = pn->value;
+            attr->stale = FALSE;
+
+            OHM_DEBUG(DBG_XV, "attribute '%s' of '%s' changed to %d",
+                      attr->def->name, adaptor->name, pn->value);
+        }
+
+        return;
+    }
+
+    if (xr->rrevent && (type == xr->rrevent + XCB_RANDR_SCREEN_CHANGE_NOTIFY ||
+                        type == xr->rrevent + XCB_RANDR_NOTIFY))
+        invalidate_attributes(xr);
+}
+
 
 
 static int rque_is_full(xrt_rque_t *rque)
@@ -761,7 +919,8 @@ static gboolean xio_cb(GIOChannel *ch, GIOCondition cond, gpointer data)
         else {
 
             while ((ev = xcb_poll_for_event(xr->xconn)) != NULL) {
-                OHM_DEBUG(DBG_XV, "got event %d", ev->response_type);
+                handle_event(xr, ev);
+                free(ev);
             }
 
             while (rque_poll_reply(xr->xconn, &xr->rque, &reply, &hlr, &ud)) {
@@ -64,7 +64,10 @@ typedef struct {
     xrt_attrdef_t        *def;
     unsigned int         *flags;
     int                   valid;
-    int32_t               value;
+    int32_t               value;   /* cached value in the server */
+    int                   stale;   /* cache needs to be revalidated */
+    int                   dirty;   /* pending is to be written */
+    int32_t               pending; /* value of the next flush */
 } xrt_attribute_t;
 
 typedef struct xrt_adaptor_s {
@@ -90,6 +93,11 @@ typedef struct xrt_s {
     int               ready;
     int               set;
     xrt_adaptor_t    *adaptors; /*  */
+    uint8_t           xvevent;  /* first Xvideo event code */
+    uint8_t           rrevent;  /* first RandR event code, if any */
+    unsigned int      nwrite;   /* attribute writes sent */
+    unsigned int      nskip;    /* unchanged writes skipped */
+    unsigned int      nflush;   /* flushes of staged writes */
 } xrt_t;
 
 static xrt_t *xrt_init(const char *);